@@ -0,0 +1,105 @@
+# generates the string tables declared in threepp/renderers/gl/shader/ShaderSources.h from the
+# GLSL files in the ShaderChunk and ShaderLib directories. The #include directives of the library
+# shaders are resolved here, into references to the chunk table
+#
+# usage: cmake -DCHUNK_DIR=<dir> -DLIB_DIR=<dir> -DOUTPUT=<file> -P embed_shaders.cmake
+
+cmake_minimum_required(VERSION 3.8)
+
+file(GLOB CHUNK_FILES ${CHUNK_DIR}/*.glsl)
+file(GLOB LIB_FILES ${LIB_DIR}/*.glsl)
+
+# the tables are searched by name
+set(CHUNK_NAMES)
+foreach(FILE ${CHUNK_FILES})
+    get_filename_component(NAME ${FILE} NAME_WE)
+    list(APPEND CHUNK_NAMES ${NAME})
+endforeach(FILE)
+list(SORT CHUNK_NAMES)
+
+set(LIB_NAMES)
+foreach(FILE ${LIB_FILES})
+    get_filename_component(NAME ${FILE} NAME_WE)
+    list(APPEND LIB_NAMES ${NAME})
+endforeach(FILE)
+list(SORT LIB_NAMES)
+
+set(CHUNKS "")
+foreach(NAME ${CHUNK_NAMES})
+    file(READ ${CHUNK_DIR}/${NAME}.glsl TEXT)
+    string(APPEND CHUNKS "  {\"${NAME}\", R\"glsl(${TEXT})glsl\"},\n")
+endforeach(NAME)
+
+set(PIECES "")
+set(PIECE_COUNT 0)
+set(SOURCES "")
+foreach(NAME ${LIB_NAMES})
+    set(FILE ${LIB_DIR}/${NAME}.glsl)
+    file(READ ${FILE} REST)
+
+    set(FIRST ${PIECE_COUNT})
+
+    while(TRUE)
+        string(REGEX MATCH "#include +<([A-Za-z0-9_.]+)>" DIRECTIVE "${REST}")
+        if(NOT DIRECTIVE)
+            break()
+        endif(NOT DIRECTIVE)
+        set(CHUNK ${CMAKE_MATCH_1})
+
+        list(FIND CHUNK_NAMES ${CHUNK} INDEX)
+        if(INDEX LESS 0)
+            message(FATAL_ERROR "${FILE}: unable to resolve #include <${CHUNK}>")
+        endif(INDEX LESS 0)
+
+        string(FIND "${REST}" "${DIRECTIVE}" POS)
+        if(POS GREATER 0)
+            string(SUBSTRING "${REST}" 0 ${POS} TEXT)
+            string(APPEND PIECES "  {R\"glsl(${TEXT})glsl\", -1},\n")
+            math(EXPR PIECE_COUNT "${PIECE_COUNT} + 1")
+        endif(POS GREATER 0)
+
+        string(APPEND PIECES "  {nullptr, ${INDEX}},\n")
+        math(EXPR PIECE_COUNT "${PIECE_COUNT} + 1")
+
+        string(LENGTH "${DIRECTIVE}" LENGTH)
+        math(EXPR POS "${POS} + ${LENGTH}")
+        string(SUBSTRING "${REST}" ${POS} -1 REST)
+    endwhile(TRUE)
+
+    if(NOT REST STREQUAL "")
+        string(APPEND PIECES "  {R\"glsl(${REST})glsl\", -1},\n")
+        math(EXPR PIECE_COUNT "${PIECE_COUNT} + 1")
+    endif(NOT REST STREQUAL "")
+
+    math(EXPR COUNT "${PIECE_COUNT} - ${FIRST}")
+    string(APPEND SOURCES "  {\"${NAME}\", ${FIRST}, ${COUNT}},\n")
+endforeach(NAME)
+
+list(LENGTH CHUNK_NAMES CHUNK_COUNT)
+list(LENGTH LIB_NAMES SOURCE_COUNT)
+
+set(CONTENT "// generated by etc/embed_shaders.cmake, do not edit
+
+#include <threepp/renderers/gl/shader/ShaderSources.h>
+
+namespace three {
+namespace gl {
+namespace shadersources {
+
+const Chunk chunks[] = {
+${CHUNKS}};
+const size_t chunk_count = ${CHUNK_COUNT};
+
+const Piece pieces[] = {
+${PIECES}};
+
+const LibSource lib_sources[] = {
+${SOURCES}};
+const size_t lib_source_count = ${SOURCE_COUNT};
+
+}
+}
+}
+")
+
+file(WRITE ${OUTPUT} "${CONTENT}")
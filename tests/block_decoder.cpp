@@ -0,0 +1,237 @@
+//
+// Created by byter on 17.10.26.
+//
+// CPU decoding of block compressed textures: single blocks with known texels, image edges and
+// invalid input
+
+#include <threepp/textures/BlockDecoder.h>
+#include "check.h"
+
+using namespace three;
+
+using Block = std::vector<byte>;
+
+struct Rgba
+{
+  int r, g, b, a;
+};
+
+Mipmap mipmap(const Block &data, int width=4, int height=4)
+{
+  Mipmap result;
+  result.data = data;
+  result.width = width;
+  result.height = height;
+  return result;
+}
+
+//decode a single 4x4 block
+std::vector<byte> decode(TextureFormat format, const Block &block)
+{
+  std::vector<byte> rgba;
+  CHECK(blocks::decode(format, mipmap(block), rgba));
+  CHECK(rgba.size() == 64);
+  return rgba;
+}
+
+bool texel(const std::vector<byte> &rgba, size_t index, const Rgba &expected)
+{
+  const byte *t = rgba.data() + index * 4;
+  return t[0] == expected.r && t[1] == expected.g && t[2] == expected.b && t[3] == expected.a;
+}
+
+bool all(const std::vector<byte> &rgba, const Rgba &expected)
+{
+  for(size_t i = 0; i < rgba.size() / 4; i++)
+    if(!texel(rgba, i, expected)) return false;
+  return true;
+}
+
+//48 bits of 3 bit indices, texel i at bit 3 * i. Little endian, as in DXT5 and RGTC
+Block indices3(unsigned (*index)(unsigned))
+{
+  uint64_t bits = 0;
+  for(unsigned i = 0; i < 16; i++) bits |= (uint64_t)index(i) << (3 * i);
+
+  Block result;
+  for(unsigned i = 0; i < 6; i++) result.push_back((byte)(bits >> (8 * i)));
+  return result;
+}
+
+Block concat(Block a, const Block &b)
+{
+  a.insert(a.end(), b.begin(), b.end());
+  return a;
+}
+
+//color 0 pure red, color 1 pure blue (RGB565, little endian)
+const Block redBlue = {0x00, 0xF8, 0x1F, 0x00};
+const Block blueRed = {0x1F, 0x00, 0x00, 0xF8};
+
+//texel i uses color index i % 4
+const Block cycling = {0xE4, 0xE4, 0xE4, 0xE4};
+
+void dxt1()
+{
+  //color 0 > color 1: four opaque colors, two of them interpolated at 1/3 and 2/3
+  std::vector<byte> rgba = decode(TextureFormat::RGBA_S3TC_DXT1, concat(redBlue, cycling));
+  for(unsigned i = 0; i < 16; i += 4) {
+    CHECK(texel(rgba, i, {255, 0, 0, 255}));
+    CHECK(texel(rgba, i + 1, {0, 0, 255, 255}));
+    CHECK(texel(rgba, i + 2, {170, 0, 85, 255}));
+    CHECK(texel(rgba, i + 3, {85, 0, 170, 255}));
+  }
+
+  //color 0 <= color 1: the midpoint and transparent black
+  rgba = decode(TextureFormat::RGBA_S3TC_DXT1, concat(blueRed, cycling));
+  CHECK(texel(rgba, 0, {0, 0, 255, 255}));
+  CHECK(texel(rgba, 1, {255, 0, 0, 255}));
+  CHECK(texel(rgba, 2, {127, 0, 127, 255}));
+  CHECK(texel(rgba, 3, {0, 0, 0, 0}));
+
+  //without alpha, the fourth color is opaque black
+  rgba = decode(TextureFormat::RGB_S3TC_DXT1, concat(blueRed, cycling));
+  CHECK(texel(rgba, 3, {0, 0, 0, 255}));
+}
+
+void dxt3()
+{
+  //texel i has alpha i, 4 bits each
+  Block alpha = {0x10, 0x32, 0x54, 0x76, 0x98, 0xBA, 0xDC, 0xFE};
+
+  //the color block always has four colors, even if color 0 <= color 1
+  std::vector<byte> rgba = decode(TextureFormat::RGBA_S3TC_DXT3, concat(alpha, concat(blueRed, cycling)));
+  for(unsigned i = 0; i < 16; i++) CHECK(rgba[i * 4 + 3] == i * 17);
+  CHECK(texel(rgba, 2, {85, 0, 170, 34}));
+  CHECK(texel(rgba, 3, {170, 0, 85, 51}));
+}
+
+void dxt5()
+{
+  Block red = {0x00, 0xF8, 0x00, 0xF8, 0x00, 0x00, 0x00, 0x00};
+
+  //alpha 0 > alpha 1: six interpolated values
+  Block alpha = concat({255, 0}, indices3([](unsigned i) {return i % 8;}));
+  std::vector<byte> rgba = decode(TextureFormat::RGBA_S3TC_DXT5, concat(alpha, red));
+
+  const int eight[8] = {255, 0, 218, 182, 145, 109, 72, 36};
+  for(unsigned i = 0; i < 16; i++) CHECK(texel(rgba, i, {255, 0, 0, eight[i % 8]}));
+
+  //alpha 0 <= alpha 1: four interpolated values, 0 and 255
+  alpha = concat({0, 255}, indices3([](unsigned i) {return i % 8;}));
+  rgba = decode(TextureFormat::RGBA_S3TC_DXT5, concat(alpha, red));
+
+  const int six[8] = {0, 255, 51, 102, 153, 204, 0, 255};
+  for(unsigned i = 0; i < 16; i++) CHECK(rgba[i * 4 + 3] == six[i % 8]);
+}
+
+void rgtc()
+{
+  Block ramp = concat({255, 0}, indices3([](unsigned i) {return i % 2;}));
+  Block constant = concat({40, 40}, indices3([](unsigned i) {return 0u;}));
+
+  std::vector<byte> rgba = decode(TextureFormat::RED_RGTC1, ramp);
+  for(unsigned i = 0; i < 16; i++) CHECK(texel(rgba, i, {i % 2 ? 0 : 255, 0, 0, 255}));
+
+  rgba = decode(TextureFormat::RG_RGTC2, concat(ramp, constant));
+  for(unsigned i = 0; i < 16; i++) CHECK(texel(rgba, i, {i % 2 ? 0 : 255, 40, 0, 255}));
+}
+
+void etc2()
+{
+  //individual mode, both base colors 0x8 (136), modifier table 0 (2, 8)
+  Block individual = {0x88, 0x88, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00};
+  CHECK(all(decode(TextureFormat::RGB_ETC2, individual), {138, 138, 138, 255}));
+
+  //the indices are stored column by column, most significant bits first. Texel (1, 0) is the
+  //5th index, it gets the large negative modifier
+  Block column = {0x88, 0x88, 0x88, 0x00, 0x00, 0x10, 0x00, 0x10};
+  std::vector<byte> rgba = decode(TextureFormat::RGB_ETC2, column);
+  CHECK(texel(rgba, 1, {128, 128, 128, 255}));
+  CHECK(texel(rgba, 0, {138, 138, 138, 255}));
+  CHECK(texel(rgba, 4, {138, 138, 138, 255}));
+
+  //differential mode, base 16 (132) without offset, modifier table 0
+  Block differential = {0x80, 0x80, 0x80, 0x02, 0x00, 0x00, 0x00, 0x00};
+  CHECK(all(decode(TextureFormat::RGB_ETC2, differential), {134, 134, 134, 255}));
+
+  //the blue offset overflows: planar mode. Origin, horizontal and vertical red are 32 (130),
+  //so the block is uniform
+  Block planar = {0x40, 0x00, 0x04, 0x42, 0x00, 0x04, 0x00, 0x00};
+  CHECK(all(decode(TextureFormat::RGB_ETC2, planar), {130, 0, 0, 255}));
+
+  //EAC alpha: base 128, multiplier 1, table 0. Index 4 adds 2, index 0 subtracts 3
+  uint64_t bits = 0x80ull << 56 | 0x10ull << 48;
+  for(unsigned i = 0; i < 16; i++) bits |= (uint64_t)(i < 8 ? 4 : 0) << (45 - 3 * i);
+
+  Block alpha;
+  for(int shift = 56; shift >= 0; shift -= 8) alpha.push_back((byte)(bits >> shift));
+
+  rgba = decode(TextureFormat::RGBA_ETC2_EAC, concat(alpha, individual));
+  //the first 8 indices are the first two columns
+  for(unsigned y = 0; y < 4; y++) {
+    for(unsigned x = 0; x < 4; x++)
+      CHECK(texel(rgba, y * 4 + x, {138, 138, 138, x < 2 ? 130 : 125}));
+  }
+}
+
+void images()
+{
+  Block red = {0x00, 0xF8, 0x00, 0xF8, 0x00, 0x00, 0x00, 0x00};
+  Block blue = {0x1F, 0x00, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+  CHECK(blocks::blockBytes(TextureFormat::RGB_S3TC_DXT1) == 8);
+  CHECK(blocks::blockBytes(TextureFormat::RGBA_S3TC_DXT5) == 16);
+  CHECK(blocks::blockBytes(TextureFormat::RGBA) == 0);
+  CHECK(blocks::imageBytes(TextureFormat::RGB_S3TC_DXT1, 5, 5) == 32);
+
+  //two blocks side by side
+  std::vector<byte> rgba;
+  CHECK(blocks::decode(TextureFormat::RGB_S3TC_DXT1, mipmap(concat(red, blue), 8, 4), rgba));
+  CHECK(rgba.size() == 8 * 4 * 4);
+  for(unsigned y = 0; y < 4; y++) {
+    for(unsigned x = 0; x < 8; x++)
+      CHECK(texel(rgba, y * 8 + x, x < 4 ? Rgba {255, 0, 0, 255} : Rgba {0, 0, 255, 255}));
+  }
+
+  //blocks at the edges are cut off
+  CHECK(blocks::decode(TextureFormat::RGB_S3TC_DXT1, mipmap(concat(red, blue), 5, 3), rgba));
+  CHECK(rgba.size() == 5 * 3 * 4);
+  for(unsigned y = 0; y < 3; y++) {
+    for(unsigned x = 0; x < 5; x++)
+      CHECK(texel(rgba, y * 5 + x, x < 4 ? Rgba {255, 0, 0, 255} : Rgba {0, 0, 255, 255}));
+  }
+
+  //a level smaller than a block
+  CHECK(blocks::decode(TextureFormat::RGB_S3TC_DXT1, mipmap(blue, 1, 1), rgba));
+  CHECK(rgba.size() == 4 && texel(rgba, 0, {0, 0, 255, 255}));
+}
+
+void invalid()
+{
+  std::vector<byte> rgba;
+
+  //not enough data for the size
+  CHECK(!blocks::decode(TextureFormat::RGB_S3TC_DXT1, mipmap(Block(8), 8, 4), rgba));
+  CHECK(!blocks::decode(TextureFormat::RGBA_S3TC_DXT5, mipmap(Block(8)), rgba));
+
+  //no CPU decoder, or not compressed
+  CHECK(!blocks::decodable(TextureFormat::RGBA_BPTC));
+  CHECK(!blocks::decodable(TextureFormat::RGBA_ASTC_4x4));
+  CHECK(!blocks::decodable(TextureFormat::RGBA));
+  CHECK(!blocks::decode(TextureFormat::RGBA_BPTC, mipmap(Block(16)), rgba));
+  CHECK(!blocks::decode(TextureFormat::RGBA, mipmap(Block(64)), rgba));
+}
+
+int main(int argc, char **argv)
+{
+  dxt1();
+  dxt3();
+  dxt5();
+  rgtc();
+  etc2();
+  images();
+  invalid();
+
+  return test::result();
+}
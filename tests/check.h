@@ -0,0 +1,39 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_TEST_CHECK_H
+#define THREEPP_TEST_CHECK_H
+
+#include <iostream>
+
+namespace three {
+namespace test {
+
+/**
+ * number of failed checks. Tests return a non-zero exit code if there were any
+ */
+inline unsigned &failures()
+{
+  static unsigned count = 0;
+  return count;
+}
+
+inline int result()
+{
+  if(failures()) std::cerr << failures() << " check(s) failed" << std::endl;
+  return failures() ? 1 : 0;
+}
+
+}
+}
+
+#define CHECK(expr) \
+  do { \
+    if(!(expr)) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #expr << std::endl; \
+      three::test::failures()++; \
+    } \
+  } while(0)
+
+#endif //THREEPP_TEST_CHECK_H
@@ -0,0 +1,297 @@
+//
+// Created by byter on 17.10.26.
+//
+// KTX and KTX2 parsing on files built in memory: headers, byte order, row padding, level
+// indices and supercompression
+
+#include <QByteArray>
+#include <threepp/loader/KTX.h>
+#include "check.h"
+
+using namespace three;
+using loader::KTX;
+
+using Data = std::vector<byte>;
+
+const byte ktx1_identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+const byte ktx2_identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+const uint32_t gl_rgb = 0x1907, gl_rgba = 0x1908, gl_unsigned_byte = 0x1401;
+const uint32_t gl_dxt1 = 0x83F0;
+const uint32_t vk_rgba = 37, vk_dxt1 = 131;
+
+/**
+ * appends values to a file, in little or big endian byte order
+ */
+struct Writer
+{
+  Data data;
+  bool bigEndian = false;
+
+  void u32(uint32_t value)
+  {
+    for(unsigned i = 0; i < 4; i++)
+      data.push_back((byte)(value >> (bigEndian ? (3 - i) * 8 : i * 8)));
+  }
+
+  void u64(uint64_t value)
+  {
+    u32((uint32_t)value);
+    u32((uint32_t)(value >> 32));
+  }
+
+  void bytes(const Data &values)
+  {
+    data.insert(data.end(), values.begin(), values.end());
+  }
+
+  void pad4()
+  {
+    while(data.size() % 4) data.push_back(0);
+  }
+};
+
+Data ktx1(uint32_t glType, uint32_t glFormat, uint32_t glInternalFormat, uint32_t width, uint32_t height,
+          const std::vector<Data> &levels, bool bigEndian=false)
+{
+  Writer w;
+  w.bigEndian = bigEndian;
+  w.bytes(Data(ktx1_identifier, ktx1_identifier + 12));
+  w.u32(0x04030201);
+  w.u32(glType);
+  w.u32(glType ? 1 : 0);
+  w.u32(glFormat);
+  w.u32(glInternalFormat);
+  w.u32(glFormat);
+  w.u32(width);
+  w.u32(height);
+  w.u32(0);
+  w.u32(0);
+  w.u32(1);
+  w.u32((uint32_t)levels.size());
+  w.u32(0);
+
+  for(const Data &level : levels) {
+    w.u32((uint32_t)level.size());
+    w.bytes(level);
+    w.pad4();
+  }
+  return w.data;
+}
+
+struct Level
+{
+  Data data;
+  uint64_t uncompressedSize;
+};
+
+Data ktx2(uint32_t vkFormat, uint32_t width, uint32_t height, uint32_t supercompression,
+          const std::vector<Level> &levels, uint64_t offsetShift=0)
+{
+  Writer w;
+  w.bytes(Data(ktx2_identifier, ktx2_identifier + 12));
+  w.u32(vkFormat);
+  w.u32(1);
+  w.u32(width);
+  w.u32(height);
+  w.u32(0);
+  w.u32(0);
+  w.u32(1);
+  w.u32((uint32_t)levels.size());
+  w.u32(supercompression);
+  //no data format descriptor, key/value or supercompression global data
+  for(unsigned i = 0; i < 4; i++) w.u32(0);
+  w.u64(0);
+  w.u64(0);
+
+  uint64_t offset = 80 + levels.size() * 24;
+  for(const Level &level : levels) {
+    w.u64(offset + offsetShift);
+    w.u64(level.data.size());
+    w.u64(level.uncompressedSize);
+    offset += level.data.size();
+  }
+  for(const Level &level : levels) w.bytes(level.data);
+
+  return w.data;
+}
+
+Data sequence(size_t count, byte first=1)
+{
+  Data result;
+  for(size_t i = 0; i < count; i++) result.push_back((byte)(first + i));
+  return result;
+}
+
+DataTexture::Ptr load(const Data &data)
+{
+  return KTX::load(data, "test", DataTexture::options());
+}
+
+void headers()
+{
+  CHECK(KTX::handles("a/b.ktx") && KTX::handles("b.KTX2") && !KTX::handles("b.png") && !KTX::handles("ktx"));
+
+  Data rgba = ktx1(gl_unsigned_byte, gl_rgba, gl_rgba, 2, 2, {sequence(16)});
+  CHECK(load(rgba) != nullptr);
+
+  //truncated header
+  CHECK(load(Data(rgba.begin(), rgba.begin() + 40)) == nullptr);
+  CHECK(load(Data()) == nullptr);
+
+  //not a KTX file
+  Data other = rgba;
+  other[1] = 'X';
+  CHECK(load(other) == nullptr);
+
+  //unknown endianness marker
+  Data endianness = rgba;
+  endianness[12] = 0x05;
+  CHECK(load(endianness) == nullptr);
+
+  //cube maps are not supported
+  Data cube = rgba;
+  cube[52] = 6;
+  CHECK(load(cube) == nullptr);
+
+  //unsupported format
+  CHECK(load(ktx1(0x1406, gl_rgba, gl_rgba, 2, 2, {sequence(64)})) == nullptr);
+}
+
+void byteOrder()
+{
+  Data little = ktx1(gl_unsigned_byte, gl_rgba, gl_rgba, 2, 2, {sequence(16)});
+  Data big = ktx1(gl_unsigned_byte, gl_rgba, gl_rgba, 2, 2, {sequence(16)}, true);
+  CHECK(little != big);
+
+  //the texel data is not swapped, only the header fields
+  for(const Data &file : {little, big}) {
+    DataTexture::Ptr texture = load(file);
+    CHECK(texture != nullptr);
+    if(!texture) continue;
+
+    CHECK(texture->format() == TextureFormat::RGBA);
+    CHECK(texture->width() == 2 && texture->height() == 2);
+    CHECK(texture->mipmaps().size() == 1);
+    CHECK(texture->mipmaps()[0].data == sequence(16));
+  }
+}
+
+void padding()
+{
+  //3 texels of RGB are 9 bytes, KTX 1 pads rows to 12
+  Data padded;
+  for(unsigned row = 0; row < 2; row++) {
+    Data texels = sequence(9, (byte)(row * 9 + 1));
+    padded.insert(padded.end(), texels.begin(), texels.end());
+    padded.insert(padded.end(), 3, 0xEE);
+  }
+
+  DataTexture::Ptr texture = load(ktx1(gl_unsigned_byte, gl_rgb, gl_rgb, 3, 2, {padded}));
+  CHECK(texture != nullptr);
+  if(texture) {
+    CHECK(texture->format() == TextureFormat::RGB);
+    CHECK(texture->mipmaps().size() == 1);
+    CHECK(texture->mipmaps()[0].width == 3 && texture->mipmaps()[0].height == 2);
+
+    //tightly packed, uploaded with an unpack alignment of 1
+    CHECK(texture->mipmaps()[0].data == sequence(18));
+    CHECK(texture->unpackAlignment() == 1);
+  }
+
+  //the padding of the last row may be left out
+  Data unpadded(padded.begin(), padded.end() - 3);
+  texture = load(ktx1(gl_unsigned_byte, gl_rgb, gl_rgb, 3, 2, {unpadded}));
+  CHECK(texture && texture->mipmaps()[0].data == sequence(18));
+
+  //too short for the padded rows
+  Data packed = sequence(18);
+  CHECK(load(ktx1(gl_unsigned_byte, gl_rgb, gl_rgb, 3, 2, {packed})) == nullptr);
+
+  //KTX2 rows are not padded
+  texture = load(ktx2(23, 3, 2, 0, {{packed, packed.size()}}));
+  CHECK(texture && texture->mipmaps()[0].data == packed);
+}
+
+void levels()
+{
+  Data block = {0x00, 0xF8, 0x1F, 0x00, 0xE4, 0xE4, 0xE4, 0xE4};
+
+  //complete chain of an 8x4 DXT1 texture: 8x4, 4x2, 2x1, 1x1
+  Data base = block;
+  base.insert(base.end(), block.begin(), block.end());
+  DataTexture::Ptr texture = load(ktx1(0, 0, gl_dxt1, 8, 4, {base, block, block, block}));
+  CHECK(texture != nullptr);
+  if(texture) {
+    CHECK(texture->compressed());
+    CHECK(texture->format() == TextureFormat::RGB_S3TC_DXT1);
+    CHECK(texture->mipmaps().size() == 4);
+    CHECK(texture->mipmaps()[3].width == 1 && texture->mipmaps()[3].height == 1);
+    CHECK(texture->minFilter == TextureFilter::LinearMipMapLinear);
+  }
+
+  //the last level is cut off: an incomplete chain is reduced to the base level
+  Data file = ktx1(0, 0, gl_dxt1, 8, 4, {base, block, block, block});
+  file.resize(file.size() - 6);
+  texture = load(file);
+  CHECK(texture != nullptr);
+  if(texture) {
+    CHECK(texture->mipmaps().size() == 1);
+    CHECK(texture->minFilter == TextureFilter::Linear);
+  }
+
+  //the size of the base level exceeds the file
+  file = ktx1(0, 0, gl_dxt1, 8, 4, {base});
+  file[64] = 0xFF;
+  CHECK(load(file) == nullptr);
+
+  //a level too small for its size
+  CHECK(load(ktx1(0, 0, gl_dxt1, 8, 4, {block})) == nullptr);
+
+  //KTX2 level index
+  texture = load(ktx2(vk_dxt1, 4, 4, 0, {{block, block.size()}}));
+  CHECK(texture && texture->compressed() && texture->mipmaps()[0].data == block);
+
+  //level offset past the end of the file
+  CHECK(load(ktx2(vk_dxt1, 4, 4, 0, {{block, block.size()}}, 1000)) == nullptr);
+
+  //level index longer than the file
+  file = ktx2(vk_dxt1, 4, 4, 0, {{block, block.size()}});
+  file[40] = 200;
+  CHECK(load(file) == nullptr);
+}
+
+void supercompression()
+{
+  Data texels = sequence(4 * 4 * 4);
+
+  //qCompress prepends the uncompressed size, which KTX2 stores in the level index instead
+  QByteArray compressed = qCompress(QByteArray((const char *)texels.data(), (int)texels.size()));
+  Data zlib((const byte *)compressed.constData() + 4, (const byte *)compressed.constData() + compressed.size());
+
+  DataTexture::Ptr texture = load(ktx2(vk_rgba, 4, 4, 3, {{zlib, texels.size()}}));
+  CHECK(texture != nullptr);
+  if(texture) {
+    CHECK(texture->format() == TextureFormat::RGBA);
+    CHECK(texture->mipmaps()[0].data == texels);
+  }
+
+  //corrupt stream
+  Data corrupt = zlib;
+  for(size_t i = 2; i < corrupt.size(); i++) corrupt[i] ^= 0x5A;
+  CHECK(load(ktx2(vk_rgba, 4, 4, 3, {{corrupt, texels.size()}})) == nullptr);
+
+  //zstd is not supported
+  CHECK(load(ktx2(vk_rgba, 4, 4, 2, {{zlib, texels.size()}})) == nullptr);
+}
+
+int main(int argc, char **argv)
+{
+  headers();
+  byteOrder();
+  padding();
+  levels();
+  supercompression();
+
+  return test::result();
+}
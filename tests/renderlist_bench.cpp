@@ -0,0 +1,83 @@
+//
+// Created by byter on 17.10.26.
+//
+// time RenderList::sort against the comparison sort it replaced. Usage: renderlist_bench [rounds]
+
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cstdio>
+#include <threepp/renderers/gl/RenderLists.h>
+#include <threepp/material/MeshBasicMaterial.h>
+#include <threepp/geometry/Box.h>
+#include <threepp/objects/Mesh.h>
+
+using namespace three;
+
+using Clock = std::chrono::steady_clock;
+
+struct Content
+{
+  std::vector<Material::Ptr> materials;
+  std::vector<BufferGeometry::Ptr> geometries;
+  Mesh::Ptr mesh;
+};
+
+void fill(gl::RenderList &list, const Content &content, size_t count, unsigned seed)
+{
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<size_t> material(0, content.materials.size() - 1);
+  std::uniform_int_distribution<size_t> geometry(0, content.geometries.size() - 1);
+  std::uniform_real_distribution<float> z(1.0f, 1000.0f);
+
+  list.init();
+  for(size_t i = 0; i < count; i++) {
+    list.push_back(content.mesh.get(), content.geometries[geometry(random)].get(),
+                   content.materials[material(random)].get(), z(random), nullptr);
+  }
+}
+
+/**
+ * @return the average time per sort in microseconds
+ */
+template <typename Sort>
+double measure(const Content &content, size_t count, unsigned rounds, Sort sort)
+{
+  gl::RenderList list;
+  Clock::duration total {0};
+
+  for(unsigned round = 0; round < rounds; round++) {
+    fill(list, content, count, round + 1);
+
+    auto start = Clock::now();
+    sort(list);
+    total += Clock::now() - start;
+  }
+  return std::chrono::duration<double, std::micro>(total).count() / rounds;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned rounds = argc > 1 ? (unsigned)std::atoi(argv[1]) : 20;
+  if(rounds == 0) rounds = 1;
+
+  Content content;
+  for(unsigned i = 0; i < 64; i++) {
+    MeshBasicMaterial::Ptr material = MeshBasicMaterial::make();
+    if(i % 8 == 7) material->opacity = 0.5f;
+    content.materials.push_back(material);
+  }
+  for(unsigned i = 0; i < 32; i++)
+    content.geometries.push_back(geometry::buffer::Box::make(1, 1, 1));
+  content.mesh = DynamicMesh::make(content.geometries.front(), content.materials.front());
+
+  printf("%10s %14s %14s %8s\n", "items", "radix [us]", "compare [us]", "speedup");
+
+  for(size_t count : {100, 1000, 10000, 100000}) {
+    double radix = measure(content, count, rounds, [](gl::RenderList &list) {list.sort();});
+    double compare = measure(content, count, rounds, [](gl::RenderList &list) {list.sortExact();});
+
+    printf("%10zu %14.1f %14.1f %8.2f\n", count, radix, compare, compare / radix);
+  }
+  return 0;
+}
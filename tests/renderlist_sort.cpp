@@ -0,0 +1,105 @@
+//
+// Created by byter on 17.10.26.
+//
+// the radix sort of RenderList::sort must produce the order of the comparison sort
+
+#include <random>
+#include <threepp/renderers/gl/RenderLists.h>
+#include <threepp/material/MeshBasicMaterial.h>
+#include <threepp/geometry/Box.h>
+#include <threepp/objects/Mesh.h>
+#include "check.h"
+
+using namespace three;
+
+struct Content
+{
+  std::vector<Material::Ptr> materials;
+  std::vector<BufferGeometry::Ptr> geometries;
+  Mesh::Ptr mesh;
+
+  Content(unsigned materialCount, unsigned geometryCount)
+  {
+    for(unsigned i = 0; i < materialCount; i++) {
+      MeshBasicMaterial::Ptr material = MeshBasicMaterial::make();
+      //every third material is transparent
+      if(i % 3 == 2) material->opacity = 0.5f;
+      materials.push_back(material);
+    }
+    for(unsigned i = 0; i < geometryCount; i++)
+      geometries.push_back(geometry::buffer::Box::make(1, 1, 1));
+
+    mesh = DynamicMesh::make(geometries.front(), materials.front());
+  }
+};
+
+enum class Depth {Continuous, Few, Close};
+
+void fill(gl::RenderList &list, const Content &content, bool groupByGeometry, Depth depth, size_t count,
+          unsigned seed)
+{
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<size_t> material(0, content.materials.size() - 1);
+  std::uniform_int_distribution<size_t> geometry(0, content.geometries.size() - 1);
+  std::uniform_real_distribution<float> z(-100.0f, 100.0f);
+  std::uniform_int_distribution<int> few(0, 3);
+  std::uniform_int_distribution<int> close(0, 1000);
+
+  list.init(groupByGeometry);
+  for(size_t i = 0; i < count; i++) {
+    float itemZ;
+    switch(depth) {
+      case Depth::Continuous:
+        itemZ = z(random);
+        break;
+      case Depth::Few:
+        //many equal depths, ordered by id
+        itemZ = (float)few(random) - 1.5f;
+        break;
+      case Depth::Close:
+        //differences below the depth resolution of the key
+        itemZ = 10.0f + close(random) * 1e-6f;
+        break;
+    }
+    list.push_back(content.mesh.get(), content.geometries[geometry(random)].get(),
+                   content.materials[material(random)].get(), itemZ, nullptr);
+  }
+}
+
+std::vector<unsigned> ids(gl::RenderList::iterator it)
+{
+  std::vector<unsigned> result;
+  for(; it; it++) result.push_back(it->id);
+  return result;
+}
+
+int main(int argc, char *argv[])
+{
+  Content content(12, 7);
+
+  for(bool groupByGeometry : {false, true}) {
+    for(Depth depth : {Depth::Continuous, Depth::Few, Depth::Close}) {
+      for(size_t count : {2, 17, 300, 5000}) {
+        for(unsigned seed = 1; seed <= 3; seed++) {
+
+          gl::RenderList keyed, exact;
+          fill(keyed, content, groupByGeometry, depth, count, seed);
+          fill(exact, content, groupByGeometry, depth, count, seed);
+
+          keyed.sort();
+          exact.sortExact();
+
+          CHECK(ids(keyed.opaque()) == ids(exact.opaque()));
+          CHECK(ids(keyed.transparent()) == ids(exact.transparent()));
+
+          //sorting again must not change anything
+          keyed.sort();
+          CHECK(ids(keyed.opaque()) == ids(exact.opaque()));
+          CHECK(ids(keyed.transparent()) == ids(exact.transparent()));
+        }
+      }
+    }
+  }
+
+  return test::result();
+}
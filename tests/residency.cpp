@@ -0,0 +1,164 @@
+//
+// Created by byter on 17.10.26.
+//
+// GPU memory accounting and eviction order of the residency tracker
+
+#include <threepp/renderers/gl/Residency.h>
+#include "check.h"
+
+using namespace three;
+using namespace three::gl;
+
+std::vector<unsigned> geometries(const std::vector<Residency::Entry> &entries)
+{
+  std::vector<unsigned> result;
+  for(const Residency::Entry &entry : entries) {
+    CHECK(entry.kind == Residency::Kind::Geometry);
+    result.push_back(entry.geometry);
+  }
+  return result;
+}
+
+void accounting()
+{
+  MemoryInfo info;
+  Residency residency(info);
+
+  sole::uuid texture = sole::uuid4();
+  residency.nextFrame();
+  residency.addTexture(texture, 1000, true);
+  residency.addGeometry(1, 200);
+  residency.addBuffers(7, 30);
+  CHECK(info.textureBytes == 1000);
+  CHECK(info.bufferBytes == 230);
+  CHECK(residency.used() == 1230);
+
+  //adding again replaces the size, it is not counted twice
+  residency.addTexture(texture, 400, true);
+  residency.addGeometry(1, 250);
+  residency.addBuffers(7, 50);
+  CHECK(info.textureBytes == 400);
+  CHECK(info.bufferBytes == 300);
+
+  //use does not change the size
+  residency.nextFrame();
+  residency.useTexture(texture);
+  residency.useGeometry(1);
+  CHECK(residency.used() == 700);
+
+  residency.removeTexture(texture);
+  residency.removeGeometry(1);
+  residency.removeBuffers(7);
+  CHECK(info.textureBytes == 0 && info.bufferBytes == 0);
+
+  //removing twice or something unknown is harmless
+  residency.removeGeometry(1);
+  residency.useGeometry(2);
+  CHECK(residency.used() == 0);
+
+  residency.addGeometry(3, 10);
+  residency.clear();
+  CHECK(residency.used() == 0);
+  CHECK(residency.evict(0).empty());
+}
+
+void leastRecentlyUsed()
+{
+  MemoryInfo info;
+  Residency residency(info);
+
+  residency.nextFrame();
+  for(unsigned id = 1; id <= 4; id++) residency.addGeometry(id, 100);
+
+  //frame 2 uses 3 and 1, in that order
+  residency.nextFrame();
+  residency.useGeometry(3);
+  residency.useGeometry(1);
+
+  //within budget: nothing is evicted
+  residency.nextFrame();
+  CHECK(residency.evict(400).empty());
+
+  //the entries not used in frame 2 go first, then the order of use
+  CHECK(geometries(residency.evict(250)) == std::vector<unsigned>({2, 4}));
+  CHECK(residency.used() == 200);
+  CHECK(geometries(residency.evict(0)) == std::vector<unsigned>({3, 1}));
+  CHECK(residency.used() == 0);
+
+  //evicted entries are unknown afterwards, using them does nothing
+  residency.useGeometry(3);
+  CHECK(residency.evict(0).empty());
+}
+
+void currentFrame()
+{
+  MemoryInfo info;
+  Residency residency(info);
+
+  residency.nextFrame();
+  residency.addGeometry(1, 100);
+  residency.addGeometry(2, 100);
+
+  //everything was used in this frame: over budget, but nothing may go
+  CHECK(residency.evict(0).empty());
+  CHECK(residency.used() == 200);
+
+  //in the next frame, only what was not used again
+  residency.nextFrame();
+  residency.useGeometry(1);
+  CHECK(geometries(residency.evict(0)) == std::vector<unsigned>({2}));
+  CHECK(residency.used() == 100);
+
+  //a new upload counts as use
+  residency.nextFrame();
+  residency.addGeometry(1, 150);
+  CHECK(residency.evict(0).empty());
+  CHECK(residency.used() == 150);
+}
+
+void nonEvictable()
+{
+  MemoryInfo info;
+  Residency residency(info);
+
+  sole::uuid target = sole::uuid4(), image = sole::uuid4();
+
+  residency.nextFrame();
+  residency.addTexture(target, 1000, false);
+  residency.addBuffers(1, 500);
+  residency.addTexture(image, 300, true);
+  residency.addGeometry(1, 200);
+
+  //the oldest entries cannot be evicted, they are skipped
+  residency.nextFrame();
+  std::vector<Residency::Entry> evicted = residency.evict(0);
+  CHECK(evicted.size() == 2);
+  if(evicted.size() == 2) {
+    CHECK(evicted[0].kind == Residency::Kind::Texture && evicted[0].texture == image);
+    CHECK(evicted[1].kind == Residency::Kind::Geometry && evicted[1].geometry == 1);
+  }
+  CHECK(info.textureBytes == 1000 && info.bufferBytes == 500);
+
+  //re-adding an evicted texture accounts for it again
+  residency.addTexture(image, 300, true);
+  CHECK(info.textureBytes == 1300);
+
+  //eviction stops at the budget
+  residency.nextFrame();
+  residency.addGeometry(2, 100);
+  residency.addGeometry(3, 100);
+  residency.nextFrame();
+  evicted = residency.evict(1600);
+  CHECK(evicted.size() == 2);
+  CHECK(residency.used() == 1600);
+}
+
+int main(int argc, char **argv)
+{
+  accounting();
+  leastRecentlyUsed();
+  currentFrame();
+  nonEvictable();
+
+  return test::result();
+}
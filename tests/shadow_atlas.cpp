@@ -0,0 +1,114 @@
+//
+// Created by byter on 17.10.26.
+//
+// packing of shadow map tiles into the atlas: layout, scaling and requests which don't fit at all
+
+#include <threepp/renderers/gl/ShadowAtlas.h>
+#include "check.h"
+
+using namespace three;
+using namespace three::gl;
+
+using Requests = std::vector<ShadowAtlas::Request>;
+
+bool overlap(const ShadowAtlas::Tile &t1, const ShadowAtlas::Tile &t2)
+{
+  return t1.x < t2.x + t2.width && t2.x < t1.x + t1.width
+         && t1.y < t2.y + t2.height && t2.y < t1.y + t1.height;
+}
+
+//all placed tiles lie within the atlas and don't overlap
+bool valid(const ShadowAtlas &atlas, size_t count)
+{
+  for(size_t i = 0; i < count; i++) {
+    if(!atlas.placed(i)) continue;
+
+    const ShadowAtlas::Tile &tile = atlas.tile(i);
+    if(tile.x < 0 || tile.y < 0 || tile.x + tile.width > atlas.size() || tile.y + tile.height > atlas.size())
+      return false;
+
+    for(size_t j = i + 1; j < count; j++)
+      if(atlas.placed(j) && overlap(tile, atlas.tile(j))) return false;
+  }
+  return true;
+}
+
+void layout()
+{
+  ShadowAtlas atlas;
+  Requests requests {{1, 512, 512}, {2, 1024, 1024}, {3, 512, 512}, {4, 2048, 1024}};
+
+  CHECK(atlas.pack(requests, 4096));
+  CHECK(atlas.scale() == 1);
+  CHECK(valid(atlas, requests.size()));
+
+  for(size_t i = 0; i < requests.size(); i++) {
+    CHECK(atlas.placed(i));
+    CHECK(atlas.tile(i).width == requests[i].width && atlas.tile(i).height == requests[i].height);
+  }
+
+  //the same requests keep the layout, anything else changes it
+  CHECK(!atlas.pack(requests, 4096));
+  CHECK(atlas.pack(requests, 2048));
+  requests[0].id = 5;
+  CHECK(atlas.pack(requests, 2048));
+}
+
+void scaled()
+{
+  //four 1024 maps need twice the size of a 1024 atlas
+  ShadowAtlas atlas;
+  Requests requests {{1, 1024, 1024}, {2, 1024, 1024}, {3, 1024, 1024}, {4, 1024, 1024}};
+
+  CHECK(atlas.pack(requests, 1024));
+  CHECK(atlas.scale() == 2);
+  CHECK(valid(atlas, requests.size()));
+  for(size_t i = 0; i < requests.size(); i++) {
+    CHECK(atlas.placed(i));
+    CHECK(atlas.tile(i).width == 512 && atlas.tile(i).height == 512);
+  }
+
+  //a single map larger than the atlas
+  CHECK(atlas.pack({{1, 4096, 2048}}, 1024));
+  CHECK(atlas.scale() == 4);
+  CHECK(atlas.tile(0).width == 1024 && atlas.tile(0).height == 512);
+}
+
+void overflow()
+{
+  //five lights in a 2x2 atlas: even at a single texel each, one does not fit
+  ShadowAtlas atlas;
+  Requests requests;
+  for(unsigned id = 1; id <= 5; id++) requests.push_back({id, 8, 8});
+
+  CHECK(atlas.pack(requests, 2));
+  CHECK(valid(atlas, requests.size()));
+
+  unsigned placed = 0;
+  for(size_t i = 0; i < requests.size(); i++) {
+    if(atlas.placed(i)) {
+      placed++;
+      CHECK(atlas.tile(i).width == 1 && atlas.tile(i).height == 1);
+    }
+    else {
+      //no stale tile from an earlier attempt
+      const ShadowAtlas::Tile &tile = atlas.tile(i);
+      CHECK(tile.x == 0 && tile.y == 0 && tile.width == 0 && tile.height == 0);
+    }
+  }
+  CHECK(placed == 4);
+
+  //once there is room again, all are placed
+  CHECK(atlas.pack(requests, 16));
+  for(size_t i = 0; i < requests.size(); i++) CHECK(atlas.placed(i));
+  CHECK(valid(atlas, requests.size()));
+}
+
+int main(int argc, char **argv)
+{
+  layout();
+  scaled();
+  overflow();
+
+  return test::result();
+}
@@ -0,0 +1,162 @@
+//
+// Created by byter on 17.10.26.
+//
+// a shadowed scene drawn with automatic instancing and without uniform blocks must look like the
+// same scene drawn object by object. Needs an OpenGL 3.1 context, skipped if none can be created
+
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QImage>
+#include <cmath>
+#include <cstdlib>
+#include <threepp/renderers/OpenGLRenderer.h>
+#include <threepp/camera/PerspectiveCamera.h>
+#include <threepp/light/DirectionalLight.h>
+#include <threepp/light/AmbientLight.h>
+#include <threepp/material/MeshLambertMaterial.h>
+#include <threepp/geometry/Box.h>
+#include <threepp/geometry/Plane.h>
+#include <threepp/objects/Mesh.h>
+#include "check.h"
+
+using namespace three;
+
+static const int size = 128;
+
+//exit code which makes ctest report the test as skipped
+static const int skipped = 77;
+
+struct Content
+{
+  Scene::Ptr scene;
+  Camera::Ptr camera;
+
+  Content()
+  {
+    scene = Scene::make();
+
+    auto groundMaterial = MeshLambertMaterial::make();
+    groundMaterial->color = Color(0xffffff);
+    auto ground = DynamicMesh::make(geometry::buffer::Plane::make(10, 10), groundMaterial);
+    ground->rotation().setX(-(float)M_PI / 2);
+    ground->receiveShadow = true;
+    scene->add(ground);
+
+    //one run of identical geometry and material, drawn with a single instanced call
+    auto boxGeometry = geometry::buffer::Box::make(0.6f, 1.5f, 0.6f);
+    auto boxMaterial = MeshLambertMaterial::make();
+    boxMaterial->color = Color(0xff8000);
+    for(int x = -1; x <= 1; x++) {
+      for(int z = -1; z <= 1; z++) {
+        auto box = DynamicMesh::make(boxGeometry, boxMaterial);
+        box->position().set(x * 2.0f, 0.75f, z * 2.0f);
+        box->castShadow = true;
+        box->receiveShadow = true;
+        scene->add(box);
+      }
+    }
+
+    scene->add(AmbientLight::make(Color(0x404040)));
+
+    auto light = DirectionalLight::make(ground, Color(0xffffff), 1);
+    light->position().set(3, 10, 2);
+    light->castShadow = true;
+    scene->add(light);
+
+    camera = PerspectiveCamera::make(45, 1, 0.1f, 100);
+    camera->position().set(0, 8, 10);
+    camera->lookAt(math::Vector3(0, 0, 0));
+    scene->add(camera);
+  }
+};
+
+/**
+ * render a new scene into an image. The renderer is kept in renderers, it must outlive the context
+ */
+QImage render(const OpenGLRendererOptions &options, std::vector<OpenGLRenderer::Ptr> &renderers)
+{
+  QOpenGLFramebufferObjectFormat format;
+  format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+  QOpenGLFramebufferObject fbo(size, size, format);
+
+  OpenGLRenderer::Ptr renderer = OpenGLRenderer::make(size, size, 1, options);
+  renderers.push_back(renderer);
+
+  renderer->setShadowMapType(ShadowMapType::PCF);
+  renderer->initContext();
+  renderer->setClearColor(Color(0x000000), 1);
+
+  auto target = OpenGLRenderer::makeExternalTarget(fbo.handle(), fbo.texture(), size, size,
+                                                   CullFace::Back, FrontFaceDirection::CCW);
+  Content content;
+
+  //the second frame reuses the render list of the first
+  renderer->render(content.scene, content.camera, target);
+  renderer->render(content.scene, content.camera, target);
+
+  return fbo.toImage();
+}
+
+/**
+ * @return the fraction of pixels which differ by more than tolerance in any channel
+ */
+float difference(const QImage &image1, const QImage &image2, int tolerance)
+{
+  unsigned different = 0;
+  for(int y = 0; y < size; y++) {
+    for(int x = 0; x < size; x++) {
+      QRgb p1 = image1.pixel(x, y), p2 = image2.pixel(x, y);
+      if(std::abs(qRed(p1) - qRed(p2)) > tolerance
+         || std::abs(qGreen(p1) - qGreen(p2)) > tolerance
+         || std::abs(qBlue(p1) - qBlue(p2)) > tolerance)
+        different++;
+    }
+  }
+  return (float)different / (size * size);
+}
+
+int main(int argc, char **argv)
+{
+  if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+  QGuiApplication app(argc, argv);
+
+  QOffscreenSurface surface;
+  surface.create();
+
+  std::vector<OpenGLRenderer::Ptr> renderers;
+  {
+    QOpenGLContext context;
+    if(!context.create() || !context.makeCurrent(&surface)) {
+      std::cerr << "no OpenGL context, skipped" << std::endl;
+      return skipped;
+    }
+    QSurfaceFormat surfaceFormat = context.format();
+    if(!context.isOpenGLES() && surfaceFormat.version() < qMakePair(3, 1)) {
+      std::cerr << "OpenGL 3.1 required, skipped" << std::endl;
+      return skipped;
+    }
+
+    OpenGLRendererOptions options;
+    QImage reference = render(options, renderers);
+
+    options.autoInstancing = true;
+    options.uniformBlocks = false;
+    QImage instanced = render(options, renderers);
+
+    options.uniformBlocks = true;
+    QImage instancedBlocks = render(options, renderers);
+
+    //something was drawn: the lit ground, the boxes and their shadows
+    unsigned black = 0;
+    for(int y = 0; y < size; y++)
+      for(int x = 0; x < size; x++)
+        if(qGray(reference.pixel(x, y)) == 0) black++;
+    CHECK(black < size * size / 2);
+
+    CHECK(difference(reference, instanced, 8) < 0.01f);
+    CHECK(difference(reference, instancedBlocks, 8) < 0.01f);
+  }
+  return test::result();
+}
@@ -0,0 +1,133 @@
+//
+// Created by byter on 17.10.26.
+//
+// mesh decimation on meshes with known shape: counts, error bound and attribute compaction
+
+#include <cmath>
+#include <threepp/geometry/Simplify.h>
+#include <threepp/geometry/Plane.h>
+#include <threepp/geometry/Sphere.h>
+#include <threepp/math/Vector4.h>
+#include "check.h"
+
+using namespace three;
+
+//a flat grid loses its interior vertices without error. The border is kept
+void flatGrid()
+{
+  auto plane = geometry::buffer::Plane::make(1, 1, 10, 10);
+  CHECK(plane->index()->size() / 3 == 200);
+  CHECK(plane->position()->itemCount() == 121);
+
+  geometry::SimplifyResult result = geometry::simplify(*plane, 0.25f);
+
+  CHECK(result.triangles > 0 && result.triangles <= 50);
+  CHECK(result.error < 1e-5f);
+  CHECK(plane->index()->size() == result.triangles * 3);
+  CHECK(plane->position()->itemCount() == result.vertices);
+  CHECK(plane->normal()->itemCount() == result.vertices);
+  CHECK(plane->uv()->itemCount() == result.vertices);
+
+  //the 40 border vertices can't be removed
+  CHECK(result.vertices >= 40 && result.vertices < 121);
+
+  for(size_t i = 0; i < result.vertices; i++)
+    CHECK(plane->position()->at(i * 3 + 2) == 0.0f);
+
+  for(size_t i = 0; i < plane->index()->size(); i++)
+    CHECK(plane->index()->at(i) < result.vertices);
+}
+
+//largest distance between a triangle's centroid and the unit sphere
+float centroidDeviation(const BufferGeometry &geometry)
+{
+  const BufferAttributeT<float> &position = *geometry.position();
+  const BufferAttributeT<uint32_t> &index = *geometry.index();
+
+  float deviation = 0;
+  for(size_t t = 0; t + 2 < index.size(); t += 3) {
+    math::Vector3 centroid(0, 0, 0);
+    for(unsigned c = 0; c < 3; c++) {
+      uint32_t v = index.at(t + c);
+      centroid += math::Vector3(position.at(v * 3), position.at(v * 3 + 1), position.at(v * 3 + 2));
+    }
+    centroid /= 3;
+    deviation = std::max(deviation, std::fabs(1.0f - centroid.length()));
+  }
+  return deviation;
+}
+
+//a sphere is reduced until the next collapse would exceed the error bound
+void sphere()
+{
+  auto sphere = geometry::buffer::Sphere::make(1, 32, 16);
+  size_t triangles = sphere->index()->size() / 3;
+  size_t vertices = sphere->position()->itemCount();
+  float deviation = centroidDeviation(*sphere);
+
+  geometry::SimplifyOptions options;
+  options.maxError = 0.02f;
+  geometry::SimplifyResult result = geometry::simplify(*sphere, 0.1f, options);
+
+  CHECK(result.triangles < triangles);
+  CHECK(result.vertices < vertices);
+  CHECK(result.error <= options.maxError);
+  CHECK(sphere->index()->size() == result.triangles * 3);
+  CHECK(sphere->position()->itemCount() == result.vertices);
+
+  //vertices are kept in place, the surface stays within the bound
+  for(size_t i = 0; i < result.vertices; i++) {
+    const BufferAttributeT<float> &position = *sphere->position();
+    math::Vector3 p(position.at(i * 3), position.at(i * 3 + 1), position.at(i * 3 + 2));
+    CHECK(std::fabs(p.length() - 1.0f) < 1e-4f);
+  }
+  CHECK(centroidDeviation(*sphere) <= deviation + 2 * options.maxError);
+
+  //without a bound, the target is reached
+  auto unbounded = geometry::buffer::Sphere::make(1, 32, 16);
+  result = geometry::simplify(*unbounded, 0.5f);
+  CHECK(result.triangles <= triangles / 2);
+}
+
+//skin indices, skin weights and line distances follow their vertices
+void attributes()
+{
+  auto plane = geometry::buffer::Plane::make(1, 1, 8, 8);
+  const BufferAttributeT<float> &position = *plane->position();
+  size_t vertexCount = position.itemCount();
+
+  std::vector<math::Vector4> skinIndices, skinWeights;
+  std::vector<float> distances;
+  for(size_t i = 0; i < vertexCount; i++) {
+    float x = position.at(i * 3), y = position.at(i * 3 + 1);
+    skinIndices.emplace_back((float)(i % 4), 0, 0, 0);
+    skinWeights.emplace_back(x + 0.5f, y + 0.5f, 0, 0);
+    distances.push_back(x);
+  }
+  plane->setSkinIndices(attribute::copied<float, math::Vector4>(skinIndices));
+  plane->setSkinWeight(attribute::copied<float, math::Vector4>(skinWeights));
+  plane->setLineDistances(attribute::copied<float>(distances));
+
+  geometry::SimplifyResult result = geometry::simplify(*plane, 0.3f);
+  CHECK(result.vertices < vertexCount);
+
+  CHECK(plane->skinIndices()->itemCount() == result.vertices);
+  CHECK(plane->skinWeight()->itemCount() == result.vertices);
+  CHECK(plane->lineDistances()->itemCount() == result.vertices);
+
+  for(size_t i = 0; i < result.vertices; i++) {
+    float x = plane->position()->at(i * 3), y = plane->position()->at(i * 3 + 1);
+    CHECK(plane->skinWeight()->at(i * 4) == x + 0.5f);
+    CHECK(plane->skinWeight()->at(i * 4 + 1) == y + 0.5f);
+    CHECK(plane->lineDistances()->at(i) == x);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  flatGrid();
+  sphere();
+  attributes();
+
+  return test::result();
+}
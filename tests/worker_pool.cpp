@@ -0,0 +1,45 @@
+//
+// Created by byter on 17.10.26.
+//
+// WorkerPool::run must return once every thread ran the job, also right after setThreads
+
+#include <atomic>
+#include <threepp/renderers/gl/WorkerPool.h>
+#include "check.h"
+
+using namespace three;
+
+int main(int argc, char *argv[])
+{
+  gl::WorkerPool pool;
+
+  for(unsigned round = 0; round < 2000; round++) {
+    unsigned threads = 1 + round % 5;
+
+    //restarts the workers whenever the count changes
+    pool.setThreads(threads);
+    CHECK(pool.threads() == threads);
+
+    std::atomic<unsigned> calls(0);
+    pool.run([&]() {calls++;});
+    CHECK(calls == threads);
+
+    //and once more with the same workers
+    calls = 0;
+    pool.run([&]() {calls++;});
+    CHECK(calls == threads);
+  }
+
+  //work distributed through a shared counter, as the callers do
+  pool.setThreads(4);
+  std::atomic<unsigned> next(0), sum(0);
+  pool.run([&]() {
+    for(unsigned i = next++; i < 10000; i = next++) sum += i;
+  });
+  CHECK(sum == 10000u * 9999u / 2);
+
+  pool.setThreads(0);
+  CHECK(pool.threads() == 1);
+
+  return test::result();
+}
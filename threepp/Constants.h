@@ -55,17 +55,11 @@ enum class TextureFormat : GLenum
   Undefined = 0,
   Alpha = GL_ALPHA,
   RGB = GL_RGB,
-#ifdef GL_BGR
-  BGR = GL_BGR,
-#endif
+  BGR = 0x80E0, //GL_BGR
   RGBA = GL_RGBA,
-#ifdef GL_BGRA
-  BGRA = GL_BGRA,
-#endif
+  BGRA = 0x80E1, //GL_BGRA
   Luminance = GL_LUMINANCE,
-#ifdef GL_LUMINANCE4_ALPHA4
-  LuminanceAlpha = GL_LUMINANCE4_ALPHA4,
-#endif
+  LuminanceAlpha = 0x8043, //GL_LUMINANCE4_ALPHA4
   Depth = GL_DEPTH,
   DepthComponent=GL_DEPTH_COMPONENT,
   DepthComponent32 = GL_DEPTH_COMPONENT32F,
@@ -74,7 +68,13 @@ enum class TextureFormat : GLenum
   RGB_S3TC_DXT1 = GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
   RGBA_S3TC_DXT1 = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,
   RGBA_S3TC_DXT3 = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,
-  RGBA_S3TC_DXT5 = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+  RGBA_S3TC_DXT5 = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+  RED_RGTC1 = 0x8DBB, //GL_COMPRESSED_RED_RGTC1
+  RG_RGTC2 = 0x8DBD, //GL_COMPRESSED_RG_RGTC2
+  RGBA_BPTC = 0x8E8C, //GL_COMPRESSED_RGBA_BPTC_UNORM
+  RGB_ETC2 = 0x9274, //GL_COMPRESSED_RGB8_ETC2
+  RGBA_ETC2_EAC = 0x9278, //GL_COMPRESSED_RGBA8_ETC2_EAC
+  RGBA_ASTC_4x4 = 0x93B0 //GL_COMPRESSED_RGBA_ASTC_4x4_KHR
 };
 
 enum class TextureType : GLenum
@@ -268,6 +268,13 @@ enum class ShaderType {
   Fragment=GL_FRAGMENT_SHADER
 };
 
+enum class Validation
+{
+  Off,    //no error checking
+  Async,  //errors are reported through a KHR_debug message callback
+  Sync    //glGetError after GL calls, program validation before every draw
+};
+
 enum class Precision : int
 {
   lowp, mediump, highp, unknown
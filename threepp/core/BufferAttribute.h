@@ -91,13 +91,18 @@ protected:
        _version(att._version),
        _itemSize(att._itemSize),
        _normalized(att._normalized),
-       _updateRange(att._updateRange) {}
+       _updateRange(att._updateRange),
+       meshPerAttribute(att.meshPerAttribute) {}
 
 public:
   virtual ~BufferAttribute() = default;
 
   bool dynamic = false;
 
+  //if > 0, the attribute advances once per this many instances instead of once per vertex.
+  //Only effective with InstancedBufferGeometry
+  unsigned meshPerAttribute = 0;
+
   using Ptr = std::shared_ptr<BufferAttribute>;
 
   Signal<void(const BufferAttribute &)> onUpload;
@@ -84,6 +84,7 @@ BufferGeometry &BufferGeometry::computeBoundingSphere()
 }
 
 void BufferGeometry::raycastIndex(const Mesh &mesh,
+                             const math::Matrix4 &matrixWorld,
                              const Material &material,
                              size_t start,
                              size_t end,
@@ -100,7 +101,7 @@ void BufferGeometry::raycastIndex(const Mesh &mesh,
     Intersection intersection;
     unsigned rayIndex = 0;
     for(const auto &ray : rays) {
-      if(checkBufferGeometryIntersection(mesh, material, raycaster, ray, _position, _uv, a, b, c, intersection)) {
+      if(checkBufferGeometryIntersection(mesh, matrixWorld, material, raycaster, ray, _position, _uv, a, b, c, intersection)) {
         intersection.faceIndex = (unsigned)std::floor(i / 3); // triangle number in indices buffer semantics
         intersection.object = &const_cast<Mesh &>(mesh);
         intersects.add(rayIndex, intersection);
@@ -111,6 +112,7 @@ void BufferGeometry::raycastIndex(const Mesh &mesh,
 }
 
 void BufferGeometry::raycastPosition(const Mesh &mesh,
+                     const math::Matrix4 &matrixWorld,
                      const Material &material,
                      size_t start, size_t end,
                      const Raycaster &raycaster,
@@ -126,7 +128,7 @@ void BufferGeometry::raycastPosition(const Mesh &mesh,
     Intersection intersection;
     unsigned rayIndex = 0;
     for(const auto &ray : rays) {
-      if (checkBufferGeometryIntersection(mesh, material, raycaster, ray, _position, _uv, a, b, c, intersection)) {
+      if (checkBufferGeometryIntersection(mesh, matrixWorld, material, raycaster, ray, _position, _uv, a, b, c, intersection)) {
         intersection.faceIndex = (unsigned)std::floor(i / 3); // triangle number in positions buffer semantics
         intersection.object = &const_cast<Mesh &>(mesh);
         intersects.add(rayIndex, intersection);
@@ -137,6 +139,7 @@ void BufferGeometry::raycastPosition(const Mesh &mesh,
 }
 
 void BufferGeometry::raycast(const Mesh &mesh,
+                             const math::Matrix4 &matrixWorld,
                              const Raycaster &raycaster,
                              const std::vector<math::Ray> &rays,
                              IntersectList &intersects)
@@ -151,7 +154,7 @@ void BufferGeometry::raycast(const Mesh &mesh,
         auto start = std::max( group.start, _drawRange.start );
         auto end = std::min( group.start + group.count, _drawRange.start + _drawRange.count );
 
-        raycastIndex(mesh, *groupMaterial, start, end, raycaster, rays, intersects);
+        raycastIndex(mesh, matrixWorld, *groupMaterial, start, end, raycaster, rays, intersects);
       }
     }
     else {
@@ -160,7 +163,7 @@ void BufferGeometry::raycast(const Mesh &mesh,
       auto start = _drawRange.start;
       auto end = std::min( _index->itemCount(), _drawRange.start + _drawRange.count );
 
-      raycastIndex(mesh, *material, start, end, raycaster, rays, intersects);
+      raycastIndex(mesh, matrixWorld, *material, start, end, raycaster, rays, intersects);
     }
   }
   else if(_position) {
@@ -173,7 +176,7 @@ void BufferGeometry::raycast(const Mesh &mesh,
         auto start = std::max( group.start, _drawRange.start );
         auto end = std::min( group.start + group.count, _drawRange.start + _drawRange.count );
 
-        raycastPosition(mesh, *groupMaterial, start, end, raycaster, rays, intersects);
+        raycastPosition(mesh, matrixWorld, *groupMaterial, start, end, raycaster, rays, intersects);
       }
     }
     else {
@@ -182,7 +185,7 @@ void BufferGeometry::raycast(const Mesh &mesh,
       auto start = _drawRange.start;
       auto end = std::min( _position->itemCount(), _drawRange.start + _drawRange.count );
 
-      raycastPosition(mesh, *material, start, end, raycaster, rays, intersects);
+      raycastPosition(mesh, matrixWorld, *material, start, end, raycaster, rays, intersects);
     }
   }
 }
@@ -103,6 +103,7 @@ protected:
   {}
 
   void raycastIndex(const Mesh &mesh,
+                    const math::Matrix4 &matrixWorld,
                     const three::Material &material,
                     size_t start, size_t end,
                     const Raycaster &raycaster,
@@ -110,6 +111,7 @@ protected:
                     IntersectList &intersects);
 
   void raycastPosition(const Mesh &mesh,
+                       const math::Matrix4 &matrixWorld,
                        const three::Material &material,
                        size_t start, size_t end,
                        const Raycaster &raycaster,
@@ -181,6 +183,12 @@ public:
 
   const BufferAttributeT<float>::Ptr bitangents() const {return _bitangents;}
 
+  const BufferAttributeT<float>::Ptr &lineDistances() const {return _lineDistances;}
+
+  const BufferAttributeT<float>::Ptr &skinIndices() const {return _skinIndices;}
+
+  const BufferAttributeT<float>::Ptr &skinWeight() const {return _skinWeight;}
+
   const std::vector<BufferAttributeT<float>::Ptr> &morphPositions() const {return _morphAttributes_position;}
 
   const std::vector<BufferAttributeT<float>::Ptr> &morphNormals() const {return _morphAttributes_normal;}
@@ -253,6 +261,18 @@ public:
     return *this;
   }
 
+  BufferGeometry &setSkinIndices(const BufferAttributeT<float>::Ptr &skinIndices)
+  {
+    _skinIndices = skinIndices;
+    return *this;
+  }
+
+  BufferGeometry &setSkinWeight(const BufferAttributeT<float>::Ptr &skinWeight)
+  {
+    _skinWeight = skinWeight;
+    return *this;
+  }
+
   BufferAttribute::Ptr getAttribute(AttributeName name)
   {
     switch(name) {
@@ -308,6 +328,7 @@ public:
                IntersectList &intersects) override;
 
   void raycast(const Mesh &mesh,
+               const math::Matrix4 &matrixWorld,
                const Raycaster &raycaster,
                const std::vector<math::Ray> &ray,
                IntersectList &intersects) override;
@@ -350,6 +371,12 @@ public:
 
   unsigned maxInstancedCount() const {return _maxInstancedCount;}
 
+  /**
+   * set the number of instances to draw. If left at 0, it is derived from the per-instance
+   * attributes on first use
+   */
+  void setMaxInstancedCount(unsigned count) {_maxInstancedCount = count;}
+
   InstancedBufferGeometry *cloned() const override
   {
     return new InstancedBufferGeometry(*this);
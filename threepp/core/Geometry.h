@@ -85,7 +85,12 @@ public:
                        const std::vector<math::Ray> &ray,
                        IntersectList &intersects) {}
 
+  /**
+   * @param matrixWorld the transform from geometry to world space, the mesh's world matrix or,
+   * for an InstancedMesh, that of the instance
+   */
   virtual void raycast(const Mesh &mesh,
+                       const math::Matrix4 &matrixWorld,
                        const Raycaster &raycaster,
                        const std::vector<math::Ray> &ray,
                        IntersectList &intersects) {}
@@ -58,6 +58,7 @@ LinearGeometry::LinearGeometry(const LinearGeometry &geometry)
 }
 
 void LinearGeometry::raycast(const Mesh &mesh,
+                             const math::Matrix4 &matrixWorld,
                              const Raycaster &raycaster,
                              const std::vector<math::Ray> &rays,
                              IntersectList &intersects)
@@ -102,7 +103,7 @@ void LinearGeometry::raycast(const Mesh &mesh,
     Intersection intersection;
     unsigned rayIndex = 0;
     for(const auto &ray : rays) {
-      if (checkIntersection(mesh, *faceMaterial, raycaster, ray, fvA, fvB, fvC, intersection)) {
+      if (checkIntersection(mesh, matrixWorld, *faceMaterial, raycaster, ray, fvA, fvB, fvC, intersection)) {
 
         if (faceVertexUvs.size() > f) {
 
@@ -218,6 +218,7 @@ public:
                IntersectList &intersects) override;
 
   void raycast(const Mesh &mesh,
+               const math::Matrix4 &matrixWorld,
                const Raycaster &raycaster,
                const std::vector<math::Ray> &rays,
                IntersectList &intersects) override;
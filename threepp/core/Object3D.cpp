@@ -2,9 +2,12 @@
 // Created by byter on 29.07.17.
 //
 
+#include <cmath>
+#include <limits>
 #include "Object3D.h"
 #include "LinearGeometry.h"
 #include "BufferGeometry.h"
+#include <threepp/objects/InstancedMesh.h>
 
 namespace three {
 
@@ -194,25 +197,167 @@ void Object3D::updateMatrix()
   _matrixWorldNeedsUpdate = true;
 }
 
+math::Sphere Object3D::localBoundingSphere()
+{
+  static const float unbounded = std::numeric_limits<float>::infinity();
+
+  if(is<Sprite>()) {
+    return frustumCulled ? Sphere(Vector3(0, 0, 0), 0.7071067811865476f) : Sphere(Vector3(0, 0, 0), unbounded);
+  }
+  if(is<ImmediateRenderObject>() || is<LensFlare>()) {
+    return Sphere(Vector3(0, 0, 0), unbounded);
+  }
+  if(InstancedMesh *mesh = typer) {
+    if(!frustumCulled || !_geometry) return Sphere(Vector3(0, 0, 0), unbounded);
+
+    return mesh->count() ? mesh->boundingSphere() : Sphere();
+  }
+  if(is<Mesh>() || is<Line>() || is<Points>()) {
+    //skinned vertices may leave the bind pose bounds
+    if(!frustumCulled || is<SkinnedMesh>() || !_geometry || _geometry->boundingSphere().isEmpty())
+      return Sphere(Vector3(0, 0, 0), unbounded);
+
+    return _geometry->boundingSphere();
+  }
+  return Sphere();
+}
+
+static void unifyBounds(Sphere &bounds, const Sphere &sphere)
+{
+  if(sphere.isEmpty()) return;
+
+  if(bounds.isEmpty()) bounds = sphere;
+  else bounds.unify(sphere);
+}
+
+size_t Object3D::stateHash() const
+{
+  size_t hash = 0;
+
+  hash_combine(hash, _visible);
+  hash_combine(hash, _layers.value());
+  hash_combine(hash, _renderOrder);
+  hash_combine(hash, frustumCulled);
+  hash_combine(hash, castShadow);
+  hash_combine(hash, receiveShadow);
+  hash_combine(hash, occluder);
+  hash_combine(hash, occluderGeometry.get());
+
+  hash_combine(hash, _geometry.get());
+  if(_geometry) {
+    //render items point into the groups
+    hash_combine(hash, _geometry->groups().data());
+    hash_combine(hash, _geometry->groups().size());
+
+    const Sphere &sphere = _geometry->boundingSphere();
+    hash_combine(hash, sphere.radius());
+    hash_combine(hash, sphere.center().x());
+    hash_combine(hash, sphere.center().y());
+    hash_combine(hash, sphere.center().z());
+  }
+
+  for(const Material::Ptr &material : _materials) {
+    hash_combine(hash, material.get());
+    if(material) {
+      hash_combine(hash, material->visible);
+      hash_combine(hash, material->transparent());
+    }
+  }
+
+  if(InstancedMesh *mesh = typer) hash_combine(hash, mesh->version());
+
+  return hash;
+}
+
 void Object3D::updateMatrixWorld(bool force)
 {
   if (matrixAutoUpdate) updateMatrix();
 
+  bool structureChanged = _childrenChanged;
+  bool transformChanged = false;
+  _childrenChanged = false;
+
+  bool changesTracked = changeTracking || (_parent && _parent->_changesTracked);
+  if(changesTracked) {
+    size_t stateHash = this->stateHash();
+
+    //the versions are outdated if they were not maintained before
+    structureChanged = structureChanged || stateHash != _stateHash || !_changesTracked;
+    transformChanged = !_changesTracked;
+
+    _stateHash = stateHash;
+  }
+  _changesTracked = changesTracked;
+
+  bool tracked = subtreeCulling || (_parent && _parent->_boundsTracked);
+  if(tracked != _boundsTracked) {
+    _boundsTracked = tracked;
+    invalidateBounds();
+  }
+  _boundsChanged = false;
+
   if (_matrixWorldNeedsUpdate || force ) {
 
-    if (_parent) {
-      _matrixWorld.multiply(_parent->_matrixWorld, _matrix);
-    } else {
-      _matrixWorld = _matrix;
+    auto update = [this]() {
+      if (_parent) {
+        _matrixWorld.multiply(_parent->_matrixWorld, _matrix);
+      } else {
+        _matrixWorld = _matrix;
+      }
+    };
+
+    //only change tracking and subtree bounds need to know if the matrix actually changed
+    if(_changesTracked || _boundsTracked) {
+      Matrix4 previous = _matrixWorld;
+      update();
+
+      if(previous != _matrixWorld) {
+        invalidateBounds();
+        transformChanged = true;
+      }
     }
+    else update();
 
     _matrixWorldNeedsUpdate = false;
     force = true;
   }
 
+  if(_boundsTracked) {
+    //geometry bounds may have been (re)computed since the last update
+    Sphere local = localBoundingSphere();
+    if(!(_localBounds == local)) {
+      _localBounds = local;
+      invalidateBounds();
+    }
+  }
+
   // update children
-  for (Object3D::Ptr child : _children) {
+  for (const Object3D::Ptr &child : _children) {
+    unsigned structureVersion = child->_structureVersion;
+    unsigned transformVersion = child->_transformVersion;
+
     child->updateMatrixWorld( force );
+
+    if(child->_boundsChanged) invalidateBounds();
+    if(child->_structureVersion != structureVersion) structureChanged = true;
+    if(child->_transformVersion != transformVersion) transformChanged = true;
+  }
+
+  if(structureChanged) _structureVersion++;
+  if(transformChanged) _transformVersion++;
+
+  if(_boundsTracked && _boundsDirty) {
+
+    Sphere bounds = _localBounds;
+    if(!std::isinf(bounds.radius())) bounds.apply(_matrixWorld);
+
+    for (const Object3D::Ptr &child : _children) {
+      unifyBounds(bounds, child->_subtreeBounds);
+    }
+
+    _subtreeBounds = bounds;
+    _boundsDirty = false;
+    _boundsChanged = true;
   }
 }
 
@@ -258,6 +403,7 @@ Object3D::Object3D(const Object3D &clone) : Object3D()
   receiveShadow = clone.receiveShadow;
   frustumCulled = clone.frustumCulled;
   matrixAutoUpdate = clone.matrixAutoUpdate;
+  subtreeCulling = clone.subtreeCulling;
 
   customDepthMaterial = clone.customDepthMaterial;
   customDistanceMaterial = clone.customDistanceMaterial;
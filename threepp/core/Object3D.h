@@ -18,6 +18,7 @@
 #include <threepp/math/Euler.h>
 #include <threepp/math/Quaternion.h>
 #include <threepp/math/Matrix4.h>
+#include <threepp/math/Sphere.h>
 #include <threepp/material/Material.h>
 #include <threepp/util/Resolver.h>
 #include "Geometry.h"
@@ -81,6 +82,40 @@ protected:
   Geometry::Ptr _geometry;
   std::vector<Material::Ptr> _materials;
 
+  //subtree bounds, see subtreeCulling
+  math::Sphere _localBounds;
+  math::Sphere _subtreeBounds;
+  bool _boundsTracked = false;
+  bool _boundsDirty = true;
+  bool _boundsChanged = false;
+
+  //change tracking, see changeTracking
+  bool _changesTracked = false;
+  size_t _stateHash = 0;
+  bool _childrenChanged = true;
+  unsigned _structureVersion = 0;
+  unsigned _transformVersion = 0;
+
+  math::Sphere localBoundingSphere();
+
+  /**
+   * mark the subtree bounds of this object and its ancestors as outdated, so that ancestors not
+   * updated along with this object don't report stale bounds. Stops at an object already marked,
+   * whose ancestors are marked as well
+   */
+  void invalidateBounds()
+  {
+    for(Object3D *object = this; object && !object->_boundsDirty; object = object->_parent)
+      object->_boundsDirty = true;
+  }
+
+  size_t stateHash() const;
+
+  /**
+   * called after child was removed from this object
+   */
+  virtual void childRemoved(Object3D *child) {}
+
   void onRotationChange(const math::Euler &rotation);
   void onQuaternionChange(const math::Quaternion &quaternion);
 
@@ -116,6 +151,29 @@ public:
   bool frustumCulled = true;
   bool matrixAutoUpdate = true;
 
+  /**
+   * maintain a world space bounding sphere around this object and all its descendants, updated
+   * by updateMatrixWorld. The renderer uses it to reject an off-screen subtree with a single test,
+   * and to skip the per-object tests for subtrees that lie completely inside the frustum
+   */
+  bool subtreeCulling = false;
+
+  /**
+   * maintain structureVersion and transformVersion for this object and its descendants. This costs
+   * a state hash and a world matrix comparison per object and update. The renderer sets it on the
+   * scene if it reuses render lists, see OpenGLRendererOptions::reuseRenderLists
+   */
+  bool changeTracking = false;
+
+  /**
+   * rasterize this object into the depth buffer used for occlusion culling (see
+   * OpenGLRendererOptions::occlusionCulling). If occluderGeometry is set, it is rasterized
+   * instead of the render geometry, which allows for a simplified proxy. Occluders themselves
+   * are never culled by occlusion
+   */
+  bool occluder = false;
+  std::shared_ptr<BufferGeometry> occluderGeometry;
+
   Material::Ptr customDepthMaterial;
   Material::Ptr customDistanceMaterial;
 
@@ -158,6 +216,31 @@ public:
 
   Object3D *parent() const {return _parent;}
 
+  /**
+   * @return true if subtreeBoundingSphere() is up to date
+   */
+  bool hasSubtreeBounds() const {return _boundsTracked && !_boundsDirty;}
+
+  /**
+   * world space bounds of this object and its descendants. An empty sphere means there is nothing
+   * to render in the subtree, an infinite radius that some part of it cannot be bounded
+   */
+  const math::Sphere &subtreeBoundingSphere() const {return _subtreeBounds;}
+
+  /**
+   * incremented by updateMatrixWorld if anything in this object's subtree changed that affects
+   * which objects are rendered and how they are sorted: children, visibility, layers, render order,
+   * shadow flags, geometries and materials (including their visible and transparent state).
+   * Only maintained while changeTracking is set on this object or an ancestor
+   */
+  unsigned structureVersion() const {return _structureVersion;}
+
+  /**
+   * incremented by updateMatrixWorld if a world transform in this object's subtree changed. Only
+   * maintained while changeTracking is set on this object or an ancestor
+   */
+  unsigned transformVersion() const {return _transformVersion;}
+
   int renderOrder() const {return _renderOrder;}
 
   virtual bool isShadowRenderable() const {return false;}
@@ -170,9 +253,10 @@ public:
     else _materials.push_back(material);
   }
 
-  const Material::Ptr material(size_t index=0) const
+  const Material::Ptr &material(size_t index=0) const
   {
-    return index < _materials.size() ? _materials[index] : nullptr;
+    static const Material::Ptr none;
+    return index < _materials.size() ? _materials[index] : none;
   }
 
   const size_t materialCount() const
@@ -180,7 +264,7 @@ public:
     return _materials.size();
   }
 
-  const Geometry::Ptr geometry() const
+  const Geometry::Ptr &geometry() const
   {
     return _geometry;
   }
@@ -293,6 +377,8 @@ public:
     object->_childId = _children.size()+1;
 
     _children.push_back( object );
+    invalidateBounds();
+    _childrenChanged = true;
   }
 
   void remove(Object3D::Ptr object)
@@ -305,17 +391,27 @@ public:
       (*found)->_childId = 0;
 
       _children.erase(found);
+      invalidateBounds();
+      _childrenChanged = true;
+
+      childRemoved(object.get());
     }
   }
 
   void removeAll()
   {
-    for(auto child : _children) {
+    std::vector<Object3D::Ptr> children;
+    children.swap(_children);
+
+    for(auto child : children) {
 
       child->_parent = nullptr;
       child->_childId = 0;
     }
-    _children.clear();
+    invalidateBounds();
+    _childrenChanged = true;
+
+    for(auto child : children) childRemoved(child.get());
   }
 
   Object3D::Ptr getChildByName(std::string name)
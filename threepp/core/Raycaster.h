@@ -37,6 +37,9 @@ struct Intersection
   Object3D *object = nullptr;
 
   unsigned faceIndex;
+
+  //index of the instance that was hit, see InstancedMesh
+  unsigned instanceId = 0;
 };
 
 /**
@@ -21,6 +21,7 @@ namespace three {
 namespace impl {
 
 inline bool checkIntersection(const Object3D &object,
+                              const math::Matrix4 &matrixWorld,
                               const Material &material,
                               const Raycaster &raycaster,
                               const math::Ray &ray,
@@ -43,7 +44,7 @@ inline bool checkIntersection(const Object3D &object,
 
   if (!intersect) return false;
 
-  result.point.apply(object.matrixWorld());
+  result.point.apply(matrixWorld);
 
   float distance = raycaster.origin().distanceTo(result.point);
 
@@ -69,6 +70,7 @@ inline math::Vector2 uvIntersection(const math::Vector3 &point,
 }
 
 inline bool checkBufferGeometryIntersection(const Object3D &object,
+                                            const math::Matrix4 &matrixWorld,
                                             const Material &material,
                                             const Raycaster &raycaster,
                                             const math::Ray &ray,
@@ -81,7 +83,7 @@ inline bool checkBufferGeometryIntersection(const Object3D &object,
   const math::Vector3 &vB = position->item_at<math::Vector3>(b);
   const math::Vector3 &vC = position->item_at<math::Vector3>(c);
 
-  if (checkIntersection(object, material, raycaster, ray, vA, vB, vC, intersection)) {
+  if (checkIntersection(object, matrixWorld, material, raycaster, ray, vA, vB, vC, intersection)) {
 
     if(uv) {
       const math::Vector2 &uvA = uv->item_at<math::Vector2>(a);
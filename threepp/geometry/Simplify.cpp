@@ -0,0 +1,471 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#include "Simplify.h"
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace three {
+namespace geometry {
+
+using namespace std;
+
+namespace {
+
+static const uint32_t none = numeric_limits<uint32_t>::max();
+
+/**
+ * sum of squared distances to a set of planes, as a symmetric 4x4 matrix. The weight is the
+ * total area of the triangles the planes were taken from
+ */
+struct Quadric
+{
+  double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+  double a11 = 0, a12 = 0, a13 = 0;
+  double a22 = 0, a23 = 0;
+  double a33 = 0;
+  double weight = 0;
+
+  Quadric() = default;
+
+  //plane with unit normal (x, y, z) and distance d, weighted by w
+  Quadric(double x, double y, double z, double d, double w)
+     : a00(x * x * w), a01(x * y * w), a02(x * z * w), a03(x * d * w),
+       a11(y * y * w), a12(y * z * w), a13(y * d * w),
+       a22(z * z * w), a23(z * d * w),
+       a33(d * d * w), weight(w)
+  {}
+
+  Quadric &operator +=(const Quadric &q)
+  {
+    a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+    a11 += q.a11; a12 += q.a12; a13 += q.a13;
+    a22 += q.a22; a23 += q.a23;
+    a33 += q.a33;
+    weight += q.weight;
+    return *this;
+  }
+
+  double error(const float *p) const
+  {
+    double x = p[0], y = p[1], z = p[2];
+
+    return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+           + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+           + a22 * z * z + 2 * a23 * z
+           + a33;
+  }
+};
+
+struct Collapse
+{
+  uint32_t from, to;
+
+  //distance in object space units
+  float error;
+
+  bool operator < (const Collapse &other) const {return error < other.error;}
+};
+
+/**
+ * hashes and compares vertices by the values of a set of attributes
+ */
+struct VertexKey
+{
+  const vector<const BufferAttributeT<float> *> &streams;
+
+  explicit VertexKey(const vector<const BufferAttributeT<float> *> &streams) : streams(streams) {}
+
+  size_t operator()(uint32_t vertex) const
+  {
+    size_t seed = 0;
+    for(const BufferAttributeT<float> *stream : streams) {
+      unsigned itemSize = stream->itemSize();
+      for(unsigned i = 0; i < itemSize; i++) {
+        uint32_t bits;
+        memcpy(&bits, &stream->at(vertex * itemSize + i), sizeof(bits));
+        hash_combine(seed, bits);
+      }
+    }
+    return seed;
+  }
+
+  bool operator()(uint32_t a, uint32_t b) const
+  {
+    for(const BufferAttributeT<float> *stream : streams) {
+      unsigned itemSize = stream->itemSize();
+      if(memcmp(&stream->at(a * itemSize), &stream->at(b * itemSize), itemSize * sizeof(float)))
+        return false;
+    }
+    return true;
+  }
+};
+
+/**
+ * @return for each vertex, the first vertex with the same values
+ */
+vector<uint32_t> weld(const vector<const BufferAttributeT<float> *> &streams, size_t vertexCount)
+{
+  VertexKey key(streams);
+  unordered_map<uint32_t, uint32_t, VertexKey, VertexKey> first(vertexCount, key, key);
+
+  vector<uint32_t> result(vertexCount);
+  for(uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+    result[vertex] = first.emplace(vertex, vertex).first->second;
+  }
+  return result;
+}
+
+template <unsigned N>
+struct Item
+{
+  float values[N];
+};
+
+template <unsigned N>
+BufferAttributeT<float>::Ptr compact(const BufferAttributeT<float> &attribute, const vector<uint32_t> &vertices)
+{
+  vector<Item<N>> items(vertices.size());
+  for(size_t i = 0; i < vertices.size(); i++) {
+    memcpy(items[i].values, &attribute.at(vertices[i] * N), sizeof(Item<N>));
+  }
+  return attribute::copied<float, Item<N>>(items, attribute.normalized());
+}
+
+BufferAttributeT<float>::Ptr compact(const BufferAttributeT<float>::Ptr &attribute, const vector<uint32_t> &vertices)
+{
+  if(!attribute) return nullptr;
+
+  switch(attribute->itemSize()) {
+    case 1:
+      return compact<1>(*attribute, vertices);
+    case 2:
+      return compact<2>(*attribute, vertices);
+    case 3:
+      return compact<3>(*attribute, vertices);
+    case 4:
+      return compact<4>(*attribute, vertices);
+    default:
+      throw invalid_argument("simplify: unsupported attribute item size");
+  }
+}
+
+}
+
+SimplifyResult simplify(BufferGeometry &geometry, float targetRatio, const SimplifyOptions &options)
+{
+  const BufferAttributeT<float>::Ptr &position = geometry.position();
+  if(!position || position->itemSize() != 3)
+    throw invalid_argument("simplify: geometry has no positions");
+  if(geometry.useMorphing())
+    throw invalid_argument("simplify: morph targets are not supported");
+
+  const size_t vertexCount = position->itemCount();
+  const float *positions = &position->at(0);
+
+  vector<uint32_t> indices;
+  if(const BufferAttributeT<uint32_t>::Ptr &index = geometry.index()) {
+    indices.resize(index->size() / 3 * 3);
+    for(size_t i = 0; i < indices.size(); i++) {
+      indices[i] = index->at(i);
+      if(indices[i] >= vertexCount) throw out_of_range("simplify: index exceeds vertex count");
+    }
+  }
+  else {
+    indices.resize(vertexCount / 3 * 3);
+    for(uint32_t i = 0; i < indices.size(); i++) indices[i] = i;
+  }
+
+  vector<const BufferAttributeT<float> *> streams;
+  for(const BufferAttributeT<float>::Ptr &attribute : {position, geometry.normal(), geometry.color(), geometry.uv(),
+                                                        geometry.uv2(), geometry.tangents(), geometry.bitangents(),
+                                                        geometry.skinIndices(), geometry.skinWeight(),
+                                                        geometry.lineDistances()}) {
+    if(!attribute) continue;
+    if(attribute->itemCount() < vertexCount)
+      throw invalid_argument("simplify: attribute has fewer items than the positions");
+    streams.push_back(attribute.get());
+  }
+
+  //identical vertices become one, vertices sharing a position form a site
+  vector<uint32_t> canonical = weld(streams, vertexCount);
+  for(uint32_t &index : indices) index = canonical[index];
+
+  vector<uint32_t> site = weld({position.get()}, vertexCount);
+
+  //the vertex used at each site. Sites with more than one are attribute seams
+  vector<uint32_t> siteVertex(vertexCount, none);
+  vector<uint8_t> seam(vertexCount, 0);
+  for(uint32_t index : indices) {
+    uint32_t &vertex = siteVertex[site[index]];
+    if(vertex == none) vertex = index;
+    else if(vertex != index) seam[site[index]] = 1;
+  }
+
+  //the group of each triangle, groups are ranges in the index
+  const vector<Group> groups = geometry.groups();
+  size_t triangleCount = indices.size() / 3;
+
+  vector<uint32_t> triangleIds(triangleCount);
+  vector<uint32_t> triangleGroup(triangleCount, none);
+  for(uint32_t t = 0; t < triangleCount; t++) triangleIds[t] = t;
+
+  for(uint32_t g = 0; g < groups.size(); g++) {
+    size_t end = std::min((groups[g].start + groups[g].count) / 3, triangleCount);
+    for(size_t t = groups[g].start / 3; t < end; t++) {
+      if(triangleGroup[t] == none) triangleGroup[t] = g;
+    }
+  }
+
+  //area weighted plane quadrics
+  vector<Quadric> quadrics(vertexCount);
+  for(size_t t = 0; t < triangleCount; t++) {
+    const float *p0 = positions + indices[t * 3] * 3;
+    const float *p1 = positions + indices[t * 3 + 1] * 3;
+    const float *p2 = positions + indices[t * 3 + 2] * 3;
+
+    double ux = p1[0] - p0[0], uy = p1[1] - p0[1], uz = p1[2] - p0[2];
+    double vx = p2[0] - p0[0], vy = p2[1] - p0[1], vz = p2[2] - p0[2];
+    double nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+
+    double length = sqrt(nx * nx + ny * ny + nz * nz);
+    if(length == 0) continue;
+
+    nx /= length; ny /= length; nz /= length;
+    Quadric quadric(nx, ny, nz, -(nx * p0[0] + ny * p0[1] + nz * p0[2]), length * 0.5);
+
+    for(unsigned c = 0; c < 3; c++) quadrics[site[indices[t * 3 + c]]] += quadric;
+  }
+
+  const size_t target = (size_t)(triangleCount * std::max(0.0f, std::min(targetRatio, 1.0f)));
+  const float minCos = cos(options.maxNormalDeviation);
+
+  SimplifyResult result;
+
+  vector<uint32_t> redirect(vertexCount);
+  vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+  vector<uint32_t> adjacency;
+  vector<uint8_t> locked(vertexCount);
+  vector<uint8_t> touched(vertexCount);
+  vector<uint32_t> siteGroup(vertexCount);
+  unordered_map<uint64_t, uint32_t> edges;
+  vector<Collapse> collapses;
+  vector<uint32_t> neighbours;
+
+  //each pass collapses edges in order of increasing error, as long as their neighbourhood is
+  //untouched by the collapses done before. Then the topology is rebuilt for the next pass
+  bool stop = false;
+  while(triangleCount > target && !stop) {
+
+    //triangles around each site
+    fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+    for(uint32_t index : indices) adjacencyOffsets[site[index] + 1]++;
+    for(size_t s = 0; s < vertexCount; s++) adjacencyOffsets[s + 1] += adjacencyOffsets[s];
+
+    adjacency.resize(indices.size());
+    vector<uint32_t> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for(uint32_t i = 0; i < indices.size(); i++) adjacency[fillOffsets[site[indices[i]]]++] = i / 3;
+
+    //sites on borders, non-manifold edges, seams or group boundaries stay
+    copy(seam.begin(), seam.end(), locked.begin());
+    fill(siteGroup.begin(), siteGroup.end(), none);
+
+    edges.clear();
+    for(size_t t = 0; t < triangleCount; t++) {
+      for(unsigned c = 0; c < 3; c++) {
+        uint64_t a = site[indices[t * 3 + c]], b = site[indices[t * 3 + (c + 1) % 3]];
+        edges[a < b ? a << 32 | b : b << 32 | a]++;
+
+        uint32_t &group = siteGroup[a];
+        if(group == none) group = triangleGroup[t];
+        else if(group != triangleGroup[t]) locked[a] = 1;
+      }
+    }
+    for(const auto &edge : edges) {
+      if(edge.second != 2) {
+        locked[edge.first >> 32] = 1;
+        locked[edge.first & 0xFFFFFFFF] = 1;
+      }
+    }
+
+    collapses.clear();
+    for(size_t t = 0; t < triangleCount; t++) {
+      for(unsigned c = 0; c < 3; c++) {
+        uint32_t a = site[indices[t * 3 + c]], b = site[indices[t * 3 + (c + 1) % 3]];
+
+        for(unsigned dir = 0; dir < 2; dir++, swap(a, b)) {
+          if(locked[a]) continue;
+
+          Quadric quadric = quadrics[a];
+          quadric += quadrics[b];
+
+          double error = quadric.weight > 0 ? std::max(quadric.error(positions + b * 3), 0.0) / quadric.weight : 0;
+          collapses.push_back({a, b, (float)sqrt(error)});
+        }
+      }
+    }
+    sort(collapses.begin(), collapses.end());
+
+    for(uint32_t v = 0; v < vertexCount; v++) redirect[v] = v;
+    fill(touched.begin(), touched.end(), 0);
+
+    size_t collapsed = 0, removed = 0;
+    for(const Collapse &collapse : collapses) {
+      if(triangleCount - removed <= target) break;
+      if(collapse.error > options.maxError) {
+        stop = true;
+        break;
+      }
+      if(touched[collapse.from] || touched[collapse.to]) continue;
+
+      //the triangles sharing the edge vanish, the others must not flip
+      uint32_t from = siteVertex[collapse.from], to = none;
+      bool valid = true;
+      size_t vanishing = 0;
+
+      for(uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && valid; a++) {
+        const uint32_t *corners = &indices[adjacency[a] * 3];
+
+        unsigned edge = 3;
+        for(unsigned c = 0; c < 3; c++) if(site[corners[c]] == collapse.to) edge = c;
+
+        if(edge < 3) {
+          //a consistent attribute vertex on the target side
+          if(to == none) to = corners[edge];
+          else if(to != corners[edge]) valid = false;
+          vanishing++;
+          continue;
+        }
+
+        const float *p[3], *q[3];
+        for(unsigned c = 0; c < 3; c++) {
+          p[c] = positions + corners[c] * 3;
+          q[c] = corners[c] == from ? positions + collapse.to * 3 : p[c];
+        }
+
+        float n0[3], n1[3];
+        for(unsigned pass = 0; pass < 2; pass++) {
+          const float **v = pass ? q : p;
+          float *n = pass ? n1 : n0;
+
+          float ux = v[1][0] - v[0][0], uy = v[1][1] - v[0][1], uz = v[1][2] - v[0][2];
+          float wx = v[2][0] - v[0][0], wy = v[2][1] - v[0][1], wz = v[2][2] - v[0][2];
+          n[0] = uy * wz - uz * wy;
+          n[1] = uz * wx - ux * wz;
+          n[2] = ux * wy - uy * wx;
+        }
+
+        float dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+        float length = sqrt((n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]) * (n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]));
+
+        if(length == 0 || dot < minCos * length) valid = false;
+      }
+      if(!valid || to == none) continue;
+
+      //the edge's endpoints may only share the neighbours across the vanishing triangles,
+      //otherwise the collapse would fold the surface onto itself
+      neighbours.clear();
+      for(uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+        for(unsigned c = 0; c < 3; c++) neighbours.push_back(site[indices[adjacency[a] * 3 + c]]);
+      }
+      sort(neighbours.begin(), neighbours.end());
+      neighbours.erase(unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+      size_t shared = 0;
+      for(uint32_t a = adjacencyOffsets[collapse.to]; a < adjacencyOffsets[collapse.to + 1]; a++) {
+        for(unsigned c = 0; c < 3; c++) {
+          uint32_t s = site[indices[adjacency[a] * 3 + c]];
+          if(s == collapse.from || s == collapse.to) continue;
+
+          auto found = lower_bound(neighbours.begin(), neighbours.end(), s);
+          if(found != neighbours.end() && *found == s) {
+            shared++;
+            neighbours.erase(found);
+          }
+        }
+      }
+      if(shared != vanishing) continue;
+
+      redirect[from] = to;
+      quadrics[collapse.to] += quadrics[collapse.from];
+
+      for(uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+        for(unsigned c = 0; c < 3; c++) touched[site[indices[adjacency[a] * 3 + c]]] = 1;
+      }
+      siteVertex[collapse.from] = none;
+
+      removed += vanishing;
+      collapsed++;
+      result.error = std::max(result.error, collapse.error);
+    }
+    if(collapsed == 0) break;
+
+    //apply the collapses, triangles keep their order
+    size_t kept = 0;
+    for(size_t t = 0; t < triangleCount; t++) {
+      uint32_t a = redirect[indices[t * 3]], b = redirect[indices[t * 3 + 1]], c = redirect[indices[t * 3 + 2]];
+      if(site[a] == site[b] || site[b] == site[c] || site[c] == site[a]) continue;
+
+      indices[kept * 3] = a;
+      indices[kept * 3 + 1] = b;
+      indices[kept * 3 + 2] = c;
+      triangleIds[kept] = triangleIds[t];
+      triangleGroup[kept] = triangleGroup[t];
+      kept++;
+    }
+    triangleCount = kept;
+    indices.resize(kept * 3);
+    triangleIds.resize(kept);
+    triangleGroup.resize(kept);
+  }
+
+  //keep the used vertices, in their original order
+  vector<uint32_t> vertices;
+  vector<uint32_t> newIndex(vertexCount, none);
+  for(uint32_t index : indices) newIndex[index] = 0;
+  for(uint32_t v = 0; v < vertexCount; v++) {
+    if(newIndex[v] == none) continue;
+    newIndex[v] = (uint32_t)vertices.size();
+    vertices.push_back(v);
+  }
+  for(uint32_t &index : indices) index = newIndex[index];
+
+  //group ranges are mapped through the surviving triangles
+  auto mapped = [&](size_t start) {
+    return (size_t)(lower_bound(triangleIds.begin(), triangleIds.end(), (uint32_t)(start / 3)) - triangleIds.begin()) * 3;
+  };
+  geometry.clearGroups();
+  for(const Group &group : groups) {
+    size_t start = mapped(group.start), end = mapped(group.start + group.count);
+    if(end > start) geometry.addGroup((uint32_t)start, (uint32_t)(end - start), (uint32_t)group.materialIndex);
+  }
+
+  geometry.setIndex(attribute::copied<uint32_t>(indices));
+  geometry.setPosition(compact(geometry.position(), vertices));
+  geometry.setNormal(compact(geometry.normal(), vertices));
+  geometry.setColor(compact(geometry.color(), vertices));
+  geometry.setUV(compact(geometry.uv(), vertices));
+  geometry.setUV2(compact(geometry.uv2(), vertices));
+  geometry.setTangents(compact(geometry.tangents(), vertices));
+  geometry.setBitangents(compact(geometry.bitangents(), vertices));
+  geometry.setSkinIndices(compact(geometry.skinIndices(), vertices));
+  geometry.setSkinWeight(compact(geometry.skinWeight(), vertices));
+  geometry.setLineDistances(compact(geometry.lineDistances(), vertices));
+  geometry.setDrawRange(0, numeric_limits<size_t>::max());
+
+  Geometry &base = geometry;
+  base.computeBoundingBox();
+  base.computeBoundingSphere();
+
+  result.triangles = triangleCount;
+  result.vertices = vertices.size();
+  return result;
+}
+
+}
+}
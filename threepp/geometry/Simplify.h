@@ -0,0 +1,57 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_GEOM_SIMPLIFY_H
+#define THREEPP_GEOM_SIMPLIFY_H
+
+#include <limits>
+#include <threepp/core/BufferGeometry.h>
+
+namespace three {
+namespace geometry {
+
+struct SimplifyOptions
+{
+  /**
+   * stop once the next collapse would move the surface further than this, in object space units
+   */
+  float maxError = std::numeric_limits<float>::infinity();
+
+  /**
+   * reject collapses which turn a triangle's normal by more than this angle (radians)
+   */
+  float maxNormalDeviation = 1.2f;
+};
+
+struct SimplifyResult
+{
+  size_t triangles = 0;
+  size_t vertices = 0;
+
+  //largest deviation introduced by the collapses, in object space units
+  float error = 0;
+};
+
+/**
+ * reduce the triangle count of a mesh geometry by collapsing edges in the order given by the
+ * quadric error metric. Vertices keep their positions and attributes, a collapse only redirects
+ * the triangles of the removed vertex to a neighbour.
+ *
+ * Vertices on open borders, on attribute seams (same position, different normal, uv, color or
+ * skinning) and on the boundaries between groups are never removed, so outlines, hard edges,
+ * texture mapping and material ranges are preserved. Groups are rewritten to the reduced index.
+ *
+ * All vertex attributes, including skin indices, skin weights and line distances, are compacted
+ * into new buffers, so the geometry owns its attributes afterwards. Non-indexed geometries are
+ * welded first. Morph targets are not supported
+ *
+ * @param geometry a triangle mesh
+ * @param targetRatio fraction of the triangles to keep
+ * @return the resulting counts and error
+ */
+DLX SimplifyResult simplify(BufferGeometry &geometry, float targetRatio, const SimplifyOptions &options=SimplifyOptions());
+
+}
+}
+#endif //THREEPP_GEOM_SIMPLIFY_H
@@ -5,12 +5,71 @@
 #ifndef THREEPP_DIRECTIONALLIGHT_H
 #define THREEPP_DIRECTIONALLIGHT_H
 
+#include <array>
 #include <threepp/camera/OrthographicCamera.h>
+#include <threepp/math/Vector4.h>
 #include "TargetLight.h"
 
 namespace three {
 
-using DirectionalLightShadow = LightShadowT<OrthographicCamera>;
+class DirectionalLightShadow : public LightShadowT<OrthographicCamera>
+{
+  friend class gl::ShadowMap;
+
+  //bounds of each cascade, computed by the renderer for the current view camera
+  struct Cascade
+  {
+    math::Vector3 position;
+    float radius;
+    float far;
+  };
+  std::array<Cascade, 4> _cascades;
+  math::Vector3 _cascadeDirection;
+  std::array<math::Matrix4, 4> _cascadeMatrices;
+  math::Vector4 _cascadeSplits;
+
+protected:
+  explicit DirectionalLightShadow(OrthographicCamera::Ptr camera) : LightShadowT(camera) {}
+
+public:
+  using Ptr = std::shared_ptr<DirectionalLightShadow>;
+  static Ptr make(OrthographicCamera::Ptr camera) {
+    return Ptr(new DirectionalLightShadow(camera));
+  }
+
+  static constexpr unsigned max_cascades = 4;
+
+  //split the view frustum into this many cascades (up to max_cascades), each rendered into its
+  //own tile of the shadow map. The shadow camera is then fitted to the cascades, and mapSize is
+  //the size of one tile. Only the first shadow casting light with cascades is cascaded
+  unsigned cascades = 1;
+
+  //blend between uniform (0) and logarithmic (1) split distances
+  float cascadeLambda = 0.75f;
+
+  //view distance covered by the cascades, 0 for the far plane of the view camera
+  float cascadeDistance = 0;
+
+  //distance towards the light in front of a cascade from which objects still cast into it
+  float cascadeCasterDistance = 100;
+
+  //cascades, limited to what is supported
+  unsigned numCascades() const {
+    if(cascades < 1) return 1;
+    if(cascades > max_cascades) return max_cascades;
+    return cascades;
+  }
+
+  //world to shadow map coordinates of a cascade, relative to its tile
+  const math::Matrix4 &cascadeMatrix(unsigned cascade) const {return _cascadeMatrices.at(cascade);}
+
+  //view depths at which the cascades end, unused cascades are beyond any depth
+  const math::Vector4 &cascadeSplits() const {return _cascadeSplits;}
+
+  DirectionalLightShadow *cloned() const override {
+    return new DirectionalLightShadow(*this);
+  }
+};
 
 class DirectionalLight : public TargetLight
 {
@@ -9,6 +9,7 @@
 
 #include <threepp/camera/PerspectiveCamera.h>
 #include <threepp/math/Vector2.h>
+#include <threepp/math/Vector4.h>
 #include <threepp/renderers/Renderer.h>
 #include "Light.h"
 
@@ -16,8 +17,25 @@ namespace three {
 
 class Light;
 
+namespace gl {
+class ShadowMap;
+}
+
 class LightShadow
 {
+  friend class gl::ShadowMap;
+
+  //casters the map was last rendered with, see isStatic
+  size_t _signature = 0;
+  bool _rendered = false;
+
+  //region of the map the shadow is rendered to, in texels and in texture coordinates
+  math::Vector4 _viewport;
+  math::Vector4 _tile {0, 0, 1, 1};
+
+  //false if the shadow got no tile in the atlas
+  bool _mapped = true;
+
 protected:
   float _bias = 0;
   float _radius = 1;
@@ -30,6 +48,10 @@ protected:
 public:
   using Ptr = std::shared_ptr<LightShadow>;
 
+  //only re-render the map if the light or a caster inside the shadow frustum moved, or a caster's
+  //geometry or instances changed. Skinned and morphed casters always count as changed
+  bool isStatic = false;
+
   float bias() const {return _bias;}
   float radius() const {return _radius;}
 
@@ -45,6 +67,13 @@ public:
   math::Matrix4 &matrix() {return _matrix;}
   const math::Matrix4 &matrix() const {return _matrix;}
 
+  //offset (x, y) and scale (z, w) of the shadow within the map. All of it, unless the renderer
+  //packs the shadows into an atlas (see OpenGLRendererOptions::shadowAtlas)
+  const math::Vector4 &tile() const {return _tile;}
+
+  //false if the shadow did not fit into the atlas. It is then neither rendered nor sampled
+  bool mapped() const {return _mapped;}
+
   virtual const Camera::Ptr camera() const = 0;
 
   virtual void update() {}
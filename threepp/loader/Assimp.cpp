@@ -16,6 +16,7 @@
 #include <threepp/material/MeshPhysicalMaterial.h>
 #include <threepp/textures/ImageTexture.h>
 #include <threepp/textures/DataTexture.h>
+#include "KTX.h"
 
 #include <QDebug>
 
@@ -119,6 +120,34 @@ public:
   }
 };
 
+TextureWrapping wrapping(aiTextureMapMode mode)
+{
+  switch(mode) {
+    case aiTextureMapMode_Wrap:
+      return TextureWrapping::Repeat;
+    case aiTextureMapMode_Mirror:
+      return TextureWrapping::MirroredRepeat;
+    default:
+      return TextureWrapping::ClampToEdge;
+  }
+}
+
+void setUvTransform(Texture &texture, aiTextureType type, const aiMaterial *material)
+{
+  aiUVTransform transform;
+  if(material->Get(AI_MATKEY_UVTRANSFORM(type, 0), transform) == AI_SUCCESS) {
+    math::Matrix3 matrix;
+    matrix.setUvTransform(
+       transform.mTranslation.x, transform.mTranslation.y,
+       transform.mScaling.x, transform.mScaling.y,
+       transform.mRotation, 0, 0);
+
+    //applied before a transform the texture may already have, see KTX
+    texture.matrix().multiply(matrix);
+    texture.setMatrixAutoUpdate(false);
+  }
+}
+
 const char *to_string(aiTextureType type)
 {
   switch(type) {
@@ -188,6 +217,7 @@ struct Access
   const aiScene * aiscene;
   ResourceLoader &loader;
   enum_map<ShadingModel, ShadingModel> &modelMap;
+  const AssimpOptions &options;
 
   unordered_map<string, QImage> images;
   unordered_map<unsigned, Mesh::Ptr> meshes;
@@ -198,8 +228,10 @@ struct Access
   Access(Scene::Ptr scene, const aiScene * aiscene,
          ResourceLoader &loader,
          enum_map<ShadingModel, ShadingModel> &modelMap,
+         const AssimpOptions &options,
          const AssimpMaterialHandler *materialHandler)
-     : scene(scene), aiscene(aiscene), loader(loader), modelMap(modelMap), materialHandler(materialHandler) {}
+     : scene(scene), aiscene(aiscene), loader(loader), modelMap(modelMap), options(options),
+       materialHandler(materialHandler) {}
 
   void readMaterial(unsigned materialIndex);
 
@@ -492,6 +524,20 @@ Texture::Ptr Access::loadTexture(aiTextureType type, unsigned index, const aiMat
     }
     else {
       string imageFile(path.C_Str());
+
+      if(KTX::handles(imageFile)) {
+        TextureOptions options = DataTexture::options();
+        options.wrapS = wrapping(mapmode[0]);
+        options.wrapT = wrapping(mapmode[1]);
+
+        DataTexture::Ptr texture = KTX::load(loader, imageFile, options);
+        if(texture) {
+          setUvTransform(*texture, type, material);
+          qDebug() << "loaded texture" << imageFile.c_str() << to_string(type);
+        }
+        return texture;
+      }
+
       QImage image;
       if(images.count(imageFile) > 0)
         image = images[imageFile];
@@ -531,28 +577,8 @@ Texture::Ptr Access::loadTexture(aiTextureType type, unsigned index, const aiMat
       }
       bool isPo2 = math::isPowerOfTwo(image.width()) && math::isPowerOfTwo(image.height());
       if(isPo2) {
-        switch(mapmode[0]) {
-          case aiTextureMapMode_Wrap:
-            options.wrapS = TextureWrapping::Repeat;
-            break;
-          case aiTextureMapMode_Clamp:
-            options.wrapS = TextureWrapping::ClampToEdge;
-            break;
-          case aiTextureMapMode_Mirror:
-            options.wrapS = TextureWrapping::MirroredRepeat;
-            break;
-        }
-        switch(mapmode[1]) {
-          case aiTextureMapMode_Wrap:
-            options.wrapT = TextureWrapping::Repeat;
-            break;
-          case aiTextureMapMode_Clamp:
-            options.wrapT = TextureWrapping::ClampToEdge;
-            break;
-          case aiTextureMapMode_Mirror:
-            options.wrapT = TextureWrapping::MirroredRepeat;
-            break;
-        }
+        options.wrapS = wrapping(mapmode[0]);
+        options.wrapT = wrapping(mapmode[1]);
       }
       else {
         options.minFilter = TextureFilter::Linear;
@@ -578,15 +604,8 @@ Texture::Ptr Access::loadTexture(aiTextureType type, unsigned index, const aiMat
       }
 
       ImageTexture::Ptr texture = ImageTexture::make(options, image);
+      setUvTransform(*texture, type, material);
 
-      aiUVTransform transform;
-      if(material->Get(AI_MATKEY_UVTRANSFORM(type, 0), transform) == AI_SUCCESS) {
-        texture->matrix().setUvTransform(
-           transform.mTranslation.x, transform.mTranslation.y,
-           transform.mScaling.x, transform.mScaling.y,
-           transform.mRotation, 0, 0);
-        texture->setMatrixAutoUpdate(false);
-      }
       return texture;
     }
   }
@@ -691,6 +710,9 @@ Mesh::Ptr Access::readMesh(int index)
   if(ai->mBitangents) {
     geometry->setBitangents(attribute::external<float, Vertex>(ai->mBitangents, ai->mNumVertices));
   }
+  if(options.simplifyRatio < 1.0f) {
+    three::geometry::simplify(*geometry, options.simplifyRatio, options.simplifyOptions);
+  }
 #if 0
   if ( this.mTangentBuffer && this.mTangentBuffer.length > 0 )
       geometry.addAttribute( 'tangents', new THREE.BufferAttribute( this.mTangentBuffer, 3 ) );
@@ -893,7 +915,7 @@ void Assimp::loadScene(string name, ResourceLoader &loader)
     return;
   }
 
-  Access access(_scene, aiscene, loader, modelMap, _materialHandler);
+  Access access(_scene, aiscene, loader, modelMap, *this, _materialHandler);
   access.readScene();
 }
 
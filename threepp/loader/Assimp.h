@@ -13,6 +13,7 @@
 #include <threepp/material/Material.h>
 #include <threepp/objects/Mesh.h>
 #include <threepp/scene/Scene.h>
+#include <threepp/geometry/Simplify.h>
 #include <threepp/util/simplesignal.h>
 
 #include "Loader.h"
@@ -30,6 +31,10 @@ struct AssimpOptions
 {
   enum_map<ShadingModel, ShadingModel> modelMap;
 
+  //if < 1, meshes are decimated to this fraction of their triangles while loading
+  float simplifyRatio = 1.0f;
+  geometry::SimplifyOptions simplifyOptions;
+
   AssimpOptions() {
     modelMap[ShadingModel::Phong] = ShadingModel::Phong;
     modelMap[ShadingModel::Gouraud] = ShadingModel::Phong;
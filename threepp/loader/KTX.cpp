@@ -0,0 +1,404 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#include "KTX.h"
+#include <cstring>
+#include <QByteArray>
+#include <QDebug>
+#include <threepp/textures/BlockDecoder.h>
+
+namespace three {
+namespace loader {
+
+using namespace std;
+
+namespace {
+
+const byte ktx1_identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+const byte ktx2_identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+const uint32_t ktx1_endianness = 0x04030201;
+
+//KTX2 supercompression schemes
+const uint32_t supercompression_none = 0;
+const uint32_t supercompression_zlib = 3;
+
+/**
+ * the texture format of a file. channels is 0 for block compressed formats
+ */
+struct Format
+{
+  TextureFormat format;
+  unsigned channels;
+  bool sRGB;
+};
+
+//KTX stores the GL format
+bool glFormat(uint32_t glType, uint32_t format, uint32_t internalFormat, Format &result)
+{
+  if(glType == GL_UNSIGNED_BYTE) {
+    switch(format) {
+      case GL_RGB:
+        result = {TextureFormat::RGB, 3, false};
+        return true;
+      case GL_RGBA:
+        result = {TextureFormat::RGBA, 4, false};
+        return true;
+      default:
+        return false;
+    }
+  }
+  if(glType != 0) return false;
+
+  switch(internalFormat) {
+    case 0x83F0: result = {TextureFormat::RGB_S3TC_DXT1, 0, false}; return true;
+    case 0x83F1: result = {TextureFormat::RGBA_S3TC_DXT1, 0, false}; return true;
+    case 0x83F2: result = {TextureFormat::RGBA_S3TC_DXT3, 0, false}; return true;
+    case 0x83F3: result = {TextureFormat::RGBA_S3TC_DXT5, 0, false}; return true;
+    case 0x8C4C: result = {TextureFormat::RGB_S3TC_DXT1, 0, true}; return true;
+    case 0x8C4D: result = {TextureFormat::RGBA_S3TC_DXT1, 0, true}; return true;
+    case 0x8C4E: result = {TextureFormat::RGBA_S3TC_DXT3, 0, true}; return true;
+    case 0x8C4F: result = {TextureFormat::RGBA_S3TC_DXT5, 0, true}; return true;
+    case 0x8DBB: result = {TextureFormat::RED_RGTC1, 0, false}; return true;
+    case 0x8DBD: result = {TextureFormat::RG_RGTC2, 0, false}; return true;
+    case 0x8E8C: result = {TextureFormat::RGBA_BPTC, 0, false}; return true;
+    case 0x8E8D: result = {TextureFormat::RGBA_BPTC, 0, true}; return true;
+    // ETC1 is a subset of ETC2
+    case 0x8D64: result = {TextureFormat::RGB_ETC2, 0, false}; return true;
+    case 0x9274: result = {TextureFormat::RGB_ETC2, 0, false}; return true;
+    case 0x9275: result = {TextureFormat::RGB_ETC2, 0, true}; return true;
+    case 0x9278: result = {TextureFormat::RGBA_ETC2_EAC, 0, false}; return true;
+    case 0x9279: result = {TextureFormat::RGBA_ETC2_EAC, 0, true}; return true;
+    case 0x93B0: result = {TextureFormat::RGBA_ASTC_4x4, 0, false}; return true;
+    case 0x93D0: result = {TextureFormat::RGBA_ASTC_4x4, 0, true}; return true;
+    default:
+      return false;
+  }
+}
+
+//KTX2 stores the Vulkan format
+bool vkFormat(uint32_t format, Format &result)
+{
+  switch(format) {
+    case 23: result = {TextureFormat::RGB, 3, false}; return true;
+    case 29: result = {TextureFormat::RGB, 3, true}; return true;
+    case 37: result = {TextureFormat::RGBA, 4, false}; return true;
+    case 43: result = {TextureFormat::RGBA, 4, true}; return true;
+    case 131: result = {TextureFormat::RGB_S3TC_DXT1, 0, false}; return true;
+    case 132: result = {TextureFormat::RGB_S3TC_DXT1, 0, true}; return true;
+    case 133: result = {TextureFormat::RGBA_S3TC_DXT1, 0, false}; return true;
+    case 134: result = {TextureFormat::RGBA_S3TC_DXT1, 0, true}; return true;
+    case 135: result = {TextureFormat::RGBA_S3TC_DXT3, 0, false}; return true;
+    case 136: result = {TextureFormat::RGBA_S3TC_DXT3, 0, true}; return true;
+    case 137: result = {TextureFormat::RGBA_S3TC_DXT5, 0, false}; return true;
+    case 138: result = {TextureFormat::RGBA_S3TC_DXT5, 0, true}; return true;
+    case 139: result = {TextureFormat::RED_RGTC1, 0, false}; return true;
+    case 141: result = {TextureFormat::RG_RGTC2, 0, false}; return true;
+    case 145: result = {TextureFormat::RGBA_BPTC, 0, false}; return true;
+    case 146: result = {TextureFormat::RGBA_BPTC, 0, true}; return true;
+    case 147: result = {TextureFormat::RGB_ETC2, 0, false}; return true;
+    case 148: result = {TextureFormat::RGB_ETC2, 0, true}; return true;
+    case 151: result = {TextureFormat::RGBA_ETC2_EAC, 0, false}; return true;
+    case 152: result = {TextureFormat::RGBA_ETC2_EAC, 0, true}; return true;
+    case 157: result = {TextureFormat::RGBA_ASTC_4x4, 0, false}; return true;
+    case 158: result = {TextureFormat::RGBA_ASTC_4x4, 0, true}; return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * bounds checked reads from the file contents
+ */
+class Reader
+{
+  const vector<byte> &_data;
+  bool _swap = false;
+
+public:
+  explicit Reader(const vector<byte> &data) : _data(data) {}
+
+  void setSwap(bool swap) {_swap = swap;}
+
+  bool has(size_t offset, size_t length) const
+  {
+    return offset <= _data.size() && length <= _data.size() - offset;
+  }
+
+  uint32_t u32(size_t offset) const
+  {
+    uint32_t value = 0;
+    for(unsigned i = 0; i < 4; i++) {
+      unsigned shift = _swap ? (3 - i) * 8 : i * 8;
+      value |= (uint32_t)_data[offset + i] << shift;
+    }
+    return value;
+  }
+
+  uint64_t u64(size_t offset) const
+  {
+    return (uint64_t)u32(offset) | (uint64_t)u32(offset + 4) << 32;
+  }
+
+  const byte *at(size_t offset) const {return _data.data() + offset;}
+};
+
+/**
+ * @return the value of the KTXorientation entry in the key/value data, empty if there is none
+ */
+string orientation(const Reader &reader, size_t offset, size_t length)
+{
+  static const char key[] = "KTXorientation";
+
+  size_t end = offset + length;
+  while(offset + 4 <= end) {
+    uint32_t size = reader.u32(offset);
+    offset += 4;
+    if(size > end - offset) break;
+
+    const char *entry = (const char *)reader.at(offset);
+    if(size > sizeof(key) && memcmp(entry, key, sizeof(key)) == 0) {
+      // the value may or may not be NUL terminated
+      string value(entry + sizeof(key), size - sizeof(key));
+      return value.substr(0, value.find('\0'));
+    }
+    offset += (size + 3) & ~3u;
+  }
+  return string();
+}
+
+/**
+ * @return the number of levels in a complete mip chain
+ */
+uint32_t chainLength(size_t width, size_t height)
+{
+  uint32_t length = 1;
+  for(size_t size = max(width, height); size > 1; size >>= 1) length++;
+  return length;
+}
+
+/**
+ * check the size of a mip level and, for KTX 1, remove the padding at the end of each row. The
+ * resulting rows are tightly packed, as DataTexture expects
+ */
+bool level(const byte *data, size_t size, const Format &format, size_t width, size_t height,
+           size_t rowAlignment, Mipmap &mipmap)
+{
+  mipmap.width = (int)width;
+  mipmap.height = (int)height;
+
+  if(format.channels == 0) {
+    size_t bytes = blocks::imageBytes(format.format, width, height);
+    if(size < bytes) return false;
+
+    mipmap.data.assign(data, data + bytes);
+    return true;
+  }
+
+  size_t rowBytes = width * format.channels;
+  size_t stride = (rowBytes + rowAlignment - 1) / rowAlignment * rowAlignment;
+  if(size < stride * (height - 1) + rowBytes) return false;
+
+  mipmap.data.resize(rowBytes * height);
+  for(size_t row = 0; row < height; row++)
+    memcpy(mipmap.data.data() + row * rowBytes, data + row * stride, rowBytes);
+
+  return true;
+}
+
+}
+
+bool KTX::handles(const std::string &file)
+{
+  size_t dot = file.rfind('.');
+  if(dot == string::npos) return false;
+
+  string extension = file.substr(dot + 1);
+  for(char &c : extension) c = (char)tolower(c);
+
+  return extension == "ktx" || extension == "ktx2";
+}
+
+DataTexture::Ptr KTX::load(ResourceLoader &loader, const std::string &file, TextureOptions options)
+{
+  Resource::Ptr resource = loader.get(file.c_str(), ios_base::in | ios_base::binary);
+  if(!resource) {
+    qWarning() << "error loading texture" << file.c_str();
+    return nullptr;
+  }
+
+  vector<byte> data(resource->size());
+  resource->in().read((char *)data.data(), data.size());
+  if((size_t)resource->in().gcount() != data.size()) {
+    qWarning() << "error reading texture" << file.c_str();
+    return nullptr;
+  }
+
+  return load(data, file, options);
+}
+
+DataTexture::Ptr KTX::load(const std::vector<byte> &data, const std::string &name, TextureOptions options)
+{
+  Reader reader(data);
+
+  Format format;
+  size_t width, height;
+  vector<Mipmap> mipmaps;
+  string orient;
+  bool generateMipmaps = false;
+
+  if(reader.has(0, 64) && memcmp(data.data(), ktx1_identifier, sizeof(ktx1_identifier)) == 0) {
+
+    uint32_t endianness = reader.u32(12);
+    if(endianness != ktx1_endianness) {
+      reader.setSwap(true);
+      if(reader.u32(12) != ktx1_endianness) {
+        qWarning() << name.c_str() << ": invalid KTX header";
+        return nullptr;
+      }
+    }
+
+    uint32_t glType = reader.u32(16), glFormatValue = reader.u32(24), glInternalFormat = reader.u32(28);
+    width = reader.u32(36);
+    height = reader.u32(40);
+    uint32_t depth = reader.u32(44), elements = reader.u32(48), faces = reader.u32(52);
+    uint32_t levels = reader.u32(56), kvBytes = reader.u32(60);
+
+    if(!glFormat(glType, glFormatValue, glInternalFormat, format)) {
+      qWarning() << name.c_str() << ": unsupported KTX format" << glInternalFormat;
+      return nullptr;
+    }
+    if(depth > 0 || elements > 0 || faces != 1 || width == 0 || height == 0) {
+      qWarning() << name.c_str() << ": only 2D KTX textures are supported";
+      return nullptr;
+    }
+
+    size_t offset = 64;
+    if(!reader.has(offset, kvBytes)) {
+      qWarning() << name.c_str() << ": truncated KTX file";
+      return nullptr;
+    }
+    orient = orientation(reader, offset, kvBytes);
+    offset += kvBytes;
+
+    // 0 levels asks for mipmaps to be generated
+    generateMipmaps = levels == 0;
+    levels = max(1u, min(levels, chainLength(width, height)));
+
+    for(uint32_t i = 0; i < levels; i++) {
+      if(!reader.has(offset, 4)) break;
+
+      uint32_t size = reader.u32(offset);
+      offset += 4;
+
+      Mipmap mipmap;
+      if(!reader.has(offset, size)
+         || !level(reader.at(offset), size, format, max<size_t>(1, width >> i), max<size_t>(1, height >> i), 4, mipmap))
+        break;
+
+      mipmaps.push_back(mipmap);
+      offset += (size + 3) & ~3u;
+    }
+  }
+  else if(reader.has(0, 80) && memcmp(data.data(), ktx2_identifier, sizeof(ktx2_identifier)) == 0) {
+
+    uint32_t vkFormatValue = reader.u32(12);
+    width = reader.u32(20);
+    height = reader.u32(24);
+    uint32_t depth = reader.u32(28), layers = reader.u32(32), faces = reader.u32(36);
+    uint32_t levels = reader.u32(40), supercompression = reader.u32(44);
+    uint32_t kvdOffset = reader.u32(56), kvdBytes = reader.u32(60);
+
+    if(vkFormatValue == 0) {
+      qWarning() << name.c_str() << ": Basis Universal textures are not supported";
+      return nullptr;
+    }
+    if(!vkFormat(vkFormatValue, format)) {
+      qWarning() << name.c_str() << ": unsupported KTX2 format" << vkFormatValue;
+      return nullptr;
+    }
+    if(depth > 0 || layers > 0 || faces != 1 || width == 0 || height == 0) {
+      qWarning() << name.c_str() << ": only 2D KTX2 textures are supported";
+      return nullptr;
+    }
+    if(supercompression != supercompression_none && supercompression != supercompression_zlib) {
+      qWarning() << name.c_str() << ": unsupported KTX2 supercompression scheme" << supercompression;
+      return nullptr;
+    }
+
+    if(reader.has(kvdOffset, kvdBytes)) orient = orientation(reader, kvdOffset, kvdBytes);
+
+    generateMipmaps = levels == 0;
+    levels = max(1u, min(levels, chainLength(width, height)));
+
+    if(!reader.has(80, levels * 24)) {
+      qWarning() << name.c_str() << ": truncated KTX2 file";
+      return nullptr;
+    }
+
+    for(uint32_t i = 0; i < levels; i++) {
+      uint64_t offset = reader.u64(80 + i * 24), size = reader.u64(88 + i * 24);
+      uint64_t uncompressedSize = reader.u64(96 + i * 24);
+
+      if(!reader.has(offset, size)) break;
+
+      size_t levelWidth = max<size_t>(1, width >> i), levelHeight = max<size_t>(1, height >> i);
+      Mipmap mipmap;
+
+      if(supercompression == supercompression_zlib) {
+        // qUncompress expects the uncompressed size up front, big endian
+        vector<byte> compressed;
+        compressed.reserve(size + 4);
+        for(int shift = 24; shift >= 0; shift -= 8) compressed.push_back((byte)((uncompressedSize >> shift) & 0xFF));
+        compressed.insert(compressed.end(), reader.at(offset), reader.at(offset) + size);
+
+        QByteArray uncompressed = qUncompress(compressed.data(), (int)compressed.size());
+        if(!level((const byte *)uncompressed.constData(), uncompressed.size(), format, levelWidth, levelHeight, 1, mipmap))
+          break;
+      }
+      else if(!level(reader.at(offset), size, format, levelWidth, levelHeight, 1, mipmap))
+        break;
+
+      mipmaps.push_back(mipmap);
+    }
+  }
+  else {
+    qWarning() << name.c_str() << ": not a KTX file";
+    return nullptr;
+  }
+
+  if(mipmaps.empty()) {
+    qWarning() << name.c_str() << ": truncated KTX file";
+    return nullptr;
+  }
+
+  // a chain that stops early would leave the texture incomplete
+  size_t complete = chainLength(width, height);
+
+  bool mipmapped = mipmaps.size() == complete || (generateMipmaps && format.channels > 0);
+
+  options.format = format.format;
+  options.type = TextureType::UnsignedByte;
+  options.encoding = format.sRGB ? Encoding::sRGB : Encoding::Linear;
+  options.magFilter = TextureFilter::Linear;
+  options.minFilter = mipmapped ? TextureFilter::LinearMipMapLinear : TextureFilter::Linear;
+
+  if(mipmaps.size() < complete && !generateMipmaps) mipmaps.resize(1);
+
+  DataTexture::Ptr texture = DataTexture::make(options, mipmaps, format.channels == 0);
+  if(generateMipmaps) texture->setGenerateMipmaps(format.channels > 0);
+
+  // the first row is the top of the image unless the orientation says otherwise. The data can't
+  // be flipped without decoding it, so the texture coordinates are
+  bool topDown = orient.find("u") == string::npos;
+  if(options.flipY == topDown) {
+    texture->matrix().setUvTransform(0, 1, 1, -1, 0, 0, 0);
+    texture->setMatrixAutoUpdate(false);
+  }
+
+  return texture;
+}
+
+}
+}
@@ -0,0 +1,52 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_KTX_H
+#define THREEPP_KTX_H
+
+#include <string>
+#include <vector>
+#include <threepp/textures/DataTexture.h>
+#include "Loader.h"
+
+namespace three {
+namespace loader {
+
+/**
+ * reads 2D textures from KTX (version 1) and KTX2 containers. The mip levels are passed on as they
+ * are stored, so block compressed textures (S3TC, RGTC, BPTC, ETC2, ASTC 4x4) stay compressed on
+ * the GPU and no mipmaps are generated at runtime. Drivers which lack support for a format get
+ * the levels decoded on the CPU where possible, see blocks::decode.
+ *
+ * Uncompressed data must be RGB or RGBA with 8 bits per channel. KTX2 files may be zlib
+ * supercompressed. Basis Universal, zstd, cube maps, arrays and 3D textures are not supported
+ */
+class DLX KTX
+{
+public:
+  /**
+   * @return true if the file name has the .ktx or .ktx2 extension
+   */
+  static bool handles(const std::string &file);
+
+  /**
+   * load a texture through the resource loader
+   *
+   * @param options format, type and encoding are taken from the file. The filters are set to
+   * trilinear if the file holds a complete mip chain, bilinear otherwise
+   * @return the texture, or nullptr if the file could not be read. The reason is logged
+   */
+  static DataTexture::Ptr load(ResourceLoader &loader, const std::string &file, TextureOptions options);
+
+  /**
+   * create a texture from the contents of a KTX file
+   *
+   * @param name used in messages
+   */
+  static DataTexture::Ptr load(const std::vector<byte> &data, const std::string &name, TextureOptions options);
+};
+
+}
+}
+#endif //THREEPP_KTX_H
@@ -5,6 +5,7 @@
 #include "Frustum.h"
 
 #include <threepp/objects/Sprite.h>
+#include <threepp/objects/InstancedMesh.h>
 #include <iostream>
 
 namespace three {
@@ -14,6 +15,13 @@ using namespace std;
 
 bool Frustum::intersectsObject(const Object3D &object) const
 {
+  if(InstancedMesh *mesh = object.typer) {
+    Sphere sphere = mesh->boundingSphere();
+    sphere.apply(object.matrixWorld());
+
+    return !sphere.isEmpty() && intersectsSphere( sphere );
+  }
+
   if (object.geometry()->boundingSphere().isEmpty())
     object.geometry()->computeBoundingSphere();
 
@@ -47,6 +55,20 @@ bool Frustum::intersectsSphere(const Sphere &sphere) const
   return true;
 }
 
+bool Frustum::containsSphere(const Sphere &sphere) const
+{
+  float radius = sphere.radius();
+
+  for (const Plane &plane : _planes) {
+
+    if (plane.distanceToPoint(sphere.center()) < radius) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 bool Frustum::intersectsBox(const Box3 &box) const
 {
   for (const Plane &plane : _planes) {
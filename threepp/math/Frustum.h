@@ -62,6 +62,11 @@ public:
 
   bool intersectsSphere(const Sphere &sphere) const;
 
+  /**
+   * @return true if the sphere lies completely inside the frustum
+   */
+  bool containsSphere(const Sphere &sphere) const;
+
   bool intersectsBox(const Box3 &box) const;
 
   bool containsPoint(const Vector3 &point)
@@ -105,6 +105,29 @@ public:
     return *this;
   }
 
+  /**
+   * expand this sphere to the smallest sphere that also encloses the given one
+   */
+  Sphere &unify(const Sphere &sphere)
+  {
+    Vector3 delta = sphere._center - _center;
+    float distance = delta.length();
+
+    if(distance + sphere._radius <= _radius) return *this;
+
+    if(distance + _radius <= sphere._radius) {
+      _center = sphere._center;
+      _radius = sphere._radius;
+      return *this;
+    }
+
+    float radius = (distance + _radius + sphere._radius) * 0.5f;
+    _center += delta * ((radius - _radius) / distance);
+    _radius = radius;
+
+    return *this;
+  }
+
   Sphere &translate(const Vector3 &offset)
   {
     _center += offset;
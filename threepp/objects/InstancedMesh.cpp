@@ -0,0 +1,78 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#include "InstancedMesh.h"
+#include <atomic>
+#include <threepp/core/Raycaster.h>
+
+namespace three {
+
+using namespace math;
+
+unsigned InstancedMesh::nextVersion()
+{
+  static std::atomic<unsigned> version {0};
+  return ++version;
+}
+
+const Sphere &InstancedMesh::boundingSphere()
+{
+  if(!_boundingSphereDirty) return _boundingSphere;
+
+  if (geometry()->boundingSphere().isEmpty()) geometry()->computeBoundingSphere();
+
+  _boundingSphere = Sphere();
+  bool first = true;
+
+  for(const Matrix4 &matrix : _matrices) {
+    Sphere sphere = geometry()->boundingSphere();
+    sphere.apply(matrix);
+
+    if(first) _boundingSphere = sphere;
+    else _boundingSphere.unify(sphere);
+    first = false;
+  }
+  _boundingSphereDirty = false;
+
+  return _boundingSphere;
+}
+
+void InstancedMesh::raycast(const Raycaster &raycaster, IntersectList &intersects)
+{
+  if (materialCount() == 0) return;
+
+  Sphere sphere = boundingSphere();
+  sphere.apply(_matrixWorld);
+
+  bool hit = false;
+  for(const auto &ray : raycaster.rays()) {
+    if (ray.intersectsSphere(sphere)) {
+      hit = true;
+      break;
+    }
+  }
+  if(!hit) return;
+
+  //raycast each instance as a plain mesh placed at the instance transform
+  Matrix4 matrixWorld;
+  std::vector<size_t> counts(raycaster.rays().size());
+
+  for(size_t index = 0; index < _matrices.size(); index++) {
+    if(!_visible[index]) continue;
+
+    for(unsigned ray = 0; ray < counts.size(); ray++)
+      counts[ray] = ray < intersects.rayCount() ? intersects.count(ray) : 0;
+
+    matrixWorld.multiply(_matrixWorld, _matrices[index]);
+
+    Mesh::raycast(raycaster, intersects, matrixWorld);
+
+    for(unsigned ray = 0; ray < counts.size() && ray < intersects.rayCount(); ray++) {
+      for(size_t i = counts[ray], l = intersects.count(ray); i < l; i++)
+        intersects.get(ray, (unsigned)i).instanceId = (unsigned)index;
+    }
+  }
+}
+
+}
@@ -0,0 +1,137 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_INSTANCEDMESH_H
+#define THREEPP_INSTANCEDMESH_H
+
+#include <vector>
+#include <threepp/objects/Mesh.h>
+#include <threepp/core/Color.h>
+#include <threepp/math/Matrix4.h>
+#include <threepp/math/Sphere.h>
+
+namespace three {
+
+/**
+ * a mesh which is drawn multiple times with a single draw call. Each instance has its own
+ * transform (relative to the mesh), and optionally its own color and visibility.
+ *
+ * If frustumCulled is set, instances are culled individually on the CPU, and only the visible
+ * ones are uploaded. Only the built-in materials support instancing (see
+ * Programs::supportsInstancedTransform)
+ */
+class DLX InstancedMesh : public Mesh
+{
+  std::vector<math::Matrix4> _matrices;
+  std::vector<Color> _colors;
+  std::vector<bool> _visible;
+
+  //bounding sphere enclosing all instances, in object space
+  math::Sphere _boundingSphere;
+  bool _boundingSphereDirty = true;
+
+  static unsigned nextVersion();
+
+  unsigned _version = nextVersion();
+
+protected:
+  InstancedMesh(const Geometry::Ptr &geometry, const Material::Ptr &material, size_t count)
+     : Mesh(geometry, {material}), _matrices(count), _visible(count, true)
+  {
+    Object3D::typer = object::Typer(this);
+    typer.allow<Mesh>();
+  }
+
+  InstancedMesh(const InstancedMesh &mesh)
+     : Mesh(mesh), _matrices(mesh._matrices), _colors(mesh._colors), _visible(mesh._visible)
+  {
+    Object3D::typer = object::Typer(this);
+    typer.allow<Mesh>();
+  }
+
+public:
+  using Ptr = std::shared_ptr<InstancedMesh>;
+
+  /**
+   * create a mesh with count instances, all of them visible and with identity transform
+   */
+  static Ptr make(const Geometry::Ptr &geometry, const Material::Ptr &material, size_t count)
+  {
+    return Ptr(new InstancedMesh(geometry, material, count));
+  }
+
+  size_t count() const {return _matrices.size();}
+
+  /**
+   * change the number of instances. New instances are visible and have identity transform
+   */
+  void setCount(size_t count)
+  {
+    _matrices.resize(count);
+    _visible.resize(count, true);
+    if(!_colors.empty()) _colors.resize(count, Color(1, 1, 1));
+
+    _boundingSphereDirty = true;
+    _version = nextVersion();
+  }
+
+  const math::Matrix4 &matrixAt(size_t index) const {return _matrices.at(index);}
+
+  void setMatrixAt(size_t index, const math::Matrix4 &matrix)
+  {
+    _matrices.at(index) = matrix;
+    _boundingSphereDirty = true;
+    _version = nextVersion();
+  }
+
+  /**
+   * @return true if per-instance colors were assigned
+   */
+  bool hasColors() const {return !_colors.empty();}
+
+  const Color &colorAt(size_t index) const {return _colors.at(index);}
+
+  /**
+   * set the color of an instance. The first call allocates colors for all instances, with
+   * white as the default. The instance color is multiplied with the material color
+   */
+  void setColorAt(size_t index, const Color &color)
+  {
+    if(_colors.empty()) _colors.resize(_matrices.size(), Color(1, 1, 1));
+
+    _colors.at(index) = color;
+    _version = nextVersion();
+  }
+
+  bool visibleAt(size_t index) const {return _visible.at(index);}
+
+  void setVisibleAt(size_t index, bool visible)
+  {
+    _visible.at(index) = visible;
+    _version = nextVersion();
+  }
+
+  /**
+   * changes with every change to the instance data. Versions are unique across all meshes
+   */
+  unsigned version() const {return _version;}
+
+  /**
+   * @return the sphere enclosing all instances, in object space. Computed on demand
+   */
+  const math::Sphere &boundingSphere();
+
+  /**
+   * raycast all visible instances. Intersection::instanceId is set to the index of the instance
+   * that was hit
+   */
+  void raycast(const Raycaster &raycaster, IntersectList &intersects) override;
+
+  InstancedMesh *cloned() const override {
+    return new InstancedMesh(*this);
+  }
+};
+
+}
+#endif //THREEPP_INSTANCEDMESH_H
@@ -0,0 +1,137 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#include "LOD.h"
+#include <cmath>
+#include <limits>
+#include <threepp/camera/PerspectiveCamera.h>
+#include <threepp/camera/OrthographicCamera.h>
+#include <threepp/camera/ArrayCamera.h>
+
+namespace three {
+
+LOD::LOD(const LOD &lod) : Object3D(lod), _current(lod._current), metric(lod.metric), hysteresis(lod.hysteresis)
+{
+  Object3D::typer = object::Typer(this);
+
+  //the children were cloned in order, levels refer to the clones
+  for(const Level &level : lod._levels) {
+    for(size_t i = 0; i < lod._children.size() && i < _children.size(); i++) {
+      if(lod._children[i] == level.object) {
+        _levels.emplace_back(_children[i], level.threshold);
+        break;
+      }
+    }
+  }
+  if(_current >= _levels.size()) _current = 0;
+}
+
+void LOD::addLevel(const Object3D::Ptr &object, float threshold)
+{
+  if(_levels.empty() && metric == Metric::ScreenSize) {
+    const Geometry::Ptr &geometry = object->geometry();
+    if(!geometry)
+      throw std::invalid_argument("LOD: screen size requires a geometry on the first level");
+
+    //computed here, update() may run on a worker thread
+    if(geometry->boundingSphere().isEmpty()) geometry->computeBoundingSphere();
+  }
+
+  add(object);
+  _levels.emplace_back(object, threshold);
+}
+
+void LOD::childRemoved(Object3D *child)
+{
+  for(size_t i = 0; i < _levels.size(); i++) {
+    if(_levels[i].object.get() != child) continue;
+
+    _levels.erase(_levels.begin() + i);
+
+    //keep the current level, fall back to the finest if it was the one removed
+    if(_current > i) _current--;
+    else if(_current == i) _current = 0;
+
+    //the next level becomes the one measured
+    if(i == 0 && !_levels.empty() && metric == Metric::ScreenSize) {
+      const Geometry::Ptr &geometry = _levels.front().object->geometry();
+      if(geometry && geometry->boundingSphere().isEmpty()) geometry->computeBoundingSphere();
+    }
+    break;
+  }
+}
+
+float LOD::measure(const Camera &camera) const
+{
+  math::Vector3 cameraPosition = camera.matrixWorld().getPosition();
+
+  if(metric == Metric::Distance) {
+    float distance = cameraPosition.distanceTo(_matrixWorld.getPosition());
+
+    //zooming in brings the object closer
+    return distance / camera.zoom();
+  }
+
+  //sphere around the finest level in world space
+  const Level &finest = _levels.front();
+  if(!finest.object->geometry()) return std::numeric_limits<float>::infinity();
+
+  math::Sphere sphere = finest.object->geometry()->boundingSphere();
+  sphere.apply(finest.object->matrixWorld());
+
+  if(OrthographicCamera *ortho = camera.typer) {
+    float height = std::fabs(ortho->top() - ortho->bottom()) / camera.zoom();
+    return height > 0 ? 2 * sphere.radius() / height : 0;
+  }
+  PerspectiveCamera *perspective = camera.typer;
+  if(!perspective) {
+    ArrayCamera *array = camera.typer;
+    perspective = array;
+  }
+  if(perspective) {
+    float distance = cameraPosition.distanceTo(sphere.center());
+    float slope = (float)std::tan(math::DEG2RAD * 0.5 * perspective->fov()) / camera.zoom();
+
+    //camera inside the sphere
+    if(distance <= sphere.radius()) return std::numeric_limits<float>::infinity();
+
+    return sphere.radius() / (distance * slope);
+  }
+  return std::numeric_limits<float>::infinity();
+}
+
+bool LOD::passed(float value, size_t level, size_t current) const
+{
+  //the threshold is shifted away from the side we are currently on
+  float margin = current >= level ? -hysteresis / 2 : hysteresis / 2;
+  float threshold = _levels[level].threshold;
+
+  if(metric == Metric::Distance)
+    return value >= threshold * (1 + margin);
+  else
+    return value <= threshold * (1 - margin);
+}
+
+size_t LOD::update(const Camera &camera)
+{
+  size_t previous = _current;
+
+  if(_levels.size() > 1) {
+    float value = measure(camera);
+
+    size_t selected = 0;
+    for(size_t level = 1; level < _levels.size(); level++) {
+      if(passed(value, level, _current)) selected = level;
+      else break;
+    }
+    _current = selected;
+  }
+  else
+    _current = 0;
+
+  _switched = _current != previous;
+  return _current;
+}
+
+}
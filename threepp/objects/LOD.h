@@ -0,0 +1,121 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_LOD_H
+#define THREEPP_LOD_H
+
+#include <vector>
+#include <threepp/core/Object3D.h>
+#include <threepp/camera/Camera.h>
+
+namespace three {
+
+/**
+ * level of detail. Each level is a child object which is rendered if the LOD is within the
+ * level's range, as seen from the current camera. The remaining levels are skipped by the
+ * renderer and the shadow map, but stay visible in the scene graph.
+ *
+ * Levels are selected either by the distance of the LOD from the camera or by the size of the
+ * finest level on screen. To avoid flickering when an object hovers around a threshold, a level
+ * is only left once the threshold has been crossed by the hysteresis margin
+ */
+class DLX LOD : public Object3D
+{
+public:
+  enum class Metric
+  {
+    //thresholds are camera distances, ascending
+    Distance,
+    //thresholds are fractions of the viewport height covered by the bounding sphere, descending
+    ScreenSize
+  };
+
+  struct Level
+  {
+    Object3D::Ptr object;
+    float threshold;
+
+    Level(const Object3D::Ptr &object, float threshold) : object(object), threshold(threshold) {}
+  };
+
+private:
+  std::vector<Level> _levels;
+
+  size_t _current = 0;
+  bool _switched = false;
+
+protected:
+  LOD(Metric metric) : Object3D(), metric(metric)
+  {
+    Object3D::typer = object::Typer(this);
+  }
+
+  LOD(const LOD &lod);
+
+  float measure(const Camera &camera) const;
+
+  bool passed(float value, size_t level, size_t current) const;
+
+  void childRemoved(Object3D *child) override;
+
+public:
+  using Ptr = std::shared_ptr<LOD>;
+  static Ptr make(Metric metric=Metric::Distance) {
+    return Ptr(new LOD(metric));
+  }
+
+  const Metric metric;
+
+  /**
+   * relative margin by which a threshold must be crossed before the level changes
+   */
+  float hysteresis = 0.1f;
+
+  /**
+   * add a level and make the object a child of this LOD. The level is dropped when the object is
+   * removed from the LOD. The threshold of the first level is
+   * ignored, it is used if no other level applies. For Metric::ScreenSize, the first level needs
+   * a geometry, whose bounding sphere is measured
+   *
+   * @param object the level's representation
+   * @param threshold distance or screen size beyond which the level applies, see Metric
+   */
+  void addLevel(const Object3D::Ptr &object, float threshold=0.0f);
+
+  const std::vector<Level> &levels() const {return _levels;}
+
+  /**
+   * select the level for the given camera. Calling this repeatedly with an unchanged camera
+   * yields the same result
+   *
+   * @return the index of the level
+   */
+  size_t update(const Camera &camera);
+
+  size_t currentLevel() const {return _current;}
+
+  /**
+   * @return whether the last update changed the level
+   */
+  bool switched() const {return _switched;}
+
+  /**
+   * @return whether child is a level other than the current one
+   */
+  bool skipped(const Object3D *child) const
+  {
+    for(size_t i = 0; i < _levels.size(); i++) {
+      if(_levels[i].object.get() == child) return i != _current;
+    }
+    return false;
+  }
+
+  LOD *cloned() const override
+  {
+    return new LOD(*this);
+  }
+};
+
+}
+#endif //THREEPP_LOD_H
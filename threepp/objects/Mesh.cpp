@@ -11,6 +11,11 @@
 namespace three {
 
 void Mesh::raycast(const Raycaster &raycaster, IntersectList &intersects)
+{
+  raycast(raycaster, intersects, _matrixWorld);
+}
+
+void Mesh::raycast(const Raycaster &raycaster, IntersectList &intersects, const math::Matrix4 &matrixWorld)
 {
   if (materialCount() == 0) return;
 
@@ -18,7 +23,7 @@ void Mesh::raycast(const Raycaster &raycaster, IntersectList &intersects)
   if (geometry()->boundingSphere().isEmpty()) geometry()->computeBoundingSphere();
 
   math::Sphere sphere = geometry()->boundingSphere();
-  sphere.apply(_matrixWorld);
+  sphere.apply(matrixWorld);
 
   bool hit = false;
   for(const auto &ray : raycaster.rays()) {
@@ -29,7 +34,7 @@ void Mesh::raycast(const Raycaster &raycaster, IntersectList &intersects)
   }
   if(!hit) return;
 
-  math::Matrix4 inverseMatrix = _matrixWorld.inverted();
+  math::Matrix4 inverseMatrix = matrixWorld.inverted();
   std::vector<math::Ray> rays(raycaster.rays());
 
   bool bbox = !geometry()->boundingBox().isEmpty();
@@ -40,7 +45,7 @@ void Mesh::raycast(const Raycaster &raycaster, IntersectList &intersects)
     if(bbox && !ray.intersectsBox(geometry()->boundingBox())) return;
   }
 
-  geometry()->raycast(*this, raycaster, rays, intersects);
+  geometry()->raycast(*this, matrixWorld, raycaster, rays, intersects);
 }
 
 }
\ No newline at end of file
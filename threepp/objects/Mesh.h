@@ -40,6 +40,11 @@ protected:
      : Object3D(geometry, materials), _drawMode(DrawMode::Triangles)
   {}
 
+  /**
+   * raycast the geometry placed with matrixWorld instead of the mesh's own world matrix
+   */
+  void raycast(const Raycaster &raycaster, IntersectList &intersects, const math::Matrix4 &matrixWorld);
+
 public:
   using Ptr = std::shared_ptr<Mesh>;
 
@@ -6,10 +6,12 @@
 #define THREEPP_OPENGLRENDERER
 
 #include <mutex>
+#include <string>
 #include <QOpenGLContext>
 #include <threepp/Constants.h>
 #include <threepp/scene/Scene.h>
 #include <threepp/camera/Camera.h>
+#include <threepp/util/simplesignal.h>
 #include "Renderer.h"
 
 namespace three {
@@ -22,6 +24,78 @@ struct DLX OpenGLRendererOptions
   bool antialias = false;
   bool premultipliedAlpha = true;
   bool preserveDrawingBuffer = false;
+
+  //number of frames the CPU may run ahead of the GPU. 0 means every frame is
+  //completed synchronously (glFinish) before render() returns
+  unsigned framesInFlight = 0;
+
+  //threads used for frustum culling, including the render thread. Values below 2 select
+  //the sequential traversal
+  unsigned projectionThreads = 0;
+
+  //draw runs of opaque items that share geometry and material with a single instanced call.
+  //Object transforms are then passed to the built-in shaders as per-instance attributes
+  bool autoInstancing = false;
+
+  //share the camera and lights state between programs through uniform buffer objects. Requires
+  //OpenGL 3.1 or OpenGL ES 3.0, otherwise they are set as uniforms of each program
+  bool uniformBlocks = true;
+
+  //pack static indexed meshes into shared buffers and draw runs of opaque items that share a
+  //material with a single glMultiDrawElementsIndirect call. Requires OpenGL 4.3, otherwise
+  //the regular path is used
+  bool multiDrawIndirect = false;
+
+  //after frustum culling, reject objects hidden behind Object3D::occluder objects. The occluders
+  //are rasterized into a low resolution depth buffer on the CPU, using the projection threads
+  bool occlusionCulling = false;
+
+  //keep the render list of the previous frame if neither the scene nor the camera changed, and
+  //cull a flat list of the scene's objects if only transforms changed. Requires Scene::autoUpdate,
+  //which maintains the change counters (see Object3D::changeTracking, set on the scene if enabled)
+  bool reuseRenderLists = true;
+
+  //bin point and spot lights without shadows into a grid of view space clusters, so each fragment
+  //only iterates over the lights near it. Changing the number of these lights does not recompile
+  //any program. Not applied with ArrayCamera
+  bool clusteredLighting = false;
+
+  //directory for linked program binaries, which let later runs skip shader compilation. Empty
+  //disables the cache. Requires OpenGL 4.1, OpenGL ES 3.0 or ARB_get_program_binary
+  std::string programCacheDir;
+
+  //upper bound for the size of the program cache in bytes. The oldest binaries are removed first
+  size_t programCacheSize = 64 * 1024 * 1024;
+
+  //don't stall rendering on program builds. Draws whose program is not built yet are skipped.
+  //With KHR_parallel_shader_compile the driver builds in the background, otherwise at most
+  //programsPerFrame programs are built per frame. See OpenGLRenderer::compile
+  bool asyncCompile = false;
+  unsigned programsPerFrame = 2;
+
+  //render all shadow maps into tiles of one texture of shadowAtlasSize texels square. Shaders
+  //then use a single texture unit for all shadows, and the shadow pass a single render target.
+  //Maps are scaled down if they don't fit
+  bool shadowAtlas = false;
+  unsigned shadowAtlasSize = 4096;
+
+  //prepare image textures on this many background threads instead of on first use. The render
+  //thread uploads at most textureUploadBudget bytes per frame, through a pixel buffer object if
+  //supported. Until then an empty texture is bound. 0 uploads synchronously
+  unsigned textureThreads = 0;
+  size_t textureUploadBudget = 16 * 1024 * 1024;
+
+  //upper bound in bytes for the GPU memory held by textures and geometry buffers. Above it, the
+  //least recently used ones are deleted after each render, and uploaded again from their data
+  //when next used. Render targets and cube textures are counted but kept. 0 disables the limit
+  size_t gpuMemoryBudget = 0;
+
+  //GL error checking. Sync costs a driver round-trip after most GL calls
+#ifdef NDEBUG
+  Validation validation = Validation::Off;
+#else
+  Validation validation = Validation::Sync;
+#endif
 };
 
 class DLX OpenGLRenderer : public Renderer, public OpenGLRendererOptions
@@ -39,6 +113,13 @@ public:
 
   std::mutex mutex;
 
+  /**
+   * emitted after a render that still exceeds gpuMemoryBudget once everything not used by it
+   * has been evicted, with the bytes in use and the budget. The application may then drop content
+   * or raise the budget
+   */
+  Signal<void(size_t used, size_t budget)> onMemoryPressure;
+
   using Ptr = std::shared_ptr<OpenGLRenderer>;
 
   static Ptr make(size_t width, size_t height, float pixelRatio, const OpenGLRendererOptions &options=OpenGLRendererOptions());
@@ -58,8 +139,19 @@ public:
   virtual void clear() = 0;
   virtual void clearDepth() = 0;
   virtual void updateShadows() = 0;
+  virtual void setFramesInFlight(unsigned framesInFlight) = 0;
 
   virtual void usePrograms(OpenGLRenderer::Ptr other) = 0;
+
+  /**
+   * build the programs for the visible materials of scene ahead of rendering, using the lights
+   * of scene as seen by camera. With asyncCompile, the builds proceed as they do while rendering,
+   * and the application calls this once per frame (e.g. while showing a loading state) until it
+   * returns true. Requires a current context
+   *
+   * @return true if all programs are ready
+   */
+  virtual bool compile(const Scene::Ptr &scene, const Camera::Ptr &camera) = 0;
 };
 
 }
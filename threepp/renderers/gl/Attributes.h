@@ -13,6 +13,12 @@
 namespace three {
 namespace gl {
 
+/**
+ * manages the GL buffers for buffer attributes.
+ *
+ * All data is transferred through the GL_ARRAY_BUFFER target, since binding GL_ELEMENT_ARRAY_BUFFER
+ * would modify the vertex array object that happens to be bound
+ */
 class Attributes
 {
   QOpenGLFunctions * const _fn;
@@ -24,8 +30,8 @@ class Attributes
 
     _fn->glGenBuffers(1, &buffer.handle);
 
-    _fn->glBindBuffer((GLenum)bufferType, buffer.handle);
-    _fn->glBufferData((GLenum)bufferType, attribute.byteCount(), attribute.data(0), usage);
+    _fn->glBindBuffer(GL_ARRAY_BUFFER, buffer.handle);
+    _fn->glBufferData(GL_ARRAY_BUFFER, attribute.byteCount(), attribute.data(0), usage);
 
     const_cast<BufferAttribute &>(attribute).onUpload.emitSignal(attribute);
 
@@ -41,21 +47,21 @@ public:
   {
     UpdateRange &updateRange = attribute.updateRange();
 
-    _fn->glBindBuffer((GLenum)bufferType, buffer.handle);
+    _fn->glBindBuffer(GL_ARRAY_BUFFER, buffer.handle);
 
     if(!attribute.dynamic) {
-      _fn->glBufferData((GLenum)bufferType, attribute.byteCount(), attribute.data(0), GL_STATIC_DRAW );
+      _fn->glBufferData(GL_ARRAY_BUFFER, attribute.byteCount(), attribute.data(0), GL_STATIC_DRAW );
     }
     else if(updateRange.count == -1) {
       // Not using update ranges
-      _fn->glBufferSubData((GLenum)bufferType, 0, attribute.byteCount(), attribute.data(0));
+      _fn->glBufferSubData(GL_ARRAY_BUFFER, 0, attribute.byteCount(), attribute.data(0));
     }
     else if(updateRange.count == 0 ) {
 
       throw std::logic_error("updateBuffer: dynamic BufferAttributeBase marked as needsUpdate but updateRange.count is 0, ensure you are using set methods or updating manually");
 
     } else {
-      _fn->glBufferSubData((GLenum)bufferType,
+      _fn->glBufferSubData(GL_ARRAY_BUFFER,
                       updateRange.start * buffer.bytesPerElement,
                       updateRange.count * buffer.bytesPerElement,
                       attribute.data(updateRange.start));
@@ -90,20 +96,28 @@ public:
     }
   }
 
-  void update(BufferAttribute &attribute, BufferType bufferType)
+  /**
+   * create the buffer, or upload the attribute data again if it has changed
+   *
+   * @return true if data was uploaded
+   */
+  bool update(BufferAttribute &attribute, BufferType bufferType)
   {
     //if ( attribute.isInterleavedBufferAttributeBase ) attribute = attribute.data;
     auto found = _buffers.find(attribute.uuid);
     if (found == _buffers.end()) {
        createBuffer(_buffers[ attribute.uuid ], attribute, bufferType );
+       return true;
     }
     else {
       Buffer &buffer = found->second;
       if ( buffer.version < attribute.version() ) {
         updateBuffer(buffer, attribute, bufferType);
         buffer.version = attribute.version();
+        return true;
       }
     }
+    return false;
   }
 };
 
@@ -70,7 +70,7 @@ void Background::render(RenderList *renderList, const Scene::Ptr scene, const Ca
 
         boxMesh->material->uniforms.set(UniformName::tCube, CAST2(bg->data, CubeTexture));
 
-        renderList->push_front(boxMesh, boxMesh->box, boxMesh->material, 0, nullptr);
+        renderList->push_front(boxMesh.get(), boxMesh->box.get(), boxMesh->material.get(), 0, nullptr);
       }
       else if(ImageTexture *ict = bg->data->typer) {
 
@@ -92,7 +92,8 @@ void Background::render(RenderList *renderList, const Scene::Ptr scene, const Ca
         planeMesh->material->map = bg->data;
 
         // TODO Push this to renderList
-        renderer.renderBufferDirect( planeCamera, nullptr, planeMesh->plane, planeMesh->material, planeMesh, nullptr);
+        renderer.renderBufferDirect( planeCamera, nullptr, planeMesh->plane.get(), planeMesh->material.get(),
+                                     planeMesh.get(), nullptr);
       }
     }
   }
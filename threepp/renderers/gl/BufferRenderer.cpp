@@ -10,10 +10,10 @@ namespace gl {
 
 void DefaultBufferRenderer::render(GLint start, GLsizei count)
 {
-  check_framebuffer(_fn);
+  check_framebuffer(_fn, _validation);
 
   _fn->glDrawArrays((GLenum)_mode, start, count);
-  check_glerror(_fn);
+  check_glerror(_fn, _validation);
 
   _renderInfo.calls ++;
   _renderInfo.vertices += count;
@@ -24,29 +24,33 @@ void DefaultBufferRenderer::render(GLint start, GLsizei count)
 
 void DefaultBufferRenderer::renderInstances(InstancedBufferGeometry *geometry, GLint start, GLsizei count)
 {
-  bool extension = _extensions.get(Extension::ANGLE_instanced_arrays);
-
-  if (!extension) {
-    throw std::invalid_argument(
-       "BufferRenderer: using InstancedBufferGeometry but hardware does not support ANGLE_instanced_arrays");
-  }
-
   BufferAttributeT<float>::Ptr position = geometry->position();
 
   if(CAST(position, ila, InterleavedBufferAttribute)) {
 
-    count = ila->count();
-    _fx->glDrawArraysInstanced((GLenum)_mode, 0, count, geometry->maxInstancedCount());
+    renderInstances(0, ila->count(), geometry->maxInstancedCount());
   }
   else {
-    _fx->glDrawArraysInstanced((GLenum)_mode, start, count, geometry->maxInstancedCount() );
+    renderInstances(start, count, geometry->maxInstancedCount());
+  }
+}
+
+void DefaultBufferRenderer::renderInstances(GLint start, GLsizei count, GLsizei instanceCount)
+{
+  bool extension = _extensions.get(Extension::ANGLE_instanced_arrays);
+
+  if (!extension) {
+    throw std::invalid_argument(
+       "BufferRenderer: instanced rendering but hardware does not support ANGLE_instanced_arrays");
   }
 
+  _fx->glDrawArraysInstanced((GLenum)_mode, start, count, instanceCount);
+
   _renderInfo.calls ++;
-  _renderInfo.vertices += count * geometry->maxInstancedCount();
+  _renderInfo.vertices += count * instanceCount;
 
-  if (_mode == DrawMode::Triangles) _renderInfo.faces += geometry->maxInstancedCount() * count / 3;
-  else if (_mode == DrawMode::Points) _renderInfo.points += geometry->maxInstancedCount() * count;
+  if (_mode == DrawMode::Triangles) _renderInfo.faces += instanceCount * count / 3;
+  else if (_mode == DrawMode::Points) _renderInfo.points += instanceCount * count;
 }
 
 void IndexedBufferRenderer::render(GLint start, GLsizei count)
@@ -62,21 +66,26 @@ void IndexedBufferRenderer::render(GLint start, GLsizei count)
 }
 
 void IndexedBufferRenderer::renderInstances(InstancedBufferGeometry *geometry, GLint start, GLsizei count)
+{
+  renderInstances(start, count, geometry->maxInstancedCount());
+}
+
+void IndexedBufferRenderer::renderInstances(GLint start, GLsizei count, GLsizei instanceCount)
 {
   bool extension = _extensions.get(Extension::ANGLE_instanced_arrays);
 
   if (!extension) {
     throw std::invalid_argument(
-       "BufferRenderer: using InstancedBufferGeometry but hardware does not support ANGLE_instanced_arrays");
+       "BufferRenderer: instanced rendering but hardware does not support ANGLE_instanced_arrays");
   }
 
-  _fx->glDrawElementsInstanced((GLenum)_mode, count, _type, (const void *)(start * _bytesPerElement), geometry->maxInstancedCount() );
+  _fx->glDrawElementsInstanced((GLenum)_mode, count, _type, (const void *)(start * _bytesPerElement), instanceCount );
 
   _renderInfo.calls ++;
-  _renderInfo.vertices += count * geometry->maxInstancedCount();
+  _renderInfo.vertices += count * instanceCount;
 
-  if (_mode == DrawMode::Triangles) _renderInfo.faces += geometry->maxInstancedCount() * count / 3;
-  else if (_mode == DrawMode::Points) _renderInfo.points += geometry->maxInstancedCount() * count;
+  if (_mode == DrawMode::Triangles) _renderInfo.faces += instanceCount * count / 3;
+  else if (_mode == DrawMode::Points) _renderInfo.points += instanceCount * count;
 }
 
 };
@@ -22,12 +22,13 @@ protected:
   DrawMode _mode;
   QOpenGLFunctions *const _fn;
   QOpenGLExtraFunctions *const _fx;
+  const Validation &_validation;
   Extensions &_extensions;
   RenderInfo &_renderInfo;
 
-  BufferRenderer(QOpenGLFunctions *fn, QOpenGLExtraFunctions *fnx,
+  BufferRenderer(QOpenGLFunctions *fn, QOpenGLExtraFunctions *fnx, const Validation &validation,
                  Extensions &extensions, RenderInfo &renderinfo)
-     : _fn(fn), _fx(fnx), _extensions(extensions), _renderInfo(renderinfo), _mode(DrawMode::Triangles)
+     : _fn(fn), _fx(fnx), _validation(validation), _extensions(extensions), _renderInfo(renderinfo), _mode(DrawMode::Triangles)
   {}
 
 public:
@@ -35,19 +36,21 @@ public:
 
   virtual void render(GLint start, GLsizei count) = 0;
   virtual void renderInstances(InstancedBufferGeometry *geometry, GLint start, GLsizei count) = 0;
+  virtual void renderInstances(GLint start, GLsizei count, GLsizei instanceCount) = 0;
 };
 
 class DefaultBufferRenderer : public BufferRenderer
 {
 public:
-  DefaultBufferRenderer(QOpenGLFunctions *fn, QOpenGLExtraFunctions *fnx,
+  DefaultBufferRenderer(QOpenGLFunctions *fn, QOpenGLExtraFunctions *fnx, const Validation &validation,
                  Extensions &extensions, RenderInfo &renderinfo)
-     : BufferRenderer(fn, fnx, extensions, renderinfo)
+     : BufferRenderer(fn, fnx, validation, extensions, renderinfo)
   {
   }
 
   void render(GLint start, GLsizei count) override;
   void renderInstances(InstancedBufferGeometry *geometry, GLint start, GLsizei count) override;
+  void renderInstances(GLint start, GLsizei count, GLsizei instanceCount) override;
 };
 
 class IndexedBufferRenderer : public BufferRenderer
@@ -56,9 +59,9 @@ class IndexedBufferRenderer : public BufferRenderer
   GLsizei _bytesPerElement = 0;
 
 public:
-  IndexedBufferRenderer(QOpenGLFunctions *fn, QOpenGLExtraFunctions *fnx,
+  IndexedBufferRenderer(QOpenGLFunctions *fn, QOpenGLExtraFunctions *fnx, const Validation &validation,
                  Extensions &extensions, RenderInfo &renderinfo)
-     : BufferRenderer(fn, fnx, extensions, renderinfo)
+     : BufferRenderer(fn, fnx, validation, extensions, renderinfo)
   {
   }
 
@@ -70,6 +73,7 @@ public:
 
   void render(GLint start, GLsizei count) override;
   void renderInstances(InstancedBufferGeometry *geometry, GLint start, GLsizei count) override;
+  void renderInstances(GLint start, GLsizei count, GLsizei instanceCount) override;
 };
 
 }
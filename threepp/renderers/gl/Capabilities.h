@@ -46,6 +46,15 @@ public:
 
   bool isGL2 = false;
 
+  //vertex array objects are core in OpenGL 3.0 and OpenGL ES 3.0
+  bool vertexArrayObjects = false;
+
+  //uniform buffer objects are core in OpenGL 3.1 and OpenGL ES 3.0
+  bool uniformBufferObjects = false;
+
+  //pixel unpack buffers together with glMapBufferRange, core in OpenGL 3.0 and OpenGL ES 3.0
+  bool pixelBufferObjects = false;
+
   GLint maxAnisotropy = -1;
   Precision maxPrecision;
   Precision precision;
@@ -70,6 +79,12 @@ public:
     floatFragmentTextures = !_extensions.get(Extension::OES_texture_float);
     floatVertexTextures = vertexTextures && floatFragmentTextures;
 
+    vertexArrayObjects = context->format().majorVersion() >= 3;
+
+    int major = context->format().majorVersion(), minor = context->format().minorVersion();
+    uniformBufferObjects = context->isOpenGLES() ? major >= 3 : major > 3 || (major == 3 && minor >= 1);
+    pixelBufferObjects = major >= 3;
+
     precision = _parameters.precision;
     maxPrecision = getMaxPrecision( precision );
 
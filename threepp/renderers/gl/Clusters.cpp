@@ -0,0 +1,318 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#include "Clusters.h"
+#include <cmath>
+#include <algorithm>
+#include <threepp/camera/PerspectiveCamera.h>
+
+namespace three {
+namespace gl {
+
+using namespace std;
+
+namespace {
+
+bool intersects(const float *min, const float *max, const math::Vector3 &center, float radius)
+{
+  float distance = 0;
+  for(unsigned i = 0; i < 3; i++) {
+    float c = center.elements()[i];
+    float d = std::max(min[i] - c, std::max(0.0f, c - max[i]));
+    distance += d * d;
+  }
+  return distance <= radius * radius;
+}
+
+//point on the line from a near plane point to a far plane point, at the given view depth
+math::Vector3 atDepth(const math::Vector3 &nearPoint, const math::Vector3 &farPoint, float depth)
+{
+  float nearDepth = -nearPoint.z(), farDepth = -farPoint.z();
+  float t = (depth - nearDepth) / (farDepth - nearDepth);
+
+  return nearPoint + (farPoint - nearPoint) * t;
+}
+
+unsigned toTile(float ndc, unsigned count)
+{
+  float tile = floor((ndc * 0.5f + 0.5f) * count);
+  return (unsigned)std::min(std::max(tile, 0.0f), (float)(count - 1));
+}
+
+}
+
+float Clusters::sliceDepth(unsigned slice) const
+{
+  float f = (float)slice / grid_z;
+  return _exponential ? _near * pow(_far / _near, f) : _near + (_far - _near) * f;
+}
+
+unsigned Clusters::sliceOf(float depth) const
+{
+  if(_exponential && depth <= 0) return 0;
+
+  float slice = floor((_exponential ? log(depth) : depth) * _slicing.x() + _slicing.y());
+  return (unsigned)std::min(std::max(slice, 0.0f), (float)(grid_z - 1));
+}
+
+void Clusters::setCamera(const Camera &camera)
+{
+  float near = camera.near(), far = camera.far();
+
+  if(!_bounds.empty() && near == _near && far == _far && camera.projectionMatrix() == _projection)
+    return;
+
+  _projection = camera.projectionMatrix();
+  _near = near;
+  _far = far;
+  PerspectiveCamera *perspective = camera.typer;
+  _exponential = perspective && near > 0;
+
+  if(_exponential) {
+    float scale = grid_z / log(far / near);
+    _slicing.set(scale, -log(near) * scale, 1, 0);
+  }
+  else {
+    float scale = grid_z / (far - near);
+    _slicing.set(scale, -near * scale, 0, 0);
+  }
+
+  //lines through the tile corners, from the near to the far plane
+  math::Matrix4 inverse = _projection.inverted();
+
+  vector<math::Vector3> nearPoints, farPoints;
+  for(unsigned y = 0; y <= grid_y; y++) {
+    for(unsigned x = 0; x <= grid_x; x++) {
+      float ndcX = -1.0f + 2.0f * x / grid_x, ndcY = -1.0f + 2.0f * y / grid_y;
+
+      nearPoints.push_back(math::Vector3(ndcX, ndcY, -1).apply(inverse));
+      farPoints.push_back(math::Vector3(ndcX, ndcY, 1).apply(inverse));
+    }
+  }
+
+  _bounds.resize(grid_x * grid_y * grid_z);
+
+  for(unsigned z = 0; z < grid_z; z++) {
+    float depths[] = {sliceDepth(z), sliceDepth(z + 1)};
+
+    for(unsigned y = 0; y < grid_y; y++) {
+      for(unsigned x = 0; x < grid_x; x++) {
+
+        Bounds &bounds = _bounds[(z * grid_y + y) * grid_x + x];
+        fill(bounds.min, bounds.min + 3, numeric_limits<float>::infinity());
+        fill(bounds.max, bounds.max + 3, -numeric_limits<float>::infinity());
+
+        unsigned corners[] = {y * (grid_x + 1) + x, y * (grid_x + 1) + x + 1,
+                              (y + 1) * (grid_x + 1) + x, (y + 1) * (grid_x + 1) + x + 1};
+
+        for(unsigned corner : corners) {
+          for(float depth : depths) {
+            math::Vector3 point = atDepth(nearPoints[corner], farPoints[corner], depth);
+
+            for(unsigned i = 0; i < 3; i++) {
+              bounds.min[i] = std::min(bounds.min[i], point.elements()[i]);
+              bounds.max[i] = std::max(bounds.max[i], point.elements()[i]);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+void Clusters::addLight(const math::Vector3 &position, const math::Vector3 &direction, const Color &color,
+                        float distance, float decay, float coneCos, float penumbraCos)
+{
+  float data[] = {position.x(), position.y(), position.z(), distance,
+                  color.r, color.g, color.b, decay,
+                  direction.x(), direction.y(), direction.z(), coneCos,
+                  penumbraCos, 0, 0, 0};
+  _lightData.insert(_lightData.end(), data, data + 16);
+
+  //a spot light's cone is bounded by the sphere as well
+  Light light;
+  light.center = position;
+  light.radius = distance;
+
+  float minDepth = -position.z() - distance, maxDepth = -position.z() + distance;
+  if(maxDepth < _near || minDepth > _far) {
+    light.minZ = 1;
+    light.maxZ = 0;
+    _lights.push_back(light);
+    return;
+  }
+  light.minZ = sliceOf(minDepth);
+  light.maxZ = sliceOf(maxDepth);
+
+  //screen bounds of the sphere's box. Boxes reaching behind the camera cover the whole screen
+  float minX = 1, maxX = -1, minY = 1, maxY = -1;
+  bool whole = false;
+
+  const float *e = _projection.elements();
+  for(unsigned i = 0; i < 8 && !whole; i++) {
+    float x = position.x() + (i & 1 ? distance : -distance);
+    float y = position.y() + (i & 2 ? distance : -distance);
+    float z = position.z() + (i & 4 ? distance : -distance);
+
+    float w = e[3] * x + e[7] * y + e[11] * z + e[15];
+    if(w <= 1e-6f) {
+      whole = true;
+      break;
+    }
+    float ndcX = (e[0] * x + e[4] * y + e[8] * z + e[12]) / w;
+    float ndcY = (e[1] * x + e[5] * y + e[9] * z + e[13]) / w;
+
+    minX = std::min(minX, ndcX);
+    maxX = std::max(maxX, ndcX);
+    minY = std::min(minY, ndcY);
+    maxY = std::max(maxY, ndcY);
+  }
+
+  if(whole) {
+    minX = minY = -1;
+    maxX = maxY = 1;
+  }
+  else if(maxX < -1 || minX > 1 || maxY < -1 || minY > 1) {
+    light.minZ = 1;
+    light.maxZ = 0;
+  }
+
+  light.minX = toTile(minX, grid_x);
+  light.maxX = toTile(maxX, grid_x);
+  light.minY = toTile(minY, grid_y);
+  light.maxY = toTile(maxY, grid_y);
+
+  _lights.push_back(light);
+}
+
+void Clusters::binSlices()
+{
+  for(unsigned z = _nextSlice++; z < grid_z; z = _nextSlice++) {
+
+    for(uint32_t index = 0; index < _lights.size(); index++) {
+      const Light &light = _lights[index];
+      if(z < light.minZ || z > light.maxZ) continue;
+
+      for(unsigned y = light.minY; y <= light.maxY; y++) {
+        for(unsigned x = light.minX; x <= light.maxX; x++) {
+
+          unsigned cell = (z * grid_y + y) * grid_x + x;
+          const Bounds &bounds = _bounds[cell];
+
+          if(intersects(bounds.min, bounds.max, light.center, light.radius))
+            _cellLights[cell].push_back(index);
+        }
+      }
+    }
+  }
+}
+
+void Clusters::update(const Lights::State &state, const Camera &camera, WorkerPool &workers)
+{
+  setCamera(camera);
+
+  _lights.clear();
+  _lightData.clear();
+
+  for(const auto &light : state.clusteredPoint) {
+    addLight(light->position, math::Vector3(), light->color, light->distance, light->decay, -2, 0);
+  }
+  for(const auto &light : state.clusteredSpot) {
+    addLight(light->position, light->direction, light->color, light->distance, light->decay,
+             light->coneCos, light->penumbraCos);
+  }
+
+  _cellLights.resize(grid_x * grid_y * grid_z);
+  for(auto &cellLights : _cellLights) cellLights.clear();
+
+  if(!_lights.empty()) {
+    _nextSlice = 0;
+    workers.run([this]() {binSlices();});
+  }
+
+  _cells.resize(_cellLights.size() * 2);
+  _indices.clear();
+
+  for(size_t cell = 0; cell < _cellLights.size(); cell++) {
+    _cells[cell * 2] = (uint32_t)_indices.size();
+    _cells[cell * 2 + 1] = (uint32_t)_cellLights[cell].size();
+
+    _indices.insert(_indices.end(), _cellLights[cell].begin(), _cellLights[cell].end());
+  }
+}
+
+void Clusters::upload(State &state, Sampler sampler, GLint internalFormat, GLenum format, GLenum type,
+                      GLsizei width, GLsizei height, const void *data)
+{
+  GLuint &texture = _textures[sampler];
+
+  if(!texture) {
+    _fn->glGenTextures(1, &texture);
+    state.bindTexture(TextureTarget::twoD, texture);
+    _fn->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    _fn->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    _fn->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    _fn->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  else
+    state.bindTexture(TextureTarget::twoD, texture);
+
+  //storage only grows, so the light count can fluctuate without reallocations
+  if(height > _heights[sampler]) {
+    _fn->glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, data);
+    _heights[sampler] = height;
+  }
+  else {
+    _fn->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, data);
+  }
+}
+
+void Clusters::upload(State &state, GLint maxTextures)
+{
+  //rows are completed with zeros
+  GLsizei lightRows = std::max<GLsizei>(1, (GLsizei)(_lightData.size() / 4 + texture_width - 1) / texture_width);
+  _lightData.resize(lightRows * texture_width * 4, 0.0f);
+
+  GLsizei indexRows = std::max<GLsizei>(1, (GLsizei)(_indices.size() + texture_width - 1) / texture_width);
+  _indices.resize(indexRows * texture_width, 0);
+
+  GLuint unit = firstUnit(maxTextures);
+
+  state.activeTexture(GL_TEXTURE0 + unit + LightData);
+  upload(state, LightData, GL_RGBA32F, GL_RGBA, GL_FLOAT, texture_width, lightRows, _lightData.data());
+
+  state.activeTexture(GL_TEXTURE0 + unit + CellData);
+  upload(state, CellData, GL_RG32UI, GL_RG_INTEGER, GL_UNSIGNED_INT, grid_x * grid_y, grid_z, _cells.data());
+
+  state.activeTexture(GL_TEXTURE0 + unit + IndexData);
+  upload(state, IndexData, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, texture_width, indexRows, _indices.data());
+}
+
+void Clusters::bind(QOpenGLExtraFunctions *fn, GLuint program, GLint maxTextures)
+{
+  GLint current;
+  fn->glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+
+  GLuint unit = firstUnit(maxTextures);
+
+  //samplers can't be assigned in GLSL 1.40, so set them while the program is current
+  fn->glUseProgram(program);
+  fn->glUniform1i(fn->glGetUniformLocation(program, "clusterLights"), unit + LightData);
+  fn->glUniform1i(fn->glGetUniformLocation(program, "clusterCells"), unit + CellData);
+  fn->glUniform1i(fn->glGetUniformLocation(program, "clusterIndices"), unit + IndexData);
+  fn->glUseProgram((GLuint)current);
+}
+
+void Clusters::clear()
+{
+  for(unsigned i = 0; i < 3; i++) {
+    if(_textures[i]) _fn->glDeleteTextures(1, &_textures[i]);
+    _textures[i] = 0;
+    _heights[i] = 0;
+  }
+  _bounds.clear();
+}
+
+}
+}
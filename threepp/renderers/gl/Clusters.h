@@ -0,0 +1,149 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_CLUSTERS_H
+#define THREEPP_CLUSTERS_H
+
+#include <vector>
+#include <atomic>
+#include <QOpenGLExtraFunctions>
+#include <threepp/camera/Camera.h>
+#include <threepp/math/Vector4.h>
+#include "Lights.h"
+#include "State.h"
+#include "WorkerPool.h"
+
+namespace three {
+namespace gl {
+
+/**
+ * clustered forward lighting. The view frustum is divided into a grid of clusters (screen tiles
+ * times depth slices, the slices growing exponentially with the distance for perspective cameras).
+ * Point and spot lights without shadows are tested against the view space bounds of the clusters
+ * each frame, and the shaders only iterate over the lights of the cluster a fragment falls into.
+ * Shading cost therefore follows the local light density, and since these lights are not part of
+ * LightsHash, adding or removing them does not recompile any program.
+ *
+ * Binning runs per depth slice on the worker pool. The results are passed to the shaders in three
+ * textures (see lights_pars.glsl):
+ *
+ * - lights: RGBA32F, 4 texels per light: view position and distance, color and decay, view
+ *   direction and cone cosine (-2 for point lights), penumbra cosine
+ * - cells: RG32UI, one texel per cluster: offset and length of the cluster's light list. Row z
+ *   holds the tiles of slice z, row by row
+ * - indices: R32UI, the concatenated light lists
+ *
+ * Lights and indices are laid out in rows of texture_width texels. The textures are bound to the
+ * last texture units, which are kept away from the material textures
+ */
+class Clusters
+{
+public:
+  static constexpr unsigned grid_x = 16;
+  static constexpr unsigned grid_y = 9;
+  static constexpr unsigned grid_z = 24;
+
+  static constexpr unsigned texture_width = 1024;
+
+  //units taken from the top of the fragment texture units, the topmost one is left alone
+  static constexpr unsigned reserved_units = 4;
+
+  enum Sampler {LightData=0, CellData=1, IndexData=2};
+
+private:
+  struct Bounds
+  {
+    float min[3], max[3];
+  };
+
+  struct Light
+  {
+    math::Vector3 center;
+    float radius;
+    unsigned minX, maxX, minY, maxY, minZ, maxZ;
+  };
+
+  QOpenGLExtraFunctions * const _fn;
+
+  GLuint _textures[3] {0, 0, 0};
+  GLsizei _heights[3] {0, 0, 0};
+
+  //camera the cluster bounds were computed for
+  math::Matrix4 _projection;
+  float _near = 0, _far = 0;
+  bool _exponential = true;
+  math::Vector4 _slicing;
+
+  std::vector<Bounds> _bounds;
+
+  std::vector<Light> _lights;
+  std::vector<float> _lightData;
+
+  std::vector<std::vector<uint32_t>> _cellLights;
+  std::vector<uint32_t> _cells;
+  std::vector<uint32_t> _indices;
+  std::atomic<unsigned> _nextSlice;
+
+  float sliceDepth(unsigned slice) const;
+
+  unsigned sliceOf(float depth) const;
+
+  void setCamera(const Camera &camera);
+
+  void addLight(const math::Vector3 &position, const math::Vector3 &direction, const Color &color,
+                float distance, float decay, float coneCos, float penumbraCos);
+
+  void binSlices();
+
+  void upload(State &state, Sampler sampler, GLint internalFormat, GLenum format, GLenum type,
+              GLsizei width, GLsizei height, const void *data);
+
+public:
+  explicit Clusters(QOpenGLExtraFunctions *fn) : _fn(fn), _nextSlice(0) {}
+
+  /**
+   * the first of the reserved texture units
+   */
+  static GLuint firstUnit(GLint maxTextures)
+  {
+    return (GLuint)maxTextures - reserved_units;
+  }
+
+  /**
+   * assign the cluster samplers of a freshly linked program to the reserved units
+   *
+   * @param maxTextures the texture unit count, see Capabilities::maxTextures
+   */
+  static void bind(QOpenGLExtraFunctions *fn, GLuint program, GLint maxTextures);
+
+  /**
+   * bin the clustered lights of the current frame
+   *
+   * @param state lights state, set up with clustering enabled
+   * @param camera the camera the state was set up for
+   * @param workers pool to distribute the depth slices on
+   */
+  void update(const Lights::State &state, const Camera &camera, WorkerPool &workers);
+
+  /**
+   * upload the binning results and bind the textures to the reserved units
+   */
+  void upload(State &state, GLint maxTextures);
+
+  /**
+   * depth slice mapping for the shaders: slice = f(depth) * x + y, where f is the natural
+   * logarithm if z is 1 and the identity otherwise
+   */
+  const math::Vector4 &slicing() const {return _slicing;}
+
+  size_t lightCount() const {return _lights.size();}
+
+  size_t indexCount() const {return _indices.size();}
+
+  void clear();
+};
+
+}
+}
+#endif //THREEPP_CLUSTERS_H
@@ -0,0 +1,110 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_DEBUGOUTPUT_H
+#define THREEPP_DEBUGOUTPUT_H
+
+#include <QOpenGLContext>
+#include <QDebug>
+#include <threepp/core/Object3D.h>
+#include "Helpers.h"
+
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT                   0x92E0
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS       0x8242
+#define GL_DEBUG_TYPE_ERROR               0x824C
+#define GL_DEBUG_SEVERITY_HIGH            0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM          0x9147
+#define GL_DEBUG_SEVERITY_LOW             0x9148
+#define GL_DEBUG_SEVERITY_NOTIFICATION    0x826B
+#endif
+
+namespace three {
+namespace gl {
+
+/**
+ * asynchronous error reporting through KHR_debug. Messages are attributed to the object and
+ * material that were current when the driver issued them
+ */
+class DebugOutput
+{
+  typedef void (QOPENGLF_APIENTRYP Callback)(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                            GLsizei length, const GLchar *message, const void *userParam);
+  typedef void (QOPENGLF_APIENTRYP DebugMessageCallback)(Callback callback, const void *userParam);
+
+  const Object3D *_object = nullptr;
+  const Material *_material = nullptr;
+
+  bool _enabled = false;
+
+  static void QOPENGLF_APIENTRY onMessage(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                          GLsizei length, const GLchar *message, const void *userParam)
+  {
+    if(severity == GL_DEBUG_SEVERITY_NOTIFICATION) return;
+
+    const DebugOutput *output = static_cast<const DebugOutput *>(userParam);
+
+    std::stringstream ss;
+    ss << "GL: " << std::string(message, length >= 0 ? length : strlen(message));
+    if(output->_object) {
+      ss << " [object " << output->_object->id() << " '" << output->_object->name() << "'";
+      if(output->_material)
+        ss << ", material " << output->_material->id << " '" << output->_material->name << "'";
+      ss << "]";
+    }
+
+    if(type == GL_DEBUG_TYPE_ERROR || severity == GL_DEBUG_SEVERITY_HIGH)
+      qCritical() << ss.str().c_str();
+    else
+      qWarning() << ss.str().c_str();
+  }
+
+public:
+  /**
+   * install the message callback into the current context, or disable debug output if another
+   * level is requested. May be called again to change the level
+   *
+   * @return the validation level that is in effect. If Async is requested but the context does
+   * not support KHR_debug, Off is returned
+   */
+  Validation init(QOpenGLContext *context, Validation level)
+  {
+    if(level != Validation::Async) {
+      if(_enabled) {
+        context->functions()->glDisable(GL_DEBUG_OUTPUT);
+        _enabled = false;
+      }
+      return level;
+    }
+
+    auto callback = (DebugMessageCallback)context->getProcAddress("glDebugMessageCallback");
+    if(!callback) callback = (DebugMessageCallback)context->getProcAddress("glDebugMessageCallbackKHR");
+
+    if(!callback) {
+      qWarning() << "KHR_debug not supported, GL validation disabled";
+      return Validation::Off;
+    }
+
+    callback(&DebugOutput::onMessage, this);
+
+    QOpenGLFunctions *f = context->functions();
+    f->glEnable(GL_DEBUG_OUTPUT);
+
+    //make sure messages are delivered while the offending draw is current
+    f->glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+    _enabled = true;
+    return level;
+  }
+
+  void setCurrent(const Object3D *object, const Material *material)
+  {
+    _object = object;
+    _material = material;
+  }
+};
+
+}
+}
+#endif //THREEPP_DEBUGOUTPUT_H
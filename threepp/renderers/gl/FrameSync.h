@@ -0,0 +1,130 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_FRAMESYNC_H
+#define THREEPP_FRAMESYNC_H
+
+#include <deque>
+#include <chrono>
+#include <QOpenGLExtraFunctions>
+#include "Helpers.h"
+
+namespace three {
+namespace gl {
+
+/**
+ * paces frame submission using fence objects. With framesInFlight == 0, every frame is
+ * completed synchronously (glFinish). Otherwise, the CPU is only blocked once more than
+ * framesInFlight frames are queued on the GPU
+ */
+class FrameSync
+{
+  QOpenGLExtraFunctions * const _fn;
+  const Validation &_validation;
+  RenderInfo &_renderInfo;
+
+  unsigned _framesInFlight;
+  std::deque<GLsync> _fences;
+
+  //upper bound for a single glClientWaitSync call, in nanoseconds
+  static constexpr GLuint64 wait_timeout = 100000000;
+
+  void waitFor(GLsync fence)
+  {
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    GLenum result;
+    do {
+      result = _fn->glClientWaitSync(fence, flags, wait_timeout);
+      flags = 0;
+    } while(result == GL_TIMEOUT_EXPIRED);
+
+    _fn->glDeleteSync(fence);
+
+    if(result == GL_WAIT_FAILED) check_glerror(_fn, _validation);
+  }
+
+public:
+  FrameSync(QOpenGLExtraFunctions *fn, const Validation &validation, RenderInfo &renderInfo, unsigned framesInFlight)
+     : _fn(fn), _validation(validation), _renderInfo(renderInfo), _framesInFlight(framesInFlight)
+  {}
+
+  unsigned framesInFlight() const {return _framesInFlight;}
+
+  /**
+   * change the limit. Dropping to 0 waits for the pending frames, since throttle no longer
+   * looks at their fences. Requires a current context
+   */
+  void setFramesInFlight(unsigned framesInFlight)
+  {
+    _framesInFlight = framesInFlight;
+
+    if(_framesInFlight == 0) finish();
+  }
+
+  /**
+   * block until the GPU queue is no deeper than framesInFlight - 1, so that the
+   * frame about to be submitted does not exceed the limit
+   */
+  void throttle()
+  {
+    _renderInfo.syncWait = 0;
+    if(_framesInFlight == 0 || _fences.size() < _framesInFlight) return;
+
+    auto start = std::chrono::steady_clock::now();
+
+    while(_fences.size() >= _framesInFlight) {
+      waitFor(_fences.front());
+      _fences.pop_front();
+    }
+
+    std::chrono::duration<float, std::milli> waited = std::chrono::steady_clock::now() - start;
+    _renderInfo.syncWait = waited.count();
+  }
+
+  /**
+   * mark the end of the current frame
+   */
+  void submit()
+  {
+    if(_framesInFlight == 0) {
+      auto start = std::chrono::steady_clock::now();
+
+      _fn->glFinish();
+
+      std::chrono::duration<float, std::milli> waited = std::chrono::steady_clock::now() - start;
+      _renderInfo.syncWait = waited.count();
+    }
+    else {
+      _fences.push_back(_fn->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+      _fn->glFlush();
+    }
+    _renderInfo.framesInFlight = (unsigned)_fences.size();
+  }
+
+  /**
+   * wait for all pending frames
+   */
+  void finish()
+  {
+    while(!_fences.empty()) {
+      waitFor(_fences.front());
+      _fences.pop_front();
+    }
+    _renderInfo.framesInFlight = 0;
+  }
+
+  /**
+   * forget all fences without waiting. Must be called before the context is destroyed
+   */
+  void clear()
+  {
+    for(GLsync fence : _fences) _fn->glDeleteSync(fence);
+    _fences.clear();
+    _renderInfo.framesInFlight = 0;
+  }
+};
+
+}
+}
+#endif //THREEPP_FRAMESYNC_H
@@ -6,6 +6,7 @@
 #define THREEPP_GEOMETRIES_H
 
 #include <unordered_map>
+#include <unordered_set>
 
 #include <threepp/core/Object3D.h>
 #include <threepp/core/LinearGeometry.h>
@@ -25,27 +26,49 @@ class Geometries
   std::unordered_map<unsigned, GeometryInfo> geometries;
   std::unordered_map<unsigned, BufferAttributeT<uint32_t>::Ptr> wireframeAttributes;
 
+  //buffer geometries whose wireframe index was uploaded after their last update
+  std::unordered_set<unsigned> wireframeUploads;
+
+  //geometry id by buffer geometry id. They differ for converted LinearGeometries
+  std::unordered_map<unsigned, unsigned> sourceIds;
+
   unsigned geometryCount = 0;
 
   Attributes &_attributes;
 
+  void removeBuffers(const BufferGeometry &buffergeometry)
+  {
+    if (buffergeometry.index()) {
+      _attributes.remove( *buffergeometry.index() );
+    }
+
+    if(buffergeometry.position()) _attributes.remove(*buffergeometry.position());
+    if(buffergeometry.normal()) _attributes.remove(*buffergeometry.normal());
+    if(buffergeometry.color()) _attributes.remove(*buffergeometry.color());
+    if(buffergeometry.uv()) _attributes.remove(*buffergeometry.uv());
+    if(buffergeometry.uv2()) _attributes.remove(*buffergeometry.uv2());
+
+    for (const BufferAttributeT<float>::Ptr &pos : buffergeometry.morphPositions()) {
+      _attributes.remove(*pos);
+    }
+    for (const BufferAttributeT<float>::Ptr &normal : buffergeometry.morphNormals()) {
+      _attributes.remove(*normal);
+    }
+  }
+
   void onGeometryDispose(Geometry *geometry)
   {
     GeometryInfo &gi = geometries[ geometry->id ];
     BufferGeometry::Ptr buffergeometry = gi.geometry;
 
-    if (buffergeometry->index()) {
-      _attributes.remove( *buffergeometry->index() );
-    }
+    onRemove.emitSignal(*buffergeometry);
 
-    if(buffergeometry->position()) _attributes.remove(*buffergeometry->position());
-    if(buffergeometry->normal()) _attributes.remove(*buffergeometry->normal());
-    if(buffergeometry->color()) _attributes.remove(*buffergeometry->color());
-    if(buffergeometry->uv()) _attributes.remove(*buffergeometry->uv());
-    if(buffergeometry->uv2()) _attributes.remove(*buffergeometry->uv2());
+    removeBuffers(*buffergeometry);
 
     geometry->onDispose.disconnect(gi.connectionId);
 
+    sourceIds.erase(buffergeometry->id);
+    wireframeUploads.erase(buffergeometry->id);
     geometries.erase(geometry->id);
 
     // TODO Remove duplicate code
@@ -68,7 +91,12 @@ class Geometries
 public:
   Geometries(Attributes &attributes) : _attributes(attributes) {}
 
-  BufferGeometry::Ptr get(Object3D::Ptr object, Geometry::Ptr geometry)
+  /**
+   * emitted before the buffers of a disposed geometry are deleted
+   */
+  Signal<void(const BufferGeometry &)> onRemove;
+
+  const BufferGeometry::Ptr &get(const Object3D::Ptr &object, const Geometry::Ptr &geometry)
   {
     GeometryInfo &gi = geometries[ geometry->id ];
 
@@ -83,34 +111,96 @@ public:
     }
     else gi.geometry = CAST2(geometry, BufferGeometry);
 
+    sourceIds[gi.geometry->id] = geometry->id;
     geometryCount++;
 
     return gi.geometry;
   }
 
-  void update(BufferGeometry::Ptr buffergeometry)
+  /**
+   * create or update the GL buffers of the geometry
+   *
+   * @return true if data was uploaded since the last call, so the size of the buffers may have
+   * changed. This includes a wireframe index created in between
+   */
+  bool update(const BufferGeometry::Ptr &buffergeometry)
   {
+    bool uploaded = wireframeUploads.erase(buffergeometry->id) > 0;
+
     if (buffergeometry->index()) {
-      _attributes.update(*buffergeometry->getIndex(), BufferType::ElementArray);
+      uploaded |= _attributes.update(*buffergeometry->getIndex(), BufferType::ElementArray);
     }
 
-    if(buffergeometry->position()) _attributes.update(*buffergeometry->position(), BufferType::Array);
-    if(buffergeometry->normal()) _attributes.update(*buffergeometry->normal(), BufferType::Array);
-    if(buffergeometry->color()) _attributes.update(*buffergeometry->color(), BufferType::Array);
-    if(buffergeometry->uv()) _attributes.update(*buffergeometry->uv(), BufferType::Array);
-    if(buffergeometry->uv2()) _attributes.update(*buffergeometry->uv2(), BufferType::Array);
+    if(buffergeometry->position()) uploaded |= _attributes.update(*buffergeometry->position(), BufferType::Array);
+    if(buffergeometry->normal()) uploaded |= _attributes.update(*buffergeometry->normal(), BufferType::Array);
+    if(buffergeometry->color()) uploaded |= _attributes.update(*buffergeometry->color(), BufferType::Array);
+    if(buffergeometry->uv()) uploaded |= _attributes.update(*buffergeometry->uv(), BufferType::Array);
+    if(buffergeometry->uv2()) uploaded |= _attributes.update(*buffergeometry->uv2(), BufferType::Array);
 
     // morph targets
 
     for (BufferAttributeT<float>::Ptr pos : buffergeometry->morphPositions()) {
-      _attributes.update(*pos, BufferType::Array);
+      uploaded |= _attributes.update(*pos, BufferType::Array);
     }
     for (BufferAttributeT<float>::Ptr normal : buffergeometry->morphNormals()) {
-      _attributes.update(*normal, BufferType::Array);
+      uploaded |= _attributes.update(*normal, BufferType::Array);
+    }
+    return uploaded;
+  }
+
+  /**
+   * @return the size of the GL buffers held by the geometry
+   */
+  size_t bytes(const BufferGeometry &buffergeometry) const
+  {
+    size_t bytes = 0;
+
+    if(buffergeometry.index()) bytes += buffergeometry.index()->byteCount();
+    if(buffergeometry.position()) bytes += buffergeometry.position()->byteCount();
+    if(buffergeometry.normal()) bytes += buffergeometry.normal()->byteCount();
+    if(buffergeometry.color()) bytes += buffergeometry.color()->byteCount();
+    if(buffergeometry.uv()) bytes += buffergeometry.uv()->byteCount();
+    if(buffergeometry.uv2()) bytes += buffergeometry.uv2()->byteCount();
+
+    for (const BufferAttributeT<float>::Ptr &pos : buffergeometry.morphPositions()) {
+      bytes += pos->byteCount();
+    }
+    for (const BufferAttributeT<float>::Ptr &normal : buffergeometry.morphNormals()) {
+      bytes += normal->byteCount();
+    }
+
+    auto wireframe = wireframeAttributes.find(buffergeometry.id);
+    if(wireframe != wireframeAttributes.end() && wireframe->second) bytes += wireframe->second->byteCount();
+
+    return bytes;
+  }
+
+  /**
+   * delete the GL buffers of a geometry to free GPU memory. The geometry stays registered, and
+   * the buffers are recreated from the attribute data on the next update
+   */
+  void evict(unsigned bufferGeometryId)
+  {
+    auto source = sourceIds.find(bufferGeometryId);
+    if(source == sourceIds.end()) return;
+
+    auto found = geometries.find(source->second);
+    if(found == geometries.end() || !found->second.geometry) return;
+
+    const BufferGeometry &buffergeometry = *found->second.geometry;
+
+    onRemove.emitSignal(buffergeometry);
+
+    removeBuffers(buffergeometry);
+
+    auto wireframe = wireframeAttributes.find(buffergeometry.id);
+    if (wireframe != wireframeAttributes.end()) {
+      if(wireframe->second) _attributes.remove( *wireframe->second );
+      wireframeAttributes.erase(wireframe);
     }
   }
 
-  BufferAttributeT<uint32_t>::Ptr getWireframeAttribute(const BufferGeometry::Ptr geometry)
+  BufferAttributeT<uint32_t>::Ptr getWireframeAttribute(BufferGeometry *geometry)
   {
     BufferAttributeT<uint32_t>::Ptr attribute = wireframeAttributes[ geometry->id ];
 
@@ -161,6 +251,7 @@ public:
     _attributes.update(*indices, BufferType::ElementArray);
 
     wireframeAttributes[ geometry->id ] = indices;
+    wireframeUploads.insert(geometry->id);
 
     return indices;
   }
@@ -15,6 +15,13 @@ namespace gl {
 struct MemoryInfo {
   unsigned geomtries = 0;
   unsigned textures = 0;
+
+  //GPU memory held by textures and geometry buffers, see OpenGLRendererOptions::gpuMemoryBudget
+  size_t textureBytes = 0;
+  size_t bufferBytes = 0;
+
+  //textures and geometries evicted since the context was created
+  unsigned evictions = 0;
 };
 
 struct RenderInfo
@@ -24,6 +31,33 @@ struct RenderInfo
   unsigned  vertices = 0;
   unsigned  faces = 0;
   unsigned  points = 0;
+
+  //milliseconds the CPU spent waiting for the GPU during the last frame
+  float syncWait = 0;
+  //frames submitted but not yet known to be completed by the GPU
+  unsigned framesInFlight = 0;
+
+  //objects tested against the occlusion buffer during the last frame, and how many of them were culled
+  unsigned occlusionTested = 0;
+  unsigned occlusionCulled = 0;
+
+  //LOD objects evaluated during the last frame, per selected level, and how many changed level
+  std::vector<unsigned> lodLevels;
+  unsigned lodSwitches = 0;
+
+  //draws of the last shadow pass, and shadow maps kept from a previous frame (LightShadow::isStatic)
+  unsigned shadowCasters = 0;
+  unsigned shadowMapsCached = 0;
+
+  //programs loaded from the program binary cache, and programs that had to be built from source
+  //while the cache was enabled. Counted since the renderer was created
+  unsigned programCacheHits = 0;
+  unsigned programCacheMisses = 0;
+
+  //textures waiting for their image to be prepared or uploaded, and the bytes uploaded by the
+  //texture streamer during the last frame (OpenGLRendererOptions::textureThreads)
+  unsigned texturesQueued = 0;
+  size_t textureUploadBytes = 0;
 };
 
 struct Buffer
@@ -41,8 +75,15 @@ inline bool clear_glerror(QOpenGLFunctions *f)
   return hasErr;
 }
 
-inline void _check_glerror(QOpenGLFunctions *f, const char *file, int line)
+/**
+ * throw if GL reported an error
+ *
+ * @param validation the level in effect for the renderer issuing the calls. Checks only at Sync
+ */
+inline void _check_glerror(QOpenGLFunctions *f, Validation validation, const char *file, int line)
 {
+  if(validation != Validation::Sync) return;
+
   GLenum err = f->glGetError();
   if(err != GL_NO_ERROR) {
     std::stringstream ss;
@@ -54,10 +95,12 @@ inline void _check_glerror(QOpenGLFunctions *f, const char *file, int line)
     throw std::logic_error(ss.str());
   }
 }
-#define check_glerror(f) _check_glerror(f, __FILE__, __LINE__)
+#define check_glerror(f, validation) _check_glerror(f, validation, __FILE__, __LINE__)
 
-inline void _check_framebuffer(QOpenGLFunctions *f, const char *file, int line)
+inline void _check_framebuffer(QOpenGLFunctions *f, Validation validation, const char *file, int line)
 {
+  if(validation != Validation::Sync) return;
+
   GLenum status = f->glCheckFramebufferStatus(GL_FRAMEBUFFER);
   if(status != GL_FRAMEBUFFER_COMPLETE) {
     std::stringstream ss;
@@ -100,7 +143,7 @@ inline void _check_framebuffer(QOpenGLFunctions *f, const char *file, int line)
     throw std::logic_error(ss.str());
   }
 }
-#define check_framebuffer(f) _check_framebuffer(f, __FILE__, __LINE__)
+#define check_framebuffer(f, validation) _check_framebuffer(f, validation, __FILE__, __LINE__)
 
 }
 }
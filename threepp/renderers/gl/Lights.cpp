@@ -9,10 +9,15 @@ namespace gl {
 
 using namespace std;
 
-void Lights::setup(const vector<Light::Ptr> &lights, unsigned numShadows, Camera::Ptr camera )
+void Lights::setup(const vector<Light::Ptr> &lights, unsigned numShadows, Camera::Ptr camera, bool clustered)
 {
   Color ambient {0, 0, 0};
 
+  state.clear();
+  state.clustered = clustered;
+
+  bool cascadesTaken = false;
+
   const math::Matrix4 &viewMatrix = camera->matrixWorldInverse();
 
   for (Light::Ptr light : lights) {
@@ -35,7 +40,14 @@ void Lights::setup(const vector<Light::Ptr> &lights, unsigned numShadows, Camera
         uniforms->direction -= dlight->target()->matrixWorld().getPosition();
       uniforms->direction.transformDirection( viewMatrix );
 
-      uniforms->shadow = light->castShadow;
+      // the first light with cascades gets them, as in ShadowMap. Even if it has no shadow tile
+      const DirectionalLightShadow::Ptr shadow = dlight->shadow_t();
+      bool first = !cascadesTaken && light->castShadow && shadowMap && shadow->numCascades() > 1;
+      if(first) cascadesTaken = true;
+
+      bool cascaded = first && shadow->mapped();
+
+      uniforms->shadow = light->castShadow && !first && shadow->mapped();
 
       if (light->castShadow) {
 
@@ -44,9 +56,19 @@ void Lights::setup(const vector<Light::Ptr> &lights, unsigned numShadows, Camera
         uniforms->shadowMapSize = light->shadow()->mapSize();
       }
 
+      if(cascaded) {
+        state.cascades = shadow->numCascades();
+        state.cascadedLight = state.directional.size();
+
+        for(unsigned i = 0; i < state.cascades; i++)
+          state.directionalCascadeMatrix.push_back(shadow->cascadeMatrix(i));
+        state.directionalCascadeSplits = shadow->cascadeSplits();
+      }
+
       if(shadowMap) {
         state.directionalShadowMap.push_back(shadowMap);
         state.directionalShadowMatrix.push_back(light->shadow()->matrix());
+        state.directionalShadowTile.push_back(light->shadow()->tile());
       }
       state.directional.push_back(uniforms);
     }
@@ -67,7 +89,7 @@ void Lights::setup(const vector<Light::Ptr> &lights, unsigned numShadows, Camera
       uniforms->penumbraCos = cos( slight->angle() * ( 1 - slight->penumbra() ) );
       uniforms->decay = ( slight->distance() == 0 ) ? 0.0f : slight->decay();
 
-      uniforms->shadow = light->castShadow;
+      uniforms->shadow = light->castShadow && light->shadow()->mapped();
 
       if (light->castShadow) {
 
@@ -78,8 +100,14 @@ void Lights::setup(const vector<Light::Ptr> &lights, unsigned numShadows, Camera
         uniforms->shadowMapSize = shadow->mapSize();
       }
 
+      if(clustered && !light->castShadow && slight->distance() > 0) {
+        state.clusteredSpot.push_back(uniforms);
+        continue;
+      }
+
       state.spotShadowMap.push_back(shadowMap);
       state.spotShadowMatrix.push_back(light->shadow()->matrix());
+      state.spotShadowTile.push_back(light->shadow()->tile());
       state.spot.push_back(uniforms);
     }
     else if(RectAreaLight *rlight = light->typer) {
@@ -120,7 +148,7 @@ void Lights::setup(const vector<Light::Ptr> &lights, unsigned numShadows, Camera
       uniforms->distance = plight->distance();
       uniforms->decay = plight->decay();
 
-      uniforms->shadow = light->castShadow;
+      uniforms->shadow = light->castShadow && plight->shadow()->mapped();
 
       if (light->castShadow) {
 
@@ -133,8 +161,14 @@ void Lights::setup(const vector<Light::Ptr> &lights, unsigned numShadows, Camera
         uniforms->shadowCameraFar = shadow->camera()->far();
       }
 
+      if(clustered && !light->castShadow && plight->distance() > 0) {
+        state.clusteredPoint.push_back(uniforms);
+        continue;
+      }
+
       state.pointShadowMap.push_back(shadowMap);
       state.pointShadowMatrix.push_back(plight->shadow()->matrix());
+      state.pointShadowTile.push_back(plight->shadow()->tile());
       state.point.push_back(uniforms);
     }
     else if(HemisphereLight *hlight = light->typer) {
@@ -131,11 +131,19 @@ using CachedHemisphereLights = std::vector<lights::Entry<HemisphereLight>::Ptr>;
 struct LightsHash {
   unsigned directionalLength=0, pointLength=0, spotLength=0, rectAreaLength=0, hemiLength=0, shadowsLength=0;
 
+  //the number of clustered lights is not part of the hash
+  bool clustered = false;
+
+  //cascades of the cascaded directional light, and its index
+  unsigned cascades = 0, cascadedLight = 0;
+
   LightsHash() {}
   LightsHash(unsigned directionalLength, unsigned pointLength,
-             unsigned spotLength, unsigned rectAreaLength, unsigned hemiLength, unsigned shadowsLength)
+             unsigned spotLength, unsigned rectAreaLength, unsigned hemiLength, unsigned shadowsLength,
+             bool clustered, unsigned cascades, unsigned cascadedLight)
      : directionalLength(directionalLength), pointLength(pointLength), spotLength(spotLength),
-       rectAreaLength(rectAreaLength), hemiLength(hemiLength), shadowsLength(shadowsLength) {}
+       rectAreaLength(rectAreaLength), hemiLength(hemiLength), shadowsLength(shadowsLength), clustered(clustered),
+       cascades(cascades), cascadedLight(cascadedLight) {}
 
   bool operator ==(const LightsHash &other)
   {
@@ -144,7 +152,10 @@ struct LightsHash {
        spotLength == other.spotLength &&
        rectAreaLength == other.rectAreaLength &&
        hemiLength == other.hemiLength &&
-       shadowsLength == other.shadowsLength;
+       shadowsLength == other.shadowsLength &&
+       clustered == other.clustered &&
+       cascades == other.cascades &&
+       cascadedLight == other.cascadedLight;
   }
   bool operator !=(const LightsHash &other)
   {
@@ -159,22 +170,38 @@ struct Lights
     CachedDirectionalLights directional;
     std::vector<Texture::Ptr> directionalShadowMap;
     std::vector<math::Matrix4> directionalShadowMatrix;
+    std::vector<math::Vector4> directionalShadowTile;
+
+    //the directional light with a cascaded shadow, see DirectionalLightShadow::cascades. Its
+    //shadow map holds all cascades, and it is not shadowed through directionalShadowMatrix
+    unsigned cascades = 0;
+    unsigned cascadedLight = 0;
+    std::vector<math::Matrix4> directionalCascadeMatrix;
+    math::Vector4 directionalCascadeSplits;
 
     CachedSpotLights spot;
     std::vector<Texture::Ptr> spotShadowMap;
     std::vector<math::Matrix4> spotShadowMatrix;
+    std::vector<math::Vector4> spotShadowTile;
     CachedRectareaLights rectArea;
 
     CachedPointLights point;
     std::vector<Texture::Ptr> pointShadowMap;
     std::vector<math::Matrix4> pointShadowMatrix;
+    std::vector<math::Vector4> pointShadowTile;
 
     CachedHemisphereLights hemi;
     Color ambient = Color::null();
     LightsHash hash;
 
+    //point and spot lights without shadows, if clustered lighting is used. See Clusters
+    bool clustered = false;
+    CachedPointLights clusteredPoint;
+    CachedSpotLights clusteredSpot;
+
     void storeHash(unsigned numShadows) {
-      hash = LightsHash(directional.size(), point.size(), spot.size(), rectArea.size(), hemi.size(), numShadows);
+      hash = LightsHash(directional.size(), point.size(), spot.size(), rectArea.size(), hemi.size(), numShadows,
+                        clustered, cascades, cascadedLight);
     }
 
     void clear()
@@ -186,15 +213,27 @@ struct Lights
       hemi.clear();
       directionalShadowMap.clear();
       directionalShadowMatrix.clear();
+      directionalShadowTile.clear();
+      directionalCascadeMatrix.clear();
+      cascades = 0;
+      cascadedLight = 0;
       spotShadowMap.clear();
       spotShadowMatrix.clear();
+      spotShadowTile.clear();
       pointShadowMap.clear();
       pointShadowMatrix.clear();
+      pointShadowTile.clear();
+      clusteredPoint.clear();
+      clusteredSpot.clear();
     }
   } state;
 
 public:
-  void setup(const std::vector<Light::Ptr> &lights, unsigned numShadows, Camera::Ptr camera );
+  /**
+   * @param clustered move point and spot lights with a finite range and no shadow into the
+   * clustered lists
+   */
+  void setup(const std::vector<Light::Ptr> &lights, unsigned numShadows, Camera::Ptr camera, bool clustered=false);
 };
 
 }
@@ -9,6 +9,7 @@
 #include <threepp/core/Object3D.h>
 #include "Helpers.h"
 #include "Geometries.h"
+#include "Residency.h"
 
 namespace three {
 namespace gl {
@@ -19,27 +20,33 @@ class Objects
 
   Geometries &_geometries;
   RenderInfo &_infoRender;
+  Residency &_residency;
 
 public:
-  Objects(Geometries &geometries, RenderInfo &infoRender)
-     : _geometries(geometries), _infoRender(infoRender)
+  Objects(Geometries &geometries, RenderInfo &infoRender, Residency &residency)
+     : _geometries(geometries), _infoRender(infoRender), _residency(residency)
   {}
 
-  BufferGeometry::Ptr update(Object3D::Ptr object)
+  const BufferGeometry::Ptr &update(const Object3D::Ptr &object)
   {
     unsigned frame = _infoRender.frame;
 
-    Geometry::Ptr geometry = object->geometry();
-    BufferGeometry::Ptr buffergeometry = _geometries.get( object, geometry );
+    const Geometry::Ptr &geometry = object->geometry();
+    const BufferGeometry::Ptr &buffergeometry = _geometries.get( object, geometry );
 
     // Update once per frame
-    if (_updateList.count(buffergeometry->id) == 0 || _updateList[ buffergeometry->id] != frame ) {
+    auto found = _updateList.find(buffergeometry->id);
+    if (found == _updateList.end() || found->second != frame ) {
 
       LinearGeometry *linearGeom = geometry->typer;
       if (linearGeom) {
         buffergeometry->update( object, linearGeom );
       }
-      _geometries.update( buffergeometry );
+      //the size only needs to be recomputed after an upload
+      if(_geometries.update( buffergeometry ))
+        _residency.addGeometry( buffergeometry->id, _geometries.bytes(*buffergeometry) );
+      else
+        _residency.useGeometry( buffergeometry->id );
 
       _updateList[ buffergeometry->id ] = frame;
     }
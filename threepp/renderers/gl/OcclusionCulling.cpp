@@ -0,0 +1,276 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#include <cmath>
+#include <algorithm>
+#include <QDebug>
+#include "OcclusionCulling.h"
+
+namespace three {
+namespace gl {
+
+using namespace std;
+
+constexpr unsigned OcclusionCulling::width;
+constexpr unsigned OcclusionCulling::height;
+constexpr unsigned OcclusionCulling::band_height;
+
+//clip space w below which a vertex counts as behind the camera
+static const float near_w = 1e-5f;
+
+//pixel coordinates limited to [-1, size] before conversion, vertices close to w=0 project far out
+static int floorPixel(float v, unsigned size)
+{
+  return (int)floor(std::max(std::min(v, (float)size), -1.0f));
+}
+
+static int ceilPixel(float v, unsigned size)
+{
+  return (int)ceil(std::max(std::min(v, (float)size), -1.0f));
+}
+
+OcclusionCulling::OcclusionCulling() : _nextBand(0)
+{
+  for(unsigned w = width, h = height; w > 0 && h > 0; w /= 2, h /= 2) {
+    _levels.emplace_back(w * h, 1.0f);
+  }
+}
+
+void OcclusionCulling::begin(const math::Matrix4 &viewProjection)
+{
+  _viewProjection = viewProjection;
+  _triangles.clear();
+}
+
+void OcclusionCulling::addOccluder(const BufferGeometry &geometry, const math::Matrix4 &matrixWorld)
+{
+  const auto &position = geometry.position();
+  if(!position || position->itemSize() != 3) return;
+
+  math::Matrix4 matrix;
+  matrix.multiply(_viewProjection, matrixWorld);
+  const float *e = matrix.elements();
+
+  //transform all vertices to clip space: x, y, z, w
+  size_t vertexCount = position->itemCount();
+  const float *p = (const float *)position->data(0);
+
+  _clip.resize(vertexCount * 4);
+  float *clip = _clip.data();
+  for(size_t i = 0; i < vertexCount; i++, p += 3, clip += 4) {
+    clip[0] = e[0] * p[0] + e[4] * p[1] + e[8] * p[2] + e[12];
+    clip[1] = e[1] * p[0] + e[5] * p[1] + e[9] * p[2] + e[13];
+    clip[2] = e[2] * p[0] + e[6] * p[1] + e[10] * p[2] + e[14];
+    clip[3] = e[3] * p[0] + e[7] * p[1] + e[11] * p[2] + e[15];
+  }
+
+  const auto &index = geometry.index();
+  size_t count = index ? index->size() : vertexCount;
+  const uint32_t *indices = index ? (const uint32_t *)index->data(0) : nullptr;
+
+  for(size_t i = 0; i + 2 < count; i += 3) {
+    Triangle triangle;
+    bool valid = true;
+
+    for(unsigned v = 0; v < 3; v++) {
+      size_t vertex = indices ? indices[i + v] : i + v;
+      if(vertex >= vertexCount) {
+        if(!_indexWarning) qWarning() << "occluder index out of range, triangle skipped";
+        _indexWarning = true;
+        valid = false;
+        break;
+      }
+
+      const float *c = _clip.data() + vertex * 4;
+      if(c[3] < near_w) {
+        valid = false;
+        break;
+      }
+
+      //viewport coordinates, depth mapped to [0, 1]
+      triangle.x[v] = (c[0] / c[3] * 0.5f + 0.5f) * width;
+      triangle.y[v] = (c[1] / c[3] * 0.5f + 0.5f) * height;
+      triangle.z[v] = c[2] / c[3] * 0.5f + 0.5f;
+    }
+    if(!valid) continue;
+
+    triangle.minX = std::max(floorPixel(std::min({triangle.x[0], triangle.x[1], triangle.x[2]}), width), 0);
+    triangle.maxX = std::min(ceilPixel(std::max({triangle.x[0], triangle.x[1], triangle.x[2]}), width), (int)width - 1);
+    triangle.minY = std::max(floorPixel(std::min({triangle.y[0], triangle.y[1], triangle.y[2]}), height), 0);
+    triangle.maxY = std::min(ceilPixel(std::max({triangle.y[0], triangle.y[1], triangle.y[2]}), height), (int)height - 1);
+
+    if(triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) continue;
+
+    //in front of the near plane (not drawn by GL) or beyond the far plane
+    float nearest = std::min({triangle.z[0], triangle.z[1], triangle.z[2]});
+    if(nearest < 0.0f || nearest > 1.0f) continue;
+
+    _triangles.push_back(triangle);
+  }
+}
+
+void OcclusionCulling::rasterize(const Triangle &t, int rowBegin, int rowEnd)
+{
+  int minY = std::max(t.minY, rowBegin), maxY = std::min(t.maxY, rowEnd - 1);
+  if(minY > maxY) return;
+
+  float x0 = t.x[0], y0 = t.y[0];
+  float x1 = t.x[1], y1 = t.y[1];
+  float x2 = t.x[2], y2 = t.y[2];
+  float z0 = t.z[0], z1 = t.z[1], z2 = t.z[2];
+
+  float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+  if(fabs(area) < 1e-8f) return;
+
+  //both windings are occluders
+  if(area < 0) {
+    swap(x1, x2);
+    swap(y1, y2);
+    swap(z1, z2);
+    area = -area;
+  }
+
+  //edge functions, w_i(x, y) = a_i * x + b_i * y + c_i, positive inside
+  float a0 = y1 - y2, b0 = x2 - x1, c0 = x1 * y2 - x2 * y1;
+  float a1 = y2 - y0, b1 = x0 - x2, c1 = x2 * y0 - x0 * y2;
+  float a2 = y0 - y1, b2 = x1 - x0, c2 = x0 * y1 - x1 * y0;
+
+  //depth is linear in screen space
+  float za = (a0 * z0 + a1 * z1 + a2 * z2) / area;
+  float zb = (b0 * z0 + b1 * z1 + b2 * z2) / area;
+  float zc = (c0 * z0 + c1 * z1 + c2 * z2) / area;
+
+  vector<float> &depth = _levels.front();
+
+  for(int y = minY; y <= maxY; y++) {
+    float py = y + 0.5f, px = t.minX + 0.5f;
+
+    float w0 = a0 * px + b0 * py + c0;
+    float w1 = a1 * px + b1 * py + c1;
+    float w2 = a2 * px + b2 * py + c2;
+    float z = za * px + zb * py + zc;
+
+    float *row = depth.data() + y * width;
+
+    //branch free, so the compiler can vectorize
+    for(int x = t.minX; x <= t.maxX; x++) {
+      bool inside = w0 >= 0 && w1 >= 0 && w2 >= 0;
+      float current = row[x];
+      row[x] = inside && z < current ? z : current;
+
+      w0 += a0;
+      w1 += a1;
+      w2 += a2;
+      z += za;
+    }
+  }
+}
+
+void OcclusionCulling::rasterizeBands()
+{
+  const unsigned bands = (height + band_height - 1) / band_height;
+
+  for(unsigned band = _nextBand++; band < bands; band = _nextBand++) {
+    int rowBegin = band * band_height;
+    int rowEnd = std::min(rowBegin + (int)band_height, (int)height);
+
+    fill(_levels.front().begin() + rowBegin * width, _levels.front().begin() + rowEnd * width, 1.0f);
+
+    for(const Triangle &triangle : _triangles) {
+      if(triangle.maxY < rowBegin || triangle.minY >= rowEnd) continue;
+      rasterize(triangle, rowBegin, rowEnd);
+    }
+  }
+}
+
+void OcclusionCulling::buildPyramid()
+{
+  unsigned w = width, h = height;
+
+  for(size_t level = 1; level < _levels.size(); level++) {
+    const vector<float> &source = _levels[level - 1];
+    vector<float> &target = _levels[level];
+
+    unsigned sw = w;
+    w /= 2;
+    h /= 2;
+
+    for(unsigned y = 0; y < h; y++) {
+      const float *row0 = source.data() + 2 * y * sw;
+      const float *row1 = row0 + sw;
+
+      for(unsigned x = 0; x < w; x++) {
+        target[y * w + x] = std::max(std::max(row0[2 * x], row0[2 * x + 1]), std::max(row1[2 * x], row1[2 * x + 1]));
+      }
+    }
+  }
+}
+
+void OcclusionCulling::rasterize(WorkerPool &workers)
+{
+  _nextBand = 0;
+  workers.run([this]() {rasterizeBands();});
+
+  buildPyramid();
+}
+
+bool OcclusionCulling::visible(const math::Sphere &sphere) const
+{
+  if(sphere.isEmpty() || std::isinf(sphere.radius())) return true;
+  if(_triangles.empty()) return true;
+
+  const math::Vector3 &center = sphere.center();
+  float radius = sphere.radius();
+  const float *e = _viewProjection.elements();
+
+  float minX = numeric_limits<float>::infinity(), maxX = -minX;
+  float minY = minX, maxY = -minX;
+  float nearest = minX;
+
+  //project the corners of the box around the sphere
+  for(unsigned corner = 0; corner < 8; corner++) {
+    float x = center.x() + (corner & 1 ? radius : -radius);
+    float y = center.y() + (corner & 2 ? radius : -radius);
+    float z = center.z() + (corner & 4 ? radius : -radius);
+
+    float cw = e[3] * x + e[7] * y + e[11] * z + e[15];
+    if(cw < near_w) return true;
+
+    float cx = (e[0] * x + e[4] * y + e[8] * z + e[12]) / cw;
+    float cy = (e[1] * x + e[5] * y + e[9] * z + e[13]) / cw;
+    float cz = (e[2] * x + e[6] * y + e[10] * z + e[14]) / cw;
+
+    minX = std::min(minX, (cx * 0.5f + 0.5f) * width);
+    maxX = std::max(maxX, (cx * 0.5f + 0.5f) * width);
+    minY = std::min(minY, (cy * 0.5f + 0.5f) * height);
+    maxY = std::max(maxY, (cy * 0.5f + 0.5f) * height);
+    nearest = std::min(nearest, cz * 0.5f + 0.5f);
+  }
+
+  //one texel of slack, occluder edges are sampled at texel centers
+  int x0 = std::max(floorPixel(minX, width) - 1, 0), x1 = std::min(ceilPixel(maxX, width) + 1, (int)width - 1);
+  int y0 = std::max(floorPixel(minY, height) - 1, 0), y1 = std::min(ceilPixel(maxY, height) + 1, (int)height - 1);
+  if(x0 > x1 || y0 > y1) return true;
+
+  //coarsest level at which the bounds still cover a few texels
+  size_t level = 0;
+  unsigned w = width;
+  while(level + 1 < _levels.size() && (x1 - x0 > 3 || y1 - y0 > 3)) {
+    level++;
+    w /= 2;
+    x0 /= 2; x1 /= 2;
+    y0 /= 2; y1 /= 2;
+  }
+
+  const vector<float> &depth = _levels[level];
+  for(int y = y0; y <= y1; y++) {
+    for(int x = x0; x <= x1; x++) {
+      if(nearest <= depth[y * w + x]) return true;
+    }
+  }
+  return false;
+}
+
+}
+}
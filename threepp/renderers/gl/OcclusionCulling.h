@@ -0,0 +1,97 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_OCCLUSIONCULLING_H
+#define THREEPP_OCCLUSIONCULLING_H
+
+#include <vector>
+#include <atomic>
+#include <threepp/core/BufferGeometry.h>
+#include <threepp/math/Matrix4.h>
+#include <threepp/math/Sphere.h>
+#include "WorkerPool.h"
+
+namespace three {
+namespace gl {
+
+/**
+ * software occlusion culling. Occluder triangles are rasterized into a low resolution depth
+ * buffer, from which a hierarchical-Z pyramid (farthest depth per tile) is built. An object is
+ * occluded if the nearest point of its bounding box lies behind all pyramid tiles its screen
+ * bounds overlap.
+ *
+ * Rasterization is split into horizontal bands which are processed on the worker pool. There
+ * is no GL involved, so the class can be used without a context
+ */
+class OcclusionCulling
+{
+public:
+  static constexpr unsigned width = 256;
+  static constexpr unsigned height = 128;
+
+private:
+  static constexpr unsigned band_height = 8;
+
+  struct Triangle
+  {
+    float x[3], y[3], z[3];
+    int minX, maxX, minY, maxY;
+  };
+
+  math::Matrix4 _viewProjection;
+
+  std::vector<Triangle> _triangles;
+  std::vector<float> _clip;
+
+  //an occluder had indices beyond its vertices
+  bool _indexWarning = false;
+
+  //level 0 is the depth buffer, each further level halves the resolution
+  std::vector<std::vector<float>> _levels;
+  std::atomic<unsigned> _nextBand;
+
+  void rasterize(const Triangle &triangle, int rowBegin, int rowEnd);
+
+  void rasterizeBands();
+
+  void buildPyramid();
+
+public:
+  OcclusionCulling();
+
+  /**
+   * start a new frame
+   *
+   * @param viewProjection projection matrix * camera world inverse
+   */
+  void begin(const math::Matrix4 &viewProjection);
+
+  /**
+   * add the triangles of an occluder. Triangles crossing the near plane are dropped, which can
+   * only make the culling less effective, never wrong
+   */
+  void addOccluder(const BufferGeometry &geometry, const math::Matrix4 &matrixWorld);
+
+  size_t triangleCount() const {return _triangles.size();}
+
+  /**
+   * rasterize the occluders and build the depth pyramid
+   */
+  void rasterize(WorkerPool &workers);
+
+  /**
+   * @param sphere bounds in world space
+   * @return false if the sphere is completely hidden by the occluders
+   */
+  bool visible(const math::Sphere &sphere) const;
+
+  /**
+   * @return the depth buffer, width x height values in [0, 1], 1 being the far plane
+   */
+  const std::vector<float> &depthBuffer() const {return _levels.front();}
+};
+
+}
+}
+#endif //THREEPP_OCCLUSIONCULLING_H
@@ -0,0 +1,261 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_PARALLELPROJECTION_H
+#define THREEPP_PARALLELPROJECTION_H
+
+#include <vector>
+#include <atomic>
+#include <threepp/core/Object3D.h>
+#include <threepp/objects/Sprite.h>
+#include <threepp/objects/LensFlare.h>
+#include <threepp/objects/ImmediateRenderObject.h>
+#include <threepp/objects/Mesh.h>
+#include <threepp/objects/InstancedMesh.h>
+#include <threepp/objects/Line.h>
+#include <threepp/objects/Points.h>
+#include <threepp/objects/LOD.h>
+#include <threepp/math/Frustum.h>
+#include "WorkerPool.h"
+
+namespace three {
+namespace gl {
+
+/**
+ * layer and frustum culling of the scene graph on a pool of worker threads.
+ *
+ * The graph is split into subtrees which the workers (and the calling thread) pick up one at a
+ * time. Each subtree produces its own list of objects that passed culling. The lists are visited
+ * in depth-first order, so the result is identical to a sequential traversal regardless of which
+ * thread processed which subtree.
+ *
+ * Workers only read the scene graph. Geometry updates, skeleton updates and anything else that
+ * touches GL or shared state are left to the caller, which runs on the GL thread
+ */
+class ParallelProjection
+{
+public:
+  enum class Kind {Sprite, LensFlare, Immediate, Renderable, LOD};
+
+  struct Projected
+  {
+    const Object3D::Ptr *object;
+    Kind kind;
+    float z;
+
+    //the bounding sphere was not computed yet, so the frustum test must be done by the caller
+    bool cullPending;
+  };
+
+private:
+  struct Task
+  {
+    const Object3D::Ptr *object;
+    bool recurse;
+    bool insideFrustum;
+    std::vector<Projected> projected;
+  };
+
+  //aim for this many subtrees per thread, to even out unbalanced graphs
+  static constexpr unsigned tasks_per_thread = 8;
+  static constexpr unsigned max_split_depth = 6;
+
+  //task slots are reused across frames, so the result vectors keep their capacity
+  std::vector<Task> _tasks;
+  size_t _taskCount = 0;
+  std::atomic<size_t> _nextTask;
+
+  WorkerPool &_workers;
+
+  //input for the current frame
+  const math::Frustum *_frustum = nullptr;
+  const math::Matrix4 *_projScreenMatrix = nullptr;
+  const Camera *_camera = nullptr;
+  Layers _layers;
+  bool _sortObjects = true;
+
+  Task &addTask(const Object3D::Ptr &object, bool recurse, bool insideFrustum)
+  {
+    if(_taskCount == _tasks.size()) _tasks.emplace_back();
+
+    Task &task = _tasks[_taskCount++];
+    task.object = &object;
+    task.recurse = recurse;
+    task.insideFrustum = insideFrustum;
+    task.projected.clear();
+    return task;
+  }
+
+  /**
+   * collect subtree roots down to the given depth. Nodes above that depth become
+   * non-recursive tasks, which preserves the depth-first order of the result
+   */
+  void split(const Object3D::Ptr &object, unsigned depth, bool insideFrustum)
+  {
+    if (!object->visible() || !testBounds(*object, insideFrustum)) return;
+
+    //levels are selected by the task which projects the LOD
+    if(depth == 0 || object->children().empty() || object->is<LOD>()) {
+      addTask(object, true, insideFrustum);
+      return;
+    }
+
+    addTask(object, false, insideFrustum);
+    for (const Object3D::Ptr &child : object->children()) {
+      split(child, depth - 1, insideFrustum);
+    }
+  }
+
+  /**
+   * subtree bounds test, see Object3D::subtreeCulling
+   *
+   * @return false if the subtree can be skipped
+   */
+  bool testBounds(const Object3D &object, bool &insideFrustum)
+  {
+    if (insideFrustum || !object.hasSubtreeBounds()) return true;
+
+    const math::Sphere &bounds = object.subtreeBoundingSphere();
+    if (bounds.isEmpty() || !_frustum->intersectsSphere(bounds)) return false;
+
+    insideFrustum = _frustum->containsSphere(bounds);
+    return true;
+  }
+
+  float depthOf(const Object3D &object)
+  {
+    if(!_sortObjects) return 0;
+
+    math::Vector3 position = object.matrixWorld().getPosition().apply(*_projScreenMatrix);
+    return position.z();
+  }
+
+  /**
+   * same tests as Renderer_impl::projectObject, but without side effects apart from the LOD level
+   * selection. The lazy bounding sphere computation of Frustum::intersectsObject would be a data
+   * race if a geometry is shared between subtrees, hence it is deferred to the caller
+   */
+  void project(const Object3D::Ptr &object, bool recurse, bool insideFrustum, std::vector<Projected> &projected)
+  {
+    if (!object->visible()) return;
+
+    if (!testBounds(*object, insideFrustum)) return;
+
+    //each LOD is visited by a single task, so the level state is not shared
+    LOD *lod = object->typer;
+    if(lod) {
+      lod->update(*_camera);
+      projected.push_back({&object, Kind::LOD, 0, false});
+    }
+
+    if (object->layers().test(_layers)) {
+
+      if(Sprite *sprite = object->typer) {
+
+        if ( ! sprite->frustumCulled || insideFrustum || _frustum->intersectsSprite(*sprite) ) {
+          projected.push_back({&object, Kind::Sprite, 0, false});
+        }
+      }
+      else if(object->is<LensFlare>()) {
+
+        projected.push_back({&object, Kind::LensFlare, 0, false});
+      }
+      else if(object->is<ImmediateRenderObject>()) {
+
+        projected.push_back({&object, Kind::Immediate, depthOf(*object), false});
+      }
+      else if(object->is<Mesh>() || object->is<Line>() || object->is<Points>()) {
+
+        if(!object->frustumCulled || insideFrustum) {
+          projected.push_back({&object, Kind::Renderable, depthOf(*object), false});
+        }
+        else {
+          const Geometry::Ptr &geometry = object->geometry();
+          InstancedMesh *instanced = object->typer;
+
+          if(instanced) {
+            //instance bounds are computed lazily as well
+            projected.push_back({&object, Kind::Renderable, depthOf(*object), true});
+          }
+          else if(geometry->boundingSphere().isEmpty()) {
+            projected.push_back({&object, Kind::Renderable, depthOf(*object), true});
+          }
+          else {
+            math::Sphere sphere = geometry->boundingSphere();
+            sphere.apply(object->matrixWorld());
+
+            if(_frustum->intersectsSphere(sphere))
+              projected.push_back({&object, Kind::Renderable, depthOf(*object), false});
+          }
+        }
+      }
+    }
+
+    if(recurse) {
+      for (const Object3D::Ptr &child : object->children()) {
+
+        if(lod && lod->skipped(child.get())) continue;
+
+        project(child, true, insideFrustum, projected);
+      }
+    }
+  }
+
+  void runTasks()
+  {
+    for(size_t index = _nextTask++; index < _taskCount; index = _nextTask++) {
+      Task &task = _tasks[index];
+      project(*task.object, task.recurse, task.insideFrustum, task.projected);
+    }
+  }
+
+public:
+  explicit ParallelProjection(WorkerPool &workers) : _nextTask(0), _workers(workers) {}
+
+  /**
+   * cull the graph below root. Returns when all subtrees have been processed
+   */
+  void project(const Object3D::Ptr &root,
+               const math::Frustum &frustum,
+               const math::Matrix4 &projScreenMatrix,
+               const Camera &camera,
+               bool sortObjects)
+  {
+    _frustum = &frustum;
+    _projScreenMatrix = &projScreenMatrix;
+    _camera = &camera;
+    _layers = camera.layers();
+    _sortObjects = sortObjects;
+
+    size_t minTasks = _workers.threads() * tasks_per_thread;
+
+    _taskCount = 0;
+    for(unsigned depth = 1; depth <= max_split_depth; depth++) {
+      size_t previous = _taskCount;
+
+      _taskCount = 0;
+      split(root, depth, false);
+
+      if(_taskCount >= minTasks || _taskCount == previous) break;
+    }
+    _nextTask = 0;
+
+    _workers.run([this]() {runTasks();});
+  }
+
+  /**
+   * visit the culling results in depth-first scene graph order
+   */
+  template <typename F>
+  void forEach(F f) const
+  {
+    for(size_t i = 0; i < _taskCount; i++) {
+      for(const Projected &projected : _tasks[i].projected) f(projected);
+    }
+  }
+};
+
+}
+}
+#endif //THREEPP_PARALLELPROJECTION_H
@@ -6,9 +6,14 @@
 #include <fstream>
 #include <sstream>
 #include <regex>
+#include <map>
+#include <tuple>
+#include <mutex>
 #include <threepp/util/impl/utils.h>
 #include "Program.h"
 #include "Renderer_impl.h"
+#include "UniformBlocks.h"
+#include "Clusters.h"
 #include "shader/ShaderChunk.h"
 
 #include <QStandardPaths>
@@ -119,6 +124,30 @@ string generateDefines(unordered_map<string, string> defines)
   return ss.str();
 }
 
+/**
+ * per-camera values shared by all programs, see UniformBlocks::setCamera
+ */
+void cameraBlock(stringstream &ss)
+{
+  ss << "layout(std140) uniform Camera {" << endl;
+  ss << "	mat4 projectionMatrix;" << endl;
+  ss << "	mat4 viewMatrix;" << endl;
+  ss << "	vec3 cameraPosition;" << endl;
+  ss << "	float toneMappingExposure;" << endl;
+  ss << "	float toneMappingWhitePoint;" << endl;
+  ss << "	float logDepthBufFC;" << endl;
+  ss << "};" << endl;
+}
+
+void clusterDefines(stringstream &ss)
+{
+  ss << "#define USE_CLUSTERED_LIGHTS" << endl;
+  ss << "#define CLUSTER_GRID_X " << Clusters::grid_x << endl;
+  ss << "#define CLUSTER_GRID_Y " << Clusters::grid_y << endl;
+  ss << "#define CLUSTER_GRID_Z " << Clusters::grid_z << endl;
+  ss << "#define CLUSTER_TEXTURE_WIDTH " << Clusters::texture_width << endl;
+}
+
 struct AttribInfo
 {
   GLsizei length;
@@ -138,7 +167,7 @@ void Program::fetchAttributeLocations(enum_map<AttributeName, GLint> &attributes
 {
   GLint numActive;
   _renderer.glGetProgramiv(_program, GL_ACTIVE_ATTRIBUTES, &numActive);
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 
   attributes.erase(AttributeName::unknown);
 
@@ -146,7 +175,7 @@ void Program::fetchAttributeLocations(enum_map<AttributeName, GLint> &attributes
   for (unsigned i = 0; i < numActive; i++) {
 
     _renderer.glGetActiveAttrib(_program, i, 100, &info.length, &info.size, &info.type, info.name);
-    check_glerror(&_renderer);
+    check_glerror(&_renderer, _renderer.validationLevel());
 
     GLint mnIndex = -1;
     GLint mtIndex = findIndexed(info.name, "morphTarget");
@@ -179,10 +208,19 @@ void Program::fetchAttributeLocations(enum_map<AttributeName, GLint> &attributes
     else if(!strncmp(info.name, "normal", 100)) {
       attributes[AttributeName::normal] = _renderer.glGetAttribLocation(_program, info.name);
     }
+    else if(!strncmp(info.name, "instanceModelMatrix", 100)) {
+      _instanceModelMatrix = _renderer.glGetAttribLocation(_program, info.name);
+    }
+    else if(!strncmp(info.name, "instanceNormalMatrix", 100)) {
+      _instanceNormalMatrix = _renderer.glGetAttribLocation(_program, info.name);
+    }
+    else if(!strncmp(info.name, "instanceColor", 100)) {
+      _instanceColor = _renderer.glGetAttribLocation(_program, info.name);
+    }
     else {
       throw std::logic_error("unknown attribute");
     }
-    check_glerror(&_renderer);
+    check_glerror(&_renderer, _renderer.validationLevel());
   }
 }
 
@@ -261,6 +299,29 @@ string unrollLoops(const string &glsl)
   return unroll.str();
 }
 
+string libraryShader(const char *source, GLenum type, const ProgramParameters &parameters)
+{
+  // library shaders have their includes resolved at build time (see ShaderSources.h), and only
+  // vary with the light counts the loops are unrolled for
+  using Key = tuple<ShaderID, GLenum, size_t, size_t, size_t, size_t, size_t>;
+
+  static mutex cacheMutex;
+  static map<Key, string> cache;
+
+  Key key(*parameters.shaderID, type, *parameters.numDirLights, *parameters.numSpotLights,
+          *parameters.numRectAreaLights, *parameters.numPointLights, *parameters.numHemiLights);
+
+  lock_guard<mutex> lock(cacheMutex);
+
+  auto found = cache.find(key);
+  if(found != cache.end()) return found->second;
+
+  string glsl = unrollLoops( replaceLightNums( source, parameters ));
+  cache.emplace(key, glsl);
+
+  return glsl;
+}
+
 enum class InfoObject {program, shader};
 string getInfoLog(QOpenGLFunctions *f, InfoObject obj, GLuint handle)
 {
@@ -284,7 +345,7 @@ string getInfoLog(QOpenGLFunctions *f, InfoObject obj, GLuint handle)
   return info;
 }
 
-GLuint createShader(QOpenGLFunctions *f, GLenum type, string glsl)
+GLuint createShader(QOpenGLFunctions *f, GLenum type, const string &glsl)
 {
   GLuint shader = f->glCreateShader( type );
 
@@ -292,6 +353,11 @@ GLuint createShader(QOpenGLFunctions *f, GLenum type, string glsl)
   f->glShaderSource( shader, 1, &source, nullptr);
   f->glCompileShader( shader );
 
+  return shader;
+}
+
+void checkShader(QOpenGLFunctions *f, GLenum type, GLuint shader, const string &glsl)
+{
   GLint value;
   f->glGetShaderiv( shader, GL_COMPILE_STATUS, &value);
 
@@ -311,14 +377,11 @@ GLuint createShader(QOpenGLFunctions *f, GLenum type, string glsl)
   }
   // --enable-privileged-webgl-extension
   // console.log( type, gl.getExtension( 'WEBGL_debug_shaders' ).getTranslatedShaderSource( shader ) );
-
-  return shader;
-
 }
 
 Program::Program(Renderer_impl &renderer,
                  Extensions &extensions,
-                 const Material::Ptr &material,
+                 const Material *material,
                  Shader &shader,
                  ProgramParameters::Ptr parameters )
    : parameters(parameters), _renderer(renderer), _cachedAttributes({make_pair(AttributeName::unknown, 0)})
@@ -464,6 +527,11 @@ Program::Program(Renderer_impl &renderer,
 
     if(*parameters->shadowMapEnabled) {
       ss << "#define USE_SHADOWMAP" << endl << "#define " << shadowMapTypeDefine << endl;
+
+      if(*parameters->dirCascades > 1) {
+        ss << "#define DIR_CASCADES " << *parameters->dirCascades << endl;
+        ss << "#define CASCADED_LIGHT " << *parameters->cascadedLight << endl;
+      }
     }
 
     if(*parameters->sizeAttenuation) ss << "#define USE_SIZEATTENUATION" << endl;
@@ -471,12 +539,24 @@ Program::Program(Renderer_impl &renderer,
     if(*parameters->logarithmicDepthBuffer) ss << "#define USE_LOGDEPTHBUF" << endl;
     if(*parameters->logarithmicDepthBuffer && extensions.get(Extension::EXT_frag_depth)) ss << "#define USE_LOGDEPTHBUF_EXT" << endl;
 
+    if(*parameters->instancedTransform) ss << "#define USE_INSTANCED_TRANSFORM" << endl;
+    if(*parameters->instanceColor) ss << "#define USE_INSTANCE_COLOR" << endl;
+
     ss << "uniform mat4 modelMatrix;" << endl;
     ss << "uniform mat4 modelViewMatrix;" << endl;
-    ss << "uniform mat4 projectionMatrix;" << endl;
-    ss << "uniform mat4 viewMatrix;" << endl;
     ss << "uniform mat3 normalMatrix;" << endl;
-    ss << "uniform vec3 cameraPosition;" << endl;
+
+    if(*parameters->uniformBlocks) {
+      ss << "#define USE_UNIFORM_BLOCKS" << endl;
+      cameraBlock(ss);
+    }
+    else {
+      ss << "uniform mat4 projectionMatrix;" << endl;
+      ss << "uniform mat4 viewMatrix;" << endl;
+      ss << "uniform vec3 cameraPosition;" << endl;
+    }
+
+    if(*parameters->clusteredLights) clusterDefines(ss);
 
     ss << "in vec3 position;" << endl;
     ss << "in vec3 normal;" << endl;
@@ -520,6 +600,19 @@ Program::Program(Renderer_impl &renderer,
 
     ss << "#endif" << endl;
 
+    ss << "#ifdef USE_INSTANCED_TRANSFORM" << endl;
+
+    ss << "	in mat4 instanceModelMatrix;" << endl;
+    ss << "	in mat3 instanceNormalMatrix;" << endl;
+
+    ss << "#endif" << endl;
+
+    ss << "#ifdef USE_INSTANCE_COLOR" << endl;
+
+    ss << "	in vec3 instanceColor;" << endl;
+
+    ss << "#endif" << endl;
+
     prefixVertex = ss.str();
 
     ss.seekp(stringstream::beg);
@@ -564,7 +657,7 @@ Program::Program(Renderer_impl &renderer,
     if(*parameters->roughnessMap) ss << "#define USE_ROUGHNESSMAP" << endl;
     if(*parameters->metalnessMap) ss << "#define USE_METALNESSMAP" << endl;
     if(*parameters->alphaMap) ss << "#define USE_ALPHAMAP" << endl;
-    if(*parameters->vertexColors != Colors::None) ss << "#define USE_COLOR" << endl;
+    if(*parameters->vertexColors != Colors::None || *parameters->instanceColor) ss << "#define USE_COLOR" << endl;
 
     if(*parameters->gradientMap) ss << "#define USE_GRADIENTMAP" << endl;
 
@@ -578,6 +671,13 @@ Program::Program(Renderer_impl &renderer,
 
     if(*parameters->shadowMapEnabled) {
       ss << "#define USE_SHADOWMAP" << endl << "#define " << shadowMapTypeDefine << endl;
+
+      if(*parameters->dirCascades > 1) {
+        ss << "#define DIR_CASCADES " << *parameters->dirCascades << endl;
+        ss << "#define CASCADED_LIGHT " << *parameters->cascadedLight << endl;
+      }
+
+      if(*parameters->shadowMapAtlas) ss << "#define SHADOWMAP_ATLAS" << endl;
     }
 
     if(*parameters->premultipliedAlpha) ss << "#define PREMULTIPLIED_ALPHA" << endl;
@@ -589,8 +689,21 @@ Program::Program(Renderer_impl &renderer,
 
     if(*parameters->envMap && extensions.get(Extension::EXT_shader_texture_lod)) ss << "#define TEXTURE_LOD_EXT" << endl;
 
-    ss << "uniform mat4 viewMatrix;" << endl;
-    ss << "uniform vec3 cameraPosition;" << endl;
+    if(*parameters->uniformBlocks) {
+      ss << "#define USE_UNIFORM_BLOCKS" << endl;
+      cameraBlock(ss);
+    }
+    else {
+      ss << "uniform mat4 viewMatrix;" << endl;
+      ss << "uniform vec3 cameraPosition;" << endl;
+    }
+
+    if(*parameters->clusteredLights) {
+      clusterDefines(ss);
+
+      //the cluster lookup projects the fragment position
+      if(!*parameters->uniformBlocks) ss << "uniform mat4 projectionMatrix;" << endl;
+    }
 
     if(( *parameters->toneMapping != ToneMapping::None)) {
       ss << "#define TONE_MAPPING" << endl;
@@ -625,16 +738,19 @@ Program::Program(Renderer_impl &renderer,
     prefixFragment = ss.str();
   }
 
-  string vertexShader = parseIncludes( shader.vertexShader() );
-  vertexShader = replaceLightNums( vertexShader, *parameters );
-
-  string fragmentShader = parseIncludes( shader.fragmentShader() );
-  fragmentShader = replaceLightNums( fragmentShader, *parameters );
+  string vertexShader, fragmentShader;
 
   if (parameters->shaderMaterial == ShaderMaterialKind::none) {
 
-    vertexShader = unrollLoops( vertexShader );
-    fragmentShader = unrollLoops( fragmentShader );
+    vertexShader = libraryShader( shader.vertexShader(), GL_VERTEX_SHADER, *parameters );
+    fragmentShader = libraryShader( shader.fragmentShader(), GL_FRAGMENT_SHADER, *parameters );
+  }
+  else {
+    vertexShader = parseIncludes( shader.vertexShader() );
+    vertexShader = replaceLightNums( vertexShader, *parameters );
+
+    fragmentShader = parseIncludes( shader.fragmentShader() );
+    fragmentShader = replaceLightNums( fragmentShader, *parameters );
   }
 
   string vertexGlsl = prefixVertex + vertexShader;
@@ -646,38 +762,68 @@ Program::Program(Renderer_impl &renderer,
   vertex << vertexGlsl.c_str();
   vertex.close();
 #endif
-  GLuint glVertexShader = createShader(&_renderer, GL_VERTEX_SHADER, vertexGlsl );
-  GLuint glFragmentShader = createShader(&_renderer, GL_FRAGMENT_SHADER, fragmentGlsl );
+  // Force a particular attribute to index 0.
+  // programs with morphTargets displace position out of attribute 0. Per-instance
+  // attributes must not occupy it either, since they are not always enabled as arrays
+  string index0Attribute = parameters->index0AttributeName;
+  if(index0Attribute.empty() && (*parameters->morphTargets || *parameters->instancedTransform))
+    index0Attribute = "position";
+
+  ProgramCache &cache = _renderer._programCache;
+  string cacheKey;
+  bool cached = false;
+
+  if(cache.enabled()) {
+    cacheKey = cache.key(vertexGlsl, fragmentGlsl, index0Attribute);
+    cached = cache.load(cacheKey, _program);
+  }
+
+  if(cached) {
+    finish();
+    return;
+  }
 
-  _renderer.glAttachShader( _program, glVertexShader );
-  _renderer.glAttachShader( _program, glFragmentShader );
-  check_glerror(&_renderer);
+  _vertexShader = createShader(&_renderer, GL_VERTEX_SHADER, vertexGlsl );
+  _fragmentShader = createShader(&_renderer, GL_FRAGMENT_SHADER, fragmentGlsl );
 
-  // Force a particular attribute to index 0.
+  _renderer.glAttachShader( _program, _vertexShader );
+  _renderer.glAttachShader( _program, _fragmentShader );
+  check_glerror(&_renderer, _renderer.validationLevel());
 
-  if (!parameters->index0AttributeName.empty()) {
+  if (!index0Attribute.empty()) {
 
-    _renderer.glBindAttribLocation( _program, 0, parameters->index0AttributeName.data());
+    _renderer.glBindAttribLocation( _program, 0, index0Attribute.data());
   }
-  else if (*parameters->morphTargets) {
+  check_glerror(&_renderer, _renderer.validationLevel());
 
-    // programs with morphTargets displace position out of attribute 0
-    _renderer.glBindAttribLocation( _program, 0, "position" );
-  }
-  check_glerror(&_renderer);
+  if(cache.enabled()) cache.prepare(_program);
 
   _renderer.glLinkProgram( _program );
 
+  _linking = true;
+  _vertexGlsl = move(vertexGlsl);
+  _fragmentGlsl = move(fragmentGlsl);
+  _cacheKey = move(cacheKey);
+
+  // with parallel compilation, the results are collected once the driver reports completion
+  if(!_renderer._parallelCompile) finish();
+}
+
+void Program::finishLink()
+{
+  checkShader(&_renderer, GL_VERTEX_SHADER, _vertexShader, _vertexGlsl);
+  checkShader(&_renderer, GL_FRAGMENT_SHADER, _fragmentShader, _fragmentGlsl);
+
   string programLog = getInfoLog(&_renderer, InfoObject::program, _program );
 
 #if 0
   GLsizei len;
   char buf[100000];
   ofstream of1("vertex.glsl", ios_base::app);
-  _renderer.glGetShaderSource(glVertexShader, 100000, &len, buf);
+  _renderer.glGetShaderSource(_vertexShader, 100000, &len, buf);
   of1 << buf;
   ofstream of2("fragment.glsl", ios_base::app);
-  _renderer.glGetShaderSource(glFragmentShader, 100000, &len, buf);
+  _renderer.glGetShaderSource(_fragmentShader, 100000, &len, buf);
   of2 << buf;
 #endif
 
@@ -696,16 +842,48 @@ Program::Program(Renderer_impl &renderer,
   }
   else if ( !programLog.empty()) cerr << programLog << endl;
 
-  fetchAttributeLocations(_cachedAttributes, _cachedIndexedAttributes);
-  check_glerror(&_renderer);
+  ProgramCache &cache = _renderer._programCache;
+  if(cache.enabled()) cache.store(_cacheKey, _program);
 
            // clean up
-  _renderer.glDeleteShader( glVertexShader );
-  _renderer.glDeleteShader( glFragmentShader );
+  _renderer.glDeleteShader( _vertexShader );
+  _renderer.glDeleteShader( _fragmentShader );
+  _vertexShader = _fragmentShader = 0;
+
+  _vertexGlsl.clear();
+  _fragmentGlsl.clear();
+  _linking = false;
+}
+
+void Program::finish()
+{
+  // a failed link throws again on every attempt
+  if(_linking) finishLink();
+
+  if(*parameters->uniformBlocks) UniformBlocks::bind(&_renderer, _program);
+  if(*parameters->clusteredLights) Clusters::bind(&_renderer, _program, _renderer._capabilities.maxTextures);
+
+  fetchAttributeLocations(_cachedAttributes, _cachedIndexedAttributes);
+  check_glerror(&_renderer, _renderer.validationLevel());
+
+  _ready = true;
+}
+
+bool Program::ready()
+{
+  if(_ready) return true;
+
+  GLint completed = GL_TRUE;
+  if(_linking) _renderer.glGetProgramiv(_program, GL_COMPLETION_STATUS_KHR, &completed);
+
+  if(completed == GL_TRUE) finish();
+  return _ready;
 }
 
 Uniforms::Ptr Program::getUniforms()
 {
+  if(!_ready) finish();
+
   if (_cachedUniforms == nullptr) {
     _cachedUniforms = Uniforms::make(_renderer, _program);
   }
@@ -715,6 +893,8 @@ Uniforms::Ptr Program::getUniforms()
 
 const enum_map<AttributeName, GLint> &Program::getAttributes()
 {
+  if(!_ready) finish();
+
   if(_cachedAttributes.count(AttributeName::unknown) == 1)
     fetchAttributeLocations(_cachedAttributes, _cachedIndexedAttributes);
 
@@ -723,6 +903,8 @@ const enum_map<AttributeName, GLint> &Program::getAttributes()
 
 const std::unordered_map<IndexedAttributeKey, GLint> &Program::getIndexedAttributes()
 {
+  if(!_ready) finish();
+
   if(_cachedAttributes.count(AttributeName::unknown) == 1)
     fetchAttributeLocations(_cachedAttributes, _cachedIndexedAttributes);
 
@@ -730,6 +912,8 @@ const std::unordered_map<IndexedAttributeKey, GLint> &Program::getIndexedAttribu
 }
 
 Program::~Program() {
+  if(_vertexShader) _renderer.glDeleteShader(_vertexShader);
+  if(_fragmentShader) _renderer.glDeleteShader(_fragmentShader);
   _renderer.glDeleteProgram(_program);
   _program = 0;
 }
@@ -22,6 +22,10 @@
 #include "Uniforms.h"
 #include "Attributes.h"
 
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR          0x91B1
+#endif
+
 namespace three {
 
 namespace gl {
@@ -244,6 +248,13 @@ public:
   ProgramParameterT<bool>            doubleSided {all};
   ProgramParameterT<bool>            flipSided {all};
   ProgramParameterT<DepthPacking>    depthPacking {all};
+  ProgramParameterT<bool>            instancedTransform {all};
+  ProgramParameterT<bool>            instanceColor {all};
+  ProgramParameterT<bool>            uniformBlocks {all};
+  ProgramParameterT<bool>            clusteredLights {all};
+  ProgramParameterT<size_t>          dirCascades {all};
+  ProgramParameterT<size_t>          cascadedLight {all};
+  ProgramParameterT<bool>            shadowMapAtlas {all};
   ProgramParameterT<std::unordered_map<std::string, std::string>> defines {all};
 
   ShaderMaterialKind shaderMaterial = ShaderMaterialKind::none;
@@ -322,19 +333,33 @@ private:
   enum_map<AttributeName, GLint> _cachedAttributes;
   std::unordered_map<IndexedAttributeKey, GLint> _cachedIndexedAttributes;
 
+  GLint _instanceModelMatrix = -1;
+  GLint _instanceNormalMatrix = -1;
+  GLint _instanceColor = -1;
+
+  //build state. While the driver is linking, the shaders and sources are kept for error reporting
+  bool _ready = false;
+  bool _linking = false;
+  GLuint _vertexShader = 0, _fragmentShader = 0;
+  std::string _vertexGlsl, _fragmentGlsl, _cacheKey;
+
   void fetchAttributeLocations(enum_map<AttributeName, GLint> &attributes,
                                std::unordered_map<IndexedAttributeKey, GLint> &indexedAttributes);
 
+  void finishLink();
+
+  void finish();
+
   Program(Renderer_impl &renderer,
           Extensions &extensions,
-          const Material::Ptr &material,
+          const Material *material,
           Shader &shader,
           ProgramParameters::Ptr parameters);
 
 public:
   static Ptr make(Renderer_impl &renderer,
                   Extensions &extensions,
-                  const Material::Ptr material,
+                  const Material *material,
                   Shader &shader,
                   const ProgramParameters::Ptr parameters)
   {
@@ -345,6 +370,14 @@ public:
 
   GLuint handle() const { return _program; }
 
+  /**
+   * @return true if the program is built. With parallel shader compilation (see
+   * OpenGLRendererOptions::asyncCompile), the driver links in the background and this polls the
+   * completion status without blocking. Otherwise, programs are ready when constructed. Accessing
+   * the uniforms or attributes of a program that is not ready waits for the build to complete
+   */
+  bool ready();
+
   Renderer_impl &renderer() {return _renderer;}
 
   const ProgramParameters::Ptr parameters;
@@ -354,6 +387,23 @@ public:
   const enum_map<AttributeName, GLint> &getAttributes();
 
   const std::unordered_map<IndexedAttributeKey, GLint> &getIndexedAttributes();
+
+  /**
+   * first of the 4 locations of the per-instance model matrix (USE_INSTANCED_TRANSFORM),
+   * or -1 if not used by this program
+   */
+  GLint instanceModelMatrix() const {return _instanceModelMatrix;}
+
+  /**
+   * first of the 3 locations of the per-instance normal matrix (USE_INSTANCED_TRANSFORM),
+   * or -1 if not used by this program
+   */
+  GLint instanceNormalMatrix() const {return _instanceNormalMatrix;}
+
+  /**
+   * location of the per-instance color (USE_INSTANCE_COLOR), or -1 if not used by this program
+   */
+  GLint instanceColor() const {return _instanceColor;}
 };
 
 }
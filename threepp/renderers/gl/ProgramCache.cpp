@@ -0,0 +1,205 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#include "ProgramCache.h"
+#include <cstring>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QDebug>
+
+namespace three {
+namespace gl {
+
+using namespace std;
+
+namespace {
+
+const char binary_suffix[] = ".bin";
+
+struct Header
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t format;
+  uint32_t length;
+};
+
+const char header_magic[4] = {'T', 'P', 'P', 'B'};
+const uint32_t header_version = 1;
+
+}
+
+bool ProgramCache::init(QOpenGLContext *context, const std::string &directory, size_t maxSize)
+{
+  _enabled = false;
+
+  int major = context->format().majorVersion(), minor = context->format().minorVersion();
+
+  bool supported = (context->isOpenGLES() && major >= 3)
+                   || (!context->isOpenGLES() && (major > 4 || (major == 4 && minor >= 1)))
+                   || context->hasExtension("GL_ARB_get_program_binary");
+  if(!supported) return false;
+
+  //drivers may support the entry points, but no format
+  GLint formats = 0;
+  _fn->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  if(formats <= 0) return false;
+
+  _directory = QString::fromStdString(directory);
+  if(!QDir().mkpath(_directory)) {
+    qWarning() << "unable to create program cache directory" << _directory;
+    return false;
+  }
+
+  _driver.clear();
+  for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION}) {
+    const char *value = (const char *)_fn->glGetString(name);
+    if(value) _driver.append(value, (int)strlen(value));
+    _driver.append("\n", 1);
+  }
+
+  _maxSize = (qint64)maxSize;
+  _size = 0;
+  for(const QFileInfo &info : QDir(_directory).entryInfoList(QDir::Files, QDir::Name)) {
+    if(info.fileName().endsWith(binary_suffix)) _size += info.size();
+  }
+
+  _enabled = true;
+  return true;
+}
+
+QString ProgramCache::path(const std::string &key) const
+{
+  return QDir(_directory).filePath(QString::fromStdString(key + binary_suffix));
+}
+
+std::string ProgramCache::key(const std::string &vertexGlsl, const std::string &fragmentGlsl,
+                              const std::string &index0Attribute) const
+{
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  //separators keep differently split inputs apart
+  hash.addData(_driver);
+  hash.addData(vertexGlsl.data(), (int)vertexGlsl.size() + 1);
+  hash.addData(fragmentGlsl.data(), (int)fragmentGlsl.size() + 1);
+  hash.addData(index0Attribute.data(), (int)index0Attribute.size() + 1);
+
+  QByteArray hex = hash.result().toHex();
+  return std::string(hex.constData(), hex.size());
+}
+
+bool ProgramCache::load(const std::string &key, GLuint program)
+{
+  QFile file(path(key));
+  if(!file.open(QIODevice::ReadOnly)) {
+    _info.programCacheMisses++;
+    return false;
+  }
+
+  QByteArray data = file.readAll();
+
+  Header header;
+  bool valid = data.size() >= (int)sizeof(Header);
+  if(valid) {
+    memcpy(&header, data.constData(), sizeof(Header));
+    valid = memcmp(header.magic, header_magic, sizeof(header_magic)) == 0
+            && header.version == header_version
+            && header.length == data.size() - sizeof(Header);
+  }
+
+  if(valid) {
+    _fn->glProgramBinary(program, header.format, data.constData() + sizeof(Header), header.length);
+
+    GLint linked = GL_FALSE;
+    _fn->glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    valid = linked == GL_TRUE;
+
+    //a rejected binary leaves an error flag behind, which must not be blamed on the next call
+    clear_glerror(_fn);
+  }
+
+  if(!valid) {
+    _size -= data.size();
+    file.remove();
+
+    _info.programCacheMisses++;
+    return false;
+  }
+
+  //evict() goes by modification time, so a hit counts as a use
+  file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+  file.close();
+
+  _info.programCacheHits++;
+  return true;
+}
+
+void ProgramCache::prepare(GLuint program)
+{
+  _fn->glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::store(const std::string &key, GLuint program)
+{
+  GLint length = 0;
+  _fn->glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if(length <= 0) return;
+
+  QByteArray data((int)sizeof(Header) + length, 0);
+
+  GLsizei written = 0;
+  GLenum format = 0;
+  _fn->glGetProgramBinary(program, length, &written, &format, data.data() + sizeof(Header));
+  if(written <= 0) return;
+
+  data.resize((int)sizeof(Header) + written);
+
+  Header header;
+  memcpy(header.magic, header_magic, sizeof(header_magic));
+  header.version = header_version;
+  header.format = format;
+  header.length = (uint32_t)written;
+  memcpy(data.data(), &header, sizeof(Header));
+
+  //write to a temporary file first, so a crash never leaves a truncated binary behind
+  QString target = path(key);
+  QString temporary = target + ".tmp";
+
+  QFile file(temporary);
+  if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+    qWarning() << "unable to write program binary" << temporary;
+    file.close();
+    file.remove();
+    return;
+  }
+  file.close();
+
+  QFile::remove(target);
+  if(!file.rename(target)) {
+    file.remove();
+    return;
+  }
+
+  _size += data.size();
+  if(_size > _maxSize) evict(target);
+}
+
+void ProgramCache::evict(const QString &keep)
+{
+  //least recently stored or loaded first
+  for(const QFileInfo &info : QDir(_directory).entryInfoList(QDir::Files, QDir::Time | QDir::Reversed)) {
+    if(_size <= _maxSize) break;
+
+    if(!info.fileName().endsWith(binary_suffix) || info.absoluteFilePath() == QFileInfo(keep).absoluteFilePath())
+      continue;
+
+    if(QFile::remove(info.absoluteFilePath())) _size -= info.size();
+  }
+}
+
+}
+}
@@ -0,0 +1,83 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_PROGRAMCACHE_H
+#define THREEPP_PROGRAMCACHE_H
+
+#include <string>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QByteArray>
+#include <QString>
+#include "Helpers.h"
+
+namespace three {
+namespace gl {
+
+/**
+ * linked program binaries stored on disk, so that programs built by a previous run can be loaded
+ * with glProgramBinary instead of being compiled and linked again.
+ *
+ * Binaries are keyed by a hash of the final shader sources, the attribute bound to location 0
+ * and the driver identification (vendor, renderer and version strings). A binary the driver
+ * rejects, e.g. after an update that kept the version string, is deleted and the program is
+ * built from source as usual. When the directory exceeds the size limit, the least recently
+ * used binaries are removed
+ */
+class ProgramCache
+{
+  QOpenGLExtraFunctions * const _fn;
+  RenderInfo &_info;
+
+  QString _directory;
+  qint64 _maxSize = 0;
+  qint64 _size = 0;
+
+  QByteArray _driver;
+  bool _enabled = false;
+
+  QString path(const std::string &key) const;
+
+  void evict(const QString &keep);
+
+public:
+  ProgramCache(QOpenGLExtraFunctions *fn, RenderInfo &info) : _fn(fn), _info(info) {}
+
+  /**
+   * enable the cache for the current context
+   *
+   * @param directory where binaries are stored, created if needed
+   * @param maxSize upper bound for the total size of the binaries in bytes
+   * @return false if the context doesn't support program binaries or the directory is not usable
+   */
+  bool init(QOpenGLContext *context, const std::string &directory, size_t maxSize);
+
+  bool enabled() const {return _enabled;}
+
+  /**
+   * @return the cache key for a program built from the given sources
+   */
+  std::string key(const std::string &vertexGlsl, const std::string &fragmentGlsl, const std::string &index0Attribute) const;
+
+  /**
+   * link program from the cached binary
+   *
+   * @return true if the program is linked, false if it must be built from source
+   */
+  bool load(const std::string &key, GLuint program);
+
+  /**
+   * request a retrievable binary. Called before linking a program that is to be stored
+   */
+  void prepare(GLuint program);
+
+  /**
+   * store the binary of a freshly linked program
+   */
+  void store(const std::string &key, GLuint program);
+};
+
+}
+}
+#endif //THREEPP_PROGRAMCACHE_H
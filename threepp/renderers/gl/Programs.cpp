@@ -10,6 +10,7 @@
 #include <threepp/material/MeshDepthMaterial.h>
 #include <threepp/material/MeshDistanceMaterial.h>
 #include <threepp/material/PointsMaterial.h>
+#include <threepp/objects/InstancedMesh.h>
 
 namespace three {
 namespace gl {
@@ -27,14 +28,41 @@ Encoding getTextureEncoding(Texture::Ptr map, bool gammaOverrideLinear)
   return enc;
 }
 
+bool Programs::supportsInstancedTransform(Material *material)
+{
+  if(material->is<ShaderMaterial>()) return false;
+
+  switch(material->info.shaderId) {
+    case ShaderID::dashed:
+    case ShaderID::cube:
+    case ShaderID::equirect:
+    case ShaderID::undefined:
+      return false;
+    default:
+      return true;
+  }
+}
+
+bool Programs::instancedTransform(const Renderer_impl &renderer, Material *material, Object3D *object)
+{
+  return (renderer.autoInstancing || renderer.multiDrawIndirect || object->is<InstancedMesh>())
+         && supportsInstancedTransform(material);
+}
+
+bool Programs::instanceColor(Material *material, Object3D *object)
+{
+  InstancedMesh *mesh = object->typer;
+  return mesh && mesh->hasColors() && supportsInstancedTransform(material);
+}
+
 ProgramParameters::Ptr Programs::getParameters(const Renderer_impl &renderer,
-                                               Material::Ptr material,
+                                               Material *material,
                                                Lights::State &lights,
                                                const vector<Light::Ptr> &shadows,
-                                               const Fog::Ptr fog,
+                                               const Fog::Ptr &fog,
                                                size_t nClipPlanes,
                                                size_t nClipIntersection,
-                                               Object3D::Ptr object)
+                                               Object3D *object)
 {
   ProgramParameters::Ptr parameters = ProgramParameters::make();
   parameters->shaderID = material->info.shaderId;
@@ -200,6 +228,7 @@ ProgramParameters::Ptr Programs::getParameters(const Renderer_impl &renderer,
   parameters->numSpotLights = lights.spot.size();
   parameters->numRectAreaLights = lights.rectArea.size();
   parameters->numHemiLights = lights.hemi.size();
+  parameters->clusteredLights = material->lights && lights.clustered;
 
   parameters->numClippingPlanes = nClipPlanes;
   parameters->numClipIntersection = nClipIntersection;
@@ -209,6 +238,9 @@ ProgramParameters::Ptr Programs::getParameters(const Renderer_impl &renderer,
   bool shadowEnabled = renderer._shadowMap.enabled && object->receiveShadow && !shadows.empty();
   parameters->shadowMapEnabled = shadowEnabled;
   parameters->shadowMapType = shadowEnabled ? renderer._shadowMap.type() : ShadowMapType::None;
+  parameters->dirCascades = shadowEnabled ? lights.cascades : 0;
+  parameters->cascadedLight = shadowEnabled ? lights.cascadedLight : 0;
+  parameters->shadowMapAtlas = shadowEnabled && renderer.shadowAtlas;
 
   parameters->toneMapping = renderer._toneMapping;
   parameters->physicallyCorrectLights = renderer._physicallyCorrectLights;
@@ -219,6 +251,15 @@ ProgramParameters::Ptr Programs::getParameters(const Renderer_impl &renderer,
   parameters->doubleSided = material->side == Side::Double;
   parameters->flipSided = material->side == Side::Back;
 
+  parameters->instancedTransform = instancedTransform(renderer, material, object);
+  parameters->instanceColor = instanceColor(material, object);
+
+  //raw shaders declare their own uniforms. The lights block carries the scene ambient color, so
+  //materials with their own ambient color stay with plain uniforms
+  parameters->uniformBlocks = renderer.uniformBlocks && _capabilities.uniformBufferObjects
+                              && parameters->shaderMaterial != ShaderMaterialKind::raw
+                              && !material->ambientColor;
+
   return parameters;
 }
 
@@ -18,7 +18,14 @@ class Renderer_impl;
 
 class Programs
 {
-  std::unordered_map<ProgramParameters::Ptr, Program::Ptr, parameters_hash, parameters_equal> _programs;
+  struct Entry
+  {
+    Program::Ptr program;
+
+    //references taken by acquireProgram
+    unsigned users;
+  };
+  std::unordered_map<ProgramParameters::Ptr, Entry, parameters_hash, parameters_equal> _programs;
 
   Extensions &_extensions;
   Capabilities &_capabilities;
@@ -64,36 +71,81 @@ public:
     }
   }
 
+  /**
+   * @return true if the material's shader can take the object transform from per-instance
+   * attributes, i.e. it transforms exclusively through the common shader chunks
+   */
+  static bool supportsInstancedTransform(Material *material);
+
+  /**
+   * @return true if the object transform is taken from per-instance attributes when rendering
+   * object with material
+   */
+  static bool instancedTransform(const Renderer_impl &renderer, Material *material, Object3D *object);
+
+  /**
+   * @return true if the color is taken from a per-instance attribute when rendering object
+   * with material
+   */
+  static bool instanceColor(Material *material, Object3D *object);
+
+  /**
+   * @return the instancing variant of the program used when rendering object with material:
+   * 0 for none, 1 for per-instance transform, 2 for per-instance transform and color
+   */
+  static unsigned instancing(const Renderer_impl &renderer, Material *material, Object3D *object)
+  {
+    if(instanceColor(material, object)) return 2;
+    return instancedTransform(renderer, material, object) ? 1 : 0;
+  }
+
   ProgramParameters::Ptr getParameters(const Renderer_impl &renderer,
-                                       Material::Ptr material,
+                                       Material *material,
                                        Lights::State &lights,
                                        const std::vector<Light::Ptr> &shadows,
-                                       const Fog::Ptr fog,
+                                       const Fog::Ptr &fog,
                                        size_t nClipPlanes,
                                        size_t nClipIntersection,
-                                       Object3D::Ptr object);
+                                       Object3D *object);
+
+  /**
+   * @return the program built for parameters, or nullptr if there is none yet
+   */
+  Program::Ptr findProgram(const ProgramParameters::Ptr &parameters) const
+  {
+    auto it = _programs.find(parameters);
+    return it != _programs.end() ? it->second.program : nullptr;
+  }
 
+  /**
+   * take a reference to the program built for parameters, building it if there is none yet. Each
+   * reference must be returned through releaseProgram
+   */
   Program::Ptr acquireProgram (Renderer_impl &renderer,
-                               Material::Ptr material, Shader &shader, ProgramParameters::Ptr parameters)
+                               Material *material, Shader &shader, ProgramParameters::Ptr parameters)
   {
     // Check if code has been already compiled
     auto it = _programs.find(parameters);
-    if(it != _programs.end()) return it->second;
+    if(it != _programs.end()) {
+      it->second.users++;
+      return it->second.program;
+    }
 
     Program::Ptr program = Program::make( renderer, _extensions, material, shader, parameters );
-    _programs[parameters] = program;
+    _programs.emplace(parameters, Entry {program, 1});
 
     return program;
   }
 
-  void releaseProgram(Program::Ptr program)
+  /**
+   * return a reference taken by acquireProgram. The program is deleted with the last reference
+   */
+  void releaseProgram(const Program::Ptr &program)
   {
-    if (program.use_count() == 2) {
-
-      //should call the program destructor
-      _programs.erase(program->parameters);
-    }
+    auto it = _programs.find(program->parameters);
+    if(it == _programs.end() || it->second.program != program) return;
 
+    if(--it->second.users == 0) _programs.erase(it);
   }
 
   void clear()
@@ -6,12 +6,14 @@
 #define THREEPP_PROPERTIES_H
 
 #include <unordered_map>
+#include <list>
 #include <string>
 #include <type_traits>
 #include <threepp/core/Object3D.h>
 #include <threepp/scene/Fog.h>
 #include <threepp/textures/Texture.h>
 #include "Program.h"
+#include "State.h"
 #include "shader/ShaderLib.h"
 
 namespace three {
@@ -29,6 +31,8 @@ struct GlProperties
 struct MaterialProperties
 {
   Program::Ptr program;
+  //built ahead of use by Renderer_impl::programReady, held until the material uses a program
+  Program::Ptr warmup;
   Fog::Ptr fog;
   std::vector<float> clippingState;
   LightsHash lightsHash;
@@ -37,13 +41,21 @@ struct MaterialProperties
   ShaderID shaderID = ShaderID::undefined;
   three::Shader shader;
   std::vector<Uniform::Ptr> uniformsList;
+  bool needsUpdate = false;
+  //the renderer is notified when the material is disposed. Only set for variant 0
+  bool watched = false;
 };
 
 class Properties
 {
   std::unordered_map<sole::uuid, GlProperties> glProperties;
 
-  std::unordered_map<sole::uuid, MaterialProperties> materialProperties;
+  //one map per instancing variant (see Programs::instancing), so that a material shared by
+  //instanced and plain objects keeps a program for each
+  std::unordered_map<sole::uuid, MaterialProperties> materialProperties[3];
+
+  //by geometry id. Lists, because State keeps a pointer to the bound array
+  std::unordered_map<size_t, std::list<VertexArray>> vertexArrays;
 
 public:
   GlProperties &getGlProperties(const sole::uuid &uuid)
@@ -51,9 +63,9 @@ public:
     return glProperties[uuid];
   }
 
-  MaterialProperties &getMaterialProperties(const sole::uuid &uuid)
+  MaterialProperties &getMaterialProperties(const sole::uuid &uuid, unsigned variant=0)
   {
-    return materialProperties[uuid];
+    return materialProperties[variant][uuid];
   }
 
   template<typename T, typename std::enable_if<!std::is_base_of<Material, T>{}, int>::type = 0>
@@ -81,33 +93,87 @@ public:
   }
 
   template<typename T, typename std::enable_if<std::is_base_of<Material, T>{}, int>::type = 0>
-  MaterialProperties &get(const T &material)
+  MaterialProperties &get(const T &material, unsigned variant=0)
   {
-    return getMaterialProperties(material.uuid);
+    return getMaterialProperties(material.uuid, variant);
   }
 
   template<typename T, typename std::enable_if<std::is_base_of<Material, T>{}, int>::type = 0>
-  MaterialProperties &get(const std::shared_ptr<T> material)
+  MaterialProperties &get(const std::shared_ptr<T> material, unsigned variant=0)
   {
-    return getMaterialProperties(material->uuid);
+    return getMaterialProperties(material->uuid, variant);
   }
 
   template<typename T, typename std::enable_if<std::is_base_of<Material, T>{}, int>::type = 0>
   void remove(const T &material)
   {
-    materialProperties.erase(material.uuid);
+    for(auto &properties : materialProperties) properties.erase(material.uuid);
   }
 
   template<typename T, typename std::enable_if<std::is_base_of<Material, T>{}, int>::type = 0>
   bool has(const T &material)
   {
-    return materialProperties.count(material.uuid) > 0;
+    for(auto &properties : materialProperties)
+      if(properties.count(material.uuid) > 0) return true;
+    return false;
+  }
+
+  /**
+   * @return the programs held by the variants of the material, including warm-up programs
+   */
+  std::vector<Program::Ptr> programs(const Material &material)
+  {
+    std::vector<Program::Ptr> result;
+    for(auto &properties : materialProperties) {
+      auto found = properties.find(material.uuid);
+      if(found == properties.end()) continue;
+
+      if(found->second.program) result.push_back(found->second.program);
+      if(found->second.warmup) result.push_back(found->second.warmup);
+    }
+    return result;
+  }
+
+  /**
+   * mark the programs of all variants of the material for rebuild
+   */
+  void needsUpdate(const Material &material)
+  {
+    for(auto &properties : materialProperties) {
+      auto found = properties.find(material.uuid);
+      if(found != properties.end()) found->second.needsUpdate = true;
+    }
+  }
+
+  VertexArray &getVertexArray(size_t geometryId, GLuint program, bool wireframe)
+  {
+    std::list<VertexArray> &arrays = vertexArrays[geometryId];
+
+    for(VertexArray &array : arrays) {
+      if(array.program == program && array.wireframe == wireframe) return array;
+    }
+    arrays.emplace_back();
+    arrays.back().program = program;
+    arrays.back().wireframe = wireframe;
+
+    return arrays.back();
+  }
+
+  std::list<VertexArray> &getVertexArrays(size_t geometryId)
+  {
+    return vertexArrays[geometryId];
+  }
+
+  void removeVertexArrays(size_t geometryId)
+  {
+    vertexArrays.erase(geometryId);
   }
 
   void clear()
   {
     glProperties.clear();
-    materialProperties.clear();
+    for(auto &properties : materialProperties) properties.clear();
+    vertexArrays.clear();
   }
 };
 
@@ -5,30 +5,41 @@
 #ifndef THREEPP_GLRENDERERLISTS_H
 #define THREEPP_GLRENDERERLISTS_H
 
+#include <cstring>
+#include <limits>
 #include <threepp/core/Object3D.h>
 #include <threepp/core/Geometry.h>
 #include <threepp/scene/Scene.h>
 #include <threepp/camera/Camera.h>
+#include <threepp/objects/Sprite.h>
+#include <threepp/objects/LensFlare.h>
+#include <threepp/light/Light.h>
 #include "Program.h"
 
 namespace three {
 namespace gl {
 
+/**
+ * non-owning references to the objects being rendered. They are kept alive by the scene
+ * for the duration of a render pass, which is the only time a RenderItem is used
+ */
 struct RenderItem
 {
   unsigned id;
-  Object3D::Ptr object;
-  BufferGeometry::Ptr geometry;
-  Material::Ptr material;
-  Program::Ptr program;
+  Object3D *object;
+  BufferGeometry *geometry;
+  Material *material;
   int renderOrder;
   float z;
   const Group *group;
 
-  RenderItem(Object3D::Ptr object, BufferGeometry::Ptr geometry, Material::Ptr material, float z, const Group *group,
-             Program::Ptr program=nullptr)
-     : object(object), geometry(geometry), material(material), program(program), renderOrder(object->renderOrder()),
-       z(z), group(group)
+  //precomputed sort key, see RenderList::opaqueKey/transparentKey
+  uint64_t sortKey = 0;
+
+  RenderItem(unsigned id, Object3D *object, BufferGeometry *geometry, Material *material, float z,
+             const Group *group)
+     : id(id), object(object), geometry(geometry), material(material),
+       renderOrder(object->renderOrder()), z(z), group(group)
   {}
 };
 
@@ -39,6 +50,147 @@ class RenderList
   std::vector<size_t> _opaque;
   std::vector<size_t> _transparent;
 
+  struct SortEntry
+  {
+    uint64_t key;
+    size_t index;
+  };
+  std::vector<SortEntry> _sortEntries;
+  std::vector<SortEntry> _sortScratch;
+
+  //false if some item could not be represented exactly in a sort key
+  bool _keysExact = true;
+
+  //order opaque items with the same material by geometry instead of depth
+  bool _groupByGeometry = false;
+
+  //items added through push_front, see reuse
+  size_t _frontOpaque = 0;
+  size_t _frontTransparent = 0;
+
+  /**
+   * maps a float to an unsigned int with the same ordering
+   */
+  static uint32_t orderedBits(float value)
+  {
+    if(value == 0) value = 0; //-0 == +0
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits & 0x80000000 ? ~bits : bits | 0x80000000;
+  }
+
+  static uint64_t renderOrderBits(int renderOrder)
+  {
+    return (uint64_t)(renderOrder - std::numeric_limits<int16_t>::min()) & 0xFFFF;
+  }
+
+  static size_t geometryId(const RenderItem &item)
+  {
+    return item.geometry ? item.geometry->id : 0;
+  }
+
+  /**
+   * renderOrder | material id | depth (or geometry id), ascending. Items with identical keys
+   * are further ordered by painterSortStable
+   */
+  uint64_t opaqueKey(const RenderItem &item)
+  {
+    static_assert(sizeof(item.material->id) <= 2, "material ids must fit into 16 bits of the sort key");
+
+    uint64_t low;
+    if(_groupByGeometry) {
+      low = geometryId(item);
+      if(low > 0xFFFFFFFF) _keysExact = false;
+    }
+    else
+      low = orderedBits(item.z);
+
+    return renderOrderBits(item.renderOrder) << 48
+           | (uint64_t)item.material->id << 32
+           | low;
+  }
+
+  /**
+   * descending renderOrder | depth, ascending. Ties are resolved by descending id, which the
+   * (stable) sort provides by processing items in reverse order
+   */
+  uint64_t transparentKey(const RenderItem &item)
+  {
+    return (~renderOrderBits(item.renderOrder) & 0xFFFF) << 32 | orderedBits(item.z);
+  }
+
+  /**
+   * stable LSD radix sort over 8 bit digits. Passes where all keys share the same digit are skipped
+   */
+  void radixSort(std::vector<SortEntry> &entries)
+  {
+    size_t count = entries.size();
+    _sortScratch.resize(count);
+
+    size_t histograms[8][256] = {};
+    for(const SortEntry &entry : entries) {
+      for(unsigned pass = 0; pass < 8; pass++)
+        histograms[pass][(entry.key >> (pass * 8)) & 0xFF]++;
+    }
+
+    SortEntry *from = entries.data(), *to = _sortScratch.data();
+    for(unsigned pass = 0; pass < 8; pass++) {
+      size_t *histogram = histograms[pass];
+      if(histogram[(from[0].key >> (pass * 8)) & 0xFF] == count) continue;
+
+      size_t offset = 0;
+      for(unsigned digit = 0; digit < 256; digit++) {
+        size_t n = histogram[digit];
+        histogram[digit] = offset;
+        offset += n;
+      }
+      for(size_t i = 0; i < count; i++) {
+        const SortEntry &entry = from[i];
+        to[histogram[(entry.key >> (pass * 8)) & 0xFF]++] = entry;
+      }
+      std::swap(from, to);
+    }
+    if(from != entries.data()) entries.swap(_sortScratch);
+  }
+
+  void sortOpaque()
+  {
+    _sortEntries.clear();
+    for(size_t index : _opaque) _sortEntries.push_back({_renderItems[index].sortKey, index});
+
+    radixSort(_sortEntries);
+
+    for(size_t i = 0, l = _sortEntries.size(); i < l; i++) _opaque[i] = _sortEntries[i].index;
+
+    //equal keys may still differ in depth (if grouped by geometry) or id. Finish them with the full comparison
+    for(size_t begin = 0, l = _sortEntries.size(); begin < l; ) {
+      size_t end = begin + 1;
+      while(end < l && _sortEntries[end].key == _sortEntries[begin].key) end++;
+
+      if(end - begin > 1)
+        std::sort(_opaque.begin() + begin, _opaque.begin() + end,
+                  [this](size_t a, size_t b) {return painterSortStable(a, b);});
+      begin = end;
+    }
+  }
+
+  void sortTransparent()
+  {
+    if(!std::is_sorted(_transparent.begin(), _transparent.end())) {
+      std::sort(_transparent.begin(), _transparent.end(),
+                [this](size_t a, size_t b) {return reversePainterSortStable(a, b);});
+      return;
+    }
+
+    _sortEntries.clear();
+    for(auto it = _transparent.rbegin(); it != _transparent.rend(); it++)
+      _sortEntries.push_back({_renderItems[*it].sortKey, *it});
+
+    radixSort(_sortEntries);
+
+    for(size_t i = 0, l = _sortEntries.size(); i < l; i++) _transparent[i] = _sortEntries[i].index;
+  }
+
   bool painterSortStable(size_t index_a, size_t index_b)
   {
     const RenderItem &a = _renderItems.at(index_a);
@@ -48,14 +200,14 @@ class RenderList
 
       return a.renderOrder < b.renderOrder;
     }
-    else if (a.program != nullptr && b.program != nullptr && a.program != b.program) {
-
-      return a.program->handle() < b.program->handle();
-    }
     else if (a.material->id != b.material->id) {
 
       return a.material->id < b.material->id;
     }
+    else if (_groupByGeometry && geometryId(a) != geometryId(b)) {
+
+      return geometryId(a) < geometryId(b);
+    }
     else if (a.z != b.z) {
 
       return a.z < b.z;
@@ -86,6 +238,46 @@ class RenderList
   }
 
 public:
+  /**
+   * what the list was built from. Renderer_impl uses this to keep the list as it is if neither
+   * the scene nor the camera changed since the last frame, and to cull a flat list of candidates
+   * instead of traversing the scene graph if only transforms changed
+   */
+  struct Source
+  {
+    enum class Kind {Sprite, LensFlare, Immediate, Renderable};
+
+    struct Candidate
+    {
+      //points into the parent's children, which stay in place while the structure is unchanged
+      const Object3D::Ptr *object;
+      Kind kind;
+    };
+
+    bool valid = false;
+    unsigned structureVersion = 0;
+    unsigned transformVersion = 0;
+    unsigned layers = 0;
+    unsigned options = 0;
+    math::Matrix4 projScreenMatrix;
+
+    //objects which passed the visibility and layer tests, in scene graph order
+    std::vector<Candidate> candidates;
+    bool candidatesValid = false;
+
+    //LOD levels were selected for the camera, which rules out the candidates
+    bool cameraDependent = false;
+
+    //projection results which are not kept in the list itself
+    std::vector<const Object3D::Ptr *> renderables;
+    std::vector<Sprite::Ptr> sprites;
+    std::vector<LensFlare::Ptr> flares;
+    std::vector<Light::Ptr> lights;
+    std::vector<Light::Ptr> shadows;
+  };
+
+  Source source;
+
   class iterator
   {
     size_t _index;
@@ -134,32 +326,69 @@ public:
     operator bool () {return _index < _indizes.size();}
   };
 
-  void init()
+  /**
+   * reset for a new frame. Items hold no ownership, so this neither frees memory nor touches
+   * reference counts; capacity is reused by the next frame
+   *
+   * @param groupByGeometry sort opaque items that share a material by geometry rather than
+   * by depth, so that runs of identical geometry/material pairs become adjacent
+   */
+  void init(bool groupByGeometry=false)
   {
     _renderItems.clear();
     _opaque.clear();
     _transparent.clear();
+    _keysExact = true;
+    _groupByGeometry = groupByGeometry;
+    _frontOpaque = 0;
+    _frontTransparent = 0;
   }
 
-  RenderList &push_back(Object3D::Ptr object, BufferGeometry::Ptr geometry, Material::Ptr material, unsigned z, const Group *group)
+  /**
+   * prepare for another frame with unchanged content. Items added through push_front are
+   * dropped, their owners add them again every frame
+   */
+  void reuse()
   {
-    _renderItems.emplace_back(object, geometry, material, z, group);
+    _opaque.erase(_opaque.begin(), _opaque.begin() + _frontOpaque);
+    _transparent.erase(_transparent.begin(), _transparent.begin() + _frontTransparent);
+    _renderItems.erase(_renderItems.end() - (_frontOpaque + _frontTransparent), _renderItems.end());
 
-    if(material->transparent())
+    _frontOpaque = 0;
+    _frontTransparent = 0;
+  }
+
+  RenderList &push_back(Object3D *object, BufferGeometry *geometry, Material *material, float z, const Group *group)
+  {
+    _renderItems.emplace_back(_renderItems.size(), object, geometry, material, z, group);
+
+    RenderItem &item = _renderItems.back();
+    if(item.renderOrder < std::numeric_limits<int16_t>::min() || item.renderOrder > std::numeric_limits<int16_t>::max())
+      _keysExact = false;
+
+    if(material->transparent()) {
+      item.sortKey = transparentKey(item);
       _transparent.push_back(_renderItems.size() - 1);
-    else
+    }
+    else {
+      item.sortKey = opaqueKey(item);
       _opaque.push_back(_renderItems.size() - 1);
+    }
     return *this;
   }
 
-  RenderList &push_front(Object3D::Ptr object, BufferGeometry::Ptr geometry, Material::Ptr material, unsigned z, const Group *group)
+  RenderList &push_front(Object3D *object, BufferGeometry *geometry, Material *material, float z, const Group *group)
   {
-    _renderItems.emplace_back(object, geometry, material, z, group);
+    _renderItems.emplace_back(_renderItems.size(), object, geometry, material, z, group);
 
-    if(material->transparent())
+    if(material->transparent()) {
       _transparent.insert(_transparent.begin(), _renderItems.size() - 1);
-    else
+      _frontTransparent++;
+    }
+    else {
       _opaque.insert(_opaque.begin(), _renderItems.size() - 1);
+      _frontOpaque++;
+    }
     return *this;
   }
 
@@ -168,6 +397,22 @@ public:
   iterator transparent() const {return iterator(_transparent, _renderItems);}
 
   RenderList &sort()
+  {
+    if(_keysExact) {
+      if(_opaque.size() > 1) sortOpaque();
+      if(_transparent.size() > 1) sortTransparent();
+    }
+    else
+      sortExact();
+
+    return *this;
+  }
+
+  /**
+   * sort with the full comparison only. This is what sort falls back to if the keys can't
+   * represent all items, and the order the key sort must reproduce
+   */
+  RenderList &sortExact()
   {
     std::sort(_opaque.begin(), _opaque.end(), [this](size_t a, size_t b) {return painterSortStable(a, b);});
     std::sort(_transparent.begin(), _transparent.end(),
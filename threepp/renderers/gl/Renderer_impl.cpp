@@ -7,6 +7,8 @@
 #include <threepp/objects/Line.h>
 #include <threepp/objects/Points.h>
 #include <threepp/objects/ImmediateRenderObject.h>
+#include <threepp/objects/InstancedMesh.h>
+#include <threepp/objects/LOD.h>
 #include <threepp/material/MeshStandardMaterial.h>
 #include <threepp/material/MeshPhongMaterial.h>
 #include <threepp/material/MeshNormalMaterial.h>
@@ -18,6 +20,7 @@
 #include <threepp/material/MeshDistanceMaterial.h>
 #include <threepp/material/ShadowMaterial.h>
 #include "refresh_uniforms.h"
+#include <limits>
 
 namespace three {
 
@@ -25,7 +28,7 @@ using namespace std;
 
 OpenGLRenderer::Ptr OpenGLRenderer::make(size_t width, size_t height, float pixelRatio, const OpenGLRendererOptions &options)
 {
-  return gl::Renderer_impl::Ptr(new gl::Renderer_impl(width, height, pixelRatio));
+  return gl::Renderer_impl::Ptr(new gl::Renderer_impl(width, height, pixelRatio, options));
 }
 
 Renderer::Target::Ptr OpenGLRenderer::makeExternalTarget(GLuint frameBuffer, GLuint texture, size_t width, size_t height,
@@ -71,36 +74,67 @@ public:
   void defer() {_active = true;}
 };
 
-Renderer_impl::Renderer_impl(size_t width, size_t height, float pixelRatio, bool premultipliedAlpha)
-   : _state(this),
+Renderer_impl::Renderer_impl(size_t width, size_t height, float pixelRatio, const OpenGLRendererOptions &options)
+   : OpenGLRenderer(options),
+     _state(this, _validation),
      _width(width),
      _height(height),
      _attributes(this),
-     _objects(_geometries, _infoRender),
+     _objects(_geometries, _infoRender, _residency),
      _geometries(_attributes),
      _capabilities(this, _extensions, _parameters ),
      _morphTargets(this),
-     _shadowMap(*this, _objects, _capabilities),
+     _shadowMap(*this, _objects, _capabilities, _infoRender),
      _programs(Programs::make(_extensions, _capabilities)),
-     _premultipliedAlpha(premultipliedAlpha),
-     _background(*this, _state, _geometries, premultipliedAlpha),
-     _textures(this, _extensions, _state, _properties, _capabilities, _infoMemory),
-     _bufferRenderer(this, this, _extensions, _infoRender),
-     _indexedBufferRenderer(this, this, _extensions, _infoRender),
+     _premultipliedAlpha(options.premultipliedAlpha),
+     _background(*this, _state, _geometries, options.premultipliedAlpha),
+     _textures(this, _validation, _extensions, _state, _properties, _capabilities, _infoMemory, _infoRender, _residency),
+     _residency(_infoMemory),
+     _bufferRenderer(this, this, _validation, _extensions, _infoRender),
+     _indexedBufferRenderer(this, this, _validation, _extensions, _infoRender),
      _spriteRenderer(*this, _state, _textures, _capabilities),
      _flareRenderer(this, _state, _textures, _capabilities),
-     _pixelRatio(pixelRatio)
+     _frameSync(this, _validation, _infoRender, options.framesInFlight),
+     _pixelRatio(pixelRatio),
+     _projection(_workers),
+     _uniformBlocks(this),
+     _clusters(this),
+     _programCache(this, _infoRender),
+     _staticBatches(this, _state, _residency)
 {
   _deferredCalls = new DeferredCalls(this);
+
+  _geometries.onRemove.connect([this](const BufferGeometry &geometry) {
+    for(VertexArray &vertexArray : _properties.getVertexArrays(geometry.id))
+      _state.deleteVertexArray(vertexArray);
+
+    _properties.removeVertexArrays(geometry.id);
+    _staticBatches.remove(geometry.id);
+    _residency.removeGeometry(geometry.id);
+  });
 }
 
 Renderer_impl::~Renderer_impl()
 {
+  //messages delivered from here on must not be attributed to objects that may be gone
+  _debugOutput.setCurrent(nullptr, nullptr);
+
   delete _deferredCalls;
 }
 
 void Renderer_impl::contextAboutToBeDestroyed()
 {
+  _frameSync.clear();
+  if(_instanceBuffer) {
+    glDeleteBuffers(1, &_instanceBuffer);
+    _instanceBuffer = 0;
+  }
+  purgeInstanceCaches(true);
+  _state.bindVertexArray(nullptr);
+  _uniformBlocks.clear();
+  _clusters.clear();
+  _staticBatches.clear();
+  _textures.clear();
   _properties.clear();
   _programs->clear();
 }
@@ -126,6 +160,39 @@ void Renderer_impl::initContext()
                    Extension::ANGLE_instanced_arrays});
 
   _capabilities.init(QOpenGLContext::currentContext());
+
+  _validationRequested = validation;
+  _validation = _debugOutput.init(QOpenGLContext::currentContext(), validation);
+
+  _textures.setStreaming(textureThreads, textureUploadBudget);
+
+  if(multiDrawIndirect && !_staticBatches.init(QOpenGLContext::currentContext()))
+    qWarning() << "multi-draw indirect not supported, using regular draw calls";
+
+  if(!programCacheDir.empty()
+     && !_programCache.init(QOpenGLContext::currentContext(), programCacheDir, programCacheSize))
+    qWarning() << "program binary cache not available, compiling all programs from source";
+
+  _parallelCompile = false;
+  if(asyncCompile) {
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+
+    typedef void (QOPENGLF_APIENTRYP MaxShaderCompilerThreads)(GLuint count);
+    MaxShaderCompilerThreads maxThreads = nullptr;
+
+    if(context->hasExtension("GL_KHR_parallel_shader_compile"))
+      maxThreads = (MaxShaderCompilerThreads)context->getProcAddress("glMaxShaderCompilerThreadsKHR");
+    else if(context->hasExtension("GL_ARB_parallel_shader_compile"))
+      maxThreads = (MaxShaderCompilerThreads)context->getProcAddress("glMaxShaderCompilerThreadsARB");
+
+    if(maxThreads) {
+      // let the implementation choose the number of compiler threads
+      maxThreads(0xFFFFFFFF);
+      _parallelCompile = true;
+    }
+    else
+      qWarning() << "parallel shader compilation not supported, building" << programsPerFrame << "programs per frame";
+  }
 }
 
 void Renderer_impl::clear(bool color, bool depth, bool stencil)
@@ -137,7 +204,7 @@ void Renderer_impl::clear(bool color, bool depth, bool stencil)
   if (stencil) bits |= GL_STENCIL_BUFFER_BIT;
 
   glClear( bits );
-  check_glerror(this);
+  check_glerror(this, _validation);
 }
 
 Renderer_impl &Renderer_impl::setSize(size_t width, size_t height, bool viewport)
@@ -183,22 +250,35 @@ void Renderer_impl::usePrograms(OpenGLRenderer::Ptr other)
 void Renderer_impl::doRender(const Scene::Ptr &scene, const Camera::Ptr &camera,
                              const Renderer::Target::Ptr &renderTarget, bool forceClear)
 {
-  if(clear_glerror(this)) return;
+  // the option may have been changed since initContext
+  if(validation != _validationRequested) {
+    _validationRequested = validation;
+    _validation = _debugOutput.init(QOpenGLContext::currentContext(), validation);
+  }
+
+  if(_validation == Validation::Sync && clear_glerror(this)) return;
   _state.init();
 
   if(renderTarget) renderTarget->init(this);
-  check_glerror(this);
+  check_glerror(this, _validation);
 
   _deferredCalls->exec();
 
+  _residency.nextFrame();
+  purgeInstanceCaches(false);
+  _textures.uploadStreamed();
+
   RenderTarget::Ptr target = dynamic_pointer_cast<RenderTarget>(renderTarget);
 
   // reset caching for this frame
   _currentGeometryProgram = no_program;
   _currentMaterialId = -1;
   _currentCamera = nullptr;
+  _uniformBlocks.invalidate();
+  _programBudget = programsPerFrame;
 
-  // update scene graph
+  // update scene graph. The change counters are only needed to reuse render lists
+  scene->changeTracking = reuseRenderLists;
   if (scene->autoUpdate()) scene->updateMatrixWorld(false);
 
   // update camera matrices and frustum
@@ -207,31 +287,109 @@ void Renderer_impl::doRender(const Scene::Ptr &scene, const Camera::Ptr &camera,
   _projScreenMatrix.multiply(camera->projectionMatrix(), camera->matrixWorldInverse());
   _frustum.set(_projScreenMatrix);
 
-  _lightsArray.clear();
-  _shadowsArray.clear();
-
-  _spritesArray.clear();
-  _flaresArray.clear();
-
   _clippingEnabled = _clipping.init(_clippingPlanes, _localClippingEnabled, camera);
 
   _currentRenderList = _renderLists.get(scene, camera);
-  _currentRenderList->init();
+  RenderList::Source &source = _currentRenderList->source;
+
+  // compare against what the list was built from
+  unsigned options = (autoInstancing ? 1 : 0) | (occlusionCulling ? 2 : 0) | (_sortObjects ? 4 : 0);
+
+  bool structureKept = reuseRenderLists && scene->autoUpdate() && source.valid
+                       && source.structureVersion == scene->structureVersion()
+                       && source.layers == camera->layers().value()
+                       && source.options == options;
+  bool transformKept = structureKept
+                       && source.transformVersion == scene->transformVersion()
+                       && source.projScreenMatrix == _projScreenMatrix;
+
+  if(structureKept) {
+    _lightsArray = source.lights;
+    _shadowsArray = source.shadows;
+  }
+  else {
+    _lightsArray.clear();
+    _shadowsArray.clear();
 
-  prepareLights(scene, camera);
+    prepareLights(scene, camera);
+
+    source.lights = _lightsArray;
+    source.shadows = _shadowsArray;
+    source.candidatesValid = false;
+    source.cameraDependent = false;
+  }
   _shadowMap.setup(_shadowsArray, scene, camera);
 
-  projectObject(scene, camera, _sortObjects);
+  // counted while the list is built. A reused list evaluates no LODs and tests no occluders
+  std::fill(_infoRender.lodLevels.begin(), _infoRender.lodLevels.end(), 0);
+  _infoRender.lodSwitches = 0;
+  _infoRender.occlusionTested = 0;
+  _infoRender.occlusionCulled = 0;
+
+  if(transformKept) {
+    // the list is still valid. Geometries may have changed their contents though
+    _currentRenderList->reuse();
+
+    _spritesArray = source.sprites;
+    _flaresArray = source.flares;
 
-  if (_sortObjects) {
-    _currentRenderList->sort();
+    for(const Object3D::Ptr *object : source.renderables) _objects.update(*object);
   }
+  else {
+    _currentRenderList->init(autoInstancing);
+
+    _spritesArray.clear();
+    _flaresArray.clear();
+    source.renderables.clear();
+
+    _workers.setThreads(projectionThreads);
+
+    if(structureKept && !source.cameraDependent && !source.candidatesValid) {
+      source.candidates.clear();
+      collectCandidates(scene, camera);
+      source.candidatesValid = !source.cameraDependent;
+    }
+
+    if(structureKept && source.candidatesValid)
+      projectCandidates(source.candidates, _sortObjects);
+    else if(projectionThreads > 1)
+      projectParallel(scene, camera, _sortObjects);
+    else
+      projectObject(scene, camera, _sortObjects);
+
+    if(occlusionCulling) cullOccluded();
+
+    if (_sortObjects) {
+      _currentRenderList->sort();
+    }
+
+    source.valid = true;
+    source.structureVersion = scene->structureVersion();
+    source.transformVersion = scene->transformVersion();
+    source.layers = camera->layers().value();
+    source.options = options;
+    source.projScreenMatrix = _projScreenMatrix;
+    source.sprites = _spritesArray;
+    source.flares = _flaresArray;
+  }
+
+  // don't let the CPU run more than framesInFlight frames ahead
+  _frameSync.throttle();
 
   if (_clippingEnabled) _clipping.beginShadows();
 
   _shadowMap.render(_shadowsArray, scene, camera);
 
-  _lights.setup(_lightsArray, _shadowsArray.size(), camera);
+  // the clusters are computed for a single projection
+  bool clustered = clusteredLighting && !camera->is<ArrayCamera>();
+
+  _lights.setup(_lightsArray, _shadowsArray.size(), camera, clustered);
+  if(uniformBlocks && _capabilities.uniformBufferObjects) _uniformBlocks.setLights(_lights.state);
+
+  if(clustered) {
+    _clusters.update(_lights.state, *camera, _workers);
+    _clusters.upload(_state, _capabilities.maxTextures);
+  }
 
   if (_clippingEnabled) _clipping.endShadows();
 
@@ -251,13 +409,18 @@ void Renderer_impl::doRender(const Scene::Ptr &scene, const Camera::Ptr &camera,
 
   // opaque pass (front-to-back order)
   if (opaqueObjects)
-    renderObjects(opaqueObjects, scene, camera, scene->overrideMaterial);
+    renderObjects(opaqueObjects, scene, camera, scene->overrideMaterial.get(),
+                  autoInstancing && _extensions.get(Extension::ANGLE_instanced_arrays),
+                  multiDrawIndirect && _staticBatches.supported());
 
   // transparent pass (back-to-front order)
   if (transparentObjects)
-    renderObjects(transparentObjects, scene, camera, scene->overrideMaterial);
+    renderObjects(transparentObjects, scene, camera, scene->overrideMaterial.get());
+
+  // custom renderers, using the default vertex array
+  _state.bindVertexArray(nullptr);
+  _currentGeometryProgram = no_program;
 
-  // custom renderers
   _spriteRenderer.render(_spritesArray, scene, camera);
   _flareRenderer.render(_flaresArray, scene, camera, _currentViewport);
 
@@ -269,18 +432,42 @@ void Renderer_impl::doRender(const Scene::Ptr &scene, const Camera::Ptr &camera,
   _state.depthBuffer.setMask(true);
   _state.colorBuffer.setMask(true);
 
+  evictResources();
+
   state().reset();
 
   _deferredCalls->defer();
 
-  glFinish();
+  _frameSync.submit();
+}
+
+void Renderer_impl::evictResources()
+{
+  if(gpuMemoryBudget == 0) return;
+
+  // what this frame used stays
+  for(const Residency::Entry &entry : _residency.evict(gpuMemoryBudget)) {
+
+    if(entry.kind == Residency::Kind::Texture)
+      _textures.evict(entry.texture);
+    else if(entry.kind == Residency::Kind::Geometry)
+      _geometries.evict(entry.geometry);
+
+    _infoMemory.evictions ++;
+  }
+
+  if(_residency.used() > gpuMemoryBudget)
+    onMemoryPressure.emitSignal(_residency.used(), gpuMemoryBudget);
 }
 
 unsigned Renderer_impl::allocTextureUnit()
 {
   unsigned textureUnit = _usedTextureUnits;
 
-  if(textureUnit >= _capabilities.maxTextures ) {
+  // the top units hold the light clusters
+  unsigned maxTextures = _capabilities.maxTextures - (clusteredLighting ? Clusters::reserved_units : 0);
+
+  if(textureUnit >= maxTextures ) {
     throw logic_error("max texture units exceeded");
   }
 
@@ -346,7 +533,7 @@ Renderer_impl& Renderer_impl::setRenderTarget(const Renderer::Target::Ptr render
   if (_currentFramebuffer != framebuffer ) {
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer );
     _currentFramebuffer = framebuffer;
-    check_glerror(this);
+    check_glerror(this, _validation);
   }
 
   _state.viewport( _currentViewport );
@@ -358,18 +545,19 @@ Renderer_impl& Renderer_impl::setRenderTarget(const Renderer::Target::Ptr render
     GLenum textarget = textureProperties.texture;
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + cubeTarget->activeCubeFace,
                            textarget, cubeTarget->activeMipMapLevel );
-    check_glerror(this);
+    check_glerror(this, _validation);
   }
   return *this;
 }
 
-void Renderer_impl::renderObjects(RenderList::iterator renderIterator, Scene::Ptr scene, Camera::Ptr camera,
-                                  Material::Ptr overrideMaterial)
+void Renderer_impl::renderObjects(RenderList::iterator renderIterator, const Scene::Ptr &scene,
+                                  const Camera::Ptr &camera, Material *overrideMaterial, bool instancing,
+                                  bool multiDraw)
 {
   while(renderIterator) {
 
     const RenderItem &renderItem = *renderIterator;
-    Material::Ptr material = overrideMaterial ? overrideMaterial : renderItem.material;
+    Material *material = overrideMaterial ? overrideMaterial : renderItem.material;
 
     if(ArrayCamera *acamera = camera->typer) {
 
@@ -394,6 +582,58 @@ void Renderer_impl::renderObjects(RenderList::iterator renderIterator, Scene::Pt
         }
       }
     }
+    else if(multiDraw && multiDrawable(renderItem, material)) {
+      _currentArrayCamera = nullptr;
+
+      //collect the run of items from the same pool that can share a single multi-draw call
+      _instanceRun.clear();
+      _instanceRun.push_back(&renderItem);
+
+      Mesh *mesh = renderItem.object->typer;
+      const StaticBatches::Pool *pool = _staticBatches.poolOf(*renderItem.geometry);
+      for(renderIterator++; renderIterator; renderIterator++) {
+        const RenderItem &next = *renderIterator;
+
+        if((!overrideMaterial && next.material != renderItem.material)
+           || next.object->frontFaceCW() != renderItem.object->frontFaceCW()
+           || !multiDrawable(next, material)
+           || _staticBatches.poolOf(*next.geometry) != pool
+           || ((Mesh *)next.object->typer)->drawMode() != mesh->drawMode())
+          break;
+
+        _instanceRun.push_back(&next);
+      }
+
+      renderMultiDraw(scene, camera, material);
+      continue;
+    }
+    else if(instancing && instanceable(renderItem, material)) {
+      _currentArrayCamera = nullptr;
+
+      //collect the run of items that can share a single draw call
+      _instanceRun.clear();
+      _instanceRun.push_back(&renderItem);
+
+      Mesh *mesh = renderItem.object->typer;
+      for(renderIterator++; renderIterator; renderIterator++) {
+        const RenderItem &next = *renderIterator;
+
+        if(next.geometry != renderItem.geometry || next.group != renderItem.group
+           || (!overrideMaterial && next.material != renderItem.material)
+           || next.object->frontFaceCW() != renderItem.object->frontFaceCW()
+           || !instanceable(next, material)
+           || ((Mesh *)next.object->typer)->drawMode() != mesh->drawMode())
+          break;
+
+        _instanceRun.push_back(&next);
+      }
+
+      if(_instanceRun.size() > 1)
+        renderInstanced(scene, camera, material);
+      else
+        renderObject( renderItem.object, scene, camera, renderItem.geometry, material, renderItem.group );
+      continue;
+    }
     else {
       _currentArrayCamera = nullptr;
       renderObject( renderItem.object, scene, camera, renderItem.geometry, material, renderItem.group );
@@ -402,8 +642,276 @@ void Renderer_impl::renderObjects(RenderList::iterator renderIterator, Scene::Pt
   }
 }
 
-void Renderer_impl::renderObject(Object3D::Ptr object, Scene::Ptr scene, Camera::Ptr camera,
-                                 BufferGeometry::Ptr geometry, Material::Ptr material, const Group *group)
+bool Renderer_impl::instanceable(const RenderItem &item, Material *material)
+{
+  Mesh *mesh = item.object->typer;
+
+  return mesh && !item.object->is<SkinnedMesh>() && !item.object->is<InstancedMesh>()
+         && mesh->morphTargetInfluences().empty()
+         && !(InstancedBufferGeometry *)item.geometry->typer
+         && Programs::supportsInstancedTransform(material);
+}
+
+bool Renderer_impl::multiDrawable(const RenderItem &item, Material *material)
+{
+  return !material->wireframe && instanceable(item, material) && _staticBatches.packable(*item.geometry);
+}
+
+void Renderer_impl::renderMultiDraw(const Scene::Ptr &scene, const Camera::Ptr &camera, Material *material)
+{
+  _instanceStride = instance_floats;
+  _instanceData.resize(_instanceRun.size() * _instanceStride);
+  float *data = _instanceData.data();
+
+  const RenderItem &first = *_instanceRun.front();
+  _staticBatches.begin(*first.geometry);
+
+  GLuint baseInstance = 0;
+  for(const RenderItem *item : _instanceRun) {
+    Object3D *object = item->object;
+
+    object->onBeforeRender.emitSignal(*this, scene, camera, *object, item->group);
+
+    object->modelViewMatrix.multiply(camera->matrixWorldInverse(), object->matrixWorld());
+    object->normalMatrix = object->modelViewMatrix.normalMatrix();
+
+    memcpy(data, object->matrixWorld().elements(), 16 * sizeof(float));
+    memcpy(data + 16, object->normalMatrix.elements(), 9 * sizeof(float));
+    data += _instanceStride;
+
+    _staticBatches.add(*item->geometry, item->group, baseInstance++);
+  }
+
+  uploadInstances();
+
+  _state.setMaterial( material, first.object->frontFaceCW());
+
+  Program::Ptr program = setProgram( camera, scene->fog(), material, first.object );
+  if(!program) return;
+
+  // the pool vertex array replaces whatever renderBufferDirect bound last
+  _currentGeometryProgram = no_program;
+  _staticBatches.bind( program->getAttributes(), program->handle() );
+
+  setupInstanceAttributes( program.get(), first.object, true );
+
+  Mesh *mesh = first.object->typer;
+  if(_staticBatches.draw((GLenum)mesh->drawMode()) > 0) _infoRender.calls++;
+
+  for(const auto &command : _staticBatches.commands()) {
+    _infoRender.vertices += command.count;
+    if(mesh->drawMode() == DrawMode::Triangles) _infoRender.faces += command.count / 3;
+  }
+
+  for(const RenderItem *item : _instanceRun) {
+    item->object->onAfterRender.emitSignal(*this, scene, camera, *item->object, item->group);
+  }
+}
+
+void Renderer_impl::renderInstanced(const Scene::Ptr &scene, const Camera::Ptr &camera, Material *material)
+{
+  _instanceStride = instance_floats;
+  _instanceData.resize(_instanceRun.size() * _instanceStride);
+  float *data = _instanceData.data();
+
+  for(const RenderItem *item : _instanceRun) {
+    Object3D *object = item->object;
+
+    object->onBeforeRender.emitSignal(*this, scene, camera, *object, item->group);
+
+    object->modelViewMatrix.multiply(camera->matrixWorldInverse(), object->matrixWorld());
+    object->normalMatrix = object->modelViewMatrix.normalMatrix();
+
+    memcpy(data, object->matrixWorld().elements(), 16 * sizeof(float));
+    memcpy(data + 16, object->normalMatrix.elements(), 9 * sizeof(float));
+    data += _instanceStride;
+  }
+
+  uploadInstances();
+
+  const RenderItem &first = *_instanceRun.front();
+  renderBufferDirect(camera, scene->fog(), first.geometry, material, first.object, first.group,
+                     (GLsizei)_instanceRun.size());
+
+  for(const RenderItem *item : _instanceRun) {
+    item->object->onAfterRender.emitSignal(*this, scene, camera, *item->object, item->group);
+  }
+}
+
+GLsizei Renderer_impl::prepareInstances(InstancedMesh &mesh, const Camera &camera)
+{
+  bool culled = mesh.frustumCulled;
+
+  //reuse what was uploaded for the same instances and camera placement, in this frame (other
+  //materials, passes) or before. Mesh versions are unique, so a recycled address never matches
+  std::vector<InstanceCache> &caches = _instanceCaches[&mesh];
+  InstanceCache *cache = nullptr;
+
+  for(InstanceCache &entry : caches) {
+    if(entry.culled == culled && entry.viewMatrix == camera.matrixWorldInverse()
+       && (!culled || entry.projectionMatrix == camera.projectionMatrix())) {
+      cache = &entry;
+      break;
+    }
+  }
+  if(cache && cache->version == mesh.version() && cache->matrixWorld == mesh.matrixWorld()) {
+    cache->frame = _infoRender.frame;
+    _instanceSource = cache->buffer;
+    _instanceStride = cache->stride;
+    return cache->count;
+  }
+  if(!cache) {
+    //recycle an entry not used in this frame, e.g. one for a camera that has moved since
+    for(InstanceCache &entry : caches) {
+      if(entry.frame != _infoRender.frame) {
+        cache = &entry;
+        break;
+      }
+    }
+    if(!cache) {
+      caches.emplace_back();
+      cache = &caches.back();
+    }
+  }
+
+  math::Frustum frustum;
+  if(culled) {
+    frustum.set(camera.projectionMatrix() * camera.matrixWorldInverse());
+
+    if (mesh.geometry()->boundingSphere().isEmpty()) mesh.geometry()->computeBoundingSphere();
+  }
+  const math::Sphere &bounds = mesh.geometry()->boundingSphere();
+
+  _instanceStride = mesh.hasColors() ? instance_floats + 3 : instance_floats;
+  _instanceData.resize(mesh.count() * _instanceStride);
+  float *data = _instanceData.data();
+
+  //cull and compact, so that only the visible instances are uploaded
+  math::Matrix4 matrixWorld, modelViewMatrix;
+  GLsizei count = 0;
+
+  for(size_t index = 0, size = mesh.count(); index < size; index++) {
+    if(!mesh.visibleAt(index)) continue;
+
+    matrixWorld.multiply(mesh.matrixWorld(), mesh.matrixAt(index));
+
+    if(culled) {
+      math::Sphere sphere = bounds;
+      sphere.apply(matrixWorld);
+      if(!frustum.intersectsSphere(sphere)) continue;
+    }
+
+    modelViewMatrix.multiply(camera.matrixWorldInverse(), matrixWorld);
+    math::Matrix3 normalMatrix = modelViewMatrix.normalMatrix();
+
+    memcpy(data, matrixWorld.elements(), 16 * sizeof(float));
+    memcpy(data + 16, normalMatrix.elements(), 9 * sizeof(float));
+    if(mesh.hasColors()) memcpy(data + 25, mesh.colorAt(index).elements, 3 * sizeof(float));
+
+    data += _instanceStride;
+    count++;
+  }
+
+  _instanceData.resize(count * _instanceStride);
+
+  if(count > 0) {
+    if(!cache->buffer) glGenBuffers(1, &cache->buffer);
+
+    //orphan the previous contents, the driver may still be reading them
+    glBindBuffer(GL_ARRAY_BUFFER, cache->buffer);
+    glBufferData(GL_ARRAY_BUFFER, _instanceData.size() * sizeof(float), _instanceData.data(), GL_DYNAMIC_DRAW);
+    check_glerror(this, _validation);
+  }
+  cache->stride = _instanceStride;
+  cache->count = count;
+  cache->version = mesh.version();
+  cache->frame = _infoRender.frame;
+  cache->culled = culled;
+  cache->matrixWorld = mesh.matrixWorld();
+  cache->viewMatrix = camera.matrixWorldInverse();
+  cache->projectionMatrix = camera.projectionMatrix();
+  _instanceSource = cache->buffer;
+
+  return count;
+}
+
+void Renderer_impl::uploadInstances()
+{
+  if(!_instanceBuffer) glGenBuffers(1, &_instanceBuffer);
+
+  //orphan the previous contents, the driver may still be reading them
+  glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+  glBufferData(GL_ARRAY_BUFFER, _instanceData.size() * sizeof(float), _instanceData.data(), GL_STREAM_DRAW);
+  check_glerror(this, _validation);
+
+  _instanceSource = _instanceBuffer;
+}
+
+void Renderer_impl::purgeInstanceCaches(bool all)
+{
+  for(auto it = _instanceCaches.begin(); it != _instanceCaches.end(); ) {
+    std::vector<InstanceCache> &caches = it->second;
+
+    for(size_t i = 0; i < caches.size(); ) {
+      if(all || caches[i].frame + instance_cache_frames < _infoRender.frame) {
+        if(caches[i].buffer) glDeleteBuffers(1, &caches[i].buffer);
+        caches.erase(caches.begin() + i);
+      }
+      else i++;
+    }
+    if(caches.empty()) it = _instanceCaches.erase(it);
+    else ++it;
+  }
+}
+
+void Renderer_impl::setupInstanceAttributes(const Program *program, Object3D *object, bool instanced)
+{
+  GLint modelMatrix = program->instanceModelMatrix();
+  GLint normalMatrix = program->instanceNormalMatrix();
+  GLint color = program->instanceColor();
+
+  if(instanced) {
+    GLsizei stride = _instanceStride * sizeof(float);
+
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceSource);
+
+    for(unsigned i = 0; modelMatrix >= 0 && i < 4; i++) {
+      _state.enableAttributeAndDivisor(modelMatrix + i, 1);
+      glVertexAttribPointer(modelMatrix + i, 4, GL_FLOAT, GL_FALSE, stride, (void *)(i * 4 * sizeof(float)));
+    }
+    for(unsigned i = 0; normalMatrix >= 0 && i < 3; i++) {
+      _state.enableAttributeAndDivisor(normalMatrix + i, 1);
+      glVertexAttribPointer(normalMatrix + i, 3, GL_FLOAT, GL_FALSE, stride, (void *)((16 + i * 3) * sizeof(float)));
+    }
+    if(color >= 0 && _instanceStride > instance_floats) {
+      _state.enableAttributeAndDivisor(color, 1);
+      glVertexAttribPointer(color, 3, GL_FLOAT, GL_FALSE, stride, (void *)(instance_floats * sizeof(float)));
+    }
+    else if(color >= 0) {
+      _state.disableAttribute(color);
+      glVertexAttrib3f(color, 1, 1, 1);
+    }
+  }
+  else {
+    //single object: constant attribute values
+    for(unsigned i = 0; modelMatrix >= 0 && i < 4; i++) {
+      _state.disableAttribute(modelMatrix + i);
+      glVertexAttrib4fv(modelMatrix + i, object->matrixWorld().elements() + i * 4);
+    }
+    for(unsigned i = 0; normalMatrix >= 0 && i < 3; i++) {
+      _state.disableAttribute(normalMatrix + i);
+      glVertexAttrib3fv(normalMatrix + i, object->normalMatrix.elements() + i * 3);
+    }
+    if(color >= 0) {
+      _state.disableAttribute(color);
+      glVertexAttrib3f(color, 1, 1, 1);
+    }
+  }
+  check_glerror(this, _validation);
+}
+
+void Renderer_impl::renderObject(Object3D *object, const Scene::Ptr &scene, const Camera::Ptr &camera,
+                                 BufferGeometry *geometry, Material *material, const Group *group)
 {
   object->onBeforeRender.emitSignal(*this, scene, camera, *object, group);
 
@@ -415,12 +923,27 @@ void Renderer_impl::renderObject(Object3D::Ptr object, Scene::Ptr scene, Camera:
     _state.setMaterial( material, object->frontFaceCW() );
 
     Program::Ptr program = setProgram( camera, scene->fog(), material, object );
+    if(!program) return;
 
     _currentGeometryProgram = no_program;
+    _state.bindVertexArray(nullptr);
 
     renderObjectImmediate( *iro, program, material );
   }
+  else if(_validation == Validation::Sync) {
+    try {
+      renderBufferDirect( camera, scene->fog(), geometry, material, object, group );
+    }
+    catch(const std::logic_error &error) {
+      std::stringstream ss;
+      ss << error.what() << " [object " << object->id() << " '" << object->name() << "', material "
+         << material->id << " '" << material->name << "']";
+      throw std::logic_error(ss.str());
+    }
+  }
   else {
+    if(_validation == Validation::Async) _debugOutput.setCurrent(object, material);
+
     renderBufferDirect( camera, scene->fog(), geometry, material, object, group );
   }
 
@@ -448,15 +971,30 @@ void Renderer_impl::prepareLights(Object3D::Ptr object, Camera::Ptr camera)
   }
 }
 
-void Renderer_impl::projectObject(Object3D::Ptr object, Camera::Ptr camera, bool sortObjects )
+void Renderer_impl::projectObject(const Object3D::Ptr &object, const Camera::Ptr &camera, bool sortObjects,
+                                  bool insideFrustum )
 {
   if (!object->visible()) return;
 
+  if (!insideFrustum && object->hasSubtreeBounds()) {
+
+    const math::Sphere &bounds = object->subtreeBoundingSphere();
+    if (bounds.isEmpty() || !_frustum.intersectsSphere(bounds)) return;
+
+    insideFrustum = _frustum.containsSphere(bounds);
+  }
+
+  LOD *lod = object->typer;
+  if(lod) {
+    lod->update(*camera);
+    countLevel(*lod);
+  }
+
   if (object->layers().test(camera->layers())) {
 
     if(Sprite *sprite = object->typer) {
 
-      if ( ! sprite->frustumCulled || _frustum.intersectsSprite(*sprite) ) {
+      if ( ! sprite->frustumCulled || insideFrustum || _frustum.intersectsSprite(*sprite) ) {
         _spritesArray.push_back( CAST2(object, Sprite));
       }
     }
@@ -470,55 +1008,240 @@ void Renderer_impl::projectObject(Object3D::Ptr object, Camera::Ptr camera, bool
 
         _vector3 = object->matrixWorld().getPosition().apply( _projScreenMatrix );
       }
-      _currentRenderList->push_back(object, nullptr, object->material(), _vector3.z(), nullptr );
+      _currentRenderList->push_back(object.get(), nullptr, object->material().get(), _vector3.z(), nullptr );
     }
     else if(object->is<Mesh>() || object->is<Line>() || object->is<Points>()) {
 
       if(SkinnedMesh *skmesh = object->typer) {
         skmesh->skeleton()->update();
       }
-      if ( ! object->frustumCulled || _frustum.intersectsObject( *object ) ) {
+      if ( ! object->frustumCulled || insideFrustum || _frustum.intersectsObject( *object ) ) {
 
         if ( sortObjects ) {
           _vector3 = object->matrixWorld().getPosition().apply( _projScreenMatrix );
         }
 
-        BufferGeometry::Ptr geometry = _objects.update( object );
+        pushRenderable(object, _vector3.z());
+      }
+    }
+  }
+
+  for (const Object3D::Ptr &child : object->children()) {
+
+    if(lod && lod->skipped(child.get())) continue;
+
+    projectObject( child, camera, sortObjects, insideFrustum );
+  }
+}
+
+void Renderer_impl::collectCandidates(const Object3D::Ptr &object, const Camera::Ptr &camera)
+{
+  if (!object->visible()) return;
+
+  RenderList::Source &source = _currentRenderList->source;
+  using Kind = RenderList::Source::Kind;
 
-        if ( object->materialCount() > 1) {
+  // the levels to traverse depend on the camera
+  if(object->is<LOD>()) {
+    source.cameraDependent = true;
+    return;
+  }
 
-          const vector<Group> &groups = geometry->groups();
+  if (object->layers().test(camera->layers())) {
 
-          for (const Group &group : groups) {
+    if(object->is<Sprite>())
+      source.candidates.push_back({&object, Kind::Sprite});
+    else if(object->is<LensFlare>())
+      source.candidates.push_back({&object, Kind::LensFlare});
+    else if(object->is<ImmediateRenderObject>())
+      source.candidates.push_back({&object, Kind::Immediate});
+    else if(object->is<Mesh>() || object->is<Line>() || object->is<Points>())
+      source.candidates.push_back({&object, Kind::Renderable});
+  }
 
-            Material::Ptr groupMaterial = object->material(group.materialIndex);
+  for (const Object3D::Ptr &child : object->children()) {
 
-            if ( groupMaterial && groupMaterial->visible ) {
+    collectCandidates( child, camera );
+  }
+}
 
-              _currentRenderList->push_back( object, geometry, groupMaterial, _vector3.z(), &group );
-            }
+void Renderer_impl::projectCandidates(const std::vector<RenderList::Source::Candidate> &candidates, bool sortObjects)
+{
+  using Kind = RenderList::Source::Kind;
+
+  for(const RenderList::Source::Candidate &candidate : candidates) {
+
+    const Object3D::Ptr &object = *candidate.object;
+
+    switch(candidate.kind) {
+      case Kind::Sprite: {
+        Sprite *sprite = object->typer;
+        if ( ! sprite->frustumCulled || _frustum.intersectsSprite(*sprite) ) {
+          _spritesArray.push_back( CAST2(object, Sprite));
+        }
+        break;
+      }
+      case Kind::LensFlare:
+        _flaresArray.push_back(CAST2(object, LensFlare));
+        break;
+      case Kind::Immediate:
+        if ( sortObjects ) {
+          _vector3 = object->matrixWorld().getPosition().apply( _projScreenMatrix );
+        }
+        _currentRenderList->push_back(object.get(), nullptr, object->material().get(), _vector3.z(), nullptr );
+        break;
+      case Kind::Renderable:
+        if(SkinnedMesh *skmesh = object->typer) {
+          skmesh->skeleton()->update();
+        }
+        if ( ! object->frustumCulled || _frustum.intersectsObject( *object ) ) {
+
+          if ( sortObjects ) {
+            _vector3 = object->matrixWorld().getPosition().apply( _projScreenMatrix );
           }
-        } else {
-          Material::Ptr material = object->material();
-          if ( material->visible )
-            _currentRenderList->push_back( object, geometry, material, _vector3.z(), nullptr);
+          pushRenderable(object, _vector3.z());
         }
+        break;
+    }
+  }
+}
+
+void Renderer_impl::countLevel(const LOD &lod)
+{
+  size_t level = lod.currentLevel();
+
+  if(_infoRender.lodLevels.size() <= level) _infoRender.lodLevels.resize(level + 1, 0);
+  _infoRender.lodLevels[level]++;
+
+  if(lod.switched()) _infoRender.lodSwitches++;
+
+  // a camera change may select different levels, see collectCandidates
+  _currentRenderList->source.cameraDependent = true;
+}
+
+void Renderer_impl::projectParallel(const Object3D::Ptr &object, const Camera::Ptr &camera, bool sortObjects )
+{
+  _projection.project(object, _frustum, _projScreenMatrix, *camera, sortObjects);
+
+  //merge on the render thread, in scene graph order. Geometry updates may upload to GL
+  _projection.forEach([this](const ParallelProjection::Projected &projected) {
+
+    const Object3D::Ptr &object = *projected.object;
+
+    switch(projected.kind) {
+      case ParallelProjection::Kind::Sprite:
+        _spritesArray.push_back( CAST2(object, Sprite));
+        break;
+      case ParallelProjection::Kind::LensFlare:
+        _flaresArray.push_back(CAST2(object, LensFlare));
+        break;
+      case ParallelProjection::Kind::LOD: {
+        LOD *lod = object->typer;
+        countLevel(*lod);
+        break;
       }
+      case ParallelProjection::Kind::Immediate:
+        _currentRenderList->push_back(object.get(), nullptr, object->material().get(), projected.z, nullptr );
+        break;
+      case ParallelProjection::Kind::Renderable:
+        if(SkinnedMesh *skmesh = object->typer) {
+          skmesh->skeleton()->update();
+        }
+        if(!projected.cullPending || _frustum.intersectsObject( *object ))
+          pushRenderable(object, projected.z);
+        break;
     }
+  });
+}
+
+void Renderer_impl::pushRenderable(const Object3D::Ptr &object, float z)
+{
+  BufferGeometry *geometry = _objects.update( object ).get();
+
+  // object refers to an entry in its parent's children, see RenderList::Source
+  _currentRenderList->source.renderables.push_back(&object);
+
+  // decided once all occluders are known, see cullOccluded
+  if(occlusionCulling) {
+    _occlusionCandidates.push_back({object.get(), geometry, z});
+    return;
   }
 
-  for (Object3D::Ptr child : object->children()) {
+  pushItems(object.get(), geometry, z);
+}
+
+void Renderer_impl::cullOccluded()
+{
+  _occlusion.begin(_projScreenMatrix);
 
-    projectObject( child, camera, sortObjects );
+  for(const OcclusionCandidate &candidate : _occlusionCandidates) {
+    Object3D *object = candidate.object;
+
+    // instanced and skinned geometry is not where the render geometry says
+    if(!object->occluder || !object->is<Mesh>() || object->is<InstancedMesh>() || object->is<SkinnedMesh>())
+      continue;
+
+    BufferGeometry *geometry = object->occluderGeometry ? object->occluderGeometry.get() : candidate.geometry;
+    if(geometry) _occlusion.addOccluder(*geometry, object->matrixWorld());
+  }
+
+  bool occlusion = _occlusion.triangleCount() > 0;
+  if(occlusion) _occlusion.rasterize(_workers);
+
+  for(const OcclusionCandidate &candidate : _occlusionCandidates) {
+    Object3D *object = candidate.object;
+
+    if(occlusion && !object->occluder && object->frustumCulled) {
+      // skinned vertices may leave the bind pose bounds
+      math::Sphere sphere;
+      if(InstancedMesh *instanced = object->typer)
+        sphere = instanced->boundingSphere();
+      else if(candidate.geometry && !object->is<SkinnedMesh>())
+        sphere = candidate.geometry->boundingSphere();
+
+      if(!sphere.isEmpty()) {
+        sphere.apply(object->matrixWorld());
+
+        _infoRender.occlusionTested++;
+        if(!_occlusion.visible(sphere)) {
+          _infoRender.occlusionCulled++;
+          continue;
+        }
+      }
+    }
+    pushItems(object, candidate.geometry, candidate.z);
   }
+  _occlusionCandidates.clear();
 }
 
-void Renderer_impl::renderObjectImmediate(ImmediateRenderObject &object, Program::Ptr program, Material::Ptr material)
+void Renderer_impl::pushItems(Object3D *object, BufferGeometry *geometry, float z)
+{
+  if ( object->materialCount() > 1) {
+
+    const vector<Group> &groups = geometry->groups();
+
+    for (const Group &group : groups) {
+
+      Material *groupMaterial = object->material(group.materialIndex).get();
+
+      if ( groupMaterial && groupMaterial->visible ) {
+
+        _currentRenderList->push_back( object, geometry, groupMaterial, z, &group );
+      }
+    }
+  } else {
+    Material *material = object->material().get();
+    if ( material->visible )
+      _currentRenderList->push_back( object, geometry, material, z, nullptr);
+  }
+}
+
+void Renderer_impl::renderObjectImmediate(ImmediateRenderObject &object, Program::Ptr program, Material *material)
 {
   renderBufferImmediate(object, program, material );
 }
 
-void Renderer_impl::renderBufferImmediate(ImmediateRenderObject &object, Program::Ptr program, Material::Ptr material)
+void Renderer_impl::renderBufferImmediate(ImmediateRenderObject &object, Program::Ptr program, Material *material)
 {
   _state.initAttributes();
 #if 0
@@ -612,16 +1335,23 @@ void Renderer_impl::renderBufferImmediate(ImmediateRenderObject &object, Program
 #endif
 }
 
-void Renderer_impl::renderBufferDirect(Camera::Ptr camera,
-                                       Fog::Ptr fog,
-                                       BufferGeometry::Ptr geometry,
-                                       Material::Ptr material,
-                                       Object3D::Ptr object,
-                                       const Group *group)
+void Renderer_impl::renderBufferDirect(const Camera::Ptr &camera,
+                                       const Fog::Ptr &fog,
+                                       BufferGeometry *geometry,
+                                       Material *material,
+                                       Object3D *object,
+                                       const Group *group,
+                                       GLsizei instanceCount)
 {
+  if(InstancedMesh *instanced = object->typer) {
+    //all instances culled
+    if((instanceCount = prepareInstances(*instanced, *camera)) == 0) return;
+  }
+
   _state.setMaterial( material, object->frontFaceCW());
 
   Program::Ptr program = setProgram( camera, fog, material, object );
+  if(!program) return;
 
   tuple<size_t, GLuint, bool> geometryProgram {geometry->id, program->handle(), material->wireframe};
 
@@ -634,7 +1364,8 @@ void Renderer_impl::renderBufferDirect(Camera::Ptr camera,
   }
 
   Mesh *mesh = object->typer;
-  if ( mesh && !mesh->morphTargetInfluences().empty() ) {
+  bool morphing = mesh && !mesh->morphTargetInfluences().empty();
+  if ( morphing ) {
 
     _morphTargets.update( mesh, geometry, material, program );
 
@@ -653,14 +1384,27 @@ void Renderer_impl::renderBufferDirect(Camera::Ptr camera,
     index = geometry->index();
   }
 
-  if ( updateBuffers )
-    setupVertexAttributes( material, program, geometry );
+  // morph attributes are reassigned every frame, so they are not worth recording
+  bool vertexArray = _capabilities.vertexArrayObjects && !morphing;
+
+  if ( updateBuffers ) {
+    if ( vertexArray ) {
+      setupVertexArray( material, program, geometry, index );
+    }
+    else {
+      _state.bindVertexArray( nullptr );
+      setupVertexAttributes( material, program, geometry );
+    }
+  }
+
+  if (program->instanceModelMatrix() >= 0 || program->instanceNormalMatrix() >= 0 || program->instanceColor() >= 0)
+    setupInstanceAttributes( program.get(), object, instanceCount > 0 );
 
   if (index) {
 
     const Buffer &attribute = _attributes.get( *index );
 
-    if ( updateBuffers )
+    if ( updateBuffers && !vertexArray )
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, attribute.handle);
 
     _indexedBufferRenderer.setIndex(attribute.type, attribute.bytesPerElement);
@@ -736,32 +1480,38 @@ void Renderer_impl::renderBufferDirect(Camera::Ptr camera,
       renderer->renderInstances( ibg, drawStart, drawCount );
     }
   }
+  else if (instanceCount > 0) {
+    renderer->renderInstances( drawStart, drawCount, instanceCount );
+  }
   else {
-    glValidateProgram(program->handle());
-    GLint status;
-    glGetProgramiv(program->handle(), GL_VALIDATE_STATUS, &status);
-    if(status != GL_TRUE) {
-      char buf[500];
-      int len;
-      glGetProgramInfoLog(program->handle(), 500, &len, buf);
-      qCritical() << buf;
+    if(_validation == Validation::Sync) {
+      glValidateProgram(program->handle());
+      GLint status;
+      glGetProgramiv(program->handle(), GL_VALIDATE_STATUS, &status);
+      if(status != GL_TRUE) {
+        char buf[500];
+        int len;
+        glGetProgramInfoLog(program->handle(), 500, &len, buf);
+        qCritical() << buf << "object" << object->id() << object->name().c_str()
+                    << "material" << material->id << material->name.c_str();
+      }
     }
 
     renderer->render( drawStart, drawCount );
   }
 }
 
-void Renderer_impl::setupVertexAttributes(Material::Ptr material,
+void Renderer_impl::setupVertexAttributes(Material *material,
                                           Program::Ptr program,
-                                          BufferGeometry::Ptr geometry,
+                                          BufferGeometry *geometry,
                                           unsigned startIndex)
 {
-  /*if ( geometry && geometry.isInstancedBufferGeometry ) {
-    if ( extensions.get( 'ANGLE_instanced_arrays' ) === null ) {
-      console.error( 'THREE.WebGLRenderer.setupVertexAttributes: using THREE.InstancedBufferGeometry but hardware does not support extension ANGLE_instanced_arrays.' );
-      return;
-    }
-  }*/
+  InstancedBufferGeometry *instancedGeometry = geometry->typer;
+
+  if ( instancedGeometry && !_extensions.get( Extension::ANGLE_instanced_arrays ) ) {
+    qCritical() << "setupVertexAttributes: using InstancedBufferGeometry but hardware does not support extension ANGLE_instanced_arrays";
+    return;
+  }
 
   _state.initAttributes();
 
@@ -797,68 +1547,50 @@ void Renderer_impl::setupVertexAttributes(Material::Ptr material,
           GLsizei stride = (GLsizei) data.stride();
           GLsizei offset = (GLsizei) iba->offset();
 
-          /*if ( data && data.isInstancedInterleavedBuffer ) {
-
-            state.enableAttributeAndDivisor( programAttribute, data.meshPerAttribute );
+          if ( instancedGeometry && iba->meshPerAttribute > 0 ) {
 
-            if ( geometry.maxInstancedCount === undefined ) {
+            _state.enableAttributeAndDivisor( programAttribute, iba->meshPerAttribute );
 
-              geometry.maxInstancedCount = data.meshPerAttribute * data.count;
+            if ( instancedGeometry->maxInstancedCount() == 0 ) {
 
+              instancedGeometry->setMaxInstancedCount( iba->meshPerAttribute * (unsigned)iba->count() );
             }
+          }
+          else {
 
-          } else {*/
-
-          _state.enableAttribute(programAttribute);
-
-          //}
+            _state.enableAttribute(programAttribute);
+          }
 
           glBindBuffer(GL_ARRAY_BUFFER, buffer);
           glVertexAttribPointer(programAttribute, size, type, normalized, stride * bytesPerElement,
                                 (void *) ((startIndex * stride + offset) * bytesPerElement));
-          check_glerror(this);
+          check_glerror(this, _validation);
         }
         else {
-          /*if ( geometryAttribute.isInstancedBufferAttribute ) {
-
-            state.enableAttributeAndDivisor( programAttribute, geometryAttribute.meshPerAttribute );
+          if ( instancedGeometry && geometryAttribute->meshPerAttribute > 0 ) {
 
-            if ( geometry.maxInstancedCount === undefined ) {
+            _state.enableAttributeAndDivisor( programAttribute, geometryAttribute->meshPerAttribute );
 
-              geometry.maxInstancedCount = geometryAttribute.meshPerAttribute * geometryAttribute.count;
+            if ( instancedGeometry->maxInstancedCount() == 0 ) {
 
+              unsigned count = (unsigned)(geometryAttribute->byteCount() / (size * bytesPerElement));
+              instancedGeometry->setMaxInstancedCount( geometryAttribute->meshPerAttribute * count );
             }
+          }
+          else {
 
-          } else {*/
-
-          _state.enableAttribute(programAttribute);
-
-          //}
+            _state.enableAttribute(programAttribute);
+          }
 
           glBindBuffer(GL_ARRAY_BUFFER, buffer);
           glVertexAttribPointer(programAttribute, size, type, normalized, 0, (void *) (startIndex * size * bytesPerElement));
-          check_glerror(this);
+          check_glerror(this, _validation);
         }
       }
       else {
 
         ShaderMaterial *shaderMat = material->typer;
-        if (shaderMat) {
-
-          switch (name) {
-
-            case AttributeName::color:
-              glVertexAttrib3fv(programAttribute, shaderMat->default_color.elements());
-              break;
-            case AttributeName::uv:
-              glVertexAttrib2fv(programAttribute, shaderMat->default_uv.elements());
-              break;
-            case AttributeName::uv2:
-              glVertexAttrib2fv(programAttribute, shaderMat->default_uv2.elements());
-              break;
-          }
-          check_glerror(this);
-        }
+        if (shaderMat) setDefaultAttribute(shaderMat, name, programAttribute);
       }
     }
 
@@ -867,18 +1599,186 @@ void Renderer_impl::setupVertexAttributes(Material::Ptr material,
   _state.disableUnusedAttributes();
 }
 
-void Renderer_impl::releaseMaterialProgramReference(Material &material)
+void Renderer_impl::setDefaultAttribute(ShaderMaterial *material, AttributeName name, GLuint location)
 {
-  auto programInfo = _properties.get( material ).program;
+  switch (name) {
+
+    case AttributeName::color:
+      glVertexAttrib3fv(location, material->default_color.elements());
+      break;
+    case AttributeName::uv:
+      glVertexAttrib2fv(location, material->default_uv.elements());
+      break;
+    case AttributeName::uv2:
+      glVertexAttrib2fv(location, material->default_uv2.elements());
+      break;
+  }
+  check_glerror(this, _validation);
+}
 
-  if (programInfo) {
-    _programs->releaseProgram( programInfo );
+void Renderer_impl::setupVertexArray(Material *material,
+                                     const Program::Ptr &program,
+                                     BufferGeometry *geometry,
+                                     const BufferAttributeT<uint32_t>::Ptr &index)
+{
+  VertexArray &vertexArray = _properties.getVertexArray(geometry->id, program->handle(), material->wireframe);
+
+  // collect the current bindings. Attributes that were added, removed or re-created since the
+  // array was recorded show up as a mismatch
+  _bindings.clear();
+  bool missing = false;
+
+  for (const auto &att : program->getAttributes()) {
+
+    const BufferAttribute::Ptr &attribute = geometry->getAttribute(att.first);
+
+    if(attribute && _attributes.has(*attribute))
+      _bindings.push_back({att.second, _attributes.get(*attribute).handle, attribute->meshPerAttribute});
+    else {
+      _bindings.push_back({att.second, 0, 0});
+      missing = true;
+    }
   }
+  if(index) _bindings.push_back({-1, _attributes.get(*index).handle, 0});
+
+  ShaderMaterial *shaderMat = material->typer;
+
+  if(vertexArray.handle && vertexArray.bindings == _bindings) {
+
+    _state.bindVertexArray(&vertexArray);
+
+    // constant attribute values are context state, not vertex array state
+    if(vertexArray.defaultAttributes) {
+      for (const auto &att : program->getAttributes()) {
+        if(!geometry->getAttribute(att.first)) setDefaultAttribute(shaderMat, att.first, att.second);
+      }
+    }
+    return;
+  }
+
+  if(!vertexArray.handle) glGenVertexArrays(1, &vertexArray.handle);
+
+  _state.bindVertexArray(&vertexArray);
+
+  setupVertexAttributes(material, program, geometry);
+
+  if(index) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _attributes.get(*index).handle);
+  check_glerror(this, _validation);
+
+  vertexArray.bindings = _bindings;
+  vertexArray.defaultAttributes = missing && shaderMat;
 }
 
-void Renderer_impl::initMaterial(Material::Ptr material, Fog::Ptr fog, Object3D::Ptr object)
+void Renderer_impl::watchMaterial(Material *material)
 {
   MaterialProperties &materialProperties = _properties.get( *material );
+  if(materialProperties.watched) return;
+
+  material->onDispose.connect([this](Material *material) {
+    releaseMaterialProgramReference(*material);
+    _properties.remove(*material);
+  });
+  materialProperties.watched = true;
+}
+
+void Renderer_impl::releaseMaterialProgramReference(Material &material)
+{
+  for(const Program::Ptr &programInfo : _properties.programs( material )) {
+    _programs->releaseProgram( programInfo );
+  }
+}
+
+Shader Renderer_impl::materialShader(Material *material, const ProgramParameters &parameters)
+{
+  const char *name = material->info.shaderName;
+  if(*parameters.shaderID != ShaderID::undefined) {
+
+    return Shader(name, shaderlib::get(*parameters.shaderID));
+  }
+  else {
+    ShaderMaterial *sm = material->typer;
+    if(sm)
+      return Shader(name, sm->uniforms, sm->vertexShader, sm->fragmentShader);
+    else
+      throw logic_error("unable to determine shader");
+  }
+}
+
+bool Renderer_impl::programReady(Material *material, const Fog::Ptr &fog, Object3D *object)
+{
+  ProgramParameters::Ptr parameters = _programs->getParameters(*this,
+     material, _lights.state, _shadowsArray, fog, _clipping.numPlanes(), _clipping.numIntersection(), object );
+
+  Program::Ptr program = _programs->findProgram(parameters);
+  if(!program) {
+
+    // without parallel compilation, every build blocks the render thread
+    if(!_parallelCompile) {
+      if(_programBudget == 0) return false;
+      _programBudget--;
+    }
+
+    Shader shader = materialShader(material, *parameters);
+    program = _programs->acquireProgram(*this, material, shader, parameters);
+
+    // the material keeps the program alive until it is drawn with a program or disposed
+    MaterialProperties &materialProperties = _properties.get( *material, Programs::instancing(*this, material, object) );
+    if(materialProperties.warmup) _programs->releaseProgram( materialProperties.warmup );
+    materialProperties.warmup = program;
+    watchMaterial(material);
+  }
+
+  return program->ready();
+}
+
+void Renderer_impl::compileObject(const Object3D::Ptr &object, const Fog::Ptr &fog, const Camera::Ptr &camera,
+                                  bool &ready)
+{
+  if (!object->visible()) return;
+
+  if (object->layers().test(camera->layers())
+      && (object->is<Mesh>() || object->is<Line>() || object->is<Points>())) {
+
+    for(size_t i = 0; i < object->materialCount(); i++) {
+      Material *material = object->material(i).get();
+      if(!material || !material->visible) continue;
+
+      if(!programReady(material, fog, object.get())) ready = false;
+    }
+  }
+
+  for (const Object3D::Ptr &child : object->children()) {
+
+    compileObject( child, fog, camera, ready );
+  }
+}
+
+bool Renderer_impl::compile(const Scene::Ptr &scene, const Camera::Ptr &camera)
+{
+  if (scene->autoUpdate()) scene->updateMatrixWorld(false);
+  if (!camera->parent()) camera->updateMatrixWorld(false);
+
+  // the program parameters depend on the lights and clipping planes, set them up as for rendering
+  _lightsArray.clear();
+  _shadowsArray.clear();
+
+  prepareLights(scene, camera);
+
+  _lights.setup(_lightsArray, _shadowsArray.size(), camera, clusteredLighting && !camera->is<ArrayCamera>());
+  _clippingEnabled = _clipping.init(_clippingPlanes, _localClippingEnabled, camera);
+
+  // without asyncCompile, everything is built right away
+  _programBudget = asyncCompile ? programsPerFrame : numeric_limits<unsigned>::max();
+
+  bool ready = true;
+  compileObject(scene, scene->fog(), camera, ready);
+
+  return ready;
+}
+
+void Renderer_impl::initMaterial(Material *material, const Fog::Ptr &fog, Object3D *object)
+{
+  MaterialProperties &materialProperties = _properties.get( *material, Programs::instancing(*this, material, object) );
 
   ProgramParameters::Ptr parameters = _programs->getParameters(*this,
      material, _lights.state, _shadowsArray, fog, _clipping.numPlanes(), _clipping.numIntersection(), object );
@@ -886,16 +1786,14 @@ void Renderer_impl::initMaterial(Material::Ptr material, Fog::Ptr fog, Object3D:
   auto program = materialProperties.program;
   bool programChange = true;
 
-  if (!program) {
-    // new material
-    material->onDispose.connect([this](Material *material) {
-      releaseMaterialProgramReference(*material);
-      _properties.remove(*material);
-    });
+  watchMaterial(material);
+
+  if(!program) {
+    // new material, or first use of this instancing variant
   }
   else if(*program->parameters != *parameters) {
     // changed glsl or parameters
-    releaseMaterialProgramReference(*material );
+    _programs->releaseProgram( program );
   }
   else if (materialProperties.shaderID != ShaderID::undefined ) {
     // same glsl and uniform list
@@ -908,18 +1806,7 @@ void Renderer_impl::initMaterial(Material::Ptr material, Fog::Ptr fog, Object3D:
 
   if(programChange) {
 
-    const char *name = material->info.shaderName;
-    if(*parameters->shaderID != ShaderID::undefined) {
-
-      materialProperties.shader = Shader(name, shaderlib::get(*parameters->shaderID));
-    }
-    else {
-      ShaderMaterial *sm = material->typer;
-      if(sm)
-        materialProperties.shader = Shader(name, sm->uniforms, sm->vertexShader, sm->fragmentShader);
-      else
-        throw logic_error("unable to determine shader");
-    }
+    materialProperties.shader = materialShader(material, *parameters);
 
     //material.onBeforeCompile( materialProperties.shader );
 
@@ -928,6 +1815,12 @@ void Renderer_impl::initMaterial(Material::Ptr material, Fog::Ptr fog, Object3D:
     materialProperties.program = program;
   }
 
+  // dropped after acquiring, so a warm-up program that is used now survives
+  if(materialProperties.warmup) {
+    _programs->releaseProgram( materialProperties.warmup );
+    materialProperties.warmup = nullptr;
+  }
+
   const auto &programAttributes = program->getIndexedAttributes();
 
   if ( material->morphTargets ) {
@@ -981,20 +1874,15 @@ void Renderer_impl::initMaterial(Material::Ptr material, Fog::Ptr fog, Object3D:
 
     // wire up the material to this renderer's lighting state
     uniforms.set(UniformName::spotLights, _lights.state.spot);
-    uniforms.set(UniformName::spotShadowMap, _lights.state.spotShadowMap);
-    uniforms.set(UniformName::spotShadowMatrix, _lights.state.spotShadowMatrix);
-
     uniforms.set(UniformName::directionalLights, _lights.state.directional);
-    uniforms.set(UniformName::directionalShadowMap, _lights.state.directionalShadowMap);
-    uniforms.set(UniformName::directionalShadowMatrix, _lights.state.directionalShadowMatrix);
 
     uniforms.set(UniformName::hemisphereLights, _lights.state.hemi);
     uniforms.set(UniformName::rectAreaLights, _lights.state.rectArea);
     // TODO (abelnation): add area lights shadow info to uniforms
 
     uniforms.set(UniformName::pointLights, _lights.state.point);
-    uniforms.set(UniformName::pointShadowMap, _lights.state.pointShadowMap);
-    uniforms.set(UniformName::pointShadowMatrix, _lights.state.pointShadowMatrix);
+
+    setShadowUniforms(uniforms);
   }
 
   auto progUniforms = materialProperties.program->getUniforms();
@@ -1015,6 +1903,26 @@ void refreshUniforms(UniformValues &uniforms, Fog &fog)
   }
 }
 
+void Renderer_impl::setShadowUniforms(UniformValues &uniforms)
+{
+  // in atlas mode, all shadow maps share one texture unit
+  if(shadowAtlas) uniforms.set(UniformName::shadowAtlas, _shadowMap.atlas());
+
+  uniforms.set(UniformName::spotShadowMap, _lights.state.spotShadowMap);
+  uniforms.set(UniformName::spotShadowMatrix, _lights.state.spotShadowMatrix);
+  uniforms.set(UniformName::spotShadowTile, _lights.state.spotShadowTile);
+
+  uniforms.set(UniformName::directionalShadowMap, _lights.state.directionalShadowMap);
+  uniforms.set(UniformName::directionalShadowMatrix, _lights.state.directionalShadowMatrix);
+  uniforms.set(UniformName::directionalShadowTile, _lights.state.directionalShadowTile);
+  uniforms.set(UniformName::directionalCascadeMatrix, _lights.state.directionalCascadeMatrix);
+  uniforms.set(UniformName::directionalCascadeSplits, _lights.state.directionalCascadeSplits);
+
+  uniforms.set(UniformName::pointShadowMap, _lights.state.pointShadowMap);
+  uniforms.set(UniformName::pointShadowMatrix, _lights.state.pointShadowMatrix);
+  uniforms.set(UniformName::pointShadowTile, _lights.state.pointShadowTile);
+}
+
 void markUniformsLightsNeedsUpdate(UniformValues &uniforms, bool refreshLights )
 {
   uniforms.needsUpdate(UniformName::ambientLightColor, refreshLights);
@@ -1041,11 +1949,11 @@ void uploadUniforms(const std::vector<Uniform::Ptr> &uniformsList, UniformValues
   }
 }
 
-Program::Ptr Renderer_impl::setProgram(Camera::Ptr camera, Fog::Ptr fog, Material::Ptr material, Object3D::Ptr object )
+Program::Ptr Renderer_impl::setProgram(const Camera::Ptr &camera, const Fog::Ptr &fog, Material *material, Object3D *object )
 {
   _usedTextureUnits = 0;
 
-  MaterialProperties &materialProperties = _properties.get( material );
+  MaterialProperties &materialProperties = _properties.get( *material, Programs::instancing(*this, material, object) );
 
   if ( _clippingEnabled ) {
 
@@ -1062,32 +1970,43 @@ Program::Ptr Renderer_impl::setProgram(Camera::Ptr camera, Fog::Ptr fog, Materia
     }
   }
 
-  if (!material->needsUpdate) {
+  // the material flag applies to the programs of all instancing variants
+  if ( material->needsUpdate ) {
+
+    _properties.needsUpdate( *material );
+    materialProperties.needsUpdate = true;
+    material->needsUpdate = false;
+  }
+
+  if (!materialProperties.needsUpdate) {
 
     if (!materialProperties.program) {
 
-      material->needsUpdate = true;
+      materialProperties.needsUpdate = true;
 
     } else if ( material->fog && materialProperties.fog != fog ) {
 
-      material->needsUpdate = true;
+      materialProperties.needsUpdate = true;
 
     } else if ( material->lights && materialProperties.lightsHash != _lights.state.hash) {
 
-      material->needsUpdate = true;
+      materialProperties.needsUpdate = true;
 
     } else if ( materialProperties.numClippingPlanes > 0 &&
        ( materialProperties.numClippingPlanes != _clipping.numPlanes() ||
           materialProperties.numIntersection != _clipping.numIntersection() ) ) {
 
-      material->needsUpdate = true;
+      materialProperties.needsUpdate = true;
     }
   }
 
-  if ( material->needsUpdate ) {
+  if ( materialProperties.needsUpdate ) {
+
+    // skip the draw until the program is built
+    if(asyncCompile && !programReady(material, fog, object)) return nullptr;
 
     initMaterial( material, fog, object );
-    material->needsUpdate = false;
+    materialProperties.needsUpdate = false;
   }
 
   bool refreshProgram = false;
@@ -1112,13 +2031,23 @@ Program::Ptr Renderer_impl::setProgram(Camera::Ptr camera, Fog::Ptr fog, Materia
     refreshMaterial = true;
   }
 
+  // camera and lights are shared through uniform buffers, see UniformBlocks
+  bool uniformBlocks = *program->parameters->uniformBlocks;
+  if(uniformBlocks) _uniformBlocks.setCamera(*camera, _toneMappingExposure, _toneMappingWhitePoint);
+
   if ( refreshProgram || camera != _currentCamera ) {
 
-    prg_uniforms->set(UniformName::projectionMatrix, camera->projectionMatrix());
+    if(!uniformBlocks)
+      prg_uniforms->set(UniformName::projectionMatrix, camera->projectionMatrix());
 
-    if (_capabilities.logarithmicDepthBuffer) {
+    if (_capabilities.logarithmicDepthBuffer && !uniformBlocks) {
       prg_uniforms->set(UniformName::logDepthBufFC, (GLfloat)(2.0f / ( log( camera->far() + 1.0f ) / M_LN2 )));
-      check_glerror(this);
+      check_glerror(this, _validation);
+    }
+
+    if(*program->parameters->clusteredLights) {
+      prg_uniforms->set(UniformName::clusterSlicing, _clusters.slicing());
+      check_glerror(this, _validation);
     }
 
     // Avoid unneeded uniform updates per ArrayCamera's sub-camera
@@ -1135,27 +2064,28 @@ Program::Ptr Renderer_impl::setProgram(Camera::Ptr camera, Fog::Ptr fog, Materia
     }
 
     // load material specific uniforms
-    // (shader material also gets them for the sake of genericity)
+    // (shader material also gets them for the sake of genericity). Skinned and instanced
+    // vertices are transformed to view space with viewMatrix, whatever the material
 
-    if(material->is<MeshPhongMaterial>()
+    if(uniformBlocks) {
+      //already in the camera block
+    }
+    else if(material->is<MeshPhongMaterial>()
        || material->is<MeshLambertMaterial>()
        || material->is<MeshBasicMaterial>()
        || material->is<MeshStandardMaterial>()
-       || material->is<ShaderMaterial>()) {
+       || material->is<ShaderMaterial>()
+       || material->skinning
+       || *program->parameters->instancedTransform) {
 
       if(prg_uniforms->get(UniformName::cameraPosition)) {
         _vector3 = camera->matrixWorld().getPosition();
         prg_uniforms->set(UniformName::cameraPosition, _vector3);
-        check_glerror(this);
+        check_glerror(this, _validation);
       }
 
       prg_uniforms->set( UniformName::viewMatrix, camera->matrixWorldInverse() );
-      check_glerror(this);
-    }
-    else if(material->skinning) {
-
-      prg_uniforms->set( UniformName::viewMatrix, camera->matrixWorldInverse() );
-      check_glerror(this);
+      check_glerror(this, _validation);
     }
   }
 
@@ -1213,10 +2143,15 @@ Program::Ptr Renderer_impl::setProgram(Camera::Ptr camera, Fog::Ptr fog, Materia
   }
   if ( refreshMaterial ) {
 
-    prg_uniforms->set(UniformName::toneMappingExposure, _toneMappingExposure );
-    prg_uniforms->set(UniformName::toneMappingWhitePoint, _toneMappingWhitePoint );
+    if(!uniformBlocks) {
+      prg_uniforms->set(UniformName::toneMappingExposure, _toneMappingExposure);
+      prg_uniforms->set(UniformName::toneMappingWhitePoint, _toneMappingWhitePoint);
+    }
+
+    // the values are copies. Cascades and atlas tiles move from frame to frame
+    if ( material->lights && _shadowMap.enabled ) setShadowUniforms( mat_uniforms );
 
-    if ( material->lights ) {
+    if ( material->lights && !uniformBlocks ) {
 
       // the current material requires lighting info
 
@@ -1291,7 +2226,7 @@ Program::Ptr Renderer_impl::setProgram(Camera::Ptr camera, Fog::Ptr fog, Materia
     else if(ShadowMaterial *mat = material->typer) {
       refresh( mat_uniforms, *mat );
     }
-    check_glerror(this);
+    check_glerror(this, _validation);
 
     // RectAreaLight Texture
     // TODO (mrdoob): Find a nicer implementation
@@ -1315,7 +2250,7 @@ Program::Ptr Renderer_impl::setProgram(Camera::Ptr camera, Fog::Ptr fog, Materia
   prg_uniforms->set(UniformName::normalMatrix, object->normalMatrix );
   prg_uniforms->set(UniformName::modelMatrix, object->matrixWorld() );
 
-  check_glerror(this);
+  check_glerror(this, _validation);
   return program;
 }
 
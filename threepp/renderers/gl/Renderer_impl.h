@@ -28,12 +28,22 @@
 #include "MorphTargets.h"
 #include "Programs.h"
 #include "Background.h"
+#include "FrameSync.h"
+#include "DebugOutput.h"
+#include "ParallelProjection.h"
+#include "UniformBlocks.h"
+#include "Clusters.h"
+#include "ProgramCache.h"
+#include "StaticBatches.h"
+#include "OcclusionCulling.h"
+#include "Residency.h"
 
 #include <QOpenGLShaderProgram>
 
 namespace three {
 
 class ImmediateRenderObject;
+class InstancedMesh;
 
 namespace gl {
 
@@ -122,6 +132,15 @@ protected:
   MemoryInfo _infoMemory;
   RenderInfo _infoRender;
 
+  Residency _residency;
+
+  FrameSync _frameSync;
+
+  DebugOutput _debugOutput;
+  Validation _validation = Validation::Sync;
+  //the option value _validation was derived from
+  Validation _validationRequested = Validation::Sync;
+
   ShadowMap _shadowMap;
 
   Attributes _attributes;
@@ -159,6 +178,62 @@ protected:
   RenderLists _renderLists;
   RenderList *_currentRenderList = nullptr;
 
+  WorkerPool _workers;
+  ParallelProjection _projection;
+
+  struct OcclusionCandidate
+  {
+    Object3D *object;
+    BufferGeometry *geometry;
+    float z;
+  };
+  OcclusionCulling _occlusion;
+  std::vector<OcclusionCandidate> _occlusionCandidates;
+
+  // instance buffer layout: model matrix (16 floats), normal matrix (9 floats), optionally color (3 floats)
+  static constexpr unsigned instance_floats = 25;
+  GLuint _instanceBuffer = 0;
+  unsigned _instanceStride = instance_floats;
+
+  //buffer the instance attributes are read from, _instanceBuffer or a cached one
+  GLuint _instanceSource = 0;
+
+  //culled and uploaded instances of an InstancedMesh, for one camera placement
+  struct InstanceCache
+  {
+    GLuint buffer = 0;
+    unsigned stride = instance_floats;
+    GLsizei count = 0;
+    unsigned version = 0;
+    unsigned frame = 0;
+    bool culled = false;
+    math::Matrix4 matrixWorld;
+    math::Matrix4 viewMatrix;
+    math::Matrix4 projectionMatrix;
+  };
+  std::unordered_map<const InstancedMesh *, std::vector<InstanceCache>> _instanceCaches;
+
+  //frames an unused instance cache is kept
+  static constexpr unsigned instance_cache_frames = 8;
+  std::vector<float> _instanceData;
+  std::vector<const RenderItem *> _instanceRun;
+
+  std::vector<VertexArray::Binding> _bindings;
+
+  UniformBlocks _uniformBlocks;
+
+  Clusters _clusters;
+
+  ProgramCache _programCache;
+
+  //programs are linked by the driver in the background, see Program::ready
+  bool _parallelCompile = false;
+
+  //synchronous program builds left for the current frame, with asyncCompile
+  unsigned _programBudget = 0;
+
+  StaticBatches _staticBatches;
+
   float getTargetPixelRatio()
   {
     return _currentRenderTarget ? _pixelRatio : 1;
@@ -168,11 +243,37 @@ protected:
 
   void initContext() override;
 
-  void initMaterial(Material::Ptr material, Fog::Ptr fog, Object3D::Ptr object);
+  void initMaterial(Material *material, const Fog::Ptr &fog, Object3D *object);
+
+  Shader materialShader(Material *material, const ProgramParameters &parameters);
+
+  //copy the current shadow matrices, tiles and maps into the uniforms of a lit material
+  void setShadowUniforms(UniformValues &uniforms);
+
+  bool programReady(Material *material, const Fog::Ptr &fog, Object3D *object);
+
+  void compileObject(const Object3D::Ptr &object, const Fog::Ptr &fog, const Camera::Ptr &camera, bool &ready);
 
   void prepareLights(Object3D::Ptr object, Camera::Ptr camera);
 
-  void projectObject(Object3D::Ptr object, Camera::Ptr camera, bool sortObjects );
+  void projectObject(const Object3D::Ptr &object, const Camera::Ptr &camera, bool sortObjects,
+                     bool insideFrustum=false );
+
+  void projectParallel(const Object3D::Ptr &object, const Camera::Ptr &camera, bool sortObjects );
+
+  void pushRenderable(const Object3D::Ptr &object, float z);
+
+  void countLevel(const LOD &lod);
+
+  void collectCandidates(const Object3D::Ptr &object, const Camera::Ptr &camera);
+
+  void projectCandidates(const std::vector<RenderList::Source::Candidate> &candidates, bool sortObjects);
+
+  void pushItems(Object3D *object, BufferGeometry *geometry, float z);
+
+  void cullOccluded();
+
+  void evictResources();
 
   void doRender(const Scene::Ptr &scene,
                 const Camera::Ptr &camera,
@@ -180,31 +281,76 @@ protected:
                 bool forceClear) override;
 
   void renderObjects(RenderList::iterator renderIterator,
-                     Scene::Ptr scene,
-                     Camera::Ptr camera,
-                     Material::Ptr overrideMaterial);
+                     const Scene::Ptr &scene,
+                     const Camera::Ptr &camera,
+                     Material *overrideMaterial,
+                     bool instancing=false,
+                     bool multiDraw=false);
+
+  bool instanceable(const RenderItem &item, Material *material);
+
+  bool multiDrawable(const RenderItem &item, Material *material);
+
+  void renderMultiDraw(const Scene::Ptr &scene, const Camera::Ptr &camera, Material *material);
+
+  void renderInstanced(const Scene::Ptr &scene, const Camera::Ptr &camera, Material *material);
+
+  void setupInstanceAttributes(const Program *program, Object3D *object, bool instanced);
+
+  GLsizei prepareInstances(InstancedMesh &mesh, const Camera &camera);
+
+  void uploadInstances();
 
-  void renderObject(Object3D::Ptr object, Scene::Ptr scene, Camera::Ptr camera, BufferGeometry::Ptr geometry,
-                    Material::Ptr material, const Group *group );
+  void purgeInstanceCaches(bool all);
 
-  Program::Ptr setProgram(Camera::Ptr camera, Fog::Ptr fog, Material::Ptr material, Object3D::Ptr object );
+  void renderObject(Object3D *object, const Scene::Ptr &scene, const Camera::Ptr &camera, BufferGeometry *geometry,
+                    Material *material, const Group *group );
+
+  Program::Ptr setProgram(const Camera::Ptr &camera, const Fog::Ptr &fog, Material *material, Object3D *object );
+
+  void watchMaterial(Material *material);
 
   void releaseMaterialProgramReference(Material &material);
 
-  void renderObjectImmediate(ImmediateRenderObject &object, Program::Ptr program, Material::Ptr material);
+  void renderObjectImmediate(ImmediateRenderObject &object, Program::Ptr program, Material *material);
+
+  void renderBufferImmediate(ImmediateRenderObject &object, Program::Ptr program, Material *material);
 
-  void renderBufferImmediate(ImmediateRenderObject &object, Program::Ptr program, Material::Ptr material);
+  void setupVertexAttributes(Material *material, Program::Ptr program, BufferGeometry *geometry, unsigned startIndex=0);
 
-  void setupVertexAttributes(Material::Ptr material, Program::Ptr program, BufferGeometry::Ptr geometry, unsigned startIndex=0);
+  void setDefaultAttribute(ShaderMaterial *material, AttributeName name, GLuint location);
+
+  /**
+   * bind the cached vertex array object for the geometry/program combination, creating or
+   * re-recording it if necessary
+   */
+  void setupVertexArray(Material *material,
+                        const Program::Ptr &program,
+                        BufferGeometry *geometry,
+                        const BufferAttributeT<uint32_t>::Ptr &index);
 
 public:
   using Ptr = std::shared_ptr<Renderer_impl>;
 
-  Renderer_impl(size_t width, size_t height, float pixelRatio, bool premultipliedAlpha=true);
+  Renderer_impl(size_t width, size_t height, float pixelRatio,
+                const OpenGLRendererOptions &options=OpenGLRendererOptions());
   ~Renderer_impl();
 
   gl::State &state() {return _state;}
 
+  //the validation level in effect, see OpenGLRendererOptions::validation
+  Validation validationLevel() const {return _validation;}
+
+  const RenderInfo &renderInfo() const {return _infoRender;}
+
+  const MemoryInfo &memoryInfo() const {return _infoMemory;}
+
+  /**
+   * make the next draw upload the camera uniforms again. Needed if the current camera was moved
+   * since the last draw, like the shadow camera between cube faces
+   */
+  void resetCamera() {_currentCamera = nullptr;}
+
   Renderer_impl &setRenderTarget(const Renderer::Target::Ptr renderTarget);
 
   const Renderer::Target::Ptr getRenderTarget() const {return _currentRenderTarget;}
@@ -217,12 +363,17 @@ public:
 
   std::vector<GLuint> allocTextureUnits(size_t count);
 
-  void renderBufferDirect(Camera::Ptr camera,
-                          Fog::Ptr fog,
-                          BufferGeometry::Ptr geometry,
-                          Material::Ptr material,
-                          Object3D::Ptr object,
-                          const Group *group);
+  /**
+   * @param instanceCount if > 0, draw this many instances using the transforms in the
+   * instance buffer. See OpenGLRendererOptions::autoInstancing
+   */
+  void renderBufferDirect(const Camera::Ptr &camera,
+                          const Fog::Ptr &fog,
+                          BufferGeometry *geometry,
+                          Material *material,
+                          Object3D *object,
+                          const Group *group,
+                          GLsizei instanceCount=0);
 
   void setTexture2D(Texture::Ptr texture, GLuint slot);
   void setTextureCube(Texture::Ptr texture, GLuint slot);
@@ -288,11 +439,19 @@ public:
 
   void updateShadows() override;
 
+  void setFramesInFlight(unsigned framesInFlight) override
+  {
+    this->framesInFlight = framesInFlight;
+    _frameSync.setFramesInFlight(framesInFlight);
+  }
+
   Renderer_impl &setSize(size_t width, size_t height, bool setViewport) override;
 
   Renderer_impl &setViewport(size_t x, size_t y, size_t width, size_t height) override;
 
   void usePrograms(OpenGLRenderer::Ptr other) override;
+
+  bool compile(const Scene::Ptr &scene, const Camera::Ptr &camera) override;
 };
 
 }
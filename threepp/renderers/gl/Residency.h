@@ -0,0 +1,207 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_RESIDENCY_H
+#define THREEPP_RESIDENCY_H
+
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <threepp/util/sole.h>
+#include "Helpers.h"
+
+namespace three {
+namespace gl {
+
+/**
+ * keeps track of the GPU memory held by textures and buffers, in the order they were
+ * last used. If a budget is exceeded, the least recently used entries are handed out for eviction.
+ *
+ * Entries are stamped with the frame they were last used in. Entries used in the current frame
+ * and entries not marked evictable (render targets, depth textures, data without a CPU copy)
+ * are never handed out
+ */
+class Residency
+{
+public:
+  enum class Kind {Texture, Geometry, Buffer};
+
+  struct Entry
+  {
+    Kind kind;
+    sole::uuid texture;
+
+    //geometry id, or the key of a buffer entry
+    unsigned geometry;
+    size_t bytes;
+    unsigned frame;
+    bool evictable;
+  };
+
+private:
+  MemoryInfo &_infoMemory;
+
+  //least recently used first
+  std::list<Entry> _entries;
+
+  std::unordered_map<sole::uuid, std::list<Entry>::iterator> _textures;
+  std::unordered_map<unsigned, std::list<Entry>::iterator> _geometries;
+  std::unordered_map<unsigned, std::list<Entry>::iterator> _buffers;
+
+  unsigned _frame = 0;
+
+  void account(const Entry &entry, bool add)
+  {
+    size_t &total = entry.kind == Kind::Texture ? _infoMemory.textureBytes : _infoMemory.bufferBytes;
+    if(add) total += entry.bytes;
+    else total -= entry.bytes;
+  }
+
+  template <typename K>
+  void add(std::unordered_map<K, std::list<Entry>::iterator> &index, const K &key, Entry entry)
+  {
+    entry.frame = _frame;
+    account(entry, true);
+
+    auto found = index.find(key);
+    if(found != index.end()) {
+      account(*found->second, false);
+      *found->second = entry;
+      _entries.splice(_entries.end(), _entries, found->second);
+    }
+    else
+      index[key] = _entries.insert(_entries.end(), entry);
+  }
+
+  template <typename K>
+  void use(std::unordered_map<K, std::list<Entry>::iterator> &index, const K &key)
+  {
+    auto found = index.find(key);
+    if(found == index.end() || found->second->frame == _frame) return;
+
+    found->second->frame = _frame;
+    _entries.splice(_entries.end(), _entries, found->second);
+  }
+
+  template <typename K>
+  void remove(std::unordered_map<K, std::list<Entry>::iterator> &index, const K &key)
+  {
+    auto found = index.find(key);
+    if(found == index.end()) return;
+
+    account(*found->second, false);
+    _entries.erase(found->second);
+    index.erase(found);
+  }
+
+public:
+  explicit Residency(MemoryInfo &infoMemory) : _infoMemory(infoMemory) {}
+
+  /**
+   * start a new frame. Called at the beginning of each render
+   */
+  void nextFrame() {_frame ++;}
+
+  /**
+   * register the texture, or update its size after a new upload. Counts as use
+   */
+  void addTexture(const sole::uuid &uuid, size_t bytes, bool evictable)
+  {
+    add(_textures, uuid, Entry {Kind::Texture, uuid, 0, bytes, 0, evictable});
+  }
+
+  void useTexture(const sole::uuid &uuid)
+  {
+    use(_textures, uuid);
+  }
+
+  void removeTexture(const sole::uuid &uuid)
+  {
+    remove(_textures, uuid);
+  }
+
+  /**
+   * register the buffers of the geometry, or update their size. Counts as use
+   */
+  void addGeometry(unsigned geometryId, size_t bytes)
+  {
+    add(_geometries, geometryId, Entry {Kind::Geometry, sole::uuid(), geometryId, bytes, 0, true});
+  }
+
+  void useGeometry(unsigned geometryId)
+  {
+    use(_geometries, geometryId);
+  }
+
+  void removeGeometry(unsigned geometryId)
+  {
+    remove(_geometries, geometryId);
+  }
+
+  /**
+   * register buffers which don't belong to a single geometry, or update their size. They have no
+   * CPU copy and are never evicted
+   */
+  void addBuffers(unsigned key, size_t bytes)
+  {
+    add(_buffers, key, Entry {Kind::Buffer, sole::uuid(), key, bytes, 0, false});
+  }
+
+  void removeBuffers(unsigned key)
+  {
+    remove(_buffers, key);
+  }
+
+  /**
+   * @return the bytes held by all registered resources
+   */
+  size_t used() const
+  {
+    return _infoMemory.textureBytes + _infoMemory.bufferBytes;
+  }
+
+  /**
+   * unregister least recently used entries until at most budget bytes are in use or no
+   * evictable entry is left
+   *
+   * @return the entries removed, which the caller must release
+   */
+  std::vector<Entry> evict(size_t budget)
+  {
+    std::vector<Entry> evicted;
+
+    for(auto it = _entries.begin(); it != _entries.end() && used() > budget; ) {
+
+      //from here on, everything was used in this frame
+      if(it->frame == _frame) break;
+
+      if(!it->evictable) {
+        ++ it;
+        continue;
+      }
+      evicted.push_back(*it);
+
+      if(it->kind == Kind::Texture) _textures.erase(it->texture);
+      else _geometries.erase(it->geometry);
+
+      account(*it, false);
+      it = _entries.erase(it);
+    }
+    return evicted;
+  }
+
+  void clear()
+  {
+    _entries.clear();
+    _textures.clear();
+    _geometries.clear();
+    _buffers.clear();
+    _infoMemory.textureBytes = 0;
+    _infoMemory.bufferBytes = 0;
+  }
+};
+
+}
+}
+#endif //THREEPP_RESIDENCY_H
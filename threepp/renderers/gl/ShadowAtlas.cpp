@@ -0,0 +1,84 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#include "ShadowAtlas.h"
+#include <algorithm>
+#include <QDebug>
+
+namespace three {
+namespace gl {
+
+using namespace std;
+
+bool ShadowAtlas::pack(const std::vector<Request> &requests, GLsizei size)
+{
+  if(size == _size && requests == _requests) return false;
+
+  _size = size;
+  _requests = requests;
+  _tiles.resize(requests.size());
+
+  GLsizei largest = 1;
+  for(const Request &request : requests) largest = max(largest, max(request.width, request.height));
+
+  for(_scale = 1; !place(_scale); _scale *= 2) {
+    if(_scale >= (unsigned)largest) {
+      qWarning() << "too many shadow maps for an atlas of size" << size << ", some lights cast no shadow";
+      place(_scale, true);
+      break;
+    }
+  }
+
+  if(_scale > 1)
+    qWarning() << "shadow maps exceed the atlas size" << size << ", scaled down by" << _scale;
+
+  return true;
+}
+
+bool ShadowAtlas::place(unsigned scale, bool partial)
+{
+  bool complete = true;
+
+  vector<size_t> order(_requests.size());
+  for(size_t i = 0; i < order.size(); i++) order[i] = i;
+
+  // tallest first, so the shelves waste little space
+  sort(order.begin(), order.end(), [this](size_t i1, size_t i2) {
+    const Request &r1 = _requests[i1], &r2 = _requests[i2];
+    return r1.height != r2.height ? r1.height > r2.height : r1.width > r2.width;
+  });
+
+  GLint x = 0, y = 0;
+  GLsizei shelfHeight = 0;
+
+  for(size_t index : order) {
+    GLsizei width = max<GLsizei>(_requests[index].width / scale, 1);
+    GLsizei height = max<GLsizei>(_requests[index].height / scale, 1);
+
+    // a single tile may not fit at any scale above one texel
+    bool fits = width <= _size && height <= _size;
+
+    if(fits && x + width > _size) {
+      y += shelfHeight;
+      x = 0;
+      shelfHeight = 0;
+    }
+    if(!fits || y + height > _size) {
+      if(!partial) return false;
+
+      _tiles[index] = {0, 0, 0, 0};
+      complete = false;
+      continue;
+    }
+
+    _tiles[index] = {x, y, width, height};
+
+    x += width;
+    shelfHeight = max(shelfHeight, height);
+  }
+  return complete;
+}
+
+}
+}
@@ -0,0 +1,77 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_SHADOWATLAS_H
+#define THREEPP_SHADOWATLAS_H
+
+#include <vector>
+#include <QOpenGLFunctions>
+
+namespace three {
+namespace gl {
+
+/**
+ * places the shadow maps of all lights side by side in one texture. Tiles are packed onto
+ * shelves, tallest first. If the requests don't fit, all tiles are scaled down by powers of two
+ * until they do, or as many as fit get a single texel. The layout is kept as long as the requests don't change, so the tiles of static
+ * shadow maps stay valid
+ */
+class ShadowAtlas
+{
+public:
+  struct Request
+  {
+    unsigned id;
+    GLsizei width, height;
+
+    bool operator ==(const Request &other) const {
+      return id == other.id && width == other.width && height == other.height;
+    }
+  };
+
+  //empty (width and height 0) if the request did not fit even at the largest scale
+  struct Tile
+  {
+    GLint x, y;
+    GLsizei width, height;
+  };
+
+private:
+  GLsizei _size = 0;
+  unsigned _scale = 1;
+
+  std::vector<Request> _requests;
+  std::vector<Tile> _tiles;
+
+  /**
+   * @param partial give requests which don't fit an empty tile, instead of failing
+   * @return true if all requests were placed
+   */
+  bool place(unsigned scale, bool partial=false);
+
+public:
+  /**
+   * lay out the tiles for the given requests
+   *
+   * @param requests the tile sizes in texels, identified by light
+   * @param size width and height of the atlas
+   * @return true if the layout changed, invalidating the content of all tiles
+   */
+  bool pack(const std::vector<Request> &requests, GLsizei size);
+
+  GLsizei size() const {return _size;}
+
+  //divisor the tiles were scaled down by to make them fit
+  unsigned scale() const {return _scale;}
+
+  //the tile for the request at index, in the order given to pack()
+  const Tile &tile(size_t index) const {return _tiles.at(index);}
+
+  //false if the request at index got no tile, its light casts no shadow
+  bool placed(size_t index) const {return _tiles.at(index).width > 0;}
+};
+
+}
+}
+#endif //THREEPP_SHADOWATLAS_H
@@ -6,14 +6,41 @@
 #include "Renderer_impl.h"
 #include <threepp/material/MeshDepthMaterial.h>
 #include <threepp/material/MeshDistanceMaterial.h>
+#include <threepp/objects/InstancedMesh.h>
+#include <threepp/objects/LOD.h>
+#include <threepp/light/DirectionalLight.h>
+#include <algorithm>
+#include <limits>
 
 namespace three {
 namespace gl {
 
-ShadowMap::ShadowMap(Renderer_impl &renderer, Objects &objects, Capabilities &capabilities)
-: _renderer(renderer), _objects(objects), _capabilities(capabilities)
+namespace {
+
+void hash_matrix(size_t &seed, const math::Matrix4 &matrix)
+{
+  for(unsigned i = 0; i < 16; i++) hash_combine(seed, matrix.elements()[i]);
+}
+
+unsigned cascadeCount(const Light &light)
+{
+  DirectionalLight *directional = light.typer;
+  return directional ? directional->shadow_t()->numCascades() : 1;
+}
+
+const math::Matrix4 shadowBias(
+   0.5, 0.0, 0.0, 0.5,
+   0.0, 0.5, 0.0, 0.5,
+   0.0, 0.0, 0.5, 0.5,
+   0.0, 0.0, 0.0, 1.0
+);
+
+}
+
+ShadowMap::ShadowMap(Renderer_impl &renderer, Objects &objects, Capabilities &capabilities, RenderInfo &info)
+: _renderer(renderer), _objects(objects), _info(info), _capabilities(capabilities)
 {
-  static constexpr uint16_t _NumberOfMaterialVariants = (Flag::Morphing | Flag::Skinning) + 1;
+  static constexpr uint16_t _NumberOfMaterialVariants = (Flag::Morphing | Flag::Skinning | Flag::Instancing) + 1;
 
   for (size_t i = 0; i < _NumberOfMaterialVariants; ++ i ) {
 
@@ -25,6 +52,74 @@ ShadowMap::ShadowMap(Renderer_impl &renderer, Objects &objects, Capabilities &ca
   }
 }
 
+RenderTargetInternal::Ptr ShadowMap::makeMap(GLsizei width, GLsizei height)
+{
+  RenderTargetInternal::Options options;
+  options.depthBuffer = false;
+  options.stencilBuffer = false;
+  options.flipY = true;
+  options.minFilter = TextureFilter::Nearest;
+  options.magFilter = TextureFilter::Nearest;
+  options.format = TextureFormat::RGBA;
+
+  return RenderTargetInternal::make(options, width, height);
+}
+
+math::Vector2 ShadowMap::mapSize(const Light &light, unsigned cascades) const
+{
+  PointLight *pointLight = light.typer;
+
+  math::Vector2 size = math::min(light.shadow()->mapSize(), _maxShadowMapSize);
+  if (pointLight) {
+
+    size.x() *= 4.0;
+    size.y() *= 2.0;
+  }
+  else if (cascades > 1) {
+
+    // the cascades are laid out side by side
+    size.x() = std::min(size.x(), std::floor(_maxShadowMapSize.x() / cascades)) * cascades;
+  }
+  return size;
+}
+
+void ShadowMap::setupAtlas(const std::vector<Light::Ptr> &lights)
+{
+  GLsizei size = std::min<GLsizei>(_renderer.shadowAtlasSize, _capabilities.maxTextureSize);
+
+  if (!_atlasMap || _atlasMap->width() != size) {
+    _atlasMap = makeMap(size, size);
+  }
+
+  std::vector<ShadowAtlas::Request> requests;
+  for (const Light::Ptr &light : lights) {
+
+    math::Vector2 size = mapSize(*light, light.get() == _cascaded ? cascadeCount(*light) : 1);
+    requests.push_back({light->id(), (GLsizei)size.x(), (GLsizei)size.y()});
+  }
+
+  bool changed = _atlas.pack(requests, size);
+
+  for (size_t i = 0; i < lights.size(); i++) {
+
+    const LightShadow::Ptr &shadow = lights[i]->shadow();
+    const ShadowAtlas::Tile &tile = _atlas.tile(i);
+
+    if (shadow->map() != _atlasMap) {
+      shadow->setMap(_atlasMap);
+      shadow->camera()->updateProjectionMatrix();
+      changed = true;
+    }
+
+    shadow->_mapped = _atlas.placed(i);
+    shadow->_viewport.set(tile.x, tile.y, tile.width, tile.height);
+    shadow->_tile.set((float)tile.x / size, (float)tile.y / size, (float)tile.width / size, (float)tile.height / size);
+
+    // the tile has moved
+    if (changed) shadow->_rendered = false;
+  }
+}
+
 void ShadowMap::setup(std::vector<Light::Ptr> lights, Scene::Ptr scene, Camera::Ptr camera)
 {
   if (!enabled || lights.empty() || (!autoUpdate && !needsUpdate)) {
@@ -35,6 +130,17 @@ void ShadowMap::setup(std::vector<Light::Ptr> lights, Scene::Ptr scene, Camera::
 
   _maxShadowMapSize.set((float)_capabilities.maxTextureSize, (float)_capabilities.maxTextureSize);
 
+  // only the first light with cascades gets them, see Lights
+  _cascaded = nullptr;
+  for (const Light::Ptr &light : lights) {
+    if (cascadeCount(*light) > 1) {
+      _cascaded = light.get();
+      break;
+    }
+  }
+
+  if (_renderer.shadowAtlas) setupAtlas(lights);
+
   // render depth map
   for (Light::Ptr light : lights) {
 
@@ -42,28 +148,29 @@ void ShadowMap::setup(std::vector<Light::Ptr> lights, Scene::Ptr scene, Camera::
     if (!shadow) continue;
 
     PointLight *pointLight = light->typer;
+    unsigned cascades = light.get() == _cascaded ? cascadeCount(*light) : 1;
 
     const Camera::Ptr shadowCamera = shadow->camera();
-    if (!shadow->map()) {
 
-      RenderTargetInternal::Options options;
-      options.depthBuffer = false;
-      options.stencilBuffer = false;
-      options.flipY = true;
-      options.minFilter = TextureFilter::Nearest;
-      options.magFilter = TextureFilter::Nearest;
-      options.format = TextureFormat::RGBA;
+    math::Vector2 shadowMapSize = mapSize(*light, cascades);
 
-      math::Vector2 shadowMapSize = math::min(shadow->mapSize(), _maxShadowMapSize);
-      if (pointLight) {
+    if (!_renderer.shadowAtlas) {
 
-        shadowMapSize.x() *= 4.0;
-        shadowMapSize.y() *= 2.0;
-      }
-      shadow->setMap(RenderTargetInternal::make(options, shadowMapSize.x(), shadowMapSize.y()));
+      // the number of cascades may have changed
+      if (shadow->map() && shadow->map()->width() != (GLsizei)shadowMapSize.x()) shadow->setMap(nullptr);
 
-      shadowCamera->updateProjectionMatrix();
+      if (!shadow->map()) {
+
+        shadow->setMap(makeMap(shadowMapSize.x(), shadowMapSize.y()));
+        shadow->_rendered = false;
+
+        shadowCamera->updateProjectionMatrix();
+      }
+      shadow->_mapped = true;
+      shadow->_viewport.set(0, 0, shadowMapSize.x(), shadowMapSize.y());
+      shadow->_tile.set(0, 0, 1, 1);
     }
+    else if (!shadow->mapped()) continue;
 
     shadow->update();
 
@@ -77,6 +184,17 @@ void ShadowMap::setup(std::vector<Light::Ptr> lights, Scene::Ptr scene, Camera::
 
       shadow->matrix() = math::Matrix4::translation(- lightPositionWorld.x(), - lightPositionWorld.y(), - lightPositionWorld.z());
     }
+    else if (cascades > 1) {
+
+      DirectionalLight *directional = light->typer;
+      DirectionalLightShadow &cascadedShadow = *directional->shadow_t();
+
+      math::Vector3 direction = directional->target()->matrixWorld().getPosition() - lightPositionWorld;
+      setupCascades(cascadedShadow, direction, *camera, cascades, shadow->_viewport.z() / cascades);
+
+      // the first cascade stands in for the light's own shadow matrix
+      shadow->matrix() = cascadedShadow.cascadeMatrix(0);
+    }
     else {
       TargetLight *targetLight = light->typer;
       assert(targetLight);
@@ -86,12 +204,7 @@ void ShadowMap::setup(std::vector<Light::Ptr> lights, Scene::Ptr scene, Camera::
       shadowCamera->updateMatrixWorld(false);
 
       // compute shadow matrix
-      shadow->matrix() = math::Matrix4(
-         0.5, 0.0, 0.0, 0.5,
-         0.0, 0.5, 0.0, 0.5,
-         0.0, 0.0, 0.5, 0.5,
-         0.0, 0.0, 0.0, 1.0
-      );
+      shadow->matrix() = shadowBias;
       shadow->matrix() *= shadowCamera->projectionMatrix();
       shadow->matrix() *= shadowCamera->matrixWorldInverse();
     }
@@ -109,41 +222,86 @@ void ShadowMap::render(std::vector<Light::Ptr> lights, Scene::Ptr scene, Camera:
   state.depthBuffer.setTest(true);
   state.setScissorTest(false);
 
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
+
+  _info.shadowCasters = 0;
+  _info.shadowMapsCached = 0;
 
   // render depth map
   for (Light::Ptr light : lights) {
 
     auto shadow = light->shadow();
-    if (!shadow || !shadow->map()) continue;
+    if (!shadow || !shadow->map() || !shadow->mapped()) continue;
 
-    _renderer.setRenderTarget(shadow->map());
-    _renderer.clear(true, true, true);
+    const Camera::Ptr &shadowCamera = shadow->camera();
 
     bool pointLight = light->is<PointLight>();
-    unsigned faceCount = 1;
+    unsigned cascades = light.get() == _cascaded ? cascadeCount(*light) : 1;
+    unsigned faceCount = pointLight ? 6 : cascades;
+
+    DirectionalLight *directional = light->typer;
 
-    math::Vector2 shadowMapSize;
-    float vpWidth = 0;
-    float vpHeight = 0;
+    // cull the casters for each cube face (if omni-directional) or the single frustum. The
+    // signature covers everything a static map depends on
+    size_t signature = 0;
+    bool dynamic = false;
 
-    if(pointLight) {
+    for (unsigned face = 0; face < faceCount; face++) {
 
-      shadowMapSize = math::min(shadow->mapSize(), _maxShadowMapSize);
-      faceCount = 6;
+      if (pointLight) setFace(*shadowCamera, face);
+      else if (cascades > 1) setCascade(*directional->shadow_t(), face);
 
-      vpWidth = shadowMapSize.x();
-      vpHeight = shadowMapSize.y();
+      // update camera matrices and frustum
+      _frustum.set(shadowCamera->projectionMatrix() * shadowCamera->matrixWorldInverse());
+
+      hash_matrix(signature, shadowCamera->projectionMatrix());
+      hash_matrix(signature, shadowCamera->matrixWorldInverse());
+
+      _casters[face].clear();
+      collectCasters(scene, camera, shadowCamera, pointLight, _casters[face], signature, dynamic);
+
+      // batch by depth material variant, to save program switches
+      std::sort(_casters[face].begin(), _casters[face].end(), [](const Caster &c1, const Caster &c2) {
+        return c1.depthMaterial != c2.depthMaterial ? c1.depthMaterial < c2.depthMaterial : c1.geometry < c2.geometry;
+      });
     }
 
-    // render shadow map for each cube face (if omni-directional) or
-    // run a single pass if not
+    if (shadow->isStatic && shadow->_rendered && !dynamic && shadow->_signature == signature) {
+      _info.shadowMapsCached++;
+      continue;
+    }
+
+    _renderer.setRenderTarget(shadow->map());
+
+    // the region of the map that belongs to the light, all of it unless in an atlas
+    const math::Vector4 &region = shadow->_viewport;
+    float x = region.x(), y = region.y();
+
+    if (_renderer.shadowAtlas) {
+
+      // the other tiles may hold cached maps
+      state.setScissorTest(true);
+      state.scissor(region);
+      _renderer.clear(true, true, true);
+      state.setScissorTest(false);
+    }
+    else
+      _renderer.clear(true, true, true);
+
+    float vpWidth = region.z();
+    float vpHeight = region.w();
+    if (pointLight) {
+      vpWidth /= 4;
+      vpHeight /= 2;
+    }
+    else
+      vpWidth /= cascades;
+
     for (unsigned face = 0; face < faceCount; face++) {
 
       if (pointLight) {
-        shadow->camera()->up() = _cubeUps[face];
-        shadow->camera()->lookAt(shadow->camera()->position() + _cubeDirections[face]);
-        shadow->camera()->updateMatrixWorld(false);
+        setFace(*shadowCamera, face);
+        _renderer.resetCamera();
 
         // These viewports map a cube-map onto a 2D texture with the
         // following orientation:
@@ -160,44 +318,156 @@ void ShadowMap::render(std::vector<Light::Ptr> lights, Scene::Ptr scene, Camera:
         switch(face) {
           case 0:
             // positive X
-            _renderer.state().viewport(vpWidth * 2, vpHeight, vpWidth, vpHeight);
+            _renderer.state().viewport(x + vpWidth * 2, y + vpHeight, vpWidth, vpHeight);
             break;
           case 1:
             // negative X
-            _renderer.state().viewport(0, vpHeight, vpWidth, vpHeight);
+            _renderer.state().viewport(x, y + vpHeight, vpWidth, vpHeight);
             break;
           case 2:
             // positive Z
-            _renderer.state().viewport(vpWidth * 3, vpHeight, vpWidth, vpHeight);
+            _renderer.state().viewport(x + vpWidth * 3, y + vpHeight, vpWidth, vpHeight);
             break;
           case 3:
             // negative Z
-            _renderer.state().viewport(vpWidth, vpHeight, vpWidth, vpHeight);
+            _renderer.state().viewport(x + vpWidth, y + vpHeight, vpWidth, vpHeight);
             break;
           case 4:
             // positive Y
-            _renderer.state().viewport(vpWidth * 3, 0, vpWidth, vpHeight);
+            _renderer.state().viewport(x + vpWidth * 3, y, vpWidth, vpHeight);
             break;
           case 5:
             // negative Y
-            _renderer.state().viewport(vpWidth, 0, vpWidth, vpHeight);
+            _renderer.state().viewport(x + vpWidth, y, vpWidth, vpHeight);
             break;
         }
       }
+      else {
+        // one tile per cascade, left to right
+        if (cascades > 1) {
+          setCascade(*directional->shadow_t(), face);
+          _renderer.resetCamera();
+        }
 
-      // update camera matrices and frustum
-      _frustum.set(shadow->camera()->projectionMatrix() * shadow->camera()->matrixWorldInverse());
+        _renderer.state().viewport(x + vpWidth * face, y, vpWidth, vpHeight);
+      }
 
-      // set object matrices & frustum culling
-      renderObject(scene, camera, shadow->camera(), pointLight);
-      check_glerror(&_renderer);
+      renderCasters(_casters[face], shadowCamera, pointLight);
+      check_glerror(&_renderer, _renderer.validationLevel());
     }
+
+    shadow->_signature = signature;
+    shadow->_rendered = true;
   }
   needsUpdate = false;
 }
 
-Material::Ptr ShadowMap::getDepthMaterial(Object3D::Ptr object,
-                                          Material::Ptr material,
+void ShadowMap::setupCascades(DirectionalLightShadow &shadow, const math::Vector3 &direction, const Camera &camera,
+                              unsigned cascades, float tileSize)
+{
+  float near = camera.near();
+  float far = shadow.cascadeDistance > 0 ? std::min(shadow.cascadeDistance, camera.far()) : camera.far();
+
+  // the view frustum corners in view space, near plane first
+  math::Matrix4 projectionInverse = camera.projectionMatrix().inverted();
+  math::Vector3 corners[8];
+  for (unsigned i = 0; i < 8; i++) {
+    corners[i].set(i & 1 ? 1 : -1, i & 2 ? 1 : -1, i & 4 ? 1 : -1);
+    corners[i].apply(projectionInverse);
+  }
+
+  // light space has a fixed orientation, so cascades only move in whole texels
+  OrthographicCamera &shadowCamera = *shadow.camera_t();
+  shadow._cascadeDirection = direction;
+  shadowCamera.position().set(0, 0, 0);
+  shadowCamera.lookAt(direction);
+  shadowCamera.updateMatrixWorld(false);
+
+  const math::Matrix4 lightToWorld = shadowCamera.matrixWorld();
+  const math::Matrix4 worldToLight = shadowCamera.matrixWorldInverse();
+
+  float begin = near;
+  for (unsigned c = 0; c < cascades; c++) {
+
+    // practical split scheme, blending logarithmic and uniform splits
+    float ratio = float(c + 1) / cascades;
+    float uniformSplit = near + (far - near) * ratio;
+    float logSplit = near > 0 ? near * std::pow(far / near, ratio) : uniformSplit;
+    float end = shadow.cascadeLambda * logSplit + (1 - shadow.cascadeLambda) * uniformSplit;
+
+    math::Vector3 points[8];
+    math::Vector3 center(0, 0, 0);
+    for (unsigned k = 0; k < 4; k++) {
+      const math::Vector3 &n = corners[k], &f = corners[k + 4];
+
+      float depth = -n.z(), range = n.z() - f.z();
+      points[k] = n + (f - n) * ((begin - depth) / range);
+      points[k + 4] = n + (f - n) * ((end - depth) / range);
+    }
+    for (math::Vector3 &point : points) {
+      point.apply(camera.matrixWorld());
+      center += point;
+    }
+    center /= 8;
+
+    // a bounding sphere keeps the cascade size independent of the view direction. Rounding
+    // hides floating point noise
+    float radius = 0;
+    for (const math::Vector3 &point : points) radius = std::max(radius, center.distanceTo(point));
+    radius = std::ceil(radius * 16) / 16;
+
+    float texel = 2 * radius / tileSize;
+
+    math::Vector3 lightCenter = center;
+    lightCenter.apply(worldToLight);
+
+    float pull = radius + shadow.cascadeCasterDistance;
+    math::Vector3 position(std::floor(lightCenter.x() / texel) * texel,
+                           std::floor(lightCenter.y() / texel) * texel,
+                           lightCenter.z() + pull);
+    position.apply(lightToWorld);
+
+    DirectionalLightShadow::Cascade &cascade = shadow._cascades[c];
+    cascade.position = position;
+    cascade.radius = radius;
+    cascade.far = pull + radius;
+
+    setCascade(shadow, c);
+
+    shadow._cascadeMatrices[c] = shadowBias;
+    shadow._cascadeMatrices[c] *= shadowCamera.projectionMatrix();
+    shadow._cascadeMatrices[c] *= shadowCamera.matrixWorldInverse();
+
+    shadow._cascadeSplits.set(c, end);
+    begin = end;
+  }
+
+  for (unsigned c = cascades; c < DirectionalLightShadow::max_cascades; c++)
+    shadow._cascadeSplits.set(c, std::numeric_limits<float>::max());
+}
+
+void ShadowMap::setCascade(DirectionalLightShadow &shadow, unsigned cascade)
+{
+  const DirectionalLightShadow::Cascade &bounds = shadow._cascades[cascade];
+  OrthographicCamera &shadowCamera = *shadow.camera_t();
+
+  shadowCamera.set(-bounds.radius, bounds.radius, bounds.radius, -bounds.radius, 0, bounds.far);
+  shadowCamera.updateProjectionMatrix();
+
+  shadowCamera.position() = bounds.position;
+  shadowCamera.lookAt(bounds.position + shadow._cascadeDirection);
+  shadowCamera.updateMatrixWorld(false);
+}
+
+void ShadowMap::setFace(Camera &shadowCamera, unsigned face)
+{
+  shadowCamera.up() = _cubeUps[face];
+  shadowCamera.lookAt(shadowCamera.position() + _cubeDirections[face]);
+  shadowCamera.updateMatrixWorld(false);
+}
+
+Material::Ptr ShadowMap::getDepthMaterial(Object3D *object,
+                                          Material *material,
                                           bool isPointLight,
                                           const Camera::Ptr &shadowCamera)
 {
@@ -216,6 +486,7 @@ Material::Ptr ShadowMap::getDepthMaterial(Object3D::Ptr object,
 
     if ( useMorphing ) variantIndex |= Flag::Morphing;
     if ( useSkinning ) variantIndex |= Flag::Skinning;
+    if ( object->is<InstancedMesh>() ) variantIndex |= Flag::Instancing;
 
     std::vector<Material::Ptr> &materialVariants = isPointLight ? _distanceMaterials : _depthMaterials;
     result = materialVariants[ variantIndex ];
@@ -277,18 +548,37 @@ Material::Ptr ShadowMap::getDepthMaterial(Object3D::Ptr object,
   return result;
 }
 
-void ShadowMap::renderObject(Object3D::Ptr object, Camera::Ptr camera, Camera::Ptr shadowCamera, bool isPointLight)
+void ShadowMap::addCaster(Object3D *object, BufferGeometry *geometry, Material *material, const Group *group,
+                          const Camera::Ptr &shadowCamera, bool isPointLight, std::vector<Caster> &casters)
+{
+  Material *depthMaterial = getDepthMaterial(object, material, isPointLight, shadowCamera).get();
+
+  casters.push_back({object, geometry, material, depthMaterial, group});
+}
+
+void ShadowMap::collectCasters(const Object3D::Ptr &object, const Camera::Ptr &camera, const Camera::Ptr &shadowCamera,
+                               bool isPointLight, std::vector<Caster> &casters, size_t &signature, bool &dynamic,
+                               bool insideFrustum)
 {
   if (!object->visible()) return;
 
+  if (!insideFrustum && object->hasSubtreeBounds()) {
+
+    const math::Sphere &bounds = object->subtreeBoundingSphere();
+    if (bounds.isEmpty() || !_frustum.intersectsSphere(bounds)) return;
+
+    insideFrustum = _frustum.containsSphere(bounds);
+  }
+
   bool visible = object->layers().test( camera->layers() );
 
   if ( visible && object->isShadowRenderable()) {
 
-    if ( object->castShadow && ( ! object->frustumCulled || _frustum.intersectsObject( *object ) ) ) {
+    if ( object->castShadow && ( ! object->frustumCulled || insideFrustum || _frustum.intersectsObject( *object ) ) ) {
 
-      object->modelViewMatrix.multiply(shadowCamera->matrixWorldInverse(), object->matrixWorld());
-      BufferGeometry::Ptr geometry = _objects.update( object );
+      BufferGeometry *geometry = _objects.update( object ).get();
+
+      size_t count = casters.size();
 
       if ( object->materialCount() > 1 ) {
 
@@ -296,33 +586,67 @@ void ShadowMap::renderObject(Object3D::Ptr object, Camera::Ptr camera, Camera::P
 
         for (const Group &group : groups) {
 
-          Material::Ptr groupMaterial = object->material(group.materialIndex);
+          Material *groupMaterial = object->material(group.materialIndex).get();
 
           if ( groupMaterial && groupMaterial->visible ) {
 
-            Material::Ptr depthMaterial = getDepthMaterial(object, groupMaterial, isPointLight, shadowCamera);
-            _renderer.renderBufferDirect( shadowCamera, nullptr, geometry, depthMaterial, object, &group );
+            addCaster(object.get(), geometry, groupMaterial, &group, shadowCamera, isPointLight, casters);
           }
         }
       }
       else {
-        Material::Ptr material = object->material();
+        Material *material = object->material().get();
         if (material->visible) {
-          Material::Ptr depthMaterial = getDepthMaterial(object, material, isPointLight, shadowCamera);
 
-          _renderer.renderBufferDirect(shadowCamera, nullptr, geometry, depthMaterial, object, nullptr);
+          addCaster(object.get(), geometry, material, nullptr, shadowCamera, isPointLight, casters);
         }
       }
+
+      if(casters.size() > count) {
+
+        hash_combine(signature, object->id());
+        hash_combine(signature, geometry->id);
+        hash_matrix(signature, object->matrixWorld());
+
+        if(geometry->position()) hash_combine(signature, geometry->position()->version());
+        if(geometry->index()) hash_combine(signature, geometry->index()->version());
+
+        for(size_t i = count; i < casters.size(); i++) hash_combine(signature, casters[i].depthMaterial);
+
+        if(InstancedMesh *instanced = object->typer) hash_combine(signature, instanced->version());
+
+        Mesh *mesh = object->typer;
+        if(object->skinned() || (mesh && !mesh->morphTargetInfluences().empty())) dynamic = true;
+      }
     }
   }
 
-  std::vector<Object3D::Ptr> children = object->children();
+  // levels are selected for the view camera, so the shadow matches what is rendered
+  LOD *lod = object->typer;
+  if(lod) lod->update(*camera);
 
-  for (auto child : object->children()) {
+  for (const Object3D::Ptr &child : object->children()) {
 
-    renderObject( child, camera, shadowCamera, isPointLight);
+    if(lod && lod->skipped(child.get())) continue;
+
+    collectCasters( child, camera, shadowCamera, isPointLight, casters, signature, dynamic, insideFrustum);
   }
 }
 
+void ShadowMap::renderCasters(const std::vector<Caster> &casters, const Camera::Ptr &shadowCamera, bool isPointLight)
+{
+  for(const Caster &caster : casters) {
+
+    caster.object->modelViewMatrix.multiply(shadowCamera->matrixWorldInverse(), caster.object->matrixWorld());
+
+    // the variants are shared, so their per-caster state is applied right before drawing
+    Material::Ptr depthMaterial = getDepthMaterial(caster.object, caster.material, isPointLight, shadowCamera);
+
+    _renderer.renderBufferDirect( shadowCamera, nullptr, caster.geometry, depthMaterial.get(), caster.object, caster.group );
+  }
+
+  _info.shadowCasters += casters.size();
+}
+
 }
 }
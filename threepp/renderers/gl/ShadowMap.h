@@ -13,10 +13,12 @@
 #include <threepp/light/Light.h>
 #include <threepp/scene/Scene.h>
 #include <threepp/camera/PerspectiveCamera.h>
+#include <threepp/light/DirectionalLight.h>
 
 #include "Objects.h"
 #include "RenderTarget.h"
 #include "Capabilities.h"
+#include "ShadowAtlas.h"
 
 namespace three {
 namespace gl {
@@ -27,13 +29,27 @@ class ShadowMap
 {
   math::Frustum _frustum;
 
-  enum Flag : uint16_t {Morphing = 1, Skinning= 2};
+  //Instancing variants are otherwise identical, but keep InstancedMesh from switching programs
+  enum Flag : uint16_t {Morphing = 1, Skinning= 2, Instancing = 4};
 
   std::vector<Material::Ptr> _depthMaterials;
   std::vector<Material::Ptr> _distanceMaterials;
 
   std::unordered_map<sole::uuid, std::unordered_map<sole::uuid, Material::Ptr>> _materialCache;
 
+  //a draw of the shadow pass
+  struct Caster
+  {
+    Object3D *object;
+    BufferGeometry *geometry;
+    Material *material;
+    Material *depthMaterial;
+    const Group *group;
+  };
+
+  //casters per cube face, cascade or the single face of other lights, sorted by depth material
+  std::vector<Caster> _casters[6];
+
   math::Vector3 _cubeDirections[6] {
      math::Vector3(1, 0, 0), math::Vector3(-1, 0, 0), math::Vector3(0, 0, 1),
      math::Vector3(0, 0, -1), math::Vector3(0, 1, 0), math::Vector3(0, -1, 0)
@@ -48,32 +64,63 @@ class ShadowMap
 
   bool _needsRender = false;
 
+  //the light whose shadow is split into cascades, see DirectionalLightShadow::cascades
+  const Light *_cascaded = nullptr;
+
+  //the map shared by all lights, see OpenGLRendererOptions::shadowAtlas
+  ShadowAtlas _atlas;
+  RenderTargetInternal::Ptr _atlasMap;
+
   ShadowMapType _type = ShadowMapType::None;
 
   Renderer_impl &_renderer;
   Objects &_objects;
+  RenderInfo &_info;
 
   const Capabilities &_capabilities;
 
-  Material::Ptr getDepthMaterial(Object3D::Ptr object,
-                                 Material::Ptr material,
+  Material::Ptr getDepthMaterial(Object3D *object,
+                                 Material *material,
                                  bool isPointLight,
                                  const Camera::Ptr &shadowCamera );
 
-  void renderObject(Object3D::Ptr object, Camera::Ptr camera, Camera::Ptr shadowCamera, bool isPointLight);
+  RenderTargetInternal::Ptr makeMap(GLsizei width, GLsizei height);
+
+  math::Vector2 mapSize(const Light &light, unsigned cascades) const;
+
+  void setupAtlas(const std::vector<Light::Ptr> &lights);
+
+  void setFace(Camera &shadowCamera, unsigned face);
+
+  void setupCascades(DirectionalLightShadow &shadow, const math::Vector3 &direction, const Camera &camera,
+                     unsigned cascades, float tileSize);
+
+  void setCascade(DirectionalLightShadow &shadow, unsigned cascade);
+
+  void collectCasters(const Object3D::Ptr &object, const Camera::Ptr &camera, const Camera::Ptr &shadowCamera,
+                      bool isPointLight, std::vector<Caster> &casters, size_t &signature, bool &dynamic,
+                      bool insideFrustum=false);
+
+  void addCaster(Object3D *object, BufferGeometry *geometry, Material *material, const Group *group,
+                 const Camera::Ptr &shadowCamera, bool isPointLight, std::vector<Caster> &casters);
+
+  void renderCasters(const std::vector<Caster> &casters, const Camera::Ptr &shadowCamera, bool isPointLight);
 
 public:
   bool enabled = false;
   bool needsUpdate = true;
   bool autoUpdate = true;
 
-  ShadowMap(Renderer_impl &renderer, Objects &objects, Capabilities &capabilities);
+  ShadowMap(Renderer_impl &renderer, Objects &objects, Capabilities &capabilities, RenderInfo &info);
 
   void setup(std::vector<Light::Ptr> lights, Scene::Ptr scene, Camera::Ptr camera);
   void render(std::vector<Light::Ptr> lights, Scene::Ptr scene, Camera::Ptr camera );
 
   ShadowMapType type() const {return _type;}
 
+  //the texture holding all shadow maps in atlas mode, otherwise null
+  Texture::Ptr atlas() const {return _atlasMap ? _atlasMap->texture() : nullptr;}
+
   void setType(ShadowMapType type) {_type = type;}
 };
 
@@ -17,6 +17,37 @@
 namespace three {
 namespace gl {
 
+/**
+ * a vertex array object, cached per geometry/program/wireframe combination
+ */
+struct VertexArray
+{
+  struct Binding
+  {
+    GLint location;
+    GLuint buffer;
+    GLuint divisor;
+
+    bool operator == (const Binding &other) const {
+      return location == other.location && buffer == other.buffer && divisor == other.divisor;
+    }
+  };
+
+  GLuint handle = 0;
+  GLuint program = 0;
+  bool wireframe = false;
+
+  //buffer bindings captured at setup, used to detect stale arrays. Location -1 is the index buffer
+  std::vector<Binding> bindings;
+
+  //the program reads attributes the geometry does not provide, which need their constant values set
+  bool defaultAttributes = false;
+
+  //attribute state tracked by State while this array is not bound
+  std::vector<GLuint> enabledAttributes;
+  std::vector<GLuint> attributeDivisors;
+};
+
 class State
 {
 public:
@@ -246,15 +277,23 @@ public:
 
   GLint maxVertexAttributes;
   std::vector<GLuint> newAttributes;
+
+  //enabled attributes and divisors are vertex array state, these belong to the currently bound array
   std::vector<GLuint> enabledAttributes;
   std::vector<GLuint> attributeDivisors;
 
+  VertexArray defaultVertexArray;
+  VertexArray *currentVertexArray = &defaultVertexArray;
+
   std::unordered_map<GLenum, bool> capabilities;
 
   std::vector<GLint> compressedTextureFormats;
 
   GLuint currentProgram = 0;
 
+  //0 == unknown
+  GLint currentUnpackAlignment = 0;
+
   Blending currentBlending = Blending::None;
   BlendEq currentBlendEquation = BlendEq::None;
   BlendFunc currentBlendSrc = BlendFunc::None;
@@ -311,11 +350,15 @@ public:
   }
 
   QOpenGLExtraFunctions * const _f;
+  const Validation &_validation;
   enum_map<TextureTarget, GLuint> emptyTextures;
 
 public:
-  State(QOpenGLExtraFunctions *fn, int initialTextureSlot=-1) :
-     colorBuffer(fn), stencilBuffer(*this, fn), depthBuffer(*this, fn), _f(fn),
+  /**
+   * @param validation the renderer's validation level in effect, read on every check
+   */
+  State(QOpenGLExtraFunctions *fn, const Validation &validation, int initialTextureSlot=-1) :
+     colorBuffer(fn), stencilBuffer(*this, fn), depthBuffer(*this, fn), _f(fn), _validation(validation),
      initialTextureSlot(initialTextureSlot), currentTextureSlot(initialTextureSlot)
   {}
 
@@ -323,7 +366,7 @@ public:
   {
     _f->glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, (GLint *)&maxTextures);
     _f->glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxVertexAttributes);
-    check_glerror(_f);
+    check_glerror(_f, _validation);
 
     newAttributes.resize(maxVertexAttributes);
     enabledAttributes.resize(maxVertexAttributes);
@@ -346,7 +389,7 @@ public:
     setCullFace(CullFace::Back);
 
     setBlending(Blending::Normal);
-    check_glerror(_f);
+    check_glerror(_f, _validation);
   }
 
   State &initAttributes()
@@ -368,7 +411,7 @@ public:
       _f->glVertexAttribDivisor(attribute, 0);
       attributeDivisors[attribute] = 0;
     }
-    check_glerror(_f);
+    check_glerror(_f, _validation);
     return *this;
   }
 
@@ -385,10 +428,58 @@ public:
       _f->glVertexAttribDivisor(attribute, meshPerAttribute);
       attributeDivisors[attribute] = meshPerAttribute;
     }
-    check_glerror(_f);
+    check_glerror(_f, _validation);
+    return *this;
+  }
+
+  State &disableAttribute(GLuint attribute)
+  {
+    newAttributes[attribute] = 0;
+
+    if (enabledAttributes[attribute] == 1) {
+      _f->glDisableVertexAttribArray(attribute);
+      enabledAttributes[attribute] = 0;
+    }
+    return *this;
+  }
+
+  /**
+   * bind a vertex array object, or the default vertex array if vertexArray is nullptr
+   */
+  State &bindVertexArray(VertexArray *vertexArray)
+  {
+    if(!vertexArray) vertexArray = &defaultVertexArray;
+    if(vertexArray == currentVertexArray) return *this;
+
+    enabledAttributes.swap(currentVertexArray->enabledAttributes);
+    attributeDivisors.swap(currentVertexArray->attributeDivisors);
+
+    enabledAttributes.swap(vertexArray->enabledAttributes);
+    attributeDivisors.swap(vertexArray->attributeDivisors);
+
+    //a new array starts with all attributes disabled
+    if(enabledAttributes.empty()) {
+      enabledAttributes.resize(maxVertexAttributes);
+      attributeDivisors.resize(maxVertexAttributes);
+    }
+
+    _f->glBindVertexArray(vertexArray->handle);
+    check_glerror(_f, _validation);
+
+    currentVertexArray = vertexArray;
     return *this;
   }
 
+  void deleteVertexArray(VertexArray &vertexArray)
+  {
+    if(&vertexArray == currentVertexArray) bindVertexArray(nullptr);
+
+    if(vertexArray.handle) {
+      _f->glDeleteVertexArrays(1, &vertexArray.handle);
+      vertexArray.handle = 0;
+    }
+  }
+
   State &disableUnusedAttributes()
   {
     for (size_t i = 0, l = enabledAttributes.size(); i != l; ++i) {
@@ -404,7 +495,7 @@ public:
   {
     if (capabilities.count(id) == 0 || !capabilities[id]) {
       _f->glEnable(id);
-      check_glerror(_f);
+      check_glerror(_f, _validation);
       capabilities[id] = true;
     }
   }
@@ -447,6 +538,15 @@ public:
     return false;
   }
 
+  void setUnpackAlignment(GLint alignment)
+  {
+    if (currentUnpackAlignment != alignment) {
+
+      _f->glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+      currentUnpackAlignment = alignment;
+    }
+  }
+
   State &
   setBlending(Blending blending, BlendEq blendEquation = BlendEq::None, BlendFunc blendSrc = BlendFunc::None,
               BlendFunc blendDst = BlendFunc::None, BlendEq blendEquationAlpha = BlendEq::None,
@@ -546,7 +646,7 @@ public:
     return *this;
   }
 
-  State &setMaterial(const Material::Ptr material, bool frontFaceCW)
+  State &setMaterial(const Material *material, bool frontFaceCW)
   {
     material->side == Side::Double ? disable(GL_CULL_FACE) : enable(GL_CULL_FACE);
 
@@ -576,7 +676,7 @@ public:
     if (currentFaceDirection != faceDirection) {
       if(faceDirection != FrontFaceDirection::Undefined) {
         _f->glFrontFace((GLenum) faceDirection);
-        check_glerror(_f);
+        check_glerror(_f, _validation);
       }
       currentFaceDirection = faceDirection;
     }
@@ -590,12 +690,12 @@ public:
 
       if (cullFace != currentCullFace) {
         _f->glCullFace((GLenum) cullFace);
-        check_glerror(_f);
+        check_glerror(_f, _validation);
       }
     }
     else {
       disable(GL_CULL_FACE);
-      check_glerror(_f);
+      check_glerror(_f, _validation);
     }
 
     currentCullFace = cullFace;
@@ -677,18 +777,30 @@ public:
     if(boundTexture->target != target || boundTexture->texture != webglTexture ) {
 
       _f->glBindTexture((GLenum)target, webglTexture >= 0 ? (GLuint)webglTexture : emptyTextures[target]);
-      check_glerror(_f);
+      check_glerror(_f, _validation);
 
       boundTexture->target = target;
       boundTexture->texture = webglTexture;
     }
   }
 
+  /**
+   * delete a texture and forget where it was bound. GL may hand out the name again
+   */
+  void deleteTexture(GLuint texture)
+  {
+    for(auto &bound : currentBoundTextures) {
+      //matches nothing, so the next bindTexture call on the unit goes through
+      if(bound.second.texture == (GLint)texture) bound.second.texture = -2;
+    }
+    _f->glDeleteTextures(1, &texture);
+  }
+
   void compressedTexImage2D(TextureTarget target, GLint level, TextureFormat internalFormat,
                             GLsizei width, GLsizei height, const std::vector<unsigned char> &data)
   {
     _f->glCompressedTexImage2D((GLenum)target, level, (GLenum)internalFormat, width, height, 0, data.size(), data.data());
-    check_glerror(_f);
+    check_glerror(_f, _validation);
   }
 
   void texImage2D(TextureTarget target,
@@ -701,7 +813,7 @@ public:
                   const QImage &image)
   {
     _f->glTexImage2D((GLenum)target, level, (GLint)internalFormat, width, height, 0, (GLenum)format, (GLenum)type, image.bits());
-    check_glerror(_f);
+    check_glerror(_f, _validation);
   }
 
   void texImage2D(TextureTarget target,
@@ -713,7 +825,7 @@ public:
   {
     _f->glTexImage2D((GLenum)target, level, (GLint)internalFormat, image.width(), image.height(), 0, (GLenum)format,
                  (GLenum)type, image.bits());
-    check_glerror(_f);
+    check_glerror(_f, _validation);
   }
 
   void texImage2D(TextureTarget target,
@@ -726,7 +838,7 @@ public:
                   const unsigned char *pixels)
   {
     _f->glTexImage2D((GLenum)target, level, (GLint)internalFormat, width, height, 0, (GLenum)format, (GLenum)type, pixels);
-    check_glerror(_f);
+    check_glerror(_f, _validation);
   }
 
   void texImage2D(TextureTarget target,
@@ -738,7 +850,7 @@ public:
                   TextureType type)
   {
     _f->glTexImage2D((GLenum)target, level, (GLint)internalFormat, width, height, 0, (GLenum)format, (GLenum)type, nullptr);
-    check_glerror(_f);
+    check_glerror(_f, _validation);
   }
 
   void texImage2D(TextureTarget target,
@@ -750,14 +862,14 @@ public:
   {
     _f->glTexImage2D((GLenum)target, level, (GLint)internalFormat,
                  mipmap.width, mipmap.height, 0, (GLenum)format, (GLenum)type, mipmap.data.data());
-    check_glerror(_f);
+    check_glerror(_f, _validation);
   }
 
   void scissor(const math::Vector4 &scissor)
   {
     if(currentScissor != scissor) {
       _f->glScissor( scissor.x(), scissor.y(), scissor.z(), scissor.w() );
-      check_glerror(_f);
+      check_glerror(_f, _validation);
       currentScissor = scissor;
     }
   }
@@ -766,7 +878,7 @@ public:
   {
     if(currentViewport.x() != x || currentViewport.y() != y || currentViewport.z() != z || currentViewport.w() != w) {
       _f->glViewport( x, y, z, w);
-      check_glerror(_f);
+      check_glerror(_f, _validation);
       currentViewport.set(x, y, z, w);
     }
   }
@@ -775,17 +887,19 @@ public:
   {
     if(currentViewport != viewport) {
       _f->glViewport( viewport.x(), viewport.y(), viewport.z(), viewport.w());
-      check_glerror(_f);
+      check_glerror(_f, _validation);
       currentViewport = viewport;
     }
   }
 
   void reset()
   {
+    bindVertexArray(nullptr);
+
     for(size_t i=0; i < enabledAttributes.size(); i ++ ) {
       if (enabledAttributes[ i ] == 1) {
         _f->glDisableVertexAttribArray( i );
-        check_glerror(_f);
+        check_glerror(_f, _validation);
         enabledAttributes[ i ] = 0;
       }
     }
@@ -804,6 +918,8 @@ public:
 
     currentProgram = 0;
 
+    currentUnpackAlignment = 0;
+
     currentBlending = Blending::None;
 
     currentFaceDirection = FrontFaceDirection::CW;
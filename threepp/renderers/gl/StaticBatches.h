@@ -0,0 +1,571 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_STATICBATCHES_H
+#define THREEPP_STATICBATCHES_H
+
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <threepp/core/BufferGeometry.h>
+#include <threepp/util/Types.h>
+#include "State.h"
+#include "Residency.h"
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER           0x8F3F
+#endif
+#ifndef GL_COPY_READ_BUFFER
+#define GL_COPY_READ_BUFFER               0x8F36
+#define GL_COPY_WRITE_BUFFER              0x8F37
+#endif
+
+namespace three {
+namespace gl {
+
+/**
+ * static indexed geometries packed into shared vertex and index buffers, so that a run of meshes
+ * using the same material can be submitted with a single glMultiDrawElementsIndirect call.
+ *
+ * Geometries are grouped into pools by vertex format. Newly packed geometries are staged on the
+ * CPU and appended to the pool buffers at the next draw, after which the staged copy is dropped.
+ * The buffers grow geometrically. Space of removed geometries is reclaimed by compacting the pool
+ * on the GPU once it makes up more than half of it. Geometries whose attributes are dynamic or
+ * change after packing are left to the regular path.
+ *
+ * Transforms are passed through the instance attributes (see Renderer_impl::setupInstanceAttributes).
+ * Each draw command gets its own baseInstance, which selects its row in the instance buffer
+ */
+class StaticBatches
+{
+public:
+  struct DrawElementsIndirectCommand
+  {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+  };
+
+  static constexpr unsigned num_streams = 5;
+
+  struct Pool
+  {
+    unsigned itemSizes[num_streams] {0, 0, 0, 0, 0};
+
+    //packed, but not yet uploaded
+    std::vector<float> staged[num_streams];
+    std::vector<uint32_t> stagedIndices;
+
+    //in use, including staged data and the space of removed geometries
+    GLint vertexCount = 0;
+    GLuint indexCount = 0;
+
+    GLint uploadedVertices = 0;
+    GLuint uploadedIndices = 0;
+
+    GLint vertexCapacity = 0;
+    GLuint indexCapacity = 0;
+
+    //held by removed geometries
+    GLint deadVertices = 0;
+    GLuint deadIndices = 0;
+
+    GLuint buffers[num_streams] {0, 0, 0, 0, 0};
+    GLuint indexBuffer = 0;
+
+    //one vertex array per program, since attribute locations differ
+    std::list<VertexArray> vertexArrays;
+
+    unsigned geometries = 0;
+  };
+
+private:
+  typedef void (QOPENGLF_APIENTRYP MultiDrawElementsIndirect)(GLenum mode, GLenum type, const void *indirect,
+                                                               GLsizei drawcount, GLsizei stride);
+
+  struct Range
+  {
+    uint32_t format;
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLint baseVertex;
+    GLint vertexCount;
+    unsigned version;
+  };
+
+  QOpenGLExtraFunctions * const _fn;
+  State &_state;
+  Residency &_residency;
+  MultiDrawElementsIndirect _multiDraw = nullptr;
+
+  std::unordered_map<uint32_t, Pool> _pools;
+  std::unordered_map<size_t, Range> _ranges;
+
+  //geometries that were modified after packing
+  std::unordered_set<size_t> _rejected;
+
+  GLuint _commandBuffer = 0;
+  std::vector<DrawElementsIndirectCommand> _commands;
+  Pool *_pool = nullptr;
+
+  //scratch for bind
+  std::vector<VertexArray::Binding> _bindings;
+
+  static AttributeName streamName(unsigned stream)
+  {
+    static const AttributeName names[num_streams] = {
+       AttributeName::position, AttributeName::normal, AttributeName::uv, AttributeName::uv2, AttributeName::color
+    };
+    return names[stream];
+  }
+
+  static unsigned versionOf(BufferGeometry &geometry)
+  {
+    unsigned version = geometry.index()->version();
+    for(unsigned i = 0; i < num_streams; i++) {
+      const BufferAttribute::Ptr &attribute = geometry.getAttribute(streamName(i));
+      if(attribute) version += attribute->version();
+    }
+    return version;
+  }
+
+  /**
+   * @return the vertex format key: 3 bits of item size per stream, 0 if absent
+   */
+  static uint32_t formatOf(BufferGeometry &geometry)
+  {
+    uint32_t format = 0;
+    for(unsigned i = 0; i < num_streams; i++) {
+      const BufferAttribute::Ptr &attribute = geometry.getAttribute(streamName(i));
+      if(attribute) format |= attribute->itemSize() << (3 * i);
+    }
+    return format;
+  }
+
+  bool pack(BufferGeometry &geometry, Range &range)
+  {
+    size_t vertexCount = geometry.position()->itemCount();
+
+    for(unsigned i = 0; i < num_streams; i++) {
+      const BufferAttribute::Ptr &attribute = geometry.getAttribute(streamName(i));
+      if(attribute && attribute->byteCount() / sizeof(float) != vertexCount * attribute->itemSize()) return false;
+    }
+
+    range.format = formatOf(geometry);
+    Pool &pool = _pools[range.format];
+
+    range.firstIndex = pool.indexCount;
+    range.indexCount = (GLuint)geometry.index()->size();
+    range.baseVertex = pool.vertexCount;
+    range.vertexCount = (GLint)vertexCount;
+    range.version = versionOf(geometry);
+
+    for(unsigned i = 0; i < num_streams; i++) {
+      const BufferAttribute::Ptr &attribute = geometry.getAttribute(streamName(i));
+      pool.itemSizes[i] = attribute ? attribute->itemSize() : 0;
+      if(!attribute) continue;
+
+      const float *data = (const float *)attribute->data(0);
+      pool.staged[i].insert(pool.staged[i].end(), data, data + vertexCount * attribute->itemSize());
+    }
+
+    const uint32_t *indices = (const uint32_t *)geometry.index()->data(0);
+    pool.stagedIndices.insert(pool.stagedIndices.end(), indices, indices + range.indexCount);
+
+    pool.vertexCount += range.vertexCount;
+    pool.indexCount += range.indexCount;
+    pool.geometries++;
+
+    return true;
+  }
+
+  /**
+   * @return a new buffer of the given size, holding the first used bytes of buffer, which is deleted
+   */
+  GLuint reallocate(GLuint buffer, GLsizeiptr used, GLsizeiptr size)
+  {
+    GLuint result;
+    _fn->glGenBuffers(1, &result);
+    _fn->glBindBuffer(GL_COPY_WRITE_BUFFER, result);
+    _fn->glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+
+    if(buffer && used > 0) {
+      _fn->glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+      _fn->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+      _fn->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    _fn->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if(buffer) _fn->glDeleteBuffers(1, &buffer);
+
+    return result;
+  }
+
+  void deleteVertexArrays(Pool &pool)
+  {
+    for(VertexArray &vertexArray : pool.vertexArrays) _state.deleteVertexArray(vertexArray);
+    pool.vertexArrays.clear();
+  }
+
+  /**
+   * register the size of the pool buffers with the residency
+   */
+  void account(uint32_t format, const Pool &pool)
+  {
+    size_t bytes = pool.indexCapacity * sizeof(uint32_t);
+    for(unsigned i = 0; i < num_streams; i++) bytes += pool.vertexCapacity * pool.itemSizes[i] * sizeof(float);
+
+    _residency.addBuffers(format, bytes);
+  }
+
+  void release(uint32_t format, Pool &pool)
+  {
+    _residency.removeBuffers(format);
+
+    for(GLuint &buffer : pool.buffers) {
+      if(buffer) _fn->glDeleteBuffers(1, &buffer);
+      buffer = 0;
+    }
+    if(pool.indexBuffer) _fn->glDeleteBuffers(1, &pool.indexBuffer);
+    pool.indexBuffer = 0;
+
+    deleteVertexArrays(pool);
+  }
+
+  /**
+   * append the staged data to the pool buffers, growing them if needed
+   */
+  void upload(uint32_t format, Pool &pool)
+  {
+    if(pool.vertexCount == pool.uploadedVertices && pool.indexCount == pool.uploadedIndices) return;
+
+    if(pool.vertexCount > pool.vertexCapacity) {
+      GLint capacity = std::max(pool.vertexCount, pool.vertexCapacity * 2);
+
+      for(unsigned i = 0; i < num_streams; i++) {
+        if(!pool.itemSizes[i]) continue;
+
+        GLsizeiptr itemBytes = pool.itemSizes[i] * sizeof(float);
+        pool.buffers[i] = reallocate(pool.buffers[i], pool.uploadedVertices * itemBytes, capacity * itemBytes);
+      }
+      pool.vertexCapacity = capacity;
+      deleteVertexArrays(pool);
+    }
+    if(pool.indexCount > pool.indexCapacity) {
+      GLuint capacity = std::max(pool.indexCount, pool.indexCapacity * 2);
+
+      pool.indexBuffer = reallocate(pool.indexBuffer, pool.uploadedIndices * sizeof(uint32_t),
+                                    capacity * sizeof(uint32_t));
+      pool.indexCapacity = capacity;
+      deleteVertexArrays(pool);
+    }
+
+    //through GL_ARRAY_BUFFER, like Attributes, so the bound vertex array is not affected
+    for(unsigned i = 0; i < num_streams; i++) {
+      if(!pool.itemSizes[i]) continue;
+
+      _fn->glBindBuffer(GL_ARRAY_BUFFER, pool.buffers[i]);
+      _fn->glBufferSubData(GL_ARRAY_BUFFER, pool.uploadedVertices * pool.itemSizes[i] * sizeof(float),
+                           pool.staged[i].size() * sizeof(float), pool.staged[i].data());
+      std::vector<float>().swap(pool.staged[i]);
+    }
+    _fn->glBindBuffer(GL_ARRAY_BUFFER, pool.indexBuffer);
+    _fn->glBufferSubData(GL_ARRAY_BUFFER, pool.uploadedIndices * sizeof(uint32_t),
+                         pool.stagedIndices.size() * sizeof(uint32_t), pool.stagedIndices.data());
+    std::vector<uint32_t>().swap(pool.stagedIndices);
+
+    pool.uploadedVertices = pool.vertexCount;
+    pool.uploadedIndices = pool.indexCount;
+
+    account(format, pool);
+  }
+
+  /**
+   * move the ranges of the pool together on the GPU, dropping the space of removed geometries
+   */
+  void compact(uint32_t format, Pool &pool)
+  {
+    GLint vertexCapacity = pool.vertexCount - pool.deadVertices;
+    GLuint indexCapacity = pool.indexCount - pool.deadIndices;
+
+    GLuint buffers[num_streams] {0, 0, 0, 0, 0};
+    for(unsigned i = 0; i < num_streams; i++) {
+      if(pool.itemSizes[i]) buffers[i] = reallocate(0, 0, vertexCapacity * pool.itemSizes[i] * sizeof(float));
+    }
+    GLuint indexBuffer = reallocate(0, 0, indexCapacity * sizeof(uint32_t));
+
+    GLint vertexCount = 0;
+    GLuint indexCount = 0;
+    for(auto &entry : _ranges) {
+      Range &range = entry.second;
+      if(range.format != format) continue;
+
+      for(unsigned i = 0; i < num_streams; i++) {
+        if(!pool.itemSizes[i]) continue;
+
+        GLsizeiptr itemBytes = pool.itemSizes[i] * sizeof(float);
+        _fn->glBindBuffer(GL_COPY_READ_BUFFER, pool.buffers[i]);
+        _fn->glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[i]);
+        _fn->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.baseVertex * itemBytes,
+                                 vertexCount * itemBytes, range.vertexCount * itemBytes);
+      }
+      //the indices are relative to baseVertex, so they are copied as they are
+      _fn->glBindBuffer(GL_COPY_READ_BUFFER, pool.indexBuffer);
+      _fn->glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+      _fn->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.firstIndex * sizeof(uint32_t),
+                               indexCount * sizeof(uint32_t), range.indexCount * sizeof(uint32_t));
+
+      range.baseVertex = vertexCount;
+      range.firstIndex = indexCount;
+      vertexCount += range.vertexCount;
+      indexCount += range.indexCount;
+    }
+    _fn->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    _fn->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    release(format, pool);
+    for(unsigned i = 0; i < num_streams; i++) pool.buffers[i] = buffers[i];
+    pool.indexBuffer = indexBuffer;
+
+    pool.vertexCount = pool.uploadedVertices = pool.vertexCapacity = vertexCount;
+    pool.indexCount = pool.uploadedIndices = pool.indexCapacity = indexCount;
+    pool.deadVertices = 0;
+    pool.deadIndices = 0;
+
+    account(format, pool);
+  }
+
+public:
+  StaticBatches(QOpenGLExtraFunctions *fn, State &state, Residency &residency)
+     : _fn(fn), _state(state), _residency(residency) {}
+
+  /**
+   * resolve glMultiDrawElementsIndirect, which is core in OpenGL 4.3. The commands select their
+   * instance attributes through baseInstance, which additionally needs OpenGL 4.2 or
+   * ARB_base_instance, and EXT_base_instance on OpenGL ES
+   *
+   * @return true if multi-draw is supported by the current context
+   */
+  bool init(QOpenGLContext *context)
+  {
+    int major = context->format().majorVersion(), minor = context->format().minorVersion();
+
+    bool supported;
+    if(context->isOpenGLES()) {
+      supported = context->hasExtension("GL_EXT_multi_draw_indirect")
+                  && context->hasExtension("GL_EXT_base_instance");
+    }
+    else {
+      bool baseInstance = major > 4 || (major == 4 && minor >= 2) || context->hasExtension("GL_ARB_base_instance");
+
+      supported = (major > 4 || (major == 4 && minor >= 3))
+                  || (baseInstance && context->hasExtension("GL_ARB_multi_draw_indirect"));
+    }
+
+    _multiDraw = nullptr;
+    if(supported) {
+      _multiDraw = (MultiDrawElementsIndirect)context->getProcAddress("glMultiDrawElementsIndirect");
+      if(!_multiDraw)
+        _multiDraw = (MultiDrawElementsIndirect)context->getProcAddress("glMultiDrawElementsIndirectEXT");
+    }
+    return _multiDraw != nullptr;
+  }
+
+  bool supported() const {return _multiDraw != nullptr;}
+
+  /**
+   * @return true if the geometry is (or can be) packed. Packing happens on first use
+   */
+  bool packable(BufferGeometry &geometry)
+  {
+    if(!geometry.index() || !geometry.position() || geometry.index()->dynamic) return false;
+
+    auto found = _ranges.find(geometry.id);
+    if(found != _ranges.end()) {
+      if(found->second.version == versionOf(geometry)) return true;
+
+      //modified after packing, so it is not static after all
+      remove(geometry.id);
+      _rejected.insert(geometry.id);
+      return false;
+    }
+    if(_rejected.count(geometry.id)) return false;
+
+    for(unsigned i = 0; i < num_streams; i++) {
+      const BufferAttribute::Ptr &attribute = geometry.getAttribute(streamName(i));
+      if(attribute && attribute->dynamic) return false;
+    }
+
+    Range range;
+    if(!pack(geometry, range)) {
+      _rejected.insert(geometry.id);
+      return false;
+    }
+    _ranges.emplace(geometry.id, range);
+    return true;
+  }
+
+  /**
+   * @return the pool the geometry was packed into. Runs must not span pools
+   */
+  const Pool *poolOf(const BufferGeometry &geometry) const
+  {
+    auto found = _ranges.find(geometry.id);
+    return found != _ranges.end() ? &_pools.at(found->second.format) : nullptr;
+  }
+
+  /**
+   * forget a geometry. Its space is reclaimed by the next compaction, or when the pool becomes empty
+   */
+  void remove(size_t geometryId)
+  {
+    _rejected.erase(geometryId);
+
+    auto found = _ranges.find(geometryId);
+    if(found == _ranges.end()) return;
+
+    Range range = found->second;
+    _ranges.erase(found);
+
+    Pool &pool = _pools[range.format];
+    if(--pool.geometries == 0) {
+      release(range.format, pool);
+      _pools.erase(range.format);
+    }
+    else {
+      pool.deadVertices += range.vertexCount;
+      pool.deadIndices += range.indexCount;
+    }
+  }
+
+  /**
+   * start collecting draw commands for the pool of the given geometry. Uploads the geometries
+   * packed since, and compacts the pool if needed, so the ranges are final afterwards
+   */
+  void begin(const BufferGeometry &geometry)
+  {
+    uint32_t format = _ranges.at(geometry.id).format;
+    _pool = &_pools.at(format);
+    _commands.clear();
+
+    upload(format, *_pool);
+    if(_pool->deadVertices * 2 > _pool->vertexCount || _pool->deadIndices * 2 > _pool->indexCount)
+      compact(format, *_pool);
+  }
+
+  /**
+   * add a draw command for a packed geometry. The drawn range is limited by the group and the
+   * draw range, like in Renderer_impl::renderBufferDirect
+   */
+  void add(const BufferGeometry &geometry, const Group *group, GLuint baseInstance)
+  {
+    const Range &range = _ranges.at(geometry.id);
+
+    size_t start = geometry.drawRange().start;
+    size_t end = geometry.drawRange().count > 0 ? start + geometry.drawRange().count : range.indexCount;
+    if(group) {
+      start = std::max(start, (size_t)group->start);
+      end = std::min(end, (size_t)(group->start + group->count));
+    }
+    end = std::min(end, (size_t)range.indexCount);
+    if(end <= start) return;
+
+    _commands.push_back({(GLuint)(end - start), 1, range.firstIndex + (GLuint)start, range.baseVertex, baseInstance});
+  }
+
+  /**
+   * bind the vertex array holding the pool streams, recording it first if needed. The instance
+   * attributes are left to the caller
+   */
+  void bind(const enum_map<AttributeName, GLint> &attributes, GLuint program)
+  {
+    //program names are reused after deletion, so the array is matched by its bindings as well
+    _bindings.clear();
+    for(unsigned i = 0; i < num_streams; i++) {
+      auto found = attributes.find(streamName(i));
+      if(_pool->itemSizes[i] && found != attributes.end() && found->second >= 0)
+        _bindings.push_back({found->second, _pool->buffers[i], 0});
+    }
+    _bindings.push_back({-1, _pool->indexBuffer, 0});
+
+    for(auto it = _pool->vertexArrays.begin(); it != _pool->vertexArrays.end(); ) {
+      if(it->program != program) {
+        ++ it;
+        continue;
+      }
+      if(it->bindings == _bindings) {
+        _state.bindVertexArray(&*it);
+        return;
+      }
+      //recorded for a deleted program of the same name
+      _state.deleteVertexArray(*it);
+      it = _pool->vertexArrays.erase(it);
+    }
+
+    _pool->vertexArrays.emplace_back();
+    VertexArray &vertexArray = _pool->vertexArrays.back();
+    vertexArray.program = program;
+    vertexArray.bindings = _bindings;
+
+    _fn->glGenVertexArrays(1, &vertexArray.handle);
+    _state.bindVertexArray(&vertexArray);
+    _state.initAttributes();
+
+    for(unsigned i = 0; i < num_streams; i++) {
+      auto found = attributes.find(streamName(i));
+      if(!_pool->itemSizes[i] || found == attributes.end() || found->second < 0) continue;
+
+      _state.enableAttribute(found->second);
+      _fn->glBindBuffer(GL_ARRAY_BUFFER, _pool->buffers[i]);
+      _fn->glVertexAttribPointer(found->second, _pool->itemSizes[i], GL_FLOAT, GL_FALSE, 0, nullptr);
+    }
+    _fn->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _pool->indexBuffer);
+    _state.disableUnusedAttributes();
+  }
+
+  /**
+   * submit the collected commands
+   *
+   * @return the number of commands
+   */
+  GLsizei draw(GLenum mode)
+  {
+    if(_commands.empty()) return 0;
+
+    if(!_commandBuffer) _fn->glGenBuffers(1, &_commandBuffer);
+
+    _fn->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commandBuffer);
+    _fn->glBufferData(GL_DRAW_INDIRECT_BUFFER, _commands.size() * sizeof(DrawElementsIndirectCommand),
+                      _commands.data(), GL_STREAM_DRAW);
+
+    _multiDraw(mode, GL_UNSIGNED_INT, nullptr, (GLsizei)_commands.size(), 0);
+
+    _fn->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    return (GLsizei)_commands.size();
+  }
+
+  const std::vector<DrawElementsIndirectCommand> &commands() const {return _commands;}
+
+  /**
+   * release all GL objects. Geometries are packed again on next use
+   */
+  void clear()
+  {
+    for(auto &pool : _pools) release(pool.first, pool.second);
+    _pools.clear();
+    _ranges.clear();
+
+    if(_commandBuffer) _fn->glDeleteBuffers(1, &_commandBuffer);
+    _commandBuffer = 0;
+  }
+};
+
+}
+}
+#endif //THREEPP_STATICBATCHES_H
@@ -0,0 +1,159 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#include "TextureStreamer.h"
+#include <cstring>
+
+namespace three {
+namespace gl {
+
+using namespace std;
+
+void TextureStreamer::work()
+{
+  unique_lock<mutex> lock(_mutex);
+
+  while(true) {
+    _wakeup.wait(lock, [this]() {return _quit || !_waiting.empty();});
+    if(_quit) return;
+
+    Job job = move(_waiting.front());
+    _waiting.pop_front();
+    lock.unlock();
+
+    //skip textures deleted while waiting
+    if(!job.texture.expired()) job.image = job.prepare();
+    job.prepare = nullptr;
+
+    lock.lock();
+    _finished.push_back(move(job));
+  }
+}
+
+void TextureStreamer::stop()
+{
+  {
+    lock_guard<mutex> lock(_mutex);
+    _quit = true;
+  }
+  _wakeup.notify_all();
+
+  for(thread &worker : _workers) worker.join();
+  _workers.clear();
+  _quit = false;
+}
+
+void TextureStreamer::setThreads(unsigned threads)
+{
+  if(threads == _workers.size()) return;
+
+  stop();
+  if(threads == 0) {
+    //the textures will be uploaded synchronously
+    _waiting.clear();
+    _finished.clear();
+    _requested.clear();
+  }
+
+  for(unsigned i = 0; i < threads; i++) {
+    _workers.emplace_back(&TextureStreamer::work, this);
+  }
+}
+
+void TextureStreamer::request(const Texture::Ptr &texture, const Prepare &prepare)
+{
+  if(requested(*texture)) return;
+
+  _requested[texture->uuid] = texture->version();
+  {
+    lock_guard<mutex> lock(_mutex);
+    _waiting.push_back({texture->uuid, texture, texture->version(), prepare, QImage()});
+  }
+  _wakeup.notify_one();
+}
+
+bool TextureStreamer::requested(const Texture &texture) const
+{
+  auto found = _requested.find(texture.uuid);
+  return found != _requested.end() && found->second == texture.version();
+}
+
+bool TextureStreamer::take(Result &result, size_t maxBytes)
+{
+  lock_guard<mutex> lock(_mutex);
+
+  while(!_finished.empty()) {
+    Job &job = _finished.front();
+
+    Texture::Ptr texture = job.texture.lock();
+    auto found = _requested.find(job.uuid);
+    bool latest = found != _requested.end() && found->second == job.version;
+
+    if(!texture || !latest || texture->version() != job.version) {
+      //deleted, or updated since. A newer request is queued or follows with the next bind
+      if(latest) _requested.erase(found);
+      _finished.pop_front();
+      continue;
+    }
+
+    if((size_t)job.image.bytesPerLine() * job.image.height() > maxBytes) return false;
+
+    result.texture = texture;
+    result.image = job.image;
+
+    _requested.erase(found);
+    _finished.pop_front();
+    return true;
+  }
+  return false;
+}
+
+void TextureStreamer::texImage2D(TextureTarget target, TextureFormat internalFormat, TextureFormat format,
+                                 TextureType type, const QImage &image, bool pixelBuffer)
+{
+  if(pixelBuffer) {
+    GLsizeiptr bytes = (GLsizeiptr)image.bytesPerLine() * image.height();
+
+    if(!_pixelBuffer) _fn->glGenBuffers(1, &_pixelBuffer);
+    _fn->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pixelBuffer);
+
+    //orphan the previous storage, a transfer from it may still be pending
+    _fn->glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+
+    void *data = _fn->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if(data) {
+      memcpy(data, image.constBits(), (size_t)bytes);
+
+      //false if the content was lost while mapped
+      if(_fn->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+        _fn->glTexImage2D((GLenum)target, 0, (GLint)internalFormat, image.width(), image.height(), 0,
+                          (GLenum)format, (GLenum)type, nullptr);
+        _fn->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        check_glerror(_fn, _validation);
+        return;
+      }
+    }
+    _fn->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+
+  _fn->glTexImage2D((GLenum)target, 0, (GLint)internalFormat, image.width(), image.height(), 0,
+                    (GLenum)format, (GLenum)type, image.constBits());
+  check_glerror(_fn, _validation);
+}
+
+void TextureStreamer::clear()
+{
+  if(_pixelBuffer) {
+    _fn->glDeleteBuffers(1, &_pixelBuffer);
+    _pixelBuffer = 0;
+  }
+
+  lock_guard<mutex> lock(_mutex);
+  _waiting.clear();
+  _finished.clear();
+  _requested.clear();
+}
+
+}
+}
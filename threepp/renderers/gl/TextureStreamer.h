@@ -0,0 +1,130 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_TEXTURESTREAMER_H
+#define THREEPP_TEXTURESTREAMER_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+#include <QOpenGLExtraFunctions>
+#include <QImage>
+#include <threepp/textures/Texture.h>
+#include "Helpers.h"
+
+namespace three {
+namespace gl {
+
+/**
+ * prepares texture images on background threads and hands them back for upload. Resizing and
+ * format conversion run on the worker threads, the render thread only copies the finished image
+ * into a pixel unpack buffer and starts the transfer from there, so the driver can return before
+ * the copy to the GPU is done.
+ *
+ * Images are handed back in the order they were finished. Requests for a texture that has been
+ * deleted or updated again in the meantime are dropped
+ */
+class TextureStreamer
+{
+public:
+  using Prepare = std::function<QImage()>;
+
+  struct Result
+  {
+    Texture::Ptr texture;
+    QImage image;
+  };
+
+private:
+  QOpenGLExtraFunctions * const _fn;
+  const Validation &_validation;
+
+  struct Job
+  {
+    sole::uuid uuid;
+    std::weak_ptr<Texture> texture;
+    unsigned version;
+    Prepare prepare;
+    QImage image;
+  };
+
+  std::vector<std::thread> _workers;
+  std::mutex _mutex;
+  std::condition_variable _wakeup;
+  bool _quit = false;
+
+  std::deque<Job> _waiting;
+  std::deque<Job> _finished;
+
+  //the texture versions requested and not yet taken. Only accessed by the render thread
+  std::unordered_map<sole::uuid, unsigned> _requested;
+
+  GLuint _pixelBuffer = 0;
+
+  void work();
+
+  void stop();
+
+public:
+  TextureStreamer(QOpenGLExtraFunctions *fn, const Validation &validation) : _fn(fn), _validation(validation) {}
+  TextureStreamer(const TextureStreamer &) = delete;
+
+  ~TextureStreamer()
+  {
+    stop();
+  }
+
+  /**
+   * @param threads number of worker threads. 0 disables streaming
+   */
+  void setThreads(unsigned threads);
+
+  bool enabled() const {return !_workers.empty();}
+
+  /**
+   * queue the current version of texture, unless already queued
+   *
+   * @param prepare produces the image to upload. Runs on a worker thread, so it must not touch
+   * the texture or any GL state
+   */
+  void request(const Texture::Ptr &texture, const Prepare &prepare);
+
+  /**
+   * @return true if the version of texture currently set is queued
+   */
+  bool requested(const Texture &texture) const;
+
+  /**
+   * take the next finished image
+   *
+   * @param maxBytes don't take an image larger than this
+   * @return false if there was no image, or the next one is too large
+   */
+  bool take(Result &result, size_t maxBytes);
+
+  /**
+   * @return the number of textures waiting to be prepared or uploaded
+   */
+  size_t queued() const {return _requested.size();}
+
+  /**
+   * upload image to level 0 of the texture bound to target, through the pixel unpack buffer if
+   * pixelBuffer is set
+   */
+  void texImage2D(TextureTarget target, TextureFormat internalFormat, TextureFormat format, TextureType type,
+                  const QImage &image, bool pixelBuffer);
+
+  /**
+   * drop all requests and release the GL objects. Called before the context is destroyed
+   */
+  void clear();
+};
+
+}
+}
+#endif //THREEPP_TEXTURESTREAMER_H
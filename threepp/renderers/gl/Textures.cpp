@@ -5,7 +5,9 @@
 #include "Textures.h"
 #include <threepp/textures/DataTexture.h>
 #include <threepp/textures/ImageTexture.h>
+#include <threepp/textures/BlockDecoder.h>
 #include <threepp/util/Resolver.h>
+#include <limits>
 
 namespace three {
 namespace gl {
@@ -16,6 +18,64 @@ bool needsGenerateMipmaps(const Texture &texture)
          && texture.minFilter != TextureFilter ::Linear;
 }
 
+/**
+ * @return the size of a texel of uncompressed data as stored by GL
+ */
+size_t texelBytes(TextureFormat format, TextureType type)
+{
+  switch(type) {
+    case TextureType::UnsignedShort4444:
+    case TextureType::UnsignedShort5551:
+    case TextureType::UnsignedShort565:
+      return 2;
+    case TextureType::UnsignedInt248:
+      return 4;
+    default:
+      break;
+  }
+
+  size_t channelBytes;
+  switch(type) {
+    case TextureType::UnsignedByte:
+    case TextureType::Byte:
+      channelBytes = 1;
+      break;
+    case TextureType::Short:
+    case TextureType::UnsignedShort:
+    case TextureType::HalfFloat:
+    case TextureType::HalfFloatOES:
+      channelBytes = 2;
+      break;
+    default:
+      channelBytes = 4;
+  }
+
+  switch(format) {
+    case TextureFormat::Alpha:
+    case TextureFormat::Luminance:
+    case TextureFormat::Depth:
+    case TextureFormat::DepthComponent:
+    case TextureFormat::DepthComponent16:
+    case TextureFormat::DepthComponent32:
+      return channelBytes;
+    case TextureFormat::LuminanceAlpha:
+      return 2 * channelBytes;
+    case TextureFormat::RGB:
+    case TextureFormat::BGR:
+      return 3 * channelBytes;
+    default:
+      return 4 * channelBytes;
+  }
+}
+
+/**
+ * @return bytes, plus the levels GL generates below them
+ */
+size_t withGeneratedMipmaps(const Texture &texture, size_t bytes)
+{
+  return needsGenerateMipmaps(texture) ? bytes + bytes / 3 : bytes;
+}
+
 void Textures::onRenderTargetDispose(RenderTargetInternal &renderTarget)
 {
   deallocateRenderTarget( renderTarget );
@@ -47,16 +107,33 @@ void Textures::deallocateTexture(Texture &texture)
       _fn->glDeleteTextures(1, &textureProperties.image_textureCube.get());
     }
     else if(textureProperties.webglInit) {
-      // 2D texture
-      _fn->glDeleteTextures(1, &textureProperties.texture.get());
+      // 2D texture. Not set if evicted
+      if(textureProperties.texture.isSet())
+        _state.deleteTexture(textureProperties.texture);
     }
     else return;
 
+    _residency.removeTexture(texture.uuid);
+
     // remove all webgl properties
     _properties.remove( texture );
   }
 }
 
+void Textures::evict(const sole::uuid &uuid)
+{
+  GlProperties &textureProperties = _properties.getGlProperties(uuid);
+  if(!textureProperties.texture.isSet()) return;
+
+  _state.deleteTexture(textureProperties.texture);
+  textureProperties.texture.reset();
+
+  // texture versions start at 1, so the next use uploads
+  textureProperties.version = 0;
+
+  _infoMemory.textures --;
+}
+
 void Textures::deallocateRenderTarget(RenderTargetInternal &renderTarget)
 {
   if (_properties.has(*renderTarget.texture())) {
@@ -65,6 +142,7 @@ void Textures::deallocateRenderTarget(RenderTargetInternal &renderTarget)
     if(textureProperties.texture.isSet())
       _fn->glDeleteTextures(1, &textureProperties.texture.get());
   }
+  _residency.removeTexture(renderTarget.texture()->uuid);
 
   renderTarget.dispose();
 
@@ -100,11 +178,108 @@ void Textures::setTexture2D(Texture::Ptr texture, unsigned slot)
 
   if (texture->version() > 0 && textureProperties.version != texture->version() ) {
 
-    uploadTexture( textureProperties, texture, slot );
+    ImageTexture *itex = texture->typer;
+    if(itex && _streamer.enabled() && itex->mipmaps().empty())
+      streamTexture( textureProperties, texture, slot );
+    else
+      uploadTexture( textureProperties, texture, slot );
     return;
   }
   _state.activeTexture(GL_TEXTURE0 + slot );
   _state.bindTexture(TextureTarget::twoD, textureProperties.texture);
+
+  _residency.useTexture(texture->uuid);
+}
+
+QImage Textures::prepareImage(const QImage &image, int maxSize, bool premultiplyAlpha, bool powerOfTwo)
+{
+  QImage prepared = clampToMaxSize( image, maxSize, false);
+
+  if(premultiplyAlpha) prepared = prepared.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+  if(powerOfTwo) prepared = makePowerOfTwo( prepared );
+
+  return prepared;
+}
+
+void Textures::streamTexture(GlProperties &textureProperties, Texture::Ptr texture, unsigned slot )
+{
+  if(!_streamer.requested(*texture)) {
+
+    ImageTexture *itex = texture->typer;
+
+    QImage image = itex->image();
+    int maxSize = _capabilities.maxTextureSize;
+    bool premultiplyAlpha = itex->premultiplyAlpha();
+    bool powerOfTwo = !(itex->needsPowerOfTwo() && itex->isPowerOfTwo());
+
+    _streamer.request(texture, [image, maxSize, premultiplyAlpha, powerOfTwo]() {
+      return prepareImage(image, maxSize, premultiplyAlpha, powerOfTwo);
+    });
+  }
+
+  // the previous version, or the empty texture until the first upload
+  _state.activeTexture(GL_TEXTURE0 + slot );
+  if(textureProperties.texture.isSet()) {
+    _state.bindTexture(TextureTarget::twoD, textureProperties.texture);
+    _residency.useTexture(texture->uuid);
+  }
+  else
+    _state.bindTexture(TextureTarget::twoD);
+}
+
+void Textures::uploadStreamed()
+{
+  _infoRender.textureUploadBytes = 0;
+
+  if(!_streamer.enabled()) {
+    _infoRender.texturesQueued = 0;
+    return;
+  }
+
+  TextureStreamer::Result result;
+  size_t bytes = 0;
+
+  // at least one image per frame, however large
+  while(bytes == 0 || bytes < _uploadBudget) {
+
+    size_t maxBytes = bytes == 0 ? std::numeric_limits<size_t>::max() : _uploadBudget - bytes;
+    if(!_streamer.take(result, maxBytes)) break;
+
+    uploadImage(result.texture, result.image);
+    bytes += (size_t)result.image.bytesPerLine() * result.image.height();
+  }
+
+  _infoRender.textureUploadBytes = bytes;
+  _infoRender.texturesQueued = (unsigned)_streamer.queued();
+}
+
+void Textures::uploadImage(const Texture::Ptr &texture, const QImage &image)
+{
+  ImageTexture *itex = texture->typer;
+  auto &textureProperties = _properties.get(texture);
+
+  initTexture(textureProperties, *texture);
+
+  // called before anything is drawn, no texture unit is in use yet
+  _state.activeTexture( GL_TEXTURE0 );
+  _state.bindTexture( TextureTarget::twoD, textureProperties.texture);
+
+  _state.setUnpackAlignment(texture->unpackAlignment());
+
+  setTextureParameters(TextureTarget::twoD, *texture );
+
+  _streamer.texImage2D(TextureTarget::twoD, itex->format(), itex->format(), itex->type(), image,
+                       _capabilities.pixelBufferObjects && !image.isNull());
+
+  if ( needsGenerateMipmaps(*texture) ) _fn->glGenerateMipmap(GL_TEXTURE_2D );
+
+  size_t bytes = (size_t)image.width() * image.height() * texelBytes(itex->format(), itex->type());
+  _residency.addTexture(texture->uuid, withGeneratedMipmaps(*texture, bytes), !image.isNull());
+
+  textureProperties.version = texture->version();
+
+  texture->onUpdate.emitSignal(*texture);
 }
 
 void Textures::setTextureCube(Texture::Ptr texture, unsigned slot)
@@ -115,6 +290,7 @@ void Textures::setTextureCube(Texture::Ptr texture, unsigned slot)
 
     TextureFormat extFormat = _extensions.extend(texture->format());
     TextureType extType = _extensions.extend(texture->type());
+    size_t bytes = 0;
 
     auto baseFunc = [&](Texture &texture) {
 
@@ -134,6 +310,8 @@ void Textures::setTextureCube(Texture::Ptr texture, unsigned slot)
       _state.activeTexture(GL_TEXTURE0 + slot );
       _state.bindTexture(TextureTarget::cubeMap, webglTextureCube);
 
+      _state.setUnpackAlignment(texture.unpackAlignment());
+
       setTextureParameters(TextureTarget::cubeMap, texture);
     };
     if(DataCubeTexture *dctex = texture->typer) {
@@ -147,11 +325,13 @@ void Textures::setTextureCube(Texture::Ptr texture, unsigned slot)
 
           _state.texImage2D(TextureTarget::cubeMapPositiveX+i, 0, extFormat, data.width(), data.height(),
                             extFormat, extType, data.bytes());
+          bytes += data.width() * data.height() * texelBytes(dctex->format(), dctex->type());
         }
         else {
           for ( size_t j = 0, jl = data.mipmaps().size(); j < jl; j ++ ) {
 
             const Mipmap &mipmap = data.mipmap(j);
+            bytes += mipmap.data.size();
 
             if ( dctex->format() != TextureFormat::RGBA && dctex->format() != TextureFormat::RGB ) {
 
@@ -180,6 +360,7 @@ void Textures::setTextureCube(Texture::Ptr texture, unsigned slot)
 
         _state.texImage2D(TextureTarget::cubeMapPositiveX+i, 0, extFormat,
                           cubeImage.width(), cubeImage.height(), extFormat, extType, cubeImage);
+        bytes += (size_t)cubeImage.width() * cubeImage.height() * texelBytes(ictex->format(), ictex->type());
       }
     }
 
@@ -188,6 +369,9 @@ void Textures::setTextureCube(Texture::Ptr texture, unsigned slot)
       _fn->glGenerateMipmap( GL_TEXTURE_CUBE_MAP );
     }
 
+    // cube textures are not evicted
+    _residency.addTexture(texture->uuid, withGeneratedMipmaps(*texture, bytes), false);
+
     textureProperties.version = texture->version();
 
     texture->onUpdate.emitSignal( *texture );
@@ -195,6 +379,8 @@ void Textures::setTextureCube(Texture::Ptr texture, unsigned slot)
   } else {
     _state.activeTexture(GL_TEXTURE0 + slot );
     _state.bindTexture(TextureTarget::cubeMap, textureProperties.image_textureCube);
+
+    _residency.useTexture(texture->uuid);
   }
 }
 
@@ -212,12 +398,12 @@ void Textures::setTextureParameters(TextureTarget textureTarget, Texture &textur
 
     _fn->glTexParameteri((GLenum)textureTarget, GL_TEXTURE_MAG_FILTER, (GLint)texture.magFilter);
     _fn->glTexParameteri((GLenum)textureTarget, GL_TEXTURE_MIN_FILTER, (GLint)texture.minFilter);
-    check_glerror(_fn);
+    check_glerror(_fn, _validation);
   }
   else {
     _fn->glTexParameteri((GLenum)textureTarget, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
     _fn->glTexParameteri((GLenum)textureTarget, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-    check_glerror(_fn);
+    check_glerror(_fn, _validation);
 
     if ( texture.wrapS != TextureWrapping::ClampToEdge || texture.wrapT != TextureWrapping::ClampToEdge) {
       qWarning() << "Texture is not power of two. Texture.wrapS and Texture.wrapT should be set to ClampToEdge";
@@ -225,7 +411,7 @@ void Textures::setTextureParameters(TextureTarget textureTarget, Texture &textur
 
     _fn->glTexParameteri((GLenum)textureTarget, GL_TEXTURE_MAG_FILTER, filterFallback( texture.magFilter ) );
     _fn->glTexParameteri((GLenum)textureTarget, GL_TEXTURE_MIN_FILTER, filterFallback( texture.minFilter ) );
-    check_glerror(_fn);
+    check_glerror(_fn, _validation);
 
     if ( texture.minFilter != TextureFilter::Nearest && texture.minFilter != TextureFilter::Linear) {
       qWarning() << "Texture is not power of two. Texture.minFilter should be set to Nearest or Linear";
@@ -242,23 +428,29 @@ void Textures::setTextureParameters(TextureTarget textureTarget, Texture &textur
 
       _fn->glTexParameterf((GLenum)textureTarget, GL_TEXTURE_MAX_ANISOTROPY_EXT,
                            std::min(texture.anisotropy, (float)_capabilities.getMaxAnisotropy()));
-      check_glerror(_fn);
+      check_glerror(_fn, _validation);
       _properties.get(texture).currentAnisotropy = texture.anisotropy;
     }
   }
 }
 
-void Textures::uploadTexture(GlProperties &textureProperties, Texture::Ptr texture, unsigned slot )
+void Textures::initTexture(GlProperties &textureProperties, Texture &texture)
 {
   if (!textureProperties.webglInit) {
 
     textureProperties.webglInit = true;
 
-    texture->onDispose.connect([this](Texture &t) {
+    texture.onDispose.connect([this](Texture &t) {
+      bool resident = _properties.has(t) && _properties.get(t).texture.isSet();
+
       deallocateTexture( t );
 
-      _infoMemory.textures --;
+      if(resident) _infoMemory.textures --;
     });
+  }
+
+  // again after eviction
+  if (!textureProperties.texture.isSet()) {
 
     GLuint tex;
     _fn->glGenTextures(1, &tex);
@@ -266,14 +458,23 @@ void Textures::uploadTexture(GlProperties &textureProperties, Texture::Ptr textu
 
     _infoMemory.textures ++;
   }
+}
+
+void Textures::uploadTexture(GlProperties &textureProperties, Texture::Ptr texture, unsigned slot )
+{
+  initTexture(textureProperties, *texture);
 
   _state.activeTexture( GL_TEXTURE0 + slot );
   _state.bindTexture( TextureTarget::twoD, textureProperties.texture);
 
-  _fn->glPixelStorei(GL_UNPACK_ALIGNMENT, texture->unpackAlignment() );
+  _state.setUnpackAlignment(texture->unpackAlignment());
 
   setTextureParameters(TextureTarget::twoD, *texture );
 
+  // what is uploaded, and whether it can be uploaded again after eviction
+  size_t bytes = 0;
+  bool evictable = false;
+
   if(DepthTexture *dtex = texture->typer) {
     // populate depth texture with dummy data
 
@@ -320,9 +521,12 @@ void Textures::uploadTexture(GlProperties &textureProperties, Texture::Ptr textu
     }
 
     _state.texImage2D(TextureTarget::twoD, 0, internalFormat, dtex->width(), dtex->height(), dtex->format(), dtex->type());
+    bytes = (size_t)dtex->width() * dtex->height() * texelBytes(internalFormat, dtex->type());
   }
   else if(DataTexture *dtex = texture->typer) {
 
+    evictable = true;
+
     if(dtex->compressed()) {
       for ( size_t i = 0, il = dtex->mipmaps().size(); i < il; i ++ ) {
 
@@ -334,6 +538,20 @@ void Textures::uploadTexture(GlProperties &textureProperties, Texture::Ptr textu
           if (std::find(formats.cbegin(), formats.cend(), (GLint)dtex->format()) != formats.cend()) {
 
             _state.compressedTexImage2D(TextureTarget::twoD, i, dtex->format(), mipmap.width, mipmap.height, mipmap.data);
+            bytes += mipmap.data.size();
+          }
+          else if(blocks::decodable(dtex->format())) {
+
+            // decode on the CPU, at 4 bytes per texel
+            if(i == 0) qWarning() << "compressed texture format" << (GLenum)dtex->format() << "not supported, decoding";
+
+            std::vector<byte> rgba;
+            if(!blocks::decode(dtex->format(), mipmap, rgba))
+              throw std::invalid_argument("uploadTexture: truncated compressed texture data");
+
+            _state.texImage2D(TextureTarget::twoD, i, TextureFormat::RGBA, mipmap.width, mipmap.height,
+                              TextureFormat::RGBA, TextureType::UnsignedByte, rgba.data());
+            bytes += rgba.size();
           }
           else {
             throw std::invalid_argument("uploadTexture: unsupported compressed texture format");
@@ -342,6 +560,7 @@ void Textures::uploadTexture(GlProperties &textureProperties, Texture::Ptr textu
         } else {
           _state.texImage2D(TextureTarget::twoD, i, dtex->format(), mipmap.width, mipmap.height, dtex->format(),
                             dtex->type(), mipmap.data.data() );
+          bytes += mipmap.data.size();
         }
       }
     }
@@ -357,6 +576,7 @@ void Textures::uploadTexture(GlProperties &textureProperties, Texture::Ptr textu
           const Mipmap &mipmap = dtex->mipmaps()[ i ];
           _state.texImage2D(TextureTarget::twoD, i, dtex->format(),
                             mipmap.width, mipmap.height, dtex->format(), dtex->type(), mipmap.data.data() );
+          bytes += mipmap.data.size();
         }
 
         dtex->setGenerateMipmaps(false);
@@ -364,23 +584,14 @@ void Textures::uploadTexture(GlProperties &textureProperties, Texture::Ptr textu
       else {
         _state.texImage2D(TextureTarget::twoD, 0, dtex->format(),
                           dtex->width(), dtex->height(), dtex->format(), dtex->type(), dtex->bytes());
+        bytes = dtex->width() * dtex->height() * texelBytes(dtex->format(), dtex->type());
       }
     }
   }
   else if(ImageTexture *itex = texture->typer) {
     // regular Texture (image, video, canvas)
-    QImage image = clampToMaxSize( itex->image(), _capabilities.maxTextureSize, false);
-
-    if(itex->premultiplyAlpha()) {
-      image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-      _fn->glBlendEquation(GL_FUNC_ADD); //TODO ?
-      _fn->glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); //TODO ?
-    }
-
-    if (!(itex->needsPowerOfTwo() && itex->isPowerOfTwo())) {
-
-      image = makePowerOfTwo( image );
-    }
+    QImage image = prepareImage( itex->image(), _capabilities.maxTextureSize, itex->premultiplyAlpha(),
+                                 !(itex->needsPowerOfTwo() && itex->isPowerOfTwo()));
 
     // use manually created mipmaps if available
     // if there are no manual mipmaps
@@ -391,17 +602,23 @@ void Textures::uploadTexture(GlProperties &textureProperties, Texture::Ptr textu
 
         const Mipmap &mipmap = itex->mipmaps()[ i ];
         _state.texImage2D(TextureTarget::twoD, i, itex->format(), itex->format(), itex->type(), mipmap );
+        bytes += (size_t)mipmap.width * mipmap.height * texelBytes(itex->format(), itex->type());
       }
 
       itex->setGenerateMipmaps(false);
+      evictable = true;
     }
     else {
       _state.texImage2D(TextureTarget::twoD, 0, itex->format(), itex->format(), itex->type(), image );
+      bytes = (size_t)image.width() * image.height() * texelBytes(itex->format(), itex->type());
+      evictable = !image.isNull();
     }
   }
 
   if ( needsGenerateMipmaps(*texture) ) _fn->glGenerateMipmap(GL_TEXTURE_2D );
 
+  _residency.addTexture(texture->uuid, withGeneratedMipmaps(*texture, bytes), evictable);
+
   textureProperties.version = texture->version();
 
   texture->onUpdate.emitSignal(*texture);
@@ -465,7 +682,7 @@ void Textures::setupDepthTexture(GLuint framebuffer, RenderTargetInternal &rende
   }
 
   setTexture2D( renderTarget.depthTexture(), 0 );
-  check_glerror(_fn);
+  check_glerror(_fn, _validation);
 
   switch(renderTarget.depthTexture()->format()) {
     case TextureFormat::Depth:
@@ -477,7 +694,7 @@ void Textures::setupDepthTexture(GLuint framebuffer, RenderTargetInternal &rende
     default:
       throw std::invalid_argument("unknown depth texture format");
   }
-  check_glerror(_fn);
+  check_glerror(_fn, _validation);
 }
 
 // Setup GL resources for a non-texture depth buffer
@@ -491,7 +708,7 @@ void Textures::setupDepthRenderbuffer(RenderTargetInternal &renderTarget)
     _fn->glBindFramebuffer( GL_FRAMEBUFFER, renderTarget.frameBuffer);
     _fn->glGenRenderbuffers(1, &renderTarget.renderBuffer);
     setupRenderBufferStorage(renderTarget.renderBuffer, renderTarget);
-    check_glerror(_fn);
+    check_glerror(_fn, _validation);
   }
 
   _fn->glBindFramebuffer(GL_FRAMEBUFFER, _defaultFBO);
@@ -523,6 +740,10 @@ void Textures::setupRenderTarget(RenderTargetInternal &renderTarget)
 
   _infoMemory.textures ++;
 
+  const Texture &texture = *renderTarget.texture();
+  size_t bytes = (size_t)renderTarget.width() * renderTarget.height() * texelBytes(texture.format(), texture.type());
+  _residency.addTexture(texture.uuid, withGeneratedMipmaps(texture, bytes), false);
+
   // Setup framebuffer
   _fn->glGenFramebuffers(1, &renderTarget.frameBuffer);
 
@@ -539,7 +760,7 @@ void Textures::setupRenderTarget(RenderTargetInternal &renderTarget)
 
     setupDepthRenderbuffer( renderTarget );
   }
-  check_framebuffer(_fn);
+  check_framebuffer(_fn, _validation);
 }
 
 // Set up GL resources for the render target
@@ -558,7 +779,7 @@ void Textures::setupRenderTarget(RenderTargetCube &renderTarget)
   // Setup framebuffer
   renderTarget.frameBuffers.resize(6);
   _fn->glGenFramebuffers(6, renderTarget.frameBuffers.data());
-  check_glerror(_fn);
+  check_glerror(_fn, _validation);
 
   // Setup color buffer
   _state.bindTexture(renderTarget.textureTarget, textureProperties.texture );
@@ -14,6 +14,8 @@
 #include "Properties.h"
 #include "Capabilities.h"
 #include "Helpers.h"
+#include "TextureStreamer.h"
+#include "Residency.h"
 
 namespace three {
 namespace gl {
@@ -21,17 +23,27 @@ namespace gl {
 class Textures
 {
   QOpenGLExtraFunctions * const _fn;
+  const Validation &_validation;
   Extensions &_extensions;
   State & _state;
   Properties &_properties;
   Capabilities &_capabilities;
   MemoryInfo &_infoMemory;
+  RenderInfo &_infoRender;
+  Residency &_residency;
 
   GLuint _defaultFBO = 0;
 
+  TextureStreamer _streamer;
+  size_t _uploadBudget = 0;
+
+  void initTexture(GlProperties &textureProperties, Texture &texture);
+
   void setTextureCubeDynamic( Texture::Ptr texture, unsigned slot );
   void setTextureParameters(TextureTarget textureTarget, Texture &texture);
   void uploadTexture(GlProperties &textureProperties, Texture::Ptr texture, unsigned slot );
+  void streamTexture(GlProperties &textureProperties, Texture::Ptr texture, unsigned slot );
+  void uploadImage(const Texture::Ptr &texture, const QImage &image);
   void setupFrameBufferTexture(GLuint framebuffer, const Renderer::Target &renderTarget, GLenum attachment, TextureTarget textureTarget);
   void setupRenderBufferStorage(GLuint renderbuffer, const RenderTarget &renderTarget );
   void setupDepthTexture(GLuint framebuffer, RenderTargetInternal &renderTarget);
@@ -39,13 +51,15 @@ class Textures
   void setupDepthRenderbuffer(RenderTargetCube &renderTarget);
 
 public:
-  Textures(QOpenGLExtraFunctions * fn, Extensions &extensions, State &state, Properties &properties,
-     Capabilities &capabilities, MemoryInfo &infoMemory)
-  : _fn(fn), _extensions(extensions), _state(state), _properties(properties), _capabilities(capabilities),
-    _infoMemory(infoMemory)
+  Textures(QOpenGLExtraFunctions * fn, const Validation &validation, Extensions &extensions, State &state,
+     Properties &properties, Capabilities &capabilities, MemoryInfo &infoMemory, RenderInfo &infoRender,
+     Residency &residency)
+  : _fn(fn), _validation(validation), _extensions(extensions), _state(state), _properties(properties),
+    _capabilities(capabilities), _infoMemory(infoMemory), _infoRender(infoRender), _residency(residency),
+    _streamer(fn, validation)
   {}
 
-  QImage clampToMaxSize(const QImage &image, int maxSize, bool flipY )
+  static QImage clampToMaxSize(const QImage &image, int maxSize, bool flipY )
   {
     QImage img = flipY ? image.mirrored() : image;
 
@@ -55,7 +69,7 @@ public:
     return img;
   }
 
-  QImage makePowerOfTwo(const QImage &image)
+  static QImage makePowerOfTwo(const QImage &image)
   {
     int width = math::nearestPowerOfTwo(image.width() );
     int height = math::nearestPowerOfTwo(image.height());
@@ -63,6 +77,11 @@ public:
     return image.scaled(width, height);
   }
 
+  /**
+   * the image uploaded for an ImageTexture without mipmaps. Thread safe
+   */
+  static QImage prepareImage(const QImage &image, int maxSize, bool premultiplyAlpha, bool powerOfTwo);
+
   inline GLenum filterFallback(TextureFilter f)
   {
     return f == TextureFilter::Nearest
@@ -83,9 +102,35 @@ public:
   void onRenderTargetDispose(RenderTargetCube &renderTarget);
   void onTextureDispose(Texture &texture);
 
+  /**
+   * delete the GL texture to free GPU memory. The texture keeps its data and is uploaded again
+   * when it is next used. Only for textures registered with the Residency as evictable
+   */
+  void evict(const sole::uuid &uuid);
+
   void setDefaultFramebuffer(GLuint fbo) {
     _defaultFBO = fbo;
   }
+
+  /**
+   * prepare image textures on background threads, see OpenGLRendererOptions::textureThreads
+   */
+  void setStreaming(unsigned threads, size_t uploadBudget) {
+    _streamer.setThreads(threads);
+    _uploadBudget = uploadBudget;
+  }
+
+  /**
+   * upload the images prepared since the last call, within the budget. Called once per frame
+   */
+  void uploadStreamed();
+
+  /**
+   * drop streaming state tied to the context. Called before the context is destroyed
+   */
+  void clear() {
+    _streamer.clear();
+  }
 };
 }
 }
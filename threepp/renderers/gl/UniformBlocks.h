@@ -0,0 +1,232 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_UNIFORMBLOCKS_H
+#define THREEPP_UNIFORMBLOCKS_H
+
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <QOpenGLExtraFunctions>
+#include <threepp/camera/Camera.h>
+#include "Lights.h"
+
+namespace three {
+namespace gl {
+
+/**
+ * collects values in std140 layout
+ */
+class Std140
+{
+  std::vector<uint8_t> _data;
+
+  void align(size_t alignment)
+  {
+    _data.resize((_data.size() + alignment - 1) / alignment * alignment, 0);
+  }
+
+  template <typename T>
+  Std140 &put(size_t alignment, const T *values, size_t count)
+  {
+    align(alignment);
+    size_t offset = _data.size();
+    _data.resize(offset + count * sizeof(T));
+    memcpy(_data.data() + offset, values, count * sizeof(T));
+    return *this;
+  }
+
+public:
+  void clear() {_data.clear();}
+
+  Std140 &scalar(float value) {return put(4, &value, 1);}
+
+  Std140 &scalar(int32_t value) {return put(4, &value, 1);}
+
+  Std140 &vec2(const math::Vector2 &v) {
+    float values[] = {v.x(), v.y()};
+    return put(8, values, 2);
+  }
+
+  Std140 &vec3(const math::Vector3 &v) {return put(16, v.elements(), 3);}
+
+  Std140 &vec3(const Color &c) {
+    float values[] = {c.r, c.g, c.b};
+    return put(16, values, 3);
+  }
+
+  Std140 &mat4(const math::Matrix4 &m) {return put(16, m.elements(), 16);}
+
+  //structures (and arrays thereof) start and end on a vec4 boundary
+  Std140 &beginStruct() {align(16); return *this;}
+
+  Std140 &endStruct() {align(16); return *this;}
+
+  const uint8_t *data() const {return _data.data();}
+
+  //the block size is rounded up to a vec4 boundary
+  GLsizeiptr size() {
+    align(16);
+    return (GLsizeiptr)_data.size();
+  }
+};
+
+/**
+ * camera and lights state shared by all programs through uniform buffers. Instead of setting
+ * the same uniforms into each program as it becomes current, the values are written whenever
+ * the camera block contents change and once per frame, respectively. Programs compiled with
+ * ProgramParameters::uniformBlocks declare the blocks (see Program.cpp and lights_pars.glsl) and
+ * get them assigned to the fixed binding points after linking.
+ *
+ * The member order must match the GLSL declarations
+ */
+class UniformBlocks
+{
+public:
+  enum Binding : GLuint {Camera=0, Lights=1};
+
+private:
+  QOpenGLExtraFunctions * const _fn;
+
+  GLuint _buffers[2] {0, 0};
+  Std140 _data;
+
+  //contents of the camera block last uploaded. A camera object may be moved between draws
+  //(shadow cube faces and cascades), so its address can't identify the values
+  std::vector<uint8_t> _cameraBlock;
+
+  void upload(Binding binding)
+  {
+    if(!_buffers[binding]) {
+      _fn->glGenBuffers(1, &_buffers[binding]);
+      _fn->glBindBuffer(GL_UNIFORM_BUFFER, _buffers[binding]);
+      _fn->glBindBufferBase(GL_UNIFORM_BUFFER, binding, _buffers[binding]);
+    }
+    else
+      _fn->glBindBuffer(GL_UNIFORM_BUFFER, _buffers[binding]);
+
+    //respecify the whole store so draws still using the previous values don't stall
+    GLsizeiptr size = _data.size();
+    _fn->glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    _fn->glBufferSubData(GL_UNIFORM_BUFFER, 0, size, _data.data());
+    _fn->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  }
+
+public:
+  explicit UniformBlocks(QOpenGLExtraFunctions *fn) : _fn(fn) {}
+
+  /**
+   * assign the blocks declared by a freshly linked program to the binding points
+   */
+  static void bind(QOpenGLExtraFunctions *fn, GLuint program)
+  {
+    GLuint index = fn->glGetUniformBlockIndex(program, "Camera");
+    if(index != GL_INVALID_INDEX) fn->glUniformBlockBinding(program, index, Camera);
+
+    index = fn->glGetUniformBlockIndex(program, "Lights");
+    if(index != GL_INVALID_INDEX) fn->glUniformBlockBinding(program, index, Lights);
+  }
+
+  /**
+   * force the camera block to be rewritten. Called at the start of each frame, since the camera
+   * and the renderer settings may have changed in between
+   */
+  void invalidate()
+  {
+    _cameraBlock.clear();
+  }
+
+  void setCamera(const three::Camera &camera, float toneMappingExposure, float toneMappingWhitePoint)
+  {
+    _data.clear();
+    _data.mat4(camera.projectionMatrix())
+       .mat4(camera.matrixWorldInverse())
+       .vec3(camera.matrixWorld().getPosition())
+       .scalar(toneMappingExposure)
+       .scalar(toneMappingWhitePoint)
+       .scalar((float)(2.0f / ( std::log( camera.far() + 1.0f ) / M_LN2 )));
+
+    size_t size = (size_t)_data.size();
+    if(_cameraBlock.size() == size && memcmp(_cameraBlock.data(), _data.data(), size) == 0) return;
+    _cameraBlock.assign(_data.data(), _data.data() + size);
+
+    upload(Camera);
+  }
+
+  void setLights(const three::gl::Lights::State &state)
+  {
+    _data.clear();
+    _data.vec3(state.ambient.isNull() ? Color(0, 0, 0) : state.ambient);
+
+    for(const auto &light : state.directional) {
+      _data.beginStruct()
+         .vec3(light->direction)
+         .vec3(light->color)
+         .scalar((int32_t)light->shadow)
+         .scalar(light->shadowBias)
+         .scalar(light->shadowRadius)
+         .vec2(light->shadowMapSize)
+         .endStruct();
+    }
+    for(const auto &light : state.spot) {
+      _data.beginStruct()
+         .vec3(light->position)
+         .vec3(light->direction)
+         .vec3(light->color)
+         .scalar(light->distance)
+         .scalar(light->decay)
+         .scalar(light->coneCos)
+         .scalar(light->penumbraCos)
+         .scalar((int32_t)light->shadow)
+         .scalar(light->shadowBias)
+         .scalar(light->shadowRadius)
+         .vec2(light->shadowMapSize)
+         .endStruct();
+    }
+    for(const auto &light : state.rectArea) {
+      _data.beginStruct()
+         .vec3(light->color)
+         .vec3(light->position)
+         .vec3(light->halfWidth)
+         .vec3(light->halfHeight)
+         .endStruct();
+    }
+    for(const auto &light : state.point) {
+      _data.beginStruct()
+         .vec3(light->position)
+         .vec3(light->color)
+         .scalar(light->distance)
+         .scalar(light->decay)
+         .scalar((int32_t)light->shadow)
+         .scalar(light->shadowBias)
+         .scalar(light->shadowRadius)
+         .vec2(light->shadowMapSize)
+         .scalar(light->shadowCameraNear)
+         .scalar(light->shadowCameraFar)
+         .endStruct();
+    }
+    for(const auto &light : state.hemi) {
+      _data.beginStruct()
+         .vec3(light->direction)
+         .vec3(light->skyColor)
+         .vec3(light->groundColor)
+         .endStruct();
+    }
+
+    upload(Lights);
+  }
+
+  void clear()
+  {
+    for(GLuint &buffer : _buffers) {
+      if(buffer) _fn->glDeleteBuffers(1, &buffer);
+      buffer = 0;
+    }
+    _cameraBlock.clear();
+  }
+};
+
+}
+}
+#endif //THREEPP_UNIFORMBLOCKS_H
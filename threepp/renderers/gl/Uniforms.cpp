@@ -139,6 +139,12 @@ UniformName get(string name, bool isIndex)
      MATCH_NAME(hemisphereLights),
      MATCH_NAME(directionalShadowMap),
      MATCH_NAME(directionalShadowMatrix),
+     MATCH_NAME(directionalCascadeMatrix),
+     MATCH_NAME(directionalShadowTile),
+     MATCH_NAME(spotShadowTile),
+     MATCH_NAME(pointShadowTile),
+     MATCH_NAME(shadowAtlas),
+     MATCH_NAME(directionalCascadeSplits),
      MATCH_NAME(spotShadowMap),
      MATCH_NAME(spotShadowMatrix),
      MATCH_NAME(pointShadowMap),
@@ -151,7 +157,11 @@ UniformName get(string name, bool isIndex)
      MATCH_NAME(groundColor),
      MATCH_NAME(coneCos),
      MATCH_NAME(penumbraCos),
-     MATCH_NAME(decay)
+     MATCH_NAME(decay),
+     MATCH_NAME(clusterLights),
+     MATCH_NAME(clusterCells),
+     MATCH_NAME(clusterIndices),
+     MATCH_NAME(clusterSlicing)
   };
   if (isIndex) {
     unsigned index = atoi(name.c_str());
@@ -180,6 +190,9 @@ void Uniforms::parseUniform(GLuint program, unsigned index, UniformContainer *co
   _renderer.glGetActiveUniform( program, index, 100, &length, &size, &type, uname);
   GLint addr = _renderer.glGetUniformLocation(program, uname);
 
+  //members of uniform blocks have no location. They are written by UniformBlocks
+  if(addr < 0) return;
+
   string name(uname);
   sregex_iterator rex_it(name.cbegin(), name.cend(), rex);
   sregex_iterator rex_end;
@@ -214,7 +227,7 @@ void Uniforms::parseUniform(GLuint program, unsigned index, UniformContainer *co
 
 void Uniform::setValue(GLfloat v) {
   _renderer.glUniform1f( _addr, v );
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(GLint v) {
@@ -226,7 +239,7 @@ void Uniform::setValue(GLint v) {
       _renderer.glUniform1i( _addr, v );
       break;
   }
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(GLuint v) {
@@ -238,54 +251,60 @@ void Uniform::setValue(GLuint v) {
       _renderer.glUniform1i( _addr, v );
       break;
   }
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(const three::Color &c) {
   _renderer.glUniform3f(_addr, c.r, c.g, c.b);
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(const math::Vector2 &v) {
   _renderer.glUniform2fv(_addr, 1, v.elements());
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(const math::Vector3 &v) {
   _renderer.glUniform3fv(_addr, 1, v.elements());
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(const math::Vector4 &v) {
   _renderer.glUniform4fv(_addr, 1, v.elements());
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(const math::Matrix3 &v) {
   _renderer.glUniformMatrix3fv( _addr, 1, GL_FALSE, v.elements());
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(const math::Matrix4 &v) {
   _renderer.glUniformMatrix4fv( _addr, 1, GL_FALSE, v.elements());
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(const GLint *array, size_t size) {
   _renderer.glUniform2iv(_addr, size, array);
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(const std::vector<math::Matrix4> &matrices)
 {
   _renderer.glUniformMatrix4fv( _addr, matrices.size(), GL_FALSE, reinterpret_cast<const GLfloat *>(matrices.data()));
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
+}
+
+void Uniform::setValue(const std::vector<math::Vector4> &vectors)
+{
+  _renderer.glUniform4fv( _addr, vectors.size(), reinterpret_cast<const GLfloat *>(vectors.data()));
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(const std::vector<float> &vector)
 {
   _renderer.glUniform1fv(_addr, vector.size(), vector.data());
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(const std::vector<Texture::Ptr> &textures)
@@ -293,7 +312,7 @@ void Uniform::setValue(const std::vector<Texture::Ptr> &textures)
   vector<GLuint> units = _renderer.allocTextureUnits(textures.size());
 
   _renderer.glUniform1iv(_addr, textures.size(), (GLint *)units.data());
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 
   for (size_t i = 0; i < textures.size(); ++ i ) {
 
@@ -306,7 +325,7 @@ void Uniform::setValue(const Texture::Ptr &texture)
   unsigned unit = _renderer.allocTextureUnit();
   _renderer.glUniform1i( _addr, unit );
   _renderer.setTexture2D(texture, unit );
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 void Uniform::setValue(const CubeTexture::Ptr &texture)
@@ -314,7 +333,7 @@ void Uniform::setValue(const CubeTexture::Ptr &texture)
   unsigned unit = _renderer.allocTextureUnit();
   _renderer.glUniform1i( _addr, unit );
   _renderer.setTextureCube(texture, unit );
-  check_glerror(&_renderer);
+  check_glerror(&_renderer, _renderer.validationLevel());
 }
 
 }
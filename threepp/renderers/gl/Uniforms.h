@@ -139,6 +139,12 @@ enum class UniformName : unsigned
   hemisphereLights,
   directionalShadowMap,
   directionalShadowMatrix,
+  directionalCascadeMatrix,
+  directionalShadowTile,
+  spotShadowTile,
+  pointShadowTile,
+  shadowAtlas,
+  directionalCascadeSplits,
   spotShadowMap,
   spotShadowMatrix,
   pointShadowMap,
@@ -149,7 +155,11 @@ enum class UniformName : unsigned
   halfWidth,
   coneCos,
   penumbraCos,
-  decay
+  decay,
+  clusterLights,
+  clusterCells,
+  clusterIndices,
+  clusterSlicing
 };
 
 namespace uniformname {
@@ -226,6 +236,8 @@ public:
 
   void setValue(const std::vector<math::Matrix4> &matrices);
 
+  void setValue(const std::vector<math::Vector4> &vectors);
+
   void setValue(const std::vector<Texture::Ptr> &textures);
 
   virtual Uniform *asUniform() {return this;}
@@ -0,0 +1,122 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_WORKERPOOL_H
+#define THREEPP_WORKERPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+namespace three {
+namespace gl {
+
+/**
+ * a set of persistent threads which, together with the calling thread, execute a job. The job
+ * is expected to distribute its work itself, typically by pulling indices from an atomic counter
+ */
+class WorkerPool
+{
+  std::vector<std::thread> _workers;
+  std::mutex _mutex;
+  std::condition_variable _wakeup;
+  std::condition_variable _finished;
+  unsigned _generation = 0;
+  unsigned _running = 0;
+  bool _quit = false;
+
+  const std::function<void()> *_job = nullptr;
+
+  /**
+   * @param generation the generation when the thread was started. Taken by the starting thread,
+   * since a run may begin before this thread gets to look
+   */
+  void work(unsigned generation)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while(true) {
+      _wakeup.wait(lock, [&]() {return _quit || _generation != generation;});
+      if(_quit) return;
+
+      generation = _generation;
+      lock.unlock();
+
+      (*_job)();
+
+      lock.lock();
+      if(--_running == 0) _finished.notify_one();
+    }
+  }
+
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _quit = true;
+    }
+    _wakeup.notify_all();
+
+    for(std::thread &worker : _workers) worker.join();
+    _workers.clear();
+    _quit = false;
+  }
+
+public:
+  WorkerPool() = default;
+  WorkerPool(const WorkerPool &) = delete;
+
+  ~WorkerPool()
+  {
+    stop();
+  }
+
+  /**
+   * @param threads total number of threads, including the calling thread
+   */
+  void setThreads(unsigned threads)
+  {
+    unsigned workers = threads > 1 ? threads - 1 : 0;
+    if(workers == _workers.size()) return;
+
+    stop();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(unsigned i = 0; i < workers; i++) {
+      _workers.emplace_back(&WorkerPool::work, this, _generation);
+    }
+  }
+
+  unsigned threads() const {return (unsigned)_workers.size() + 1;}
+
+  /**
+   * run the job on all threads. Returns when every thread has finished it
+   */
+  void run(const std::function<void()> &job)
+  {
+    if(_workers.empty()) {
+      job();
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _job = &job;
+      _running = (unsigned)_workers.size();
+      _generation++;
+    }
+    _wakeup.notify_all();
+
+    job();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _finished.wait(lock, [this]() {return _running == 0;});
+  }
+};
+
+}
+}
+#endif //THREEPP_WORKERPOOL_H
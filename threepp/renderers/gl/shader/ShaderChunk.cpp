@@ -4,8 +4,10 @@
 
 #include "ShaderChunk.h"
 
-#include <QResource>
-#include <unordered_map>
+#include "ShaderSources.h"
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
 
 namespace three {
 namespace gl {
@@ -25,27 +27,15 @@ const char *getShaderChunk(ShaderChunk chunk)
 
 const char *getShaderChunk(std::string chunk)
 {
-  static unordered_map<string, QByteArray> shader_chunks;
+  using namespace shadersources;
 
-  if(shader_chunks.find(chunk) != shader_chunks.end()) {
-    QByteArray &qb = shader_chunks[chunk];
-    return qb.data();
-  }
-  QString resName = QString(":/chunk/") + QString::fromStdString(chunk) + ".glsl";
-  QResource res(resName);
+  const Chunk *end = chunks + chunk_count;
+  const Chunk *found = lower_bound(chunks, end, chunk.c_str(),
+                                   [](const Chunk &c, const char *name) {return strcmp(c.name, name) < 0;});
 
-  if(!res.isValid()) throw invalid_argument(string("invalid resource: ")+chunk);
+  if(found == end || chunk != found->name) throw invalid_argument(string("invalid resource: ")+chunk);
 
-  if(res.isCompressed()) {
-    QByteArray uncompressed = qUncompress(res.data(), res.size());
-    shader_chunks[chunk] = uncompressed;
-    return shader_chunks[chunk].data();
-  }
-  else {
-    QByteArray ba = QByteArray::fromRawData((const char *)res.data(), res.size());
-    shader_chunks[chunk] = ba;
-    return shader_chunks[chunk].data();
-  }
+  return found->text;
 }
 
 }
@@ -1,4 +1,4 @@
-#ifdef USE_COLOR
+#if defined( USE_COLOR ) || defined( USE_INSTANCE_COLOR )
 
 	out vec3 vColor;
 
@@ -2,4 +2,13 @@
 
 	vColor.xyz = color.xyz;
 
+#endif
+#ifdef USE_INSTANCE_COLOR
+
+	#ifdef USE_COLOR
+		vColor.xyz *= instanceColor.xyz;
+	#else
+		vColor.xyz = instanceColor.xyz;
+	#endif
+
 #endif
\ No newline at end of file
@@ -1,4 +1,12 @@
-vec3 transformedNormal = normalMatrix * objectNormal;
+#ifdef USE_INSTANCED_TRANSFORM
+
+	vec3 transformedNormal = instanceNormalMatrix * objectNormal;
+
+#else
+
+	vec3 transformedNormal = normalMatrix * objectNormal;
+
+#endif
 
 #ifdef FLIP_SIDED
 
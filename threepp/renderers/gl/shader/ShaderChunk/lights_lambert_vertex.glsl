@@ -61,6 +61,30 @@ vec3 directLightColor_Diffuse;
 
 #endif
 
+#ifdef USE_CLUSTERED_LIGHTS
+
+	// the lights of the cluster containing the vertex
+	uvec2 lightCluster = getLightCluster( geometry.position );
+
+	for ( uint i = 0u; i < lightCluster.y; i ++ ) {
+
+		getClusteredDirectLightIrradiance( lightCluster.x + i, geometry, directLight );
+
+		dotNL = dot( geometry.normal, directLight.direction );
+		directLightColor_Diffuse = PI * directLight.color;
+
+		vLightFront += saturate( dotNL ) * directLightColor_Diffuse;
+
+		#ifdef DOUBLE_SIDED
+
+			vLightBack += saturate( -dotNL ) * directLightColor_Diffuse;
+
+		#endif
+
+	}
+
+#endif
+
 /*
 #if NUM_RECT_AREA_LIGHTS > 0
 
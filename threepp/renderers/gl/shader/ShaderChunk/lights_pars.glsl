@@ -1,4 +1,8 @@
-uniform vec3 ambientLightColor;
+#ifndef USE_UNIFORM_BLOCKS
+
+	uniform vec3 ambientLightColor;
+
+#endif
 
 vec3 getAmbientLightIrradiance( const in vec3 ambientLightColor ) {
 
@@ -26,7 +30,9 @@ vec3 getAmbientLightIrradiance( const in vec3 ambientLightColor ) {
 		vec2 shadowMapSize;
 	};
 
-	uniform DirectionalLight directionalLights[ NUM_DIR_LIGHTS ];
+	#ifndef USE_UNIFORM_BLOCKS
+		uniform DirectionalLight directionalLights[ NUM_DIR_LIGHTS ];
+	#endif
 
 	void getDirectionalDirectLightIrradiance( const in DirectionalLight directionalLight, const in GeometricContext geometry, out IncidentLight directLight ) {
 
@@ -55,7 +61,9 @@ vec3 getAmbientLightIrradiance( const in vec3 ambientLightColor ) {
 		float shadowCameraFar;
 	};
 
-	uniform PointLight pointLights[ NUM_POINT_LIGHTS ];
+	#ifndef USE_UNIFORM_BLOCKS
+		uniform PointLight pointLights[ NUM_POINT_LIGHTS ];
+	#endif
 
 	// directLight is an out parameter as having it as a return value caused compiler errors on some devices
 	void getPointDirectLightIrradiance( const in PointLight pointLight, const in GeometricContext geometry, out IncidentLight directLight ) {
@@ -91,7 +99,9 @@ vec3 getAmbientLightIrradiance( const in vec3 ambientLightColor ) {
 		vec2 shadowMapSize;
 	};
 
-	uniform SpotLight spotLights[ NUM_SPOT_LIGHTS ];
+	#ifndef USE_UNIFORM_BLOCKS
+		uniform SpotLight spotLights[ NUM_SPOT_LIGHTS ];
+	#endif
 
 	// directLight is an out parameter as having it as a return value caused compiler errors on some devices
 	void getSpotDirectLightIrradiance( const in SpotLight spotLight, const in GeometricContext geometry, out IncidentLight directLight  ) {
@@ -135,7 +145,9 @@ vec3 getAmbientLightIrradiance( const in vec3 ambientLightColor ) {
 	uniform sampler2D ltcMat; // RGBA Float
 	uniform sampler2D ltcMag; // Alpha Float (only has w component)
 
-	uniform RectAreaLight rectAreaLights[ NUM_RECT_AREA_LIGHTS ];
+	#ifndef USE_UNIFORM_BLOCKS
+		uniform RectAreaLight rectAreaLights[ NUM_RECT_AREA_LIGHTS ];
+	#endif
 
 #endif
 
@@ -148,7 +160,9 @@ vec3 getAmbientLightIrradiance( const in vec3 ambientLightColor ) {
 		vec3 groundColor;
 	};
 
-	uniform HemisphereLight hemisphereLights[ NUM_HEMI_LIGHTS ];
+	#ifndef USE_UNIFORM_BLOCKS
+		uniform HemisphereLight hemisphereLights[ NUM_HEMI_LIGHTS ];
+	#endif
 
 	vec3 getHemisphereLightIrradiance( const in HemisphereLight hemiLight, const in GeometricContext geometry ) {
 
@@ -170,6 +184,101 @@ vec3 getAmbientLightIrradiance( const in vec3 ambientLightColor ) {
 #endif
 
 
+#ifdef USE_CLUSTERED_LIGHTS
+
+	// point and spot lights without shadows, binned into view space clusters by the renderer.
+	// See Clusters.h for the texture layouts
+	uniform highp sampler2D clusterLights;
+	uniform highp usampler2D clusterCells;
+	uniform highp usampler2D clusterIndices;
+	uniform vec4 clusterSlicing;
+
+	ivec2 clusterTexel( const in uint index ) {
+
+		return ivec2( int( index % uint( CLUSTER_TEXTURE_WIDTH ) ), int( index / uint( CLUSTER_TEXTURE_WIDTH ) ) );
+
+	}
+
+	// offset and length of the light list of the cluster containing a view space position
+	uvec2 getLightCluster( const in vec3 viewPosition ) {
+
+		vec4 clip = projectionMatrix * vec4( viewPosition, 1.0 );
+		vec2 tile = ( clip.xy / clip.w * 0.5 + 0.5 ) * vec2( CLUSTER_GRID_X, CLUSTER_GRID_Y );
+
+		float depth = - viewPosition.z;
+		float slice = ( clusterSlicing.z > 0.5 ? log( max( depth, 1e-6 ) ) : depth ) * clusterSlicing.x + clusterSlicing.y;
+
+		ivec3 cluster = clamp( ivec3( floor( vec3( tile, slice ) ) ), ivec3( 0 ), ivec3( CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1, CLUSTER_GRID_Z - 1 ) );
+
+		return texelFetch( clusterCells, ivec2( cluster.y * CLUSTER_GRID_X + cluster.x, cluster.z ), 0 ).xy;
+
+	}
+
+	// directLight is an out parameter as having it as a return value caused compiler errors on some devices
+	void getClusteredDirectLightIrradiance( const in uint index, const in GeometricContext geometry, out IncidentLight directLight ) {
+
+		uint light = texelFetch( clusterIndices, clusterTexel( index ), 0 ).x * 4u;
+
+		vec4 positionDistance = texelFetch( clusterLights, clusterTexel( light ), 0 );
+		vec4 colorDecay = texelFetch( clusterLights, clusterTexel( light + 1u ), 0 );
+		vec4 directionCone = texelFetch( clusterLights, clusterTexel( light + 2u ), 0 );
+
+		vec3 lVector = positionDistance.xyz - geometry.position;
+		directLight.direction = normalize( lVector );
+
+		float lightDistance = length( lVector );
+
+		directLight.color = colorDecay.rgb;
+		directLight.color *= punctualLightIntensityToIrradianceFactor( lightDistance, positionDistance.w, colorDecay.w );
+
+		// point lights have a cone cosine below -1
+		if ( directionCone.w >= - 1.0 ) {
+
+			float penumbraCos = texelFetch( clusterLights, clusterTexel( light + 3u ), 0 ).x;
+			float angleCos = dot( directLight.direction, directionCone.xyz );
+
+			directLight.color *= angleCos > directionCone.w ? smoothstep( directionCone.w, penumbraCos, angleCos ) : 0.0;
+
+		}
+
+		directLight.visible = ( directLight.color != vec3( 0.0 ) );
+
+	}
+
+#endif
+
+
+#ifdef USE_UNIFORM_BLOCKS
+
+	// written once per frame by the renderer, see UniformBlocks.h
+	layout(std140) uniform Lights {
+
+		vec3 ambientLightColor;
+
+		#if NUM_DIR_LIGHTS > 0
+			DirectionalLight directionalLights[ NUM_DIR_LIGHTS ];
+		#endif
+
+		#if NUM_SPOT_LIGHTS > 0
+			SpotLight spotLights[ NUM_SPOT_LIGHTS ];
+		#endif
+
+		#if NUM_RECT_AREA_LIGHTS > 0
+			RectAreaLight rectAreaLights[ NUM_RECT_AREA_LIGHTS ];
+		#endif
+
+		#if NUM_POINT_LIGHTS > 0
+			PointLight pointLights[ NUM_POINT_LIGHTS ];
+		#endif
+
+		#if NUM_HEMI_LIGHTS > 0
+			HemisphereLight hemisphereLights[ NUM_HEMI_LIGHTS ];
+		#endif
+	};
+
+#endif
+
+
 #if defined( USE_ENVMAP ) && defined( PHYSICAL )
 
 	vec3 getLightProbeIndirectIrradiance( /*const in SpecularLightProbe specularLightProbe,*/ const in GeometricContext geometry, const in int maxMIPLevel ) {
@@ -32,7 +32,7 @@ IncidentLight directLight;
 		getPointDirectLightIrradiance( pointLight, geometry, directLight );
 
 		#ifdef USE_SHADOWMAP
-		directLight.color *= all( bvec2( pointLight.shadow, directLight.visible ) ) ? getPointShadow( pointShadowMap[ i ], pointLight.shadowMapSize, pointLight.shadowBias, pointLight.shadowRadius, vPointShadowCoord[ i ], pointLight.shadowCameraNear, pointLight.shadowCameraFar ) : 1.0;
+		directLight.color *= all( bvec2( pointLight.shadow, directLight.visible ) ) ? getPointShadow( SHADOW_MAP( pointShadowMap[ i ], pointShadowTile[ i ] ), pointLight.shadowBias, pointLight.shadowRadius, vPointShadowCoord[ i ], pointLight.shadowCameraNear, pointLight.shadowCameraFar ) : 1.0;
 		#endif
 
 		RE_Direct( directLight, geometry, material, reflectedLight );
@@ -52,7 +52,7 @@ IncidentLight directLight;
 		getSpotDirectLightIrradiance( spotLight, geometry, directLight );
 
 		#ifdef USE_SHADOWMAP
-		directLight.color *= all( bvec2( spotLight.shadow, directLight.visible ) ) ? getShadow( spotShadowMap[ i ], spotLight.shadowMapSize, spotLight.shadowBias, spotLight.shadowRadius, vSpotShadowCoord[ i ] ) : 1.0;
+		directLight.color *= all( bvec2( spotLight.shadow, directLight.visible ) ) ? getShadow( SHADOW_MAP( spotShadowMap[ i ], spotShadowTile[ i ] ), spotLight.shadowBias, spotLight.shadowRadius, vSpotShadowCoord[ i ] ) : 1.0;
 		#endif
 
 		RE_Direct( directLight, geometry, material, reflectedLight );
@@ -61,10 +61,35 @@ IncidentLight directLight;
 
 #endif
 
+#if defined( USE_CLUSTERED_LIGHTS ) && defined( RE_Direct )
+
+	uvec2 lightCluster = getLightCluster( geometry.position );
+
+	for ( uint i = 0u; i < lightCluster.y; i ++ ) {
+
+		getClusteredDirectLightIrradiance( lightCluster.x + i, geometry, directLight );
+
+		RE_Direct( directLight, geometry, material, reflectedLight );
+
+	}
+
+#endif
+
 #if ( NUM_DIR_LIGHTS > 0 ) && defined( RE_Direct )
 
 	DirectionalLight directionalLight;
 
+	#if defined( USE_SHADOWMAP ) && defined( DIR_CASCADES )
+
+	// getShadow skips the cascaded light, its shadow is looked up here
+	float cascadedShadow[ NUM_DIR_LIGHTS ];
+	for ( int c = 0; c < NUM_DIR_LIGHTS; c ++ ) cascadedShadow[ c ] = 1.0;
+
+	directionalLight = directionalLights[ CASCADED_LIGHT ];
+	cascadedShadow[ CASCADED_LIGHT ] = getCascadedShadow( SHADOW_MAP( directionalShadowMap[ CASCADED_LIGHT ], directionalShadowTile[ CASCADED_LIGHT ] ), directionalLight.shadowBias, directionalLight.shadowRadius );
+
+	#endif
+
 	for ( int i = 0; i < NUM_DIR_LIGHTS; i ++ ) {
 
 		directionalLight = directionalLights[ i ];
@@ -72,7 +97,11 @@ IncidentLight directLight;
 		getDirectionalDirectLightIrradiance( directionalLight, geometry, directLight );
 
 		#ifdef USE_SHADOWMAP
-		directLight.color *= all( bvec2( directionalLight.shadow, directLight.visible ) ) ? getShadow( directionalShadowMap[ i ], directionalLight.shadowMapSize, directionalLight.shadowBias, directionalLight.shadowRadius, vDirectionalShadowCoord[ i ] ) : 1.0;
+		directLight.color *= all( bvec2( directionalLight.shadow, directLight.visible ) ) ? getShadow( SHADOW_MAP( directionalShadowMap[ i ], directionalShadowTile[ i ] ), directionalLight.shadowBias, directionalLight.shadowRadius, vDirectionalShadowCoord[ i ] ) : 1.0;
+		#endif
+
+		#if defined( USE_SHADOWMAP ) && defined( DIR_CASCADES )
+		directLight.color *= cascadedShadow[ i ];
 		#endif
 
 		RE_Direct( directLight, geometry, material, reflectedLight );
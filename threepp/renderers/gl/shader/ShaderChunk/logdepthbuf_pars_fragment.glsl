@@ -1,6 +1,8 @@
 #ifdef USE_LOGDEPTHBUF
 
-	uniform float logDepthBufFC;
+	#ifndef USE_UNIFORM_BLOCKS
+		uniform float logDepthBufFC;
+	#endif
 
 	#ifdef USE_LOGDEPTHBUF_EXT
 
@@ -6,6 +6,8 @@
 
 	#endif
 
-	uniform float logDepthBufFC;
+	#ifndef USE_UNIFORM_BLOCKS
+		uniform float logDepthBufFC;
+	#endif
 
 #endif
\ No newline at end of file
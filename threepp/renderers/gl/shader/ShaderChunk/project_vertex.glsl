@@ -1,3 +1,11 @@
-vec4 mvPosition = modelViewMatrix * vec4( transformed, 1.0 );
+#ifdef USE_INSTANCED_TRANSFORM
+
+	vec4 mvPosition = viewMatrix * ( instanceModelMatrix * vec4( transformed, 1.0 ) );
+
+#else
+
+	vec4 mvPosition = modelViewMatrix * vec4( transformed, 1.0 );
+
+#endif
 
 gl_Position = projectionMatrix * mvPosition;
@@ -1,22 +1,55 @@
 #ifdef USE_SHADOWMAP
 
+	#ifdef SHADOWMAP_ATLAS
+
+		// all maps are tiles of one texture, given as offset (xy) and scale (zw) per light
+		uniform sampler2D shadowAtlas;
+
+		#define SHADOW_MAP( map, tile ) shadowAtlas, tile
+
+	#else
+
+		#define SHADOW_MAP( map, tile ) map, vec4( 0.0, 0.0, 1.0, 1.0 )
+
+	#endif
+
 	#if NUM_DIR_LIGHTS > 0
 
+		#ifdef SHADOWMAP_ATLAS
+		uniform vec4 directionalShadowTile[ NUM_DIR_LIGHTS ];
+		#else
 		uniform sampler2D directionalShadowMap[ NUM_DIR_LIGHTS ];
+		#endif
 		in vec4 vDirectionalShadowCoord[ NUM_DIR_LIGHTS ];
 
 	#endif
 
+	#ifdef DIR_CASCADES
+
+		uniform vec4 directionalCascadeSplits;
+		in vec4 vDirectionalCascadeCoord[ DIR_CASCADES ];
+		in float vCascadeDepth;
+
+	#endif
+
 	#if NUM_SPOT_LIGHTS > 0
 
+		#ifdef SHADOWMAP_ATLAS
+		uniform vec4 spotShadowTile[ NUM_SPOT_LIGHTS ];
+		#else
 		uniform sampler2D spotShadowMap[ NUM_SPOT_LIGHTS ];
+		#endif
 		in vec4 vSpotShadowCoord[ NUM_SPOT_LIGHTS ];
 
 	#endif
 
 	#if NUM_POINT_LIGHTS > 0
 
+		#ifdef SHADOWMAP_ATLAS
+		uniform vec4 pointShadowTile[ NUM_POINT_LIGHTS ];
+		#else
 		uniform sampler2D pointShadowMap[ NUM_POINT_LIGHTS ];
+		#endif
 		in vec4 vPointShadowCoord[ NUM_POINT_LIGHTS ];
 
 	#endif
@@ -57,7 +90,8 @@
 
 	}
 
-	float getShadow( sampler2D shadowMap, vec2 shadowMapSize, float shadowBias, float shadowRadius, vec4 shadowCoord ) {
+	// the map is the tile of shadowMap at offset tile.xy, scaled by tile.zw
+	float getShadow( sampler2D shadowMap, vec4 tile, float shadowBias, float shadowRadius, vec4 shadowCoord ) {
 
 		float shadow = 1.0;
 
@@ -76,6 +110,18 @@
 
 		if ( frustumTest ) {
 
+		vec2 shadowMapSize = vec2( textureSize( shadowMap, 0 ) );
+
+		shadowCoord.xy = tile.xy + tile.zw * shadowCoord.xy;
+
+		if ( tile.z < 1.0 || tile.w < 1.0 ) {
+
+			// keep the filter taps inside the tile
+			vec2 margin = ( shadowRadius + 1.0 ) / shadowMapSize;
+			shadowCoord.xy = clamp( shadowCoord.xy, tile.xy + margin, tile.xy + tile.zw - margin );
+
+		}
+
 		#if defined( SHADOWMAP_TYPE_PCF )
 
 			vec2 texelSize = vec2( 1.0 ) / shadowMapSize;
@@ -130,6 +176,12 @@
 
 	}
 
+	float getShadow( sampler2D shadowMap, vec2 shadowMapSize, float shadowBias, float shadowRadius, vec4 shadowCoord ) {
+
+		return getShadow( shadowMap, vec4( 0.0, 0.0, 1.0, 1.0 ), shadowBias, shadowRadius, shadowCoord );
+
+	}
+
 	// cubeToUV() maps a 3D direction vector suitable for cube texture mapping to a 2D
 	// vector suitable for 2D texture mapping. This code uses the following layout for the
 	// 2D texture:
@@ -201,9 +253,10 @@
 
 	}
 
-	float getPointShadow( sampler2D shadowMap, vec2 shadowMapSize, float shadowBias, float shadowRadius, vec4 shadowCoord, float shadowCameraNear, float shadowCameraFar ) {
+	// the cube layout is the tile of shadowMap at offset tile.xy, scaled by tile.zw
+	float getPointShadow( sampler2D shadowMap, vec4 tile, float shadowBias, float shadowRadius, vec4 shadowCoord, float shadowCameraNear, float shadowCameraFar ) {
 
-		vec2 texelSize = vec2( 1.0 ) / ( shadowMapSize * vec2( 4.0, 2.0 ) );
+		vec2 texelSize = vec2( 1.0 ) / ( vec2( textureSize( shadowMap, 0 ) ) * tile.zw );
 
 		// for point lights, the uniform @vShadowCoord is re-purposed to hold
 		// the vector from the light to the world-space position of the fragment.
@@ -221,23 +274,54 @@
 			vec2 offset = vec2( - 1, 1 ) * shadowRadius * texelSize.y;
 
 			return (
-				texture2DCompare( shadowMap, cubeToUV( bd3D + offset.xyy, texelSize.y ), dp ) +
-				texture2DCompare( shadowMap, cubeToUV( bd3D + offset.yyy, texelSize.y ), dp ) +
-				texture2DCompare( shadowMap, cubeToUV( bd3D + offset.xyx, texelSize.y ), dp ) +
-				texture2DCompare( shadowMap, cubeToUV( bd3D + offset.yyx, texelSize.y ), dp ) +
-				texture2DCompare( shadowMap, cubeToUV( bd3D, texelSize.y ), dp ) +
-				texture2DCompare( shadowMap, cubeToUV( bd3D + offset.xxy, texelSize.y ), dp ) +
-				texture2DCompare( shadowMap, cubeToUV( bd3D + offset.yxy, texelSize.y ), dp ) +
-				texture2DCompare( shadowMap, cubeToUV( bd3D + offset.xxx, texelSize.y ), dp ) +
-				texture2DCompare( shadowMap, cubeToUV( bd3D + offset.yxx, texelSize.y ), dp )
+				texture2DCompare( shadowMap, tile.xy + tile.zw * cubeToUV( bd3D + offset.xyy, texelSize.y ), dp ) +
+				texture2DCompare( shadowMap, tile.xy + tile.zw * cubeToUV( bd3D + offset.yyy, texelSize.y ), dp ) +
+				texture2DCompare( shadowMap, tile.xy + tile.zw * cubeToUV( bd3D + offset.xyx, texelSize.y ), dp ) +
+				texture2DCompare( shadowMap, tile.xy + tile.zw * cubeToUV( bd3D + offset.yyx, texelSize.y ), dp ) +
+				texture2DCompare( shadowMap, tile.xy + tile.zw * cubeToUV( bd3D, texelSize.y ), dp ) +
+				texture2DCompare( shadowMap, tile.xy + tile.zw * cubeToUV( bd3D + offset.xxy, texelSize.y ), dp ) +
+				texture2DCompare( shadowMap, tile.xy + tile.zw * cubeToUV( bd3D + offset.yxy, texelSize.y ), dp ) +
+				texture2DCompare( shadowMap, tile.xy + tile.zw * cubeToUV( bd3D + offset.xxx, texelSize.y ), dp ) +
+				texture2DCompare( shadowMap, tile.xy + tile.zw * cubeToUV( bd3D + offset.yxx, texelSize.y ), dp )
 			) * ( 1.0 / 9.0 );
 
 		#else // no percentage-closer filtering
 
-			return texture2DCompare( shadowMap, cubeToUV( bd3D, texelSize.y ), dp );
+			return texture2DCompare( shadowMap, tile.xy + tile.zw * cubeToUV( bd3D, texelSize.y ), dp );
 
 		#endif
 
 	}
 
+	float getPointShadow( sampler2D shadowMap, vec2 shadowMapSize, float shadowBias, float shadowRadius, vec4 shadowCoord, float shadowCameraNear, float shadowCameraFar ) {
+
+		return getPointShadow( shadowMap, vec4( 0.0, 0.0, 1.0, 1.0 ), shadowBias, shadowRadius, shadowCoord, shadowCameraNear, shadowCameraFar );
+
+	}
+
+	#ifdef DIR_CASCADES
+
+	// the cascades share one map, side by side. A cascade ends at the view depth given by its split
+	float getCascadedShadow( sampler2D shadowMap, vec4 tile, float shadowBias, float shadowRadius ) {
+
+		int cascade = int( dot( vec4( greaterThan( vec4( vCascadeDepth ), directionalCascadeSplits ) ), vec4( 1.0 ) ) );
+
+		if ( cascade >= DIR_CASCADES ) return 1.0;
+
+		vec4 shadowCoord = vec4( 0.0 );
+
+		for ( int c = 0; c < DIR_CASCADES; c ++ ) {
+
+			if ( c == cascade ) shadowCoord = vDirectionalCascadeCoord[ c ];
+
+		}
+
+		vec4 cascadeTile = vec4( tile.x + tile.z * float( cascade ) / float( DIR_CASCADES ), tile.y, tile.z / float( DIR_CASCADES ), tile.w );
+
+		return getShadow( shadowMap, cascadeTile, shadowBias, shadowRadius, shadowCoord );
+
+	}
+
+	#endif
+
 #endif
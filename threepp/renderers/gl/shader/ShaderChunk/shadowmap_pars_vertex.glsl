@@ -7,6 +7,14 @@
 
 	#endif
 
+	#ifdef DIR_CASCADES
+
+		uniform mat4 directionalCascadeMatrix[ DIR_CASCADES ];
+		out vec4 vDirectionalCascadeCoord[ DIR_CASCADES ];
+		out float vCascadeDepth;
+
+	#endif
+
 	#if NUM_SPOT_LIGHTS > 0
 
 		uniform mat4 spotShadowMatrix[ NUM_SPOT_LIGHTS ];
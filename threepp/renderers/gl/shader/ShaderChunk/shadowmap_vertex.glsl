@@ -10,6 +10,18 @@
 
 	#endif
 
+	#ifdef DIR_CASCADES
+
+	for ( int c = 0; c < DIR_CASCADES; c ++ ) {
+
+		vDirectionalCascadeCoord[ c ] = directionalCascadeMatrix[ c ] * worldPosition;
+
+	}
+
+	vCascadeDepth = - ( viewMatrix * worldPosition ).z;
+
+	#endif
+
 	#if NUM_SPOT_LIGHTS > 0
 
 	for ( int i = 0; i < NUM_SPOT_LIGHTS; i ++ ) {
@@ -11,10 +11,17 @@ float getShadowMask() {
 	for ( int i = 0; i < NUM_DIR_LIGHTS; i ++ ) {
 
 		directionalLight = directionalLights[ i ];
-		shadow *= bool( directionalLight.shadow ) ? getShadow( directionalShadowMap[ i ], directionalLight.shadowMapSize, directionalLight.shadowBias, directionalLight.shadowRadius, vDirectionalShadowCoord[ i ] ) : 1.0;
+		shadow *= bool( directionalLight.shadow ) ? getShadow( SHADOW_MAP( directionalShadowMap[ i ], directionalShadowTile[ i ] ), directionalLight.shadowBias, directionalLight.shadowRadius, vDirectionalShadowCoord[ i ] ) : 1.0;
 
 	}
 
+	#ifdef DIR_CASCADES
+
+	directionalLight = directionalLights[ CASCADED_LIGHT ];
+	shadow *= getCascadedShadow( SHADOW_MAP( directionalShadowMap[ CASCADED_LIGHT ], directionalShadowTile[ CASCADED_LIGHT ] ), directionalLight.shadowBias, directionalLight.shadowRadius );
+
+	#endif
+
 	#endif
 
 	#if NUM_SPOT_LIGHTS > 0
@@ -24,7 +31,7 @@ float getShadowMask() {
 	for ( int i = 0; i < NUM_SPOT_LIGHTS; i ++ ) {
 
 		spotLight = spotLights[ i ];
-		shadow *= bool( spotLight.shadow ) ? getShadow( spotShadowMap[ i ], spotLight.shadowMapSize, spotLight.shadowBias, spotLight.shadowRadius, vSpotShadowCoord[ i ] ) : 1.0;
+		shadow *= bool( spotLight.shadow ) ? getShadow( SHADOW_MAP( spotShadowMap[ i ], spotShadowTile[ i ] ), spotLight.shadowBias, spotLight.shadowRadius, vSpotShadowCoord[ i ] ) : 1.0;
 
 	}
 
@@ -37,7 +44,7 @@ float getShadowMask() {
 	for ( int i = 0; i < NUM_POINT_LIGHTS; i ++ ) {
 
 		pointLight = pointLights[ i ];
-		shadow *= bool( pointLight.shadow ) ? getPointShadow( pointShadowMap[ i ], pointLight.shadowMapSize, pointLight.shadowBias, pointLight.shadowRadius, vPointShadowCoord[ i ], pointLight.shadowCameraNear, pointLight.shadowCameraFar ) : 1.0;
+		shadow *= bool( pointLight.shadow ) ? getPointShadow( SHADOW_MAP( pointShadowMap[ i ], pointShadowTile[ i ] ), pointLight.shadowBias, pointLight.shadowRadius, vPointShadowCoord[ i ], pointLight.shadowCameraNear, pointLight.shadowCameraFar ) : 1.0;
 
 	}
 
@@ -1,7 +1,11 @@
 #define saturate(a) clamp( a, 0.0, 1.0 )
 
-uniform float toneMappingExposure;
-uniform float toneMappingWhitePoint;
+#ifndef USE_UNIFORM_BLOCKS
+
+	uniform float toneMappingExposure;
+	uniform float toneMappingWhitePoint;
+
+#endif
 
 // exposure only
 vec3 LinearToneMapping( vec3 color ) {
@@ -1,5 +1,13 @@
 #if defined( USE_ENVMAP ) || defined( DISTANCE ) || defined ( USE_SHADOWMAP )
 
-	vec4 worldPosition = modelMatrix * vec4( transformed, 1.0 );
+	#ifdef USE_INSTANCED_TRANSFORM
+
+		vec4 worldPosition = instanceModelMatrix * vec4( transformed, 1.0 );
+
+	#else
+
+		vec4 worldPosition = modelMatrix * vec4( transformed, 1.0 );
+
+	#endif
 
 #endif
@@ -4,76 +4,69 @@
 
 #include "ShaderLib.h"
 
-#include <QResource>
-#include <QFile>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
 
 #include <threepp/core/Color.h>
 #include <threepp/math/Vector3.h>
+#include "ShaderSources.h"
 
-static void qInitResource()
+namespace three {
+namespace gl {
+
+/**
+ * @return the library shader source with the given name, assembled from the embedded pieces
+ */
+static std::string libSource(const char *name)
 {
-  static bool done = false;
+  using namespace shadersources;
 
-  if (done) return;
-  done = true;
+  const LibSource *end = lib_sources + lib_source_count;
+  const LibSource *source = std::lower_bound(lib_sources, end, name,
+                                             [](const LibSource &s, const char *n) {return strcmp(s.name, n) < 0;});
 
-  //must do this outside of namespace - hence this function
-  Q_INIT_RESOURCE(ShaderLib);
-  Q_INIT_RESOURCE(ShaderChunk);
-}
+  if(source == end || strcmp(source->name, name) != 0)
+    throw std::logic_error(std::string("shader source not available: ") + name);
 
-namespace three {
-namespace gl {
+  std::string result;
+  for(unsigned i = source->first; i < source->first + source->count; i++) {
+    const Piece &piece = pieces[i];
+    result.append(piece.text ? piece.text : chunks[piece.chunk].text);
+  }
+  return result;
+}
 
 class LibShader
 {
   ShaderID _id;
   uniformslib::LibUniformValues _uniforms;
 
-  QFile _vertex;
-  QByteArray _vertexShader;
+  const char *_vertex;
+  std::string _vertexShader;
 
-  QFile _fragment;
-  QByteArray _fragmentShader;
+  const char *_fragment;
+  std::string _fragmentShader;
 
 public:
   LibShader(ShaderID id, const uniformslib::LibUniformValues &uniforms, const char *vertexShader, const char *fragmentShader)
      : _uniforms(uniforms), _id(id), _vertex(vertexShader), _fragment(fragmentShader)
   {}
 
-  LibShader(const LibShader &shader)
-     : _id(shader._id), _uniforms(shader._uniforms), _vertex(shader._vertex.fileName()), _fragment(shader._fragment.fileName()),
-       _vertexShader(shader._vertexShader), _fragmentShader(shader._fragmentShader)
-  {}
-
   const uniformslib::LibUniformValues &uniforms() const {
     return _uniforms;
   }
 
   const char *vertexShader()
   {
-    if (!_vertexShader.isNull()) return _vertexShader.data();
-
-    if(_vertex.open(QIODevice::ReadOnly)) {
-      _vertexShader = _vertex.readAll();
-      _vertex.close();
-    }
-    else
-      throw std::logic_error("shader resource not available");
+    if (_vertexShader.empty()) _vertexShader = libSource(_vertex);
 
     return _vertexShader.data();
   }
 
   const char *fragmentShader()
   {
-    if (!_fragmentShader.isNull()) return _fragmentShader.data();
-
-    if(_fragment.open(QIODevice::ReadOnly)) {
-      _fragmentShader = _fragment.readAll();
-      _fragment.close();
-    }
-    else
-      throw std::logic_error("shader resource not available");
+    if (_fragmentShader.empty()) _fragmentShader = libSource(_fragment);
 
     return _fragmentShader.data();
   }
@@ -91,8 +84,6 @@ class ShaderLib
 public:
   ShaderLib()
   {
-    qInitResource();
-
     add(ShaderID::basic,
         LibShader(ShaderID::basic,
                   uniformslib::merged(
@@ -105,8 +96,8 @@ public:
                         UniformsID::fog
                      }
                   ),
-                  ":shader/meshbasic_vert.glsl",
-                  ":shader/meshbasic_frag.glsl"
+                  "meshbasic_vert",
+                  "meshbasic_frag"
         ));
     add(ShaderID::lambert,
         LibShader(ShaderID::lambert,
@@ -124,8 +115,8 @@ public:
                   ).merge(UniformsID::lights, {
                      {UniformName::emissive, Color(ColorName::black)}
                   }),
-                  ":shader/meshlambert_vert.glsl",
-                  ":shader/meshlambert_frag.glsl"
+                  "meshlambert_vert",
+                  "meshlambert_frag"
         ));
     add(ShaderID::phong,
         LibShader(ShaderID::phong,
@@ -149,8 +140,8 @@ public:
                      {UniformName::specular, Color(ColorName::white)},
                      {UniformName::shininess, 30.0f}
                   }),
-                  ":shader/meshphong_vert.glsl",
-                  ":shader/meshphong_frag.glsl"
+                  "meshphong_vert",
+                  "meshphong_frag"
         ));
     add(ShaderID::standard,
         LibShader(ShaderID::standard,
@@ -174,8 +165,8 @@ public:
                      {UniformName::metalness,       0.5f},
                      {UniformName::envMapIntensity, 1}
                   }),
-                  ":shader/meshphysical_vert.glsl",
-                  ":shader/meshphysical_frag.glsl"
+                  "meshphysical_vert",
+                  "meshphysical_frag"
         ));
     add(ShaderID::physical,
         LibShader(ShaderID::physical,
@@ -184,8 +175,8 @@ public:
              {UniformName::clearCoat, 0.0f},
              {UniformName::clearCoatRoughness, 0.0f}
            }),
-           ":shader/meshphysical_vert.glsl",
-           ":shader/meshphysical_frag.glsl"
+           "meshphysical_vert",
+           "meshphysical_frag"
         ));
     add(ShaderID::points,
         LibShader(ShaderID::points,
@@ -195,8 +186,8 @@ public:
                         UniformsID::fog
                      }
                   ),
-                  ":shader/points_vert.glsl",
-                  ":shader/points_frag.glsl"
+                  "points_vert",
+                  "points_frag"
         ));
     add(ShaderID::dashed,
         LibShader(ShaderID::dashed,
@@ -209,8 +200,8 @@ public:
                      {UniformName::dashSize,  1},
                      {UniformName::totalSize, 2}
                   }),
-                  ":shader/linedashed_vert.glsl",
-                  ":shader/linedashed_frag.glsl"
+                  "linedashed_vert",
+                  "linedashed_frag"
         ));
     add(ShaderID::depth,
         LibShader(ShaderID::depth,
@@ -220,8 +211,8 @@ public:
                         UniformsID::displacementmap
                      }
                   ),
-                  ":shader/depth_vert.glsl",
-                  ":shader/depth_frag.glsl"
+                  "depth_vert",
+                  "depth_frag"
         ));
     add(ShaderID::normal,
         LibShader(ShaderID::normal,
@@ -235,8 +226,8 @@ public:
                   ).merge(UniformsID::displacementmap, {
                      {UniformName::opacity, 1.0f},
                   }),
-                  ":shader/normal_vert.glsl",
-                  ":shader/normal_frag.glsl"
+                  "normal_vert",
+                  "normal_frag"
         ));
     add(ShaderID::cube,
         LibShader(ShaderID::cube,
@@ -245,16 +236,16 @@ public:
                      uniformslib::value<float>(UniformName::tFlip, -1.0f),
                      uniformslib::value<float>(UniformName::opacity, 1.0f)
                   },
-                  ":shader/cube_vert.glsl",
-                  ":shader/cube_frag.glsl"
+                  "cube_vert",
+                  "cube_frag"
         ));
     add(ShaderID::equirect,
         LibShader(ShaderID::equirect,
                   {
                      uniformslib::value<Texture::Ptr>(UniformName::tEquirect, nullptr)
                   },
-                  ":shader/equirect_vert.glsl",
-                  ":shader/equirect_frag.glsl"
+                  "equirect_vert",
+                  "equirect_frag"
         ));
     add(ShaderID::distanceRGBA,
         LibShader(ShaderID::distanceRGBA,
@@ -268,8 +259,8 @@ public:
                      {UniformName::nearDistance,      1.0f},
                      {UniformName::farDistance,       1000.0f},
                   }),
-                  ":shader/distanceRGBA_vert.glsl",
-                  ":shader/distanceRGBA_frag.glsl"
+                  "distanceRGBA_vert",
+                  "distanceRGBA_frag"
         ));
     add(ShaderID::shadow,
         LibShader(ShaderID::shadow,
@@ -282,8 +273,8 @@ public:
                      {UniformName::color,   Color(ColorName::black)},
                      {UniformName::opacity, 1.0f}
                   }),
-                  ":shader/shadow_vert.glsl",
-                  ":shader/shadow_frag.glsl"
+                  "shadow_vert",
+                  "shadow_frag"
         ));
   }
 
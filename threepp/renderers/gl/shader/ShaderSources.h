@@ -0,0 +1,54 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_SHADERSOURCES_H
+#define THREEPP_SHADERSOURCES_H
+
+#include <cstddef>
+
+namespace three {
+namespace gl {
+namespace shadersources {
+
+/**
+ * GLSL sources compiled into the library. The tables are generated at build time from the files
+ * in ShaderChunk and ShaderLib (see etc/embed_shaders.cmake) and sorted by name
+ */
+struct Chunk
+{
+  const char *name;
+  const char *text;
+};
+
+/**
+ * part of a library shader: literal text, or the chunk an #include directive was resolved to
+ */
+struct Piece
+{
+  const char *text;
+  int chunk;
+};
+
+/**
+ * a library shader (file name without extension), made of count pieces starting at first
+ */
+struct LibSource
+{
+  const char *name;
+  unsigned first;
+  unsigned count;
+};
+
+extern const Chunk chunks[];
+extern const size_t chunk_count;
+
+extern const Piece pieces[];
+
+extern const LibSource lib_sources[];
+extern const size_t lib_source_count;
+
+}
+}
+}
+#endif //THREEPP_SHADERSOURCES_H
@@ -187,6 +187,9 @@ public:
 
                          value<std::vector<Texture::Ptr>>(UniformName::directionalShadowMap, std::vector<Texture::Ptr>()),
                          value<std::vector<math::Matrix4>>(UniformName::directionalShadowMatrix, std::vector<math::Matrix4>()),
+                         value<std::vector<math::Vector4>>(UniformName::directionalShadowTile, std::vector<math::Vector4>()),
+                         value<std::vector<math::Matrix4>>(UniformName::directionalCascadeMatrix, std::vector<math::Matrix4>()),
+                         value<math::Vector4>(UniformName::directionalCascadeSplits, math::Vector4()),
 
                          value<CachedSpotLights>(UniformName::spotLights, CachedSpotLights(), {
                             value<Color>(UniformName::color, Color::null()),
@@ -204,6 +207,7 @@ public:
 
                          value<std::vector<Texture::Ptr>>(UniformName::spotShadowMap, std::vector<Texture::Ptr>()),
                          value<std::vector<math::Matrix4>>(UniformName::spotShadowMatrix, std::vector<math::Matrix4>()),
+                         value<std::vector<math::Vector4>>(UniformName::spotShadowTile, std::vector<math::Vector4>()),
 
                          value<CachedPointLights>(UniformName::pointLights, CachedPointLights(), {
                             value<Color>(UniformName::color, Color::null()),
@@ -220,6 +224,7 @@ public:
 
                          value<std::vector<Texture::Ptr>>(UniformName::pointShadowMap, std::vector<Texture::Ptr>()),
                          value<std::vector<math::Matrix4>>(UniformName::pointShadowMatrix, std::vector<math::Matrix4>()),
+                         value<std::vector<math::Vector4>>(UniformName::pointShadowTile, std::vector<math::Vector4>()),
 
                          value<CachedHemisphereLights>(UniformName::hemisphereLights, CachedHemisphereLights(), {
                             value<math::Vector3>(UniformName::direction, math::Vector3()),
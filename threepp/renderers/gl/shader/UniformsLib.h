@@ -111,6 +111,7 @@ UNIFORM_VALUE_T(int)
 UNIFORM_VALUE_T(unsigned)
 UNIFORM_VALUE_T(math::Vector2)
 UNIFORM_VALUE_T(math::Vector3)
+UNIFORM_VALUE_T(math::Vector4)
 UNIFORM_VALUE_T(math::Matrix3)
 UNIFORM_VALUE_T(math::Matrix4)
 UNIFORM_VALUE_T(Texture::Ptr)
@@ -118,6 +119,7 @@ UNIFORM_VALUE_T(CubeTexture::Ptr)
 UNIFORM_VALUE_T(std::vector<float>)
 UNIFORM_VALUE_T(std::vector<Texture::Ptr>)
 UNIFORM_VALUE_T(std::vector<math::Matrix4>)
+UNIFORM_VALUE_T(std::vector<math::Vector4>)
 
 #define UNIFORM_STRUCT_BODY(Cls) \
   Cls value; \
@@ -0,0 +1,350 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#include "BlockDecoder.h"
+#include <algorithm>
+#include <cstring>
+
+namespace three {
+namespace blocks {
+
+namespace {
+
+//decoded 4x4 block, row by row
+using Texels = byte[16][4];
+
+inline byte clamp255(int value)
+{
+  return (byte)std::min(255, std::max(0, value));
+}
+
+inline uint64_t littleEndian(const byte *data, unsigned count)
+{
+  uint64_t value = 0;
+  for(unsigned i = 0; i < count; i++) value |= (uint64_t)data[i] << (i * 8);
+  return value;
+}
+
+inline uint64_t bigEndian(const byte *data)
+{
+  uint64_t value = 0;
+  for(unsigned i = 0; i < 8; i++) value = value << 8 | data[i];
+  return value;
+}
+
+void rgb565(uint16_t color, int *rgb)
+{
+  int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+  rgb[0] = r << 3 | r >> 2;
+  rgb[1] = g << 2 | g >> 4;
+  rgb[2] = b << 3 | b >> 2;
+}
+
+// S3TC color block. The blocks of DXT3 and DXT5 always use four colors
+void decodeColors(const byte *block, Texels &texels, bool fourColors)
+{
+  uint16_t c0 = (uint16_t)littleEndian(block, 2), c1 = (uint16_t)littleEndian(block + 2, 2);
+
+  int colors[4][4];
+  rgb565(c0, colors[0]);
+  rgb565(c1, colors[1]);
+  colors[0][3] = colors[1][3] = colors[2][3] = colors[3][3] = 255;
+
+  for(unsigned c = 0; c < 3; c++) {
+    if(c0 > c1 || fourColors) {
+      colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+      colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+    }
+    else {
+      colors[2][c] = (colors[0][c] + colors[1][c]) / 2;
+      colors[3][c] = 0;
+    }
+  }
+  // transparent black
+  if(c0 <= c1 && !fourColors) colors[3][3] = 0;
+
+  uint32_t indices = (uint32_t)littleEndian(block + 4, 4);
+  for(unsigned i = 0; i < 16; i++) {
+    const int *color = colors[(indices >> (2 * i)) & 3];
+    for(unsigned c = 0; c < 4; c++) texels[i][c] = (byte)color[c];
+  }
+}
+
+// DXT3 alpha, 4 bits per texel
+void decodeExplicitAlpha(const byte *block, Texels &texels)
+{
+  uint64_t alphas = littleEndian(block, 8);
+  for(unsigned i = 0; i < 16; i++) texels[i][3] = (byte)(((alphas >> (4 * i)) & 15) * 17);
+}
+
+// DXT5 alpha and RGTC channels, interpolated between two endpoints
+void decodeInterpolated(const byte *block, Texels &texels, unsigned channel)
+{
+  int values[8];
+  values[0] = block[0];
+  values[1] = block[1];
+
+  if(values[0] > values[1]) {
+    for(int i = 1; i < 7; i++) values[i + 1] = ((7 - i) * values[0] + i * values[1]) / 7;
+  }
+  else {
+    for(int i = 1; i < 5; i++) values[i + 1] = ((5 - i) * values[0] + i * values[1]) / 5;
+    values[6] = 0;
+    values[7] = 255;
+  }
+
+  uint64_t indices = littleEndian(block + 2, 6);
+  for(unsigned i = 0; i < 16; i++) texels[i][channel] = (byte)values[(indices >> (3 * i)) & 7];
+}
+
+const int etc_modifiers[8][2] = {{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+const int etc_distances[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+
+const int eac_modifiers[16][8] = {
+   {-3, -6, -9, -15, 2, 5, 8, 14},
+   {-3, -7, -10, -13, 2, 6, 9, 12},
+   {-2, -5, -8, -13, 1, 4, 7, 12},
+   {-2, -4, -6, -13, 1, 3, 5, 12},
+   {-3, -6, -8, -12, 2, 5, 7, 11},
+   {-3, -7, -9, -11, 2, 6, 8, 10},
+   {-4, -7, -8, -11, 3, 6, 7, 10},
+   {-3, -5, -8, -11, 2, 4, 7, 10},
+   {-2, -6, -8, -10, 1, 5, 7, 9},
+   {-2, -5, -8, -10, 1, 4, 7, 9},
+   {-2, -4, -8, -10, 1, 3, 7, 9},
+   {-2, -5, -7, -10, 1, 4, 6, 9},
+   {-3, -4, -7, -10, 2, 3, 6, 9},
+   {-1, -2, -3, -10, 0, 1, 2, 9},
+   {-4, -6, -8, -9, 3, 5, 7, 8},
+   {-3, -5, -7, -9, 2, 4, 6, 8}
+};
+
+// ETC1 and ETC2 RGB blocks, including the T, H and planar modes of ETC2
+void decodeETC2(const byte *block, Texels &texels)
+{
+  uint64_t bits = bigEndian(block);
+
+  auto field = [bits](unsigned shift, unsigned count) {
+    return (int)((bits >> shift) & ((1u << count) - 1));
+  };
+  // the 2 bit index of a texel, stored column by column
+  auto index = [bits](unsigned x, unsigned y) {
+    unsigned i = x * 4 + y;
+    return (int)(((bits >> (16 + i)) & 1) << 1 | ((bits >> i) & 1));
+  };
+  auto set = [&texels](unsigned x, unsigned y, const int *rgb) {
+    for(unsigned c = 0; c < 3; c++) texels[y * 4 + x][c] = clamp255(rgb[c]);
+  };
+  auto expand4 = [](int value) {return value * 17;};
+  auto expand5 = [](int value) {return value << 3 | value >> 2;};
+  auto expand6 = [](int value) {return value << 2 | value >> 4;};
+  auto expand7 = [](int value) {return value << 1 | value >> 6;};
+  auto signed3 = [](int value) {return value >= 4 ? value - 8 : value;};
+
+  int base[2][3];
+
+  if(field(33, 1)) {
+    int r = field(59, 5), g = field(51, 5), b = field(43, 5);
+    int r2 = r + signed3(field(56, 3)), g2 = g + signed3(field(48, 3)), b2 = b + signed3(field(40, 3));
+
+    if(r2 < 0 || r2 > 31) {
+      // T mode
+      int c1[3] = {expand4(field(59, 2) << 2 | field(56, 2)), expand4(field(52, 4)), expand4(field(48, 4))};
+      int c2[3] = {expand4(field(44, 4)), expand4(field(40, 4)), expand4(field(36, 4))};
+      int d = etc_distances[field(34, 2) << 1 | field(32, 1)];
+
+      int paint[4][3];
+      for(unsigned c = 0; c < 3; c++) {
+        paint[0][c] = c1[c];
+        paint[1][c] = c2[c] + d;
+        paint[2][c] = c2[c];
+        paint[3][c] = c2[c] - d;
+      }
+      for(unsigned y = 0; y < 4; y++)
+        for(unsigned x = 0; x < 4; x++) set(x, y, paint[index(x, y)]);
+      return;
+    }
+    if(g2 < 0 || g2 > 31) {
+      // H mode
+      int h1[3] = {field(59, 4), field(56, 3) << 1 | field(52, 1), field(51, 1) << 3 | field(47, 3)};
+      int h2[3] = {field(43, 4), field(39, 4), field(35, 4)};
+
+      int order = (h1[0] << 8 | h1[1] << 4 | h1[2]) >= (h2[0] << 8 | h2[1] << 4 | h2[2]) ? 1 : 0;
+      int d = etc_distances[field(34, 1) << 2 | field(32, 1) << 1 | order];
+
+      int c1[3] = {expand4(h1[0]), expand4(h1[1]), expand4(h1[2])};
+      int c2[3] = {expand4(h2[0]), expand4(h2[1]), expand4(h2[2])};
+
+      int paint[4][3];
+      for(unsigned c = 0; c < 3; c++) {
+        paint[0][c] = c1[c] + d;
+        paint[1][c] = c1[c] - d;
+        paint[2][c] = c2[c] + d;
+        paint[3][c] = c2[c] - d;
+      }
+      for(unsigned y = 0; y < 4; y++)
+        for(unsigned x = 0; x < 4; x++) set(x, y, paint[index(x, y)]);
+      return;
+    }
+    if(b2 < 0 || b2 > 31) {
+      // planar mode: origin, horizontal and vertical colors
+      int o[3] = {expand6(field(57, 6)),
+                  expand7(field(56, 1) << 6 | field(49, 6)),
+                  expand6(field(48, 1) << 5 | field(43, 2) << 3 | field(39, 3))};
+      int h[3] = {expand6(field(34, 5) << 1 | field(32, 1)), expand7(field(25, 7)), expand6(field(19, 6))};
+      int v[3] = {expand6(field(13, 6)), expand7(field(6, 7)), expand6(field(0, 6))};
+
+      for(unsigned y = 0; y < 4; y++) {
+        for(unsigned x = 0; x < 4; x++) {
+          int rgb[3];
+          for(unsigned c = 0; c < 3; c++)
+            rgb[c] = ((int)x * (h[c] - o[c]) + (int)y * (v[c] - o[c]) + 4 * o[c] + 2) >> 2;
+          set(x, y, rgb);
+        }
+      }
+      return;
+    }
+
+    // differential mode
+    base[0][0] = expand5(r); base[0][1] = expand5(g); base[0][2] = expand5(b);
+    base[1][0] = expand5(r2); base[1][1] = expand5(g2); base[1][2] = expand5(b2);
+  }
+  else {
+    // individual mode
+    base[0][0] = expand4(field(60, 4)); base[0][1] = expand4(field(52, 4)); base[0][2] = expand4(field(44, 4));
+    base[1][0] = expand4(field(56, 4)); base[1][1] = expand4(field(48, 4)); base[1][2] = expand4(field(40, 4));
+  }
+
+  int tables[2] = {field(37, 3), field(34, 3)};
+  bool flip = field(32, 1) != 0;
+
+  for(unsigned y = 0; y < 4; y++) {
+    for(unsigned x = 0; x < 4; x++) {
+      // two 2x4 sub-blocks side by side, or two 4x2 sub-blocks on top of each other
+      unsigned sub = flip ? y / 2 : x / 2;
+
+      int i = index(x, y);
+      int modifier = etc_modifiers[tables[sub]][i & 1];
+      if(i & 2) modifier = -modifier;
+
+      int rgb[3] = {base[sub][0] + modifier, base[sub][1] + modifier, base[sub][2] + modifier};
+      set(x, y, rgb);
+    }
+  }
+}
+
+// EAC alpha block of ETC2 RGBA
+void decodeEAC(const byte *block, Texels &texels)
+{
+  uint64_t bits = bigEndian(block);
+
+  int base = (int)(bits >> 56);
+  int multiplier = (int)((bits >> 52) & 15);
+  const int *modifiers = eac_modifiers[(bits >> 48) & 15];
+
+  for(unsigned x = 0; x < 4; x++) {
+    for(unsigned y = 0; y < 4; y++) {
+      unsigned i = x * 4 + y;
+      int index = (int)((bits >> (45 - 3 * i)) & 7);
+
+      texels[y * 4 + x][3] = clamp255(base + modifiers[index] * multiplier);
+    }
+  }
+}
+
+}
+
+unsigned blockBytes(TextureFormat format)
+{
+  switch(format) {
+    case TextureFormat::RGB_S3TC_DXT1:
+    case TextureFormat::RGBA_S3TC_DXT1:
+    case TextureFormat::RED_RGTC1:
+    case TextureFormat::RGB_ETC2:
+      return 8;
+    case TextureFormat::RGBA_S3TC_DXT3:
+    case TextureFormat::RGBA_S3TC_DXT5:
+    case TextureFormat::RG_RGTC2:
+    case TextureFormat::RGBA_BPTC:
+    case TextureFormat::RGBA_ETC2_EAC:
+    case TextureFormat::RGBA_ASTC_4x4:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+bool decodable(TextureFormat format)
+{
+  return blockBytes(format) > 0 && format != TextureFormat::RGBA_BPTC && format != TextureFormat::RGBA_ASTC_4x4;
+}
+
+bool decode(TextureFormat format, const Mipmap &mipmap, std::vector<byte> &rgba)
+{
+  if(!decodable(format) || mipmap.width < 0 || mipmap.height < 0) return false;
+
+  size_t width = (size_t)mipmap.width, height = (size_t)mipmap.height;
+  if(mipmap.data.size() < imageBytes(format, width, height)) return false;
+
+  rgba.assign(width * height * 4, 0);
+
+  const byte *block = mipmap.data.data();
+  unsigned bytes = blockBytes(format);
+
+  for(size_t by = 0; by < height; by += 4) {
+    for(size_t bx = 0; bx < width; bx += 4, block += bytes) {
+
+      Texels texels;
+      for(unsigned i = 0; i < 16; i++) {
+        texels[i][0] = texels[i][1] = texels[i][2] = 0;
+        texels[i][3] = 255;
+      }
+
+      switch(format) {
+        case TextureFormat::RGB_S3TC_DXT1:
+          decodeColors(block, texels, false);
+          for(unsigned i = 0; i < 16; i++) texels[i][3] = 255;
+          break;
+        case TextureFormat::RGBA_S3TC_DXT1:
+          decodeColors(block, texels, false);
+          break;
+        case TextureFormat::RGBA_S3TC_DXT3:
+          decodeColors(block + 8, texels, true);
+          decodeExplicitAlpha(block, texels);
+          break;
+        case TextureFormat::RGBA_S3TC_DXT5:
+          decodeColors(block + 8, texels, true);
+          decodeInterpolated(block, texels, 3);
+          break;
+        case TextureFormat::RED_RGTC1:
+          decodeInterpolated(block, texels, 0);
+          break;
+        case TextureFormat::RG_RGTC2:
+          decodeInterpolated(block, texels, 0);
+          decodeInterpolated(block + 8, texels, 1);
+          break;
+        case TextureFormat::RGB_ETC2:
+          decodeETC2(block, texels);
+          break;
+        case TextureFormat::RGBA_ETC2_EAC:
+          decodeETC2(block + 8, texels);
+          decodeEAC(block, texels);
+          break;
+        default:
+          return false;
+      }
+
+      // blocks at the right and bottom edges may be partially outside the image
+      for(size_t y = 0; y < 4 && by + y < height; y++) {
+        size_t count = std::min<size_t>(4, width - bx);
+        memcpy(rgba.data() + ((by + y) * width + bx) * 4, texels[y * 4], count * 4);
+      }
+    }
+  }
+  return true;
+}
+
+}
+}
@@ -0,0 +1,45 @@
+//
+// Created by byter on 17.10.26.
+//
+
+#ifndef THREEPP_BLOCKDECODER_H
+#define THREEPP_BLOCKDECODER_H
+
+#include <vector>
+#include <threepp/util/osdecl.h>
+#include <threepp/util/Types.h>
+#include <threepp/Constants.h>
+
+namespace three {
+namespace blocks {
+
+/**
+ * @return the size in bytes of a 4x4 texel block of format, 0 if format is not block compressed
+ */
+DLX unsigned blockBytes(TextureFormat format);
+
+/**
+ * @return the size in bytes of a width x height image in the block compressed format
+ */
+inline size_t imageBytes(TextureFormat format, size_t width, size_t height)
+{
+  return ((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+/**
+ * @return true if images of format can be decoded on the CPU. That is the case for the S3TC,
+ * RGTC and ETC2 formats, but not for BPTC and ASTC
+ */
+DLX bool decodable(TextureFormat format);
+
+/**
+ * decode a block compressed image into RGBA with 8 bits per channel, for drivers that don't
+ * support format
+ *
+ * @return false if format is not decodable or mipmap holds less data than its size requires
+ */
+DLX bool decode(TextureFormat format, const Mipmap &mipmap, std::vector<byte> &rgba);
+
+}
+}
+#endif //THREEPP_BLOCKDECODER_H
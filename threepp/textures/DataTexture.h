@@ -55,6 +55,23 @@ public:
     return Ptr(new DataTexture(options, TextureDataT<float>::make(data, width, height), width, height));
   }
 
+  /**
+   * create a texture from prebuilt mipmap levels, largest first
+   *
+   * @param options the format is either RGB/RGBA or, if compressed is set, a block compressed
+   * format. The levels are uploaded as they are, uncompressed rows must be tightly packed
+   * (data textures unpack with an alignment of 1)
+   */
+  static Ptr make(const TextureOptions &options, const std::vector<Mipmap> &mipmaps, bool compressed)
+  {
+    const Mipmap &base = mipmaps.at(0);
+
+    Ptr p(new DataTexture(options, TextureDataT<byte>::make(base.data, base.width, base.height),
+                          base.width, base.height, compressed));
+    p->_mipmaps = mipmaps;
+    return p;
+  }
+
   static Ptr make(const TextureOptions &options, unsigned width, unsigned height)
   {
     switch(options.type) {
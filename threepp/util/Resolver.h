@@ -55,14 +55,16 @@ class Points;
 class Mesh;
 class DynamicMesh;
 class SkinnedMesh;
+class InstancedMesh;
 class Sprite;
 class ImmediateRenderObject;
 class LensFlare;
+class LOD;
 
 namespace object {
 using Typer = three::Typer<Camera, ArrayCamera, OrthographicCamera, PerspectiveCamera,
    Light, AmbientLight, DirectionalLight, HemisphereLight, PointLight, RectAreaLight, SpotLight, TargetLight,
-   Line, LineSegments, Mesh, DynamicMesh, Sprite, ImmediateRenderObject, Points, SkinnedMesh, LensFlare>;
+   Line, LineSegments, Mesh, DynamicMesh, Sprite, ImmediateRenderObject, Points, SkinnedMesh, InstancedMesh, LensFlare, LOD>;
 }
 
 class LinearGeometry;
@@ -45,6 +45,8 @@ public:
   }
 
   bool isSet() {return _isSet;}
+
+  void reset() {_isSet = false;}
 };
 
 struct Mipmap {
@@ -129,6 +131,8 @@ public:
   bool test(const Layers &layers) const {
     return (mask & layers.mask) != 0;
   }
+
+  unsigned value() const {return mask;}
 };
 
 struct Group {